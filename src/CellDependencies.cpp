@@ -0,0 +1,206 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class CellDependencies that finds out which code
+  cells depend on which others.
+*/
+
+#include "CellDependencies.h"
+#include "EditorCell.h"
+#include "GroupCell.h"
+#include "MaximaTokenizer.h"
+
+void CellDependencies::Symbols::Merge(const Symbols &other) {
+  defines.insert(other.defines.begin(), other.defines.end());
+  uses.insert(other.uses.begin(), other.uses.end());
+  changesGlobalState = changesGlobalState || other.changesGlobalState;
+  usesLabels = usesLabels || other.usesLabels;
+}
+
+bool CellDependencies::Symbols::Uses(const NameSet &definitions) const {
+  // Iterate over the smaller set
+  if (definitions.size() < uses.size()) {
+    for (auto const &name : definitions)
+      if (uses.count(name) != 0)
+        return true;
+  } else {
+    for (auto const &name : uses)
+      if (definitions.count(name) != 0)
+        return true;
+  }
+  return false;
+}
+
+const CellDependencies::NameSet &CellDependencies::GlobalStateFunctions() {
+  static const NameSet functions = {
+    wxS("load"), wxS("batchload"), wxS("batch"), wxS("loadfile"),
+    wxS("declare"), wxS("assume"), wxS("forget"), wxS("kill"),
+    wxS("remvalue"), wxS("remfunction"), wxS("remarray"), wxS("remove"),
+    wxS("tellsimp"), wxS("tellsimpafter"), wxS("defrule"), wxS("defmatch"),
+    wxS("matchdeclare"), wxS("let"), wxS("remlet"), wxS("remrule"),
+    wxS("infix"), wxS("prefix"), wxS("postfix"), wxS("nary"),
+    wxS("matchfix"), wxS("nofix"), wxS("alias"), wxS("depends"),
+    wxS("gradef"), wxS("atvalue"), wxS("put"), wxS("ordergreat"),
+    wxS("orderless"), wxS("unorder"), wxS("texput"), wxS("reset"),
+    wxS("set_plot_option"), wxS("set_draw_defaults"), wxS("newcontext"),
+    wxS("supcontext"), wxS("activate"), wxS("deactivate"),
+    wxS("killcontext"), wxS("context"), wxS("setup_autoload"),
+    wxS("to_lisp"), wxS("ev"), wxS("apply"), wxS("funmake"), wxS("eval_string"),
+    wxS("parse_string"), wxS("translate"), wxS("compile"), wxS("compfile"),
+    wxS("chdir"), wxS("system"), wxS("random"), wxS("set_random_state"),
+    wxS("with_stdout"), wxS("writefile"), wxS("closefile"), wxS("save"),
+    wxS("stringout"), wxS("tex"), wxS("opena"), wxS("openw")};
+  return functions;
+}
+
+bool CellDependencies::IsLabelReference(const wxString &name) {
+  if ((name == wxS("%")) || (name == wxS("_")) || (name == wxS("__")) ||
+      (name == wxS("%th")) || (name == wxS("labels")) || (name == wxS("linenum")))
+    return true;
+  if ((name.Length() < 3) || (!name.StartsWith(wxS("%"))))
+    return false;
+  if ((name[1] != wxS('i')) && (name[1] != wxS('o')) && (name[1] != wxS('t')))
+    return false;
+  for (std::size_t i = 2; i < name.Length(); i++)
+    if ((name[i] < wxS('0')) || (name[i] > wxS('9')))
+      return false;
+  return true;
+}
+
+CellDependencies::Symbols CellDependencies::Analyze(
+  GroupCell *cell, const OptionVariableFunction &isOptionVariable) {
+  Symbols symbols;
+  EditorCell *editor = cell->GetEditable();
+  if ((cell->GetGroupType() != GC_TYPE_CODE) || (!editor))
+    return symbols;
+
+  // The tokens of the current command, without whitespace and comments
+  std::vector<const MaximaTokenizer::Token *> command;
+  auto const analyzeCommand = [&]() {
+    if (command.empty())
+      return;
+    for (auto token : command) {
+      TextStyle const style = token->GetTextStyle();
+      if (style == TS_CODE_LISP)
+        symbols.changesGlobalState = true;
+      if ((style == TS_CODE_VARIABLE) || (style == TS_CODE_FUNCTION)) {
+        symbols.uses.insert(token->GetText());
+        if (GlobalStateFunctions().count(token->GetText()) != 0)
+          symbols.changesGlobalState = true;
+        if (IsLabelReference(token->GetText()))
+          symbols.usesLabels = true;
+      }
+    }
+
+    // Is this a definition of the form name:..., name[...]:=... or
+    // f(...):=... or define(f(...), ...)?
+    wxString name;
+    if ((command[0]->GetTextStyle() == TS_CODE_FUNCTION) &&
+        (command[0]->GetText() == wxS("define")) && (command.size() > 2) &&
+        (command[1]->GetText() == wxS("(")))
+      name = command[2]->GetText();
+    else {
+      if ((command[0]->GetTextStyle() != TS_CODE_VARIABLE) &&
+          (command[0]->GetTextStyle() != TS_CODE_FUNCTION))
+        return;
+      name = command[0]->GetText();
+      std::size_t pos = 1;
+      if ((pos < command.size()) && ((command[pos]->GetText() == wxS("(")) ||
+                                     (command[pos]->GetText() == wxS("[")))) {
+        int depth = 0;
+        for (; pos < command.size(); pos++) {
+          wxString const &text = command[pos]->GetText();
+          if ((text == wxS("(")) || (text == wxS("[")))
+            depth++;
+          if ((text == wxS(")")) || (text == wxS("]")))
+            depth--;
+          if (depth == 0) {
+            pos++;
+            break;
+          }
+        }
+      }
+      if ((pos >= command.size()) || (command[pos]->GetText() != wxS(":")))
+        return;
+    }
+    symbols.defines.insert(name);
+    if (isOptionVariable(name))
+      symbols.changesGlobalState = true;
+  };
+
+  for (auto const &token : editor->GetAllTokens()) {
+    if (token.GetTextStyle() == TS_CODE_ENDOFLINE) {
+      analyzeCommand();
+      command.clear();
+      continue;
+    }
+    if (token.GetTextStyle() == TS_CODE_COMMENT)
+      continue;
+    wxString trimmed = token.GetText();
+    trimmed.Trim(true);
+    trimmed.Trim(false);
+    if (trimmed.IsEmpty())
+      continue;
+    command.push_back(&token);
+  }
+  analyzeCommand();
+  return symbols;
+}
+
+void CellDependencies::AppendWithHiddenTree(GroupCell *cell,
+                                            std::vector<GroupCell *> &cells) {
+  cells.push_back(cell);
+  if (cell->GetHiddenTree())
+    for (auto &hidden : OnList(cell->GetHiddenTree()))
+      AppendWithHiddenTree(&hidden, cells);
+}
+
+std::vector<GroupCell *> CellDependencies::CellsToUpdate(
+  GroupCell *tree, const std::function<bool(GroupCell *cell)> &isStale,
+  const OptionVariableFunction &isOptionVariable) {
+  std::vector<GroupCell *> result;
+  if (!tree)
+    return result;
+
+  std::vector<GroupCell *> cells;
+  for (auto &cell : OnList(tree))
+    AppendWithHiddenTree(&cell, cells);
+
+  // The names whose values change if the cells in result are evaluated
+  NameSet changedNames;
+  // Does evaluating the cells in result change maxima's global state?
+  bool globalStateChanged = false;
+  for (auto *cell : cells) {
+    if ((cell->GetGroupType() != GC_TYPE_CODE) || (!cell->GetEditable()))
+      continue;
+    Symbols const symbols = Analyze(cell, isOptionVariable);
+    // Once a cell is evaluated again all later label numbers change.
+    if (isStale(cell) || globalStateChanged ||
+        (symbols.usesLabels && !result.empty()) ||
+        symbols.Uses(changedNames)) {
+      result.push_back(cell);
+      changedNames.insert(symbols.defines.begin(), symbols.defines.end());
+      globalStateChanged = globalStateChanged || symbols.changesGlobalState;
+    }
+  }
+  return result;
+}
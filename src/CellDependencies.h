@@ -0,0 +1,98 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class CellDependencies that finds out which code
+  cells depend on which others.
+*/
+
+#ifndef CELLDEPENDENCIES_H
+#define CELLDEPENDENCIES_H
+
+#include <functional>
+#include <unordered_set>
+#include <vector>
+#include <wx/hashmap.h>
+#include <wx/string.h>
+
+class GroupCell;
+
+/*! Finds out which names code cells define and use
+
+  The analysis only looks at the tokens MaximaTokenizer has found in the
+  cells' code. It therefore errs on the safe side: A cell that might change
+  anything beyond the names it assigns values to is marked as changing the
+  global state, which makes all cells that follow it depend on it.
+*/
+class CellDependencies
+{
+public:
+  //! A set of names
+  using NameSet = std::unordered_set<wxString, wxStringHash>;
+  //! Tells if an assignment to a name changes one of maxima's option variables
+  using OptionVariableFunction = std::function<bool(const wxString &name)>;
+
+  //! What a cell or a group of cells defines and uses
+  struct Symbols
+  {
+    //! The variables and functions that are assigned a value or definition
+    NameSet defines;
+    //! All variables and functions that are mentioned
+    NameSet uses;
+    //! Do all later cells depend on this one?
+    bool changesGlobalState = false;
+    //! Does this cell refer to input or output labels like %o1?
+    bool usesLabels = false;
+
+    //! Adds the symbols of another cell
+    void Merge(const Symbols &other);
+    //! Does this cell use a name the other one defines?
+    bool Uses(const NameSet &definitions) const;
+  };
+
+  //! Finds the names a code cell defines and uses
+  static Symbols Analyze(GroupCell *cell,
+                         const OptionVariableFunction &isOptionVariable);
+
+  /*! Finds the code cells that need to be evaluated in order to bring maxima
+    up to date
+
+    \param tree The first cell of the worksheet. Folded cells are included.
+    \param isStale Tells if a cell has been changed since its last evaluation
+    \param isOptionVariable Tells if a name is one of maxima's option variables
+    \return The stale cells and all cells that depend on them, in the order
+            they appear in the worksheet.
+  */
+  static std::vector<GroupCell *> CellsToUpdate(
+    GroupCell *tree, const std::function<bool(GroupCell *cell)> &isStale,
+    const OptionVariableFunction &isOptionVariable);
+
+  //! Appends a cell and the cells folded into it to a list of cells
+  static void AppendWithHiddenTree(GroupCell *cell, std::vector<GroupCell *> &cells);
+
+private:
+  //! Functions whose effect isn't limited to the names they are called with
+  static const NameSet &GlobalStateFunctions();
+  //! Does a name refer to one of maxima's input or output labels?
+  static bool IsLabelReference(const wxString &name);
+};
+
+#endif // CELLDEPENDENCIES_H
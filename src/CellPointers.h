@@ -33,6 +33,7 @@ template<class T> class wxScrolled;
 typedef wxScrolled<wxWindow> wxScrolledCanvas;
 
 class EditorCell;
+class LazyMathCell;
 class TextCell;
 
 /*! The storage for pointers to cells.
@@ -109,6 +110,8 @@ public:
   CellPtr<GroupCell> m_lastWorkingGroup;
   //! The textcell the text maxima is sending us was ending in.
   CellPtr<TextCell> m_currentTextCell;
+  //! The big outputs that have to be converted to cells or that can be released
+  std::vector<CellPtr<LazyMathCell>> m_lazyCellsToUpdate;
   /*! The group cell maxima is currently working on.
 
     NULL means that maxima isn't currently evaluating a cell.
@@ -318,6 +318,40 @@ void ConfigDialogue::SetCheckboxValues() {
                                         "starting a fresh maxima process every time the worksheet is to be "
                                         "re-evaluated. As this needs a little bit of time this switch allows "
                                         "to disable this behavior."));
+  m_framedMaximaOutput->SetToolTip(
+                                   _("Makes maxima tell wxMaxima the length of each formula or "
+                                     "status message before sending it, which makes big outputs "
+                                     "faster to receive."));
+  m_pipelineCommands->SetToolTip(
+                                 _("Sends the next few commands to maxima while it still works on the "
+                                   "current one if they cannot make maxima ask a question. This makes "
+                                   "long lists of short commands evaluate much faster. If one of these "
+                                   "commands fails the commands maxima already has received are "
+                                   "evaluated before the evaluation is aborted."));
+  m_cacheCompiledLisp->SetToolTip(
+                                  _("Lets maxima compile the Lisp part of wxMaxima once and load the "
+                                    "compiled file from wxMaxima's cache directory afterwards, which "
+                                    "makes maxima start faster. Only works if maxima can read the "
+                                    "files wxMaxima writes, which isn't the case if it runs in a "
+                                    "sandbox of its own, for example."));
+  m_warmSpareMaxima->SetToolTip(
+                                _("Keeps an additional maxima process running in the background "
+                                  "that \"Restart Maxima\" and new windows can use instead of "
+                                  "waiting for a new maxima to start up."));
+  m_warmSpareMaximaIdleMinutes->SetToolTip(
+                                           _("The spare maxima is closed if it hasn't been used for this "
+                                             "many minutes."));
+  m_warmSpareMaximaMinFreeMegabytes->SetToolTip(
+                                                _("No spare maxima is kept if less memory than this is free."));
+  m_xmlInspectorMegabytes->SetToolTip(
+                                      _("If the data the raw XML monitor shows exceeds this size the "
+                                        "oldest data is dropped."));
+  m_output1DChunkLength->SetToolTip(
+                                    _("If display2d is false maxima's results are displayed as plain "
+                                      "text. Lines of these results or of other text maxima outputs "
+                                      "that are longer than this are split into several "
+                                      "pieces that the worksheet can break between, which makes "
+                                      "huge results faster to display. 0 means: Never split lines."));
   m_maximaUserLocation->SetToolTip(
                                    _("Enter the path to the Maxima executable."));
   m_additionalParameters->SetToolTip(_("Additional parameters for Maxima"
@@ -526,6 +560,15 @@ void ConfigDialogue::SetCheckboxValues() {
   m_keepPercentWithSpecials->SetValue(configuration->CheckKeepPercent());
   m_abortOnError->SetValue(configuration->GetAbortOnError());
   m_restartOnReEvaluation->SetValue(configuration->RestartOnReEvaluation());
+  m_framedMaximaOutput->SetValue(configuration->FramedMaximaOutput());
+  m_pipelineCommands->SetValue(configuration->PipelineCommands());
+  m_cacheCompiledLisp->SetValue(configuration->CacheCompiledLisp());
+  m_warmSpareMaxima->SetValue(configuration->WarmSpareMaxima());
+  m_warmSpareMaximaIdleMinutes->SetValue(configuration->WarmSpareMaximaIdleMinutes());
+  m_warmSpareMaximaMinFreeMegabytes->SetValue(
+                                              configuration->WarmSpareMaximaMinFreeMegabytes());
+  m_xmlInspectorMegabytes->SetValue(configuration->XmlInspectorMegabytes());
+  m_output1DChunkLength->SetValue(configuration->Output1DChunkLength());
   m_defaultFramerate->SetValue(m_configuration->DefaultFramerate());
   m_maxGnuplotMegabytes->SetValue(configuration->MaxGnuplotMegabytes());
   m_autosaveMinutes->SetValue(configuration->AutosaveMinutes());
@@ -1554,6 +1597,58 @@ wxWindow *ConfigDialogue::CreateMaximaPanel() {
     new wxCheckBox(handlingSizer->GetStaticBox(), wxID_ANY,
                    _("Start a new maxima for each re-evaluation"));
   handlingSizer->Add(m_restartOnReEvaluation, wxSizerFlags());
+  m_framedMaximaOutput =
+    new wxCheckBox(handlingSizer->GetStaticBox(), wxID_ANY,
+                   _("Receive maxima's output in length-prefixed frames"));
+  handlingSizer->Add(m_framedMaximaOutput, wxSizerFlags());
+  m_pipelineCommands =
+    new wxCheckBox(handlingSizer->GetStaticBox(), wxID_ANY,
+                   _("Send short commands before maxima has finished the previous one"));
+  handlingSizer->Add(m_pipelineCommands, wxSizerFlags());
+  m_cacheCompiledLisp =
+    new wxCheckBox(handlingSizer->GetStaticBox(), wxID_ANY,
+                   _("Let maxima keep a compiled copy of wxMaxima's Lisp part"));
+  handlingSizer->Add(m_cacheCompiledLisp, wxSizerFlags());
+  m_warmSpareMaxima =
+    new wxCheckBox(handlingSizer->GetStaticBox(), wxID_ANY,
+                   _("Keep a spare maxima running for restarts and new windows"));
+  handlingSizer->Add(m_warmSpareMaxima, wxSizerFlags());
+  wxFlexGridSizer *spareSizer = new wxFlexGridSizer(2);
+  spareSizer->Add(new wxStaticText(handlingSizer->GetStaticBox(), wxID_ANY,
+                                   _("Close an unused spare maxima after [minutes]:")),
+                  wxSizerFlags().Center().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  m_warmSpareMaximaIdleMinutes = new wxSpinCtrl(
+                                                handlingSizer->GetStaticBox(), wxID_ANY, wxEmptyString, wxDefaultPosition,
+                                                wxSize(150 * GetContentScaleFactor(), -1), wxSP_ARROW_KEYS, 1, 1440);
+  spareSizer->Add(m_warmSpareMaximaIdleMinutes,
+                  wxSizerFlags().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  spareSizer->Add(new wxStaticText(handlingSizer->GetStaticBox(), wxID_ANY,
+                                   _("Only keep a spare maxima if this much memory is free [MB]:")),
+                  wxSizerFlags().Center().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  m_warmSpareMaximaMinFreeMegabytes = new wxSpinCtrl(
+                                                     handlingSizer->GetStaticBox(), wxID_ANY, wxEmptyString, wxDefaultPosition,
+                                                     wxSize(150 * GetContentScaleFactor(), -1), wxSP_ARROW_KEYS, 0, 65536);
+  spareSizer->Add(m_warmSpareMaximaMinFreeMegabytes,
+                  wxSizerFlags().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  handlingSizer->Add(spareSizer, wxSizerFlags().Border(wxLEFT, 20 * GetContentScaleFactor()));
+  wxFlexGridSizer *outputSizer = new wxFlexGridSizer(2);
+  outputSizer->Add(new wxStaticText(handlingSizer->GetStaticBox(), wxID_ANY,
+                                    _("Memory for the raw XML monitor [MB]:")),
+                   wxSizerFlags().Center().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  m_xmlInspectorMegabytes = new wxSpinCtrl(
+                                           handlingSizer->GetStaticBox(), wxID_ANY, wxEmptyString, wxDefaultPosition,
+                                           wxSize(150 * GetContentScaleFactor(), -1), wxSP_ARROW_KEYS, 1, 4096);
+  outputSizer->Add(m_xmlInspectorMegabytes,
+                   wxSizerFlags().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  outputSizer->Add(new wxStaticText(handlingSizer->GetStaticBox(), wxID_ANY,
+                                    _("Split lines of plain text results after [chars]:")),
+                   wxSizerFlags().Center().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  m_output1DChunkLength = new wxSpinCtrl(
+                                         handlingSizer->GetStaticBox(), wxID_ANY, wxEmptyString, wxDefaultPosition,
+                                         wxSize(150 * GetContentScaleFactor(), -1), wxSP_ARROW_KEYS, 0, 1000000);
+  outputSizer->Add(m_output1DChunkLength,
+                   wxSizerFlags().Border(wxUP | wxDOWN, 5 * GetContentScaleFactor()));
+  handlingSizer->Add(outputSizer, wxSizerFlags());
   vsizer->Add(handlingSizer, wxSizerFlags().Expand().Border(
                                                             wxALL, 5 * GetContentScaleFactor()));
 
@@ -2055,13 +2150,14 @@ wxWindow *ConfigDialogue::CreateStylePanel() {
       } while((entry != NULL) && (entry->GetName() != "content.xml"));
     wxXmlDocument xmlText;
     xmlText.Load(zipstream);
-    wxXmlNode *xmlcells = xmlText.GetRoot();
-    if (xmlcells)
-      xmlcells = xmlcells->GetChildren();
+    XMLTokenStream xml(xmlText.GetRoot());
+    // Skip the root element's start tag
+    xml.Next();
+    xml.Next();
 
     MathParser mp(m_configuration.get());
     CellListBuilder<GroupCell> tree;
-    tree.DynamicAppend(mp.ParseTag(xmlcells));
+    tree.DynamicAppend(mp.ParseTag(xml));
     m_sampleWorksheet->InsertGroupCells(std::move(tree));
   }
   vsizer->Add(m_sampleWorksheet, wxSizerFlags(1).Expand().
@@ -2108,6 +2204,15 @@ void ConfigDialogue::WriteSettings() {
   configuration->MaxClipbrdBitmapMegabytes(
                                            m_maxClipbrdBitmapMegabytes->GetValue());
   configuration->RestartOnReEvaluation(m_restartOnReEvaluation->GetValue());
+  configuration->FramedMaximaOutput(m_framedMaximaOutput->GetValue());
+  configuration->PipelineCommands(m_pipelineCommands->GetValue());
+  configuration->CacheCompiledLisp(m_cacheCompiledLisp->GetValue());
+  configuration->WarmSpareMaxima(m_warmSpareMaxima->GetValue());
+  configuration->WarmSpareMaximaIdleMinutes(m_warmSpareMaximaIdleMinutes->GetValue());
+  configuration->WarmSpareMaximaMinFreeMegabytes(
+                                                 m_warmSpareMaximaMinFreeMegabytes->GetValue());
+  configuration->XmlInspectorMegabytes(m_xmlInspectorMegabytes->GetValue());
+  configuration->Output1DChunkLength(m_output1DChunkLength->GetValue());
   configuration->MaximaUserLocation(m_maximaUserLocation->GetValue());
   configuration->AutodetectMaxima(m_autodetectMaxima->GetValue());
   configuration->HelpBrowserUserLocation(m_helpBrowserUserLocation->GetValue());
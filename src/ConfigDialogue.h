@@ -284,6 +284,14 @@ protected:
   wxCheckBox *m_abortOnError;
   wxCheckBox *m_offerKnownAnswers;
   wxCheckBox *m_restartOnReEvaluation;
+  wxCheckBox *m_framedMaximaOutput;
+  wxCheckBox *m_pipelineCommands;
+  wxCheckBox *m_cacheCompiledLisp;
+  wxCheckBox *m_warmSpareMaxima;
+  wxSpinCtrl *m_warmSpareMaximaIdleMinutes;
+  wxSpinCtrl *m_warmSpareMaximaMinFreeMegabytes;
+  wxSpinCtrl *m_xmlInspectorMegabytes;
+  wxSpinCtrl *m_output1DChunkLength;
   wxCheckBox *m_wrapLatexMath;
   wxCheckBox *m_usesvg;
   wxCheckBox *m_antialiasLines;
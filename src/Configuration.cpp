@@ -349,6 +349,14 @@ void Configuration::ResetAllToDefaults() {
   m_displayedDigits = 100;
   m_autoIndent = true;
   m_restartOnReEvaluation = true;
+  m_framedMaximaOutput = false;
+  m_pipelineCommands = false;
+  m_cacheCompiledLisp = false;
+  m_warmSpareMaxima = false;
+  m_warmSpareMaximaIdleMinutes = 30;
+  m_warmSpareMaximaMinFreeMegabytes = 1024;
+  m_xmlInspectorMegabytes = 16;
+  m_output1DChunkLength = 10000;
   m_matchParens = true;
   m_showMatchingParens = true;
   m_insertAns = false;
@@ -848,6 +856,19 @@ void Configuration::ReadConfig() {
     m_displayedDigits = 20;
 
   config->Read(wxS("restartOnReEvaluation"), &m_restartOnReEvaluation);
+  config->Read(wxS("framedMaximaOutput"), &m_framedMaximaOutput);
+  config->Read(wxS("pipelineCommands"), &m_pipelineCommands);
+  config->Read(wxS("cacheCompiledLisp"), &m_cacheCompiledLisp);
+  config->Read(wxS("warmSpareMaxima"), &m_warmSpareMaxima);
+  config->Read(wxS("warmSpareMaximaIdleMinutes"), &m_warmSpareMaximaIdleMinutes);
+  config->Read(wxS("warmSpareMaximaMinFreeMegabytes"),
+               &m_warmSpareMaximaMinFreeMegabytes);
+  config->Read(wxS("xmlInspectorMegabytes"), &m_xmlInspectorMegabytes);
+  if (m_xmlInspectorMegabytes < 1)
+    m_xmlInspectorMegabytes = 1;
+  config->Read(wxS("output1DChunkLength"), &m_output1DChunkLength);
+  if (m_output1DChunkLength < 0)
+    m_output1DChunkLength = 0;
 
   config->Read(wxS("matchParens"), &m_matchParens);
   config->Read(wxS("showMatchingParens"), &m_showMatchingParens);
@@ -1572,6 +1593,15 @@ void Configuration::WriteStyles(wxConfigBase *config) {
   config->Write(wxS("insertAns"), m_insertAns);
   config->Write(wxS("openHCaret"), m_openHCaret);
   config->Write(wxS("restartOnReEvaluation"), m_restartOnReEvaluation);
+  config->Write(wxS("framedMaximaOutput"), m_framedMaximaOutput);
+  config->Write(wxS("pipelineCommands"), m_pipelineCommands);
+  config->Write(wxS("cacheCompiledLisp"), m_cacheCompiledLisp);
+  config->Write(wxS("warmSpareMaxima"), m_warmSpareMaxima);
+  config->Write(wxS("warmSpareMaximaIdleMinutes"), m_warmSpareMaximaIdleMinutes);
+  config->Write(wxS("warmSpareMaximaMinFreeMegabytes"),
+                m_warmSpareMaximaMinFreeMegabytes);
+  config->Write(wxS("xmlInspectorMegabytes"), m_xmlInspectorMegabytes);
+  config->Write(wxS("output1DChunkLength"), m_output1DChunkLength);
   config->Write(wxS("invertBackground"), m_invertBackground);
   config->Write("recentItems", m_recentItems);
   config->Write(wxS("undoLimit"), m_undoLimit);
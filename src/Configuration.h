@@ -30,6 +30,7 @@
 #include <wx/hashmap.h>
 #include "LoggingMessageDialog.h"
 #include "TextStyle.h"
+#include "TextMetrics.h"
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -274,6 +275,9 @@ public:
   void SetRecalcDC(wxDC *dc)
     { m_dc = dc; }
 
+  //! Measures text without needing GetRecalcDC(), even in background threads
+  TextMetrics &GetTextMetrics() { return m_textMetrics; }
+
   wxString GetFontName(TextStyle ts = TS_CODE_DEFAULT) const;
 
   // cppcheck-suppress functionStatic
@@ -371,6 +375,7 @@ public:
   void FontChanged()
     {
       m_charsInFont.clear();
+      m_textMetrics.Clear();
     }
 
   //! Calculates the default line width for the worksheet
@@ -631,6 +636,59 @@ public:
 
   void RestartOnReEvaluation(bool arg){ m_restartOnReEvaluation = arg; }
 
+  //! Ask maxima to tell us the length of its XML output before sending it?
+  bool FramedMaximaOutput() const
+    { return m_framedMaximaOutput; }
+
+  void FramedMaximaOutput(bool arg){ m_framedMaximaOutput = arg; }
+
+  /*! Send commands to maxima before it has finished the previous one?
+
+    Only commands that cannot make maxima ask a question are followed by
+    commands that are sent ahead.
+  */
+  bool PipelineCommands() const
+    { return m_pipelineCommands; }
+
+  void PipelineCommands(bool arg){ m_pipelineCommands = arg; }
+
+  /*! Let maxima load a compiled wxMathML.lisp from wxMaxima's cache directory?
+
+    Only works if maxima can read the files wxMaxima writes, which isn't the
+    case if it runs in a sandbox of its own, for example.
+  */
+  bool CacheCompiledLisp() const
+    { return m_cacheCompiledLisp; }
+
+  void CacheCompiledLisp(bool arg){ m_cacheCompiledLisp = arg; }
+
+  //! Keep a spare maxima running for restarts and new windows?
+  bool WarmSpareMaxima() const
+    { return m_warmSpareMaxima; }
+
+  void WarmSpareMaxima(bool arg){ m_warmSpareMaxima = arg; }
+
+  //! The number of minutes an unused spare maxima is kept running
+  long WarmSpareMaximaIdleMinutes() const {return m_warmSpareMaximaIdleMinutes;}
+  void WarmSpareMaximaIdleMinutes(long minutes)
+    {m_warmSpareMaximaIdleMinutes = minutes;}
+
+  //! The free memory [in Megabytes] below which no spare maxima is kept
+  long WarmSpareMaximaMinFreeMegabytes() const
+    {return m_warmSpareMaximaMinFreeMegabytes;}
+  void WarmSpareMaximaMinFreeMegabytes(long megaBytes)
+    {m_warmSpareMaximaMinFreeMegabytes = megaBytes;}
+
+  //! The memory [in Megabytes] the raw XML monitor may use for the data it shows
+  long XmlInspectorMegabytes() const {return m_xmlInspectorMegabytes;}
+  void XmlInspectorMegabytes(long megaBytes)
+    {m_xmlInspectorMegabytes = (megaBytes < 1) ? 1 : megaBytes;}
+
+  //! The number of chars after which lines of plain text or streamed output are split; 0 = never
+  long Output1DChunkLength() const {return m_output1DChunkLength;}
+  void Output1DChunkLength(long chars)
+    {m_output1DChunkLength = (chars < 0) ? 0 : chars;}
+
   //! Reads the size of the current worksheet's visible window. See SetCanvasSize
   wxSize GetCanvasSize() const
     { return m_canvasSize; }
@@ -1072,6 +1130,7 @@ private:
   bool m_latin2greek;
   double m_zoomFactor;
   wxDC *m_dc;
+  TextMetrics m_textMetrics{this};
   wxString m_maximaShareDir;
   bool m_forceUpdate;
   bool m_clipToDrawRegion = true;
@@ -1079,6 +1138,14 @@ private:
   wxString m_maximaParameters;
   bool m_keepPercent;
   bool m_restartOnReEvaluation;
+  bool m_framedMaximaOutput;
+  bool m_pipelineCommands;
+  bool m_cacheCompiledLisp;
+  bool m_warmSpareMaxima;
+  long m_warmSpareMaximaIdleMinutes;
+  long m_warmSpareMaximaMinFreeMegabytes;
+  long m_xmlInspectorMegabytes;
+  long m_output1DChunkLength;
   wxString m_fontCMRI, m_fontCMSY, m_fontCMEX, m_fontCMMI, m_fontCMTI;
   bool m_printing;
   long m_lineWidth_em;
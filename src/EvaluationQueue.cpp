@@ -45,6 +45,10 @@ void EvaluationQueue::Clear() {
   m_size = 0;
   m_commands.clear();
   m_workingGroupChanged = false;
+  m_commandSent = false;
+  m_commandsSentAhead = 0;
+  m_inFlight.clear();
+  m_clearAfterSentCommands = false;
 }
 
 bool EvaluationQueue::IsInQueue(GroupCell *gr) const {
@@ -54,13 +58,32 @@ bool EvaluationQueue::IsInQueue(GroupCell *gr) const {
 void EvaluationQueue::Remove(GroupCell *gr) {
   bool removeFirst = IsLastInQueue(gr);
   auto pos = std::find(m_queue.begin(), m_queue.end(), gr);
-  if (pos != m_queue.end())
-    m_queue.erase(pos);
+  if (pos == m_queue.end())
+    return;
+
+  // Maxima will still answer the commands from this cell it already has
+  // received. Their output and their prompts must neither end up in nor
+  // make us skip the commands of other cells.
+  std::size_t removedSent = 0;
+  for (auto &cell : m_inFlight)
+    if (cell == gr) {
+      cell = NULL;
+      removedSent++;
+    }
+  if (removeFirst && m_commandSent && (removedSent > 0)) {
+    m_commandSent = false;
+    m_commandsSentAhead -= removedSent - 1;
+  } else
+    m_commandsSentAhead -= removedSent;
+
+  m_queue.erase(pos);
   m_size = m_queue.size();
   if (removeFirst) {
     m_commands.clear();
+    m_commandSent = false;
+    m_workingGroupChanged = true;
     if (!m_queue.empty())
-      AddTokens(gr);
+      AddTokens(GetCell());
   }
 }
 
@@ -95,6 +118,11 @@ void EvaluationQueue::AddHiddenTreeToQueue(const GroupCell *gr) {
 }
 
 void EvaluationQueue::RemoveFirst() {
+  m_commandSent = false;
+  if (m_clearAfterSentCommands && (m_commandsSentAhead == 0)) {
+    Clear();
+    return;
+  }
   if (!m_commands.empty()) {
     m_workingGroupChanged = false;
     m_commands.erase(m_commands.begin());
@@ -112,6 +140,10 @@ void EvaluationQueue::RemoveFirst() {
 }
 
 void EvaluationQueue::AddTokens(const GroupCell *cell) {
+  Tokenize(cell, m_commands);
+}
+
+void EvaluationQueue::Tokenize(const GroupCell *cell, std::vector<Command> &commands) {
   if (cell == NULL)
     return;
   wxString token;
@@ -128,7 +160,7 @@ void EvaluationQueue::AddTokens(const GroupCell *cell) {
       token.Trim(true);
       token.Trim(false);
       if (!token.IsEmpty())
-        m_commands.emplace_back(token, index);
+        commands.emplace_back(token, index);
       token.Clear();
       continue;
     }
@@ -137,7 +169,7 @@ void EvaluationQueue::AddTokens(const GroupCell *cell) {
       token.Trim(true);
       token.Trim(false);
       if (!token.IsEmpty())
-        m_commands.emplace_back(token, index);
+        commands.emplace_back(token, index);
       token.Clear();
       continue;
     }
@@ -145,7 +177,7 @@ void EvaluationQueue::AddTokens(const GroupCell *cell) {
   token.Trim(true);
   token.Trim(false);
   if (!token.IsEmpty())
-    m_commands.emplace_back(token, index);
+    commands.emplace_back(token, index);
 }
 
 GroupCell *EvaluationQueue::GetCell() {
@@ -155,6 +187,64 @@ GroupCell *EvaluationQueue::GetCell() {
     return m_queue.front();
 }
 
+void EvaluationQueue::SetCommandSent() {
+  if (m_commands.empty())
+    return;
+  m_commandSent = true;
+  m_inFlight.push_back(m_queue.front());
+}
+
+void EvaluationQueue::CommandSentAhead(GroupCell *cell) {
+  m_commandsSentAhead++;
+  m_inFlight.push_back(cell);
+}
+
+bool EvaluationQueue::TakeCommandSentAhead() {
+  if (!m_commandSent && (m_commandsSentAhead > 0) && !m_commands.empty()) {
+    m_commandsSentAhead--;
+    m_commandSent = true;
+    return true;
+  }
+  return false;
+}
+
+wxString EvaluationQueue::PeekCommand(std::size_t n, GroupCell **cell) const {
+  *cell = NULL;
+  if (m_queue.empty())
+    return {};
+  if (n < m_commands.size()) {
+    *cell = m_queue.front();
+    return m_commands[n].GetString();
+  }
+  n -= m_commands.size();
+  std::vector<Command> commands;
+  for (auto i = m_queue.begin() + 1; i != m_queue.end(); ++i) {
+    commands.clear();
+    Tokenize(*i, commands);
+    if (n < commands.size()) {
+      *cell = *i;
+      return commands[n].GetString();
+    }
+    n -= commands.size();
+  }
+  return {};
+}
+
+bool EvaluationQueue::IgnorePrompt() {
+  if (m_inFlight.empty())
+    return false;
+  bool const removed = !m_inFlight.front();
+  m_inFlight.pop_front();
+  return removed;
+}
+
+void EvaluationQueue::ClearAfterSentCommands() {
+  if (m_commandsSentAhead == 0)
+    Clear();
+  else
+    m_clearAfterSentCommands = true;
+}
+
 wxString EvaluationQueue::GetCommand() {
   if (m_commands.empty())
     return {};
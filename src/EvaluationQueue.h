@@ -35,6 +35,7 @@
 #include "precomp.h"
 #include "GroupCell.h"
 #include <wx/arrstr.h>
+#include <deque>
 #include <vector>
 #include <utility>
 
@@ -82,8 +83,28 @@ private:
   //! The groupCells in the evaluation Queue.
   std::vector<GroupCell *> m_queue;
 
+  /*! Has maxima already received the first command in the queue?
+
+    Commands that have been sent ahead don't count as sent before they have
+    become the first command and TakeCommandSentAhead() has been called.
+  */
+  bool m_commandSent = false;
+  //! The number of commands after the first one maxima already has received
+  std::size_t m_commandsSentAhead = 0;
+  /*! The cells of all commands maxima has received, but not answered with a prompt
+
+    In the order they have been sent, which is the order maxima answers them
+    in. Commands from cells that have been removed from the queue while maxima
+    was working on them are NULL: Their output and their prompt are discarded.
+  */
+  std::deque<GroupCell *> m_inFlight;
+  //! Clear the queue as soon as maxima has finished all commands it has received?
+  bool m_clearAfterSentCommands = false;
+
   //! Adds all commands in commandString as separate tokens to the queue.
   void AddTokens(const GroupCell *cell);
+  //! Adds all commands in the cell as separate tokens to commands.
+  static void Tokenize(const GroupCell *cell, std::vector<Command> &commands);
 
 public:
   /*! Query for the label the user has assigned to the current command.
@@ -157,6 +178,56 @@ public:
 
   //! Get the size of the queue
   int CommandsLeftInCell() const { return m_commands.size(); }
+
+  /*! \name Commands that have been sent ahead
+
+    If pipelining is enabled the commands that follow the first one may be
+    sent to maxima before it has finished the first one. Maxima answers
+    each of them with a prompt, in order: The queue keeps track of how many
+    of them are still waiting for their prompt so each output can be
+    attributed to the right cell.
+    @{
+  */
+  //! Has maxima already received the first command?
+  bool CommandSent() const { return m_commandSent; }
+  //! Records that the first command has been sent to maxima.
+  void SetCommandSent();
+  //! The number of commands after the first one that have been sent to maxima
+  std::size_t CommandsSentAhead() const { return m_commandsSentAhead; }
+  //! Records that the command after the last one sent, which belongs to cell, has been sent, too.
+  void CommandSentAhead(GroupCell *cell);
+  /*! Marks the first command as sent, if it has been sent ahead
+
+    \return true, if maxima already has received the first command
+  */
+  bool TakeCommandSentAhead();
+  /*! Returns a command that is waiting to be sent to maxima
+
+    \param n 0 = the first command in the queue, 1 = the one following it, ...
+    \param cell Is set to the cell the command belongs to.
+    \return The command, or an empty string if the queue is shorter.
+  */
+  wxString PeekCommand(std::size_t n, GroupCell **cell) const;
+  //! The number of commands maxima has received, but hasn't answered with a prompt, yet
+  std::size_t CommandsInFlight() const { return m_inFlight.size(); }
+  /*! To be called on each main prompt before RemoveFirst()
+
+    Forgets the command the prompt answers.
+    \return true, if the prompt belongs to a command from a cell that has
+    been removed from the queue and therefore has to be ignored.
+  */
+  bool IgnorePrompt();
+  /*! Does the output maxima sends now belong to a cell that has been removed?
+
+    In this case the output has to be discarded and the working group must
+    not change before the prompt that ends the removed cell's command.
+  */
+  bool DiscardsOutput() const { return !m_inFlight.empty() && !m_inFlight.front(); }
+  //! Clears the queue once maxima has answered all commands it has received.
+  void ClearAfterSentCommands();
+  //! Will the queue be cleared once maxima has answered all commands it has received?
+  bool ClearsAfterSentCommands() const { return m_clearAfterSentCommands; }
+  //! @}
 };
 
 
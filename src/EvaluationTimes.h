@@ -0,0 +1,97 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the struct EvaluationTimes that records how long the
+  stages of evaluating a cell took and which resources maxima needed for it.
+*/
+
+#ifndef EVALUATIONTIMES_H
+#define EVALUATIONTIMES_H
+
+#include <chrono>
+#include <cstddef>
+
+/*! The points in time the stages of evaluating a cell have ended at
+
+  Each time point that hasn't been reached, yet, is the epoch of the clock.
+  The stages are
+  - sent: The cell's first command has been sent to maxima.
+  - firstByte, lastByte: The first and the last data from maxima has arrived
+    while the cell was evaluated. The time in between is mostly the transfer
+    and the time maxima computes between two outputs.
+  - parsed: The last output has been converted to cells.
+  - laidOut: The cell has been laid out after its last output has arrived.
+  - painted: The cell has been drawn after its last layout.
+
+  The resources maxima has used for the cell are sampled every few seconds
+  while the cell is evaluated.
+*/
+struct EvaluationTimes
+{
+  using Clock = std::chrono::steady_clock;
+
+  explicit EvaluationTimes(long serialNumber)
+    : serial(serialNumber), sent(Clock::now()) {}
+
+  //! Has a stage ended?
+  static bool Reached(Clock::time_point time) { return time != Clock::time_point(); }
+
+  //! To be called each time data from maxima arrives
+  void DataReceived()
+    {
+      lastByte = Clock::now();
+      if (!Reached(firstByte))
+        firstByte = lastByte;
+    }
+  //! To be called each time an output has been added to the cell
+  void Parsed() { parsed = Clock::now(); }
+  //! To be called each time the cell has been laid out
+  void LaidOut()
+    {
+      if (Reached(parsed))
+        laidOut = Clock::now();
+    }
+  //! To be called each time the cell has been drawn
+  void Painted()
+    {
+      if (Reached(laidOut) && (painted < laidOut))
+        painted = Clock::now();
+    }
+
+  //! Identifies the evaluation these times belong to
+  long serial;
+  Clock::time_point sent;
+  Clock::time_point firstByte;
+  Clock::time_point lastByte;
+  Clock::time_point parsed;
+  Clock::time_point laidOut;
+  Clock::time_point painted;
+
+  //! The CPU time maxima has used for this cell in seconds; negative = unknown
+  double cpuTime = -1;
+  //! The most memory maxima occupied while evaluating this cell, in bytes; 0 = unknown
+  std::size_t peakMemory = 0;
+  //! The page faults that made maxima wait for the disk; negative = unknown
+  long long majorPageFaults = -1;
+};
+
+#endif // EVALUATIONTIMES_H
@@ -32,6 +32,7 @@ const wxWindowIDRef EventIDs::menu_pane_math(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_pane_history(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_pane_structure(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_pane_xmlInspector(wxWindow::NewControlId());
+const wxWindowIDRef EventIDs::menu_pane_profiling(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_pane_format(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_pane_greek(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_pane_unicode(wxWindow::NewControlId());
@@ -379,6 +380,8 @@ const wxWindowIDRef EventIDs::menu_bug_report(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_add_path(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_evaluate_all_visible(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_evaluate_all(wxWindow::NewControlId());
+const wxWindowIDRef EventIDs::menu_evaluate_all_parallel(wxWindow::NewControlId());
+const wxWindowIDRef EventIDs::menu_evaluate_changed(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_show_tip(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_show_cellbrackets(wxWindow::NewControlId());
 const wxWindowIDRef EventIDs::menu_print_cellbrackets(wxWindow::NewControlId());
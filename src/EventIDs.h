@@ -91,6 +91,7 @@ public:
   static const wxWindowIDRef menu_pane_history;      //!< Both the "toggle the history pane" command and the history pane
   static const wxWindowIDRef menu_pane_structure;    //!< Both the "toggle the structure pane" command and the structure
   static const wxWindowIDRef menu_pane_xmlInspector; //!< Both the "toggle the xml monitor" command and the monitor pane
+  static const wxWindowIDRef menu_pane_profiling; //!< Both the "toggle the evaluation times pane" command and the pane
   static const wxWindowIDRef menu_pane_format;    //!< Both the "toggle the format pane" command and the format pane
   static const wxWindowIDRef menu_pane_greek;     //!< Both the "toggle the greek pane" command and the "greek" pane
   static const wxWindowIDRef menu_pane_unicode;   //!< Both the "toggle the unicode pane" command and the "unicode" pane
@@ -443,6 +444,8 @@ public:
   static const wxWindowIDRef menu_add_path;
   static const wxWindowIDRef menu_evaluate_all_visible;
   static const wxWindowIDRef menu_evaluate_all;
+  static const wxWindowIDRef menu_evaluate_all_parallel;
+  static const wxWindowIDRef menu_evaluate_changed;
   static const wxWindowIDRef menu_show_tip;
   static const wxWindowIDRef menu_show_cellbrackets;
   static const wxWindowIDRef menu_print_cellbrackets;
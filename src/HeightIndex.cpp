@@ -0,0 +1,157 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class HeightIndex that knows the y positions of all
+  GroupCells of a worksheet.
+*/
+
+#include "HeightIndex.h"
+#include "GroupCell.h"
+#include "Trace.h"
+
+int HeightIndex::CellHeight(const GroupCell *cell) {
+  // Cells that haven't been recalculated yet have a negative height
+  return wxMax(0, cell->GetHeight());
+}
+
+bool HeightIndex::Sync(GroupCell *tree, int baseIndent, int groupSkip) {
+  m_baseIndent = baseIndent;
+  if ((tree == m_tree) && (groupSkip == m_groupSkip) &&
+      !m_listChanged)
+    return false;
+
+  WXM_TRACE_ZONE("HeightIndex::Sync");
+  m_tree = tree;
+  m_groupSkip = groupSkip;
+  m_listChanged = false;
+  m_cells.clear();
+  m_heights.clear();
+  for (auto &cell : OnList(tree)) {
+    cell.SetHeightIndex(this, m_cells.size());
+    m_cells.push_back(&cell);
+    m_heights.push_back(CellHeight(&cell));
+  }
+
+  // Build the Fenwick tree in linear time: Each node adds its sum to its parent
+  std::size_t const size = m_cells.size();
+  m_fenwick.assign(size + 1, 0);
+  for (std::size_t i = 1; i <= size; i++) {
+    m_fenwick[i] += m_heights[i - 1] + m_groupSkip;
+    std::size_t const parent = i + (i & (~i + 1));
+    if (parent <= size)
+      m_fenwick[parent] += m_fenwick[i];
+  }
+  return true;
+}
+
+void HeightIndex::Clear() {
+  m_tree = {};
+  m_listChanged = true;
+  m_cells.clear();
+  m_heights.clear();
+  m_fenwick.clear();
+}
+
+bool HeightIndex::Contains(const GroupCell *cell) const {
+  if (!cell || !m_tree || m_listChanged)
+    return false;
+  if (cell->GetHeightIndex() != this)
+    return false;
+  std::size_t const slot = cell->GetHeightIndexSlot();
+  return (slot < m_cells.size()) && (m_cells[slot] == cell);
+}
+
+std::size_t HeightIndex::GetSlot(const GroupCell *cell) const {
+  wxASSERT(Contains(cell));
+  return cell->GetHeightIndexSlot();
+}
+
+void HeightIndex::HeightChanged(const GroupCell *cell) {
+  // If the list of cells has changed the next Sync() will read all heights
+  if (!Contains(cell))
+    return;
+  std::size_t const slot = cell->GetHeightIndexSlot();
+  int const height = CellHeight(cell);
+  if (height == m_heights[slot])
+    return;
+  Add(slot, height - m_heights[slot]);
+  m_heights[slot] = height;
+}
+
+void HeightIndex::Add(std::size_t slot, int delta) {
+  for (std::size_t i = slot + 1; i < m_fenwick.size(); i += i & (~i + 1))
+    m_fenwick[i] += delta;
+}
+
+int HeightIndex::PrefixSum(std::size_t count) const {
+  int sum = 0;
+  for (std::size_t i = count; i > 0; i -= i & (~i + 1))
+    sum += m_fenwick[i];
+  return sum;
+}
+
+int HeightIndex::GetTop(std::size_t slot) const {
+  return m_baseIndent + PrefixSum(slot);
+}
+
+int HeightIndex::GetTotalHeight() const {
+  if (m_cells.empty())
+    return m_baseIndent;
+  return GetBottom(m_cells.size() - 1);
+}
+
+std::size_t HeightIndex::FindSlot(int y) const {
+  wxASSERT(!m_cells.empty());
+  int remaining = y - m_baseIndent;
+  if (remaining < 0)
+    return 0;
+
+  // Descend the Fenwick tree: count ends up as the number of cells that
+  // end at or above y
+  std::size_t const size = m_cells.size();
+  std::size_t step = 1;
+  while (step * 2 <= size)
+    step *= 2;
+  std::size_t count = 0;
+  for (; step > 0; step /= 2) {
+    if ((count + step <= size) && (m_fenwick[count + step] <= remaining)) {
+      count += step;
+      remaining -= m_fenwick[count];
+    }
+  }
+  if (count >= size)
+    return size - 1;
+  return count;
+}
+
+GroupCell *HeightIndex::FirstCellEndingBelow(int y) const {
+  if (m_cells.empty())
+    return {};
+  // If y is in the GroupSkip below a cell we need the next one. Cells with a
+  // height of 0 might end above their top, though.
+  std::size_t slot = FindSlot(y);
+  while ((slot < m_cells.size()) && (GetBottom(slot) <= y))
+    slot++;
+  if (slot < m_cells.size())
+    return m_cells[slot];
+  return {};
+}
@@ -0,0 +1,125 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class HeightIndex that knows the y positions of all
+  GroupCells of a worksheet.
+*/
+
+#ifndef HEIGHTINDEX_H
+#define HEIGHTINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+class GroupCell;
+
+/*! An index of the heights of the GroupCells of a worksheet
+
+  The y position of a GroupCell is the sum of the heights of all GroupCells
+  above it. This index keeps these heights in a Fenwick tree, which means that
+  finding the y position of the nth cell, finding the cell at an y position
+  and updating the height of a cell all take logarithmic time, instead of
+  requiring to walk through the whole worksheet.
+
+  GroupCells that have been recalculated tell the index about their new height
+  by calling HeightChanged(). Inserting, deleting, folding or unfolding cells
+  changes the list of GroupCells, which the cells tell us about by calling
+  ListChanged(): In this case Sync() rebuilds the index, which takes linear
+  time.
+
+  The cells keep a pointer to the index => it has to outlive them.
+*/
+class HeightIndex
+{
+public:
+  HeightIndex() = default;
+  HeightIndex(const HeightIndex &) = delete;
+  HeightIndex &operator=(const HeightIndex &) = delete;
+
+  /*! Makes sure the index describes the list of GroupCells starting at tree
+
+    \param tree The first GroupCell of the worksheet
+    \param baseIndent The y position the worksheet starts at
+    \param groupSkip The vertical space between GroupCells
+    \return true, if the index had to be rebuilt, which means that the list of
+            GroupCells has changed.
+  */
+  bool Sync(GroupCell *tree, int baseIndent, int groupSkip);
+  //! Forget all cells: The next Sync() will rebuild the index
+  void Clear();
+
+  //! Tells the index that the list of GroupCells has changed
+  void ListChanged() { m_listChanged = true; }
+  //! Tells the index that the height of a GroupCell has changed
+  void HeightChanged(const GroupCell *cell);
+
+  //! Is the index up to date and does it contain this cell?
+  bool Contains(const GroupCell *cell) const;
+  //! The number of GroupCells in the index
+  std::size_t Size() const { return m_cells.size(); }
+  //! The GroupCell in a slot of the index
+  GroupCell *GetCell(std::size_t slot) const { return m_cells[slot]; }
+  //! The slot a GroupCell Contains() is in.
+  std::size_t GetSlot(const GroupCell *cell) const;
+
+  //! The y coordinate of the top of the GroupCell in a slot
+  int GetTop(std::size_t slot) const;
+  //! The y coordinate of the bottom of the GroupCell in a slot
+  int GetBottom(std::size_t slot) const
+    { return GetTop(slot) + m_heights[slot] - 1; }
+  //! The height of the GroupCell in a slot, as last reported by it
+  int GetHeight(std::size_t slot) const { return m_heights[slot]; }
+  //! The y coordinate the last GroupCell ends at
+  int GetTotalHeight() const;
+
+  /*! The slot of the last GroupCell that begins at or above y
+
+    Returns 0 for y positions above the first cell and Size()-1 for y positions
+    below the last one. Must not be called if the index is empty.
+  */
+  std::size_t FindSlot(int y) const;
+  //! The first GroupCell whose bottom is below y, or NULL if there is none
+  GroupCell *FirstCellEndingBelow(int y) const;
+
+private:
+  //! The height a GroupCell occupies, not including the GroupSkip
+  static int CellHeight(const GroupCell *cell);
+  //! Adds delta to the extent of the cell in slot
+  void Add(std::size_t slot, int delta);
+  //! The sum of the extents of the first count cells
+  int PrefixSum(std::size_t count) const;
+
+  //! The GroupCells in the order they appear in the worksheet
+  std::vector<GroupCell *> m_cells;
+  //! The height of each cell, as last reported
+  std::vector<int> m_heights;
+  //! The Fenwick tree of the cells' heights plus the GroupSkip, 1-based
+  std::vector<int> m_fenwick;
+  //! The first GroupCell of the list the index has been built for
+  const GroupCell *m_tree = {};
+  //! Has the list of GroupCells changed since the index has been built?
+  bool m_listChanged = true;
+  int m_baseIndent = 0;
+  int m_groupSkip = 0;
+};
+
+#endif // HEIGHTINDEX_H
@@ -43,6 +43,7 @@
 #include "wx/log.h"
 #include "StringUtils.h"
 #include "SvgBitmap.h"
+#include "Trace.h"
 #include <wx/mstream.h>
 #include <wx/regex.h>
 #include <wx/stdpaths.h>
@@ -798,6 +799,7 @@ void Image::LoadImage(wxString image, wxString wxmxFile,
 void Image::LoadImage_Backgroundtask(std::unique_ptr<ThreadNumberLimiter> limiter,
                                      wxString image, wxString wxmxFile,
                                      bool remove) {
+  WXM_TRACE_ZONE("Image::LoadImage_Backgroundtask");
   wxLogBuffer errorAggregator;
 
   if (!wxmxFile.IsEmpty()) {
@@ -0,0 +1,166 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class LayoutPool that lays out GroupCells in parallel.
+*/
+
+#include "LayoutPool.h"
+#include "GroupCell.h"
+#include "Trace.h"
+
+//! Is the current thread laying out cells for a LayoutPool?
+static thread_local bool t_inLayoutThread = false;
+//! The worst outcome the cells of the current GroupCell have reported
+static thread_local LayoutPool::Outcome t_outcome = LayoutPool::done;
+
+LayoutPool::LayoutPool() {
+  m_numberOfThreads = std::thread::hardware_concurrency();
+  if (m_numberOfThreads < 1)
+    m_numberOfThreads = 1;
+  if (m_numberOfThreads > 16)
+    m_numberOfThreads = 16;
+}
+
+LayoutPool::~LayoutPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_exit = true;
+  }
+  m_workAvailable.notify_all();
+  for (auto &thread : m_threads)
+    thread.join();
+}
+
+bool LayoutPool::InLayoutThread() { return t_inLayoutThread; }
+
+void LayoutPool::Fail(Outcome outcome) {
+  if (outcome > t_outcome)
+    t_outcome = outcome;
+}
+
+bool LayoutPool::IsWorthIt(std::size_t cells) const {
+  // Waking up the threads costs more than laying out a few cells
+  return (m_numberOfThreads > 1) && (cells >= 2 * m_numberOfThreads);
+}
+
+void LayoutPool::StartThreads() {
+  if (!m_queues.empty())
+    return;
+  for (std::size_t i = 0; i < m_numberOfThreads; i++)
+    m_queues.emplace_back(std::make_unique<Queue>());
+  // The last queue belongs to the GUI thread.
+  for (std::size_t i = 0; i + 1 < m_numberOfThreads; i++)
+    m_threads.emplace_back(&LayoutPool::WorkerThread, this, i);
+}
+
+std::vector<LayoutPool::Outcome>
+LayoutPool::Layout(const std::vector<GroupCell *> &cells) {
+  if (cells.empty())
+    return {};
+  WXM_TRACE_ZONE("LayoutPool::Layout");
+  StartThreads();
+  m_cells = &cells;
+  m_outcomes.assign(cells.size(), done);
+
+  // Neighbouring cells go to the same thread, which keeps the queues short
+  // if the cells are of similar size.
+  std::size_t const chunk = (cells.size() + m_queues.size() - 1) / m_queues.size();
+  for (std::size_t i = 0; i < m_queues.size(); i++) {
+    std::lock_guard<std::mutex> lock(m_queues[i]->lock);
+    for (std::size_t job = i * chunk; (job < (i + 1) * chunk) && (job < cells.size()); job++)
+      m_queues[i]->jobs.push_back(job);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_generation++;
+    m_busy = m_threads.size();
+  }
+  m_workAvailable.notify_all();
+
+  Work(m_queues.size() - 1);
+
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_threadFinished.wait(lock, [this] { return m_busy == 0; });
+  }
+  m_cells = {};
+  return std::move(m_outcomes);
+}
+
+void LayoutPool::WorkerThread(std::size_t queue) {
+  std::uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_workAvailable.wait(lock, [this, generation] {
+        return m_exit || (m_generation != generation);
+      });
+      if (m_exit)
+        return;
+      generation = m_generation;
+    }
+
+    Work(queue);
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_busy--;
+    }
+    m_threadFinished.notify_one();
+  }
+}
+
+void LayoutPool::Work(std::size_t queue) {
+  t_inLayoutThread = true;
+  std::size_t job;
+  while (PopJob(queue, job)) {
+    t_outcome = done;
+    (*m_cells)[job]->RecalculateOutput();
+    m_outcomes[job] = t_outcome;
+  }
+  t_inLayoutThread = false;
+}
+
+bool LayoutPool::PopJob(std::size_t queue, std::size_t &job) {
+  {
+    Queue &own = *m_queues[queue];
+    std::lock_guard<std::mutex> lock(own.lock);
+    if (!own.jobs.empty()) {
+      job = own.jobs.front();
+      own.jobs.pop_front();
+      return true;
+    }
+  }
+  // Steal from the end of the other queues: That is the work their owners
+  // would have done last.
+  for (std::size_t i = 1; i < m_queues.size(); i++) {
+    Queue &victim = *m_queues[(queue + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(victim.lock);
+    if (!victim.jobs.empty()) {
+      job = victim.jobs.back();
+      victim.jobs.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,129 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  The header file for the pool of threads that lay out GroupCells in parallel
+*/
+
+#ifndef LAYOUTPOOL_H
+#define LAYOUTPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class GroupCell;
+
+/*! A pool of threads that lay out the output of many GroupCells in parallel
+
+  The output of a GroupCell only depends on the cells inside it, which means
+  that the outputs of different GroupCells can be laid out at the same time.
+  The cells measure text using TextMetrics while they are laid out by this
+  pool, as only the GUI thread may use a wxDC.
+
+  Each thread has its own queue of GroupCells. A thread whose queue has run
+  empty steals cells from the other threads' queues, so one long output
+  doesn't leave the other threads idle.
+
+  Cells that cannot be laid out by a background thread tell this by calling
+  Fail(). Layout() then tells the GUI thread to lay out their GroupCell
+  itself.
+*/
+class LayoutPool
+{
+public:
+  //! Tells if and why a GroupCell could not be laid out, in increasing severity
+  enum Outcome : std::uint8_t
+  {
+    done,     //!< The output has been laid out
+    retry,    //!< TextMetrics didn't know all glyphs, yet. Will work the next time.
+    guiThread //!< The output contains a cell only the GUI thread can lay out
+  };
+
+  LayoutPool();
+  LayoutPool(const LayoutPool&) = delete;
+  LayoutPool& operator=(const LayoutPool&) = delete;
+  ~LayoutPool();
+
+  /*! Calls GroupCell::RecalculateOutput() for all cells, in parallel
+
+    Returns when all cells have been processed. The GUI thread helps laying
+    out cells while it waits.
+
+    \param cells The GroupCells to lay out
+    \return The outcome for each cell
+  */
+  std::vector<Outcome> Layout(const std::vector<GroupCell *> &cells);
+
+  //! Is this thread laying out cells for a LayoutPool?
+  static bool InLayoutThread();
+  //! Tells the pool that the cell that is being laid out cannot be laid out here
+  static void Fail(Outcome outcome);
+
+  //! Is it worth distributing this many GroupCells between threads?
+  bool IsWorthIt(std::size_t cells) const;
+
+private:
+  //! The GroupCells a thread has yet to lay out, by their index
+  struct Queue
+  {
+    std::mutex lock;
+    std::deque<std::size_t> jobs;
+  };
+
+  //! Starts the threads, if that hasn't been done, yet
+  void StartThreads();
+  //! The main loop of a thread in the pool
+  void WorkerThread(std::size_t queue);
+  //! Lays out cells until no queue has a cell left
+  void Work(std::size_t queue);
+  //! Takes a cell from our own queue, or steals one from another queue
+  bool PopJob(std::size_t queue, std::size_t &job);
+
+  //! The number of threads including the GUI thread
+  std::size_t m_numberOfThreads;
+  std::vector<std::thread> m_threads;
+  //! One queue per thread. The last one belongs to the GUI thread.
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  //! Guards m_generation, m_busy and m_exit
+  std::mutex m_lock;
+  //! Tells the threads that there is new work
+  std::condition_variable m_workAvailable;
+  //! Tells Layout() that a thread has finished
+  std::condition_variable m_threadFinished;
+  //! Incremented each time Layout() hands out new work
+  std::uint64_t m_generation = 0;
+  //! The number of background threads that still are working
+  std::size_t m_busy = 0;
+  //! Tells the threads to exit
+  bool m_exit = false;
+  //! The cells the current Layout() lays out
+  const std::vector<GroupCell *> *m_cells = {};
+  //! The outcome for each of m_cells
+  std::vector<Outcome> m_outcomes;
+};
+
+#endif // LAYOUTPOOL_H
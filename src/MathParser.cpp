@@ -29,9 +29,11 @@
 
 #include <utility>
 #include <memory>
+#include <vector>
 #include <wx/config.h>
 #include <wx/intl.h>
 #include <wx/sstream.h>
+#include <wx/thread.h>
 #include <wx/tokenzr.h>
 #include "ErrorRedirector.h"
 
@@ -51,6 +53,7 @@
 #include "IntCell.h"
 #include "IntervalCell.h"
 #include "LabelCell.h"
+#include "LazyMathCell.h"
 #include "LimitCell.h"
 #include "ListCell.h"
 #include "LongNumberCell.h"
@@ -62,6 +65,7 @@
 #include "SubCell.h"
 #include "SubSupCell.h"
 #include "SumCell.h"
+#include "Trace.h"
 #include "Version.h"
 #include "VisiblyInvalidCell.h"
 
@@ -71,26 +75,20 @@
 */
 #define CALL_MEMBER_FN(object, ptrToMember) ((object).*(ptrToMember))
 
-wxXmlNode *MathParser::SkipWhitespaceNode(wxXmlNode *node) {
-  if (node) {
-    // If this is a text node there is a chance that this is a whitespace we
-    // want to skip
-    if (node->GetType() == wxXML_TEXT_NODE) {
-      // This is a text node => Let's see if it is whitespace-only and skip it
-      // if it is.
-      wxString contents = node->GetContent();
-      contents.Trim();
-      if (contents.Length() <= 1)
-        node = node->GetNext();
-    }
-  }
-  return node;
+bool MathParser::IsWhitespaceText(const wxString &text) {
+  // Equivalent to wxString::Trim() followed by a test for Length() <= 1, but
+  // without copying the text
+  std::size_t length = text.length();
+  auto it = text.end();
+  while ((length > 1) && wxIsspace(*--it))
+    length--;
+  return length <= 1;
 }
 
-wxXmlNode *MathParser::GetNextTag(wxXmlNode *node) {
-  if (node)
-    node = node->GetNext();
-  return SkipWhitespaceNode(node);
+bool MathParser::AtChild(XMLTokenStream &xml) {
+  while ((xml.GetType() == XMLTokenStream::text) && IsWhitespaceText(xml.GetText()))
+    xml.Next();
+  return xml.AtContent();
 }
 
 MathParser::MathParser(Configuration *cfg, const wxString &zipfile) {
@@ -167,151 +165,125 @@ MathParser::MathParser(Configuration *cfg, const wxString &zipfile) {
 
 MathParser::~MathParser() {}
 
-std::unique_ptr<Cell> MathParser::ParseVariableNameTag(wxXmlNode *node){
-  auto children = node->GetChildren();
-  if (children != NULL)
-    {
-      if((m_configuration->IsOperator(children->GetContent())) ||
-         (node->GetAttribute(wxS("type")) == wxS("Operator")))
-        return ParseText(children, TS_OPERATOR);
-      else
-        return ParseText(children, TS_VARIABLE);
-    }
-  return ParseText(children, TS_VARIABLE);
+std::unique_ptr<Cell> MathParser::ParseVariableNameTag(const XMLTag &tag, XMLTokenStream &xml){
+  wxString text = xml.ReadText();
+  if((m_configuration->IsOperator(text)) ||
+     (tag.GetAttribute(wxS("type")) == wxS("Operator")))
+    return ParseText(std::move(text), TS_OPERATOR);
+  else
+    return ParseText(std::move(text), TS_VARIABLE);
 }
 
-std::unique_ptr<Cell> MathParser::ParseHiddenOperatorTag(wxXmlNode *node) {
-  auto retval = ParseText(node->GetChildren());
+std::unique_ptr<Cell> MathParser::ParseHiddenOperatorTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml) {
+  auto retval = ParseText(xml.ReadText());
   retval->SetHidableMultSign(true);
   return retval;
 }
 
-std::unique_ptr<Cell> MathParser::ParseOutputTag(wxXmlNode *node) {
-  wxXmlNode *children = node->GetChildren();
-  return children ? ParseTag(children) : nullptr;
+std::unique_ptr<Cell> MathParser::ParseOutputTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml) {
+  return ParseTag(xml);
 }
 
-std::unique_ptr<Cell> MathParser::ParseMtdTag(wxXmlNode *node) {
-  wxXmlNode *children = node->GetChildren();
-  return children ? ParseTag(children) : nullptr;
+std::unique_ptr<Cell> MathParser::ParseMtdTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml) {
+  return ParseTag(xml);
 }
 
-int MathParser::CountChildren(wxXmlNode *node) {
-  if(node == NULL)
-    return 0;
-  wxXmlNode *children = node->GetChildren();
+int MathParser::CountChildren(XMLTokenStream xml) {
   int num = 0;
-  if (children)
-    children = SkipWhitespaceNode(children);
-
-  while (children) {
+  while (AtChild(xml)) {
     num++;
-    children = GetNextTag(children);
+    xml.Skip();
   }
   return num;
 }
 
-std::unique_ptr<Cell> MathParser::ParseRowTag(wxXmlNode *node) {
-  if(node == NULL)
-    return nullptr;
-
-  if (node->GetAttribute(wxS("list")) == wxS("true")) {
-    wxXmlNode *child = node->GetChildren();
-    child = SkipWhitespaceNode(child);
+std::unique_ptr<Cell> MathParser::ParseRowTag(const XMLTag &tag, XMLTokenStream &xml) {
+  if (tag.GetAttribute(wxS("list")) == wxS("true")) {
     // No special Handling for NULL args here: They are completely legal in this
     // case.
-    auto inner = ParseTag(child, true);
+    auto inner = ParseTag(xml, true);
     auto cell =
       std::make_unique<ListCell>(m_group, m_configuration, std::move(inner));
     cell->SetType(m_ParserStyle);
     cell->SetHighlight(m_highlight);
-    ParseCommonAttrs(node, cell);
+    ParseCommonAttrs(tag, cell);
     return cell;
-  } else if (node->GetAttribute(wxS("set")) == wxS("true")) {
-    wxXmlNode *child = node->GetChildren();
-    child = SkipWhitespaceNode(child);
+  } else if (tag.GetAttribute(wxS("set")) == wxS("true")) {
     // No special Handling for NULL args here: They are completely legal in this
     // case.
-    auto inner = ParseTag(child, true);
+    auto inner = ParseTag(xml, true);
     auto cell =
       std::make_unique<SetCell>(m_group, m_configuration, std::move(inner));
     cell->SetType(m_ParserStyle);
     cell->SetHighlight(m_highlight);
-    ParseCommonAttrs(node, cell);
+    ParseCommonAttrs(tag, cell);
     return cell;
-  } else {
-    if (node->GetChildren())
-      return ParseTag(node->GetChildren(), true);
-    return nullptr;
-  }
+  } else
+    return ParseTag(xml, true);
 }
 
-std::unique_ptr<Cell> MathParser::ParseHighlightTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto inner = HandleNullPointer(ParseTag(child, true));
-
+std::unique_ptr<Cell> MathParser::ParseHighlightTag(const XMLTag &tag, XMLTokenStream &xml) {
   wxString boxName = wxS("boxname");
+  wxString name;
+  bool const named = tag.GetAttribute(boxName, &name);
+  if (named && (name == wxS("highlight")))
+    {
+      bool highlight = m_highlight;
+      m_highlight = true;
+      auto tmp = ParseTag(xml);
+      m_highlight = highlight;
+      return tmp;
+    }
+
+  auto inner = HandleNullPointer(ParseTag(xml, true));
   std::unique_ptr<Cell> cell;
-  if(!node->HasAttribute(boxName))
+  if(!named)
     cell = std::make_unique<BoxCell>(m_group, m_configuration, std::move(inner));
   else
-    {
-      wxString name = node->GetAttribute(boxName);
-      if(name == wxS("highlight"))
-        {
-          bool highlight = m_highlight;
-          m_highlight = true;
-          auto tmp = ParseTag(node->GetChildren());
-          m_highlight = highlight;
-          return tmp;
-        }
-      else
-        cell = std::make_unique<NamedBoxCell>(m_group, m_configuration, std::move(inner),
-                                              name);
-    }
+    cell = std::make_unique<NamedBoxCell>(m_group, m_configuration, std::move(inner),
+                                          name);
   cell->SetType(m_ParserStyle);
-  ParseCommonAttrs(node, cell);
+  ParseCommonAttrs(tag, cell);
   return cell;
 }
 
-std::unique_ptr<Cell> MathParser::ParseMiscTextTag(wxXmlNode *node) {
-  if (node->GetAttribute(wxS("listdelim")) == wxS("true"))
+std::unique_ptr<Cell> MathParser::ParseMiscTextTag(const XMLTag &tag, XMLTokenStream &xml) {
+  if (tag.GetAttribute(wxS("listdelim")) == wxS("true"))
     return {};
   else {
     TextStyle style = TS_TEXT;
-    if (node->GetAttribute(wxS("type")) == wxS("error"))
+    if (tag.GetAttribute(wxS("type")) == wxS("error"))
       style = TS_ERROR;
-    if (node->GetAttribute(wxS("type")) == wxS("ASCII-Art"))
+    if (tag.GetAttribute(wxS("type")) == wxS("ASCII-Art"))
       style = TS_ASCIIMATHS;
-    if (node->GetAttribute(wxS("type")) == wxS("Operator"))
+    if (tag.GetAttribute(wxS("type")) == wxS("Operator"))
       style = TS_OPERATOR;
-    if (node->GetAttribute(wxS("type")) == wxS("warning"))
+    if (tag.GetAttribute(wxS("type")) == wxS("warning"))
       style = TS_WARNING;
-    return ParseText(node->GetChildren(), style);
+    return ParseText(xml.ReadText(), style);
   }
 }
 
-std::unique_ptr<Cell> MathParser::ParseAnimationTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseAnimationTag(const XMLTag &tag, XMLTokenStream &xml) {
   wxString gnuplotSources;
   wxString gnuplotData;
-  bool del = node->GetAttribute(wxS("del"), wxS("false")) == wxS("true");
+  bool del = tag.GetAttribute(wxS("del"), wxS("false")) == wxS("true");
   auto animation =
     std::make_unique<AnimationCell>(m_group, m_configuration, m_wxmxFile);
-  auto const &str = node->GetChildren()->GetContent();
+  wxString const str = xml.ReadText();
   wxArrayString images;
   wxString framerate;
-  if (node->GetAttribute(wxS("fr"), &framerate)) {
+  if (tag.GetAttribute(wxS("fr"), &framerate)) {
     long fr;
     if (framerate.ToLong(&fr))
       animation->SetFrameRate(fr);
   }
-  if (node->GetAttribute(wxS("frame"), &framerate)) {
+  if (tag.GetAttribute(wxS("frame"), &framerate)) {
     long frame;
     if (framerate.ToLong(&frame))
       animation->SetDisplayedIndex(frame);
   }
-  if (node->GetAttribute(wxS("running"), wxS("true")) == wxS("false"))
+  if (tag.GetAttribute(wxS("running"), wxS("true")) == wxS("false"))
     animation->AnimationRunning(false);
   wxStringTokenizer imageFiles(str, wxS(";"));
   int numImgs = 0;
@@ -325,13 +297,13 @@ std::unique_ptr<Cell> MathParser::ParseAnimationTag(wxXmlNode *node) {
 
   animation->LoadImages(images, del);
 
-  wxString ppi = node->GetAttribute(wxS("ppi"), wxEmptyString);
+  wxString ppi = tag.GetAttribute(wxS("ppi"), wxEmptyString);
   long ppi_num;
   if (ppi.ToLong(&ppi_num))
     animation->SetPPI(ppi_num);
 
-  if(node->GetAttribute(wxS("gnuplotSources"), &gnuplotSources) &&
-     node->GetAttribute(wxS("gnuplotData"), &gnuplotData))
+  if(tag.GetAttribute(wxS("gnuplotSources"), &gnuplotSources) &&
+     tag.GetAttribute(wxS("gnuplotData"), &gnuplotData))
     {
       wxLogMessage(_("Importing uncompressed gnuplot sources for an animation"));
       wxStringTokenizer dataFiles(gnuplotData, wxS(";"));
@@ -343,8 +315,8 @@ std::unique_ptr<Cell> MathParser::ParseAnimationTag(wxXmlNode *node) {
         }
       }
     }
-  if(node->GetAttribute(wxS("gnuplotSources_gz"), &gnuplotSources) &&
-     node->GetAttribute(wxS("gnuplotData_gz"), &gnuplotData))
+  if(tag.GetAttribute(wxS("gnuplotSources_gz"), &gnuplotSources) &&
+     tag.GetAttribute(wxS("gnuplotData_gz"), &gnuplotData))
     {
       wxLogMessage(_("Importing compressed gnuplot sources for an animation"));
       wxStringTokenizer dataFiles(gnuplotData, wxS(";"));
@@ -360,9 +332,9 @@ std::unique_ptr<Cell> MathParser::ParseAnimationTag(wxXmlNode *node) {
   return animation;
 }
 
-std::unique_ptr<Cell> MathParser::ParseImageTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseImageTag(const XMLTag &tag, XMLTokenStream &xml) {
   std::unique_ptr<ImgCell> imageCell;
-  wxString filename(node->GetChildren()->GetContent());
+  wxString filename(xml.ReadText());
 
   if (!m_wxmxFile.IsEmpty()) // loading from zip
     {
@@ -370,13 +342,13 @@ std::unique_ptr<Cell> MathParser::ParseImageTag(wxXmlNode *node) {
                                             m_wxmxFile, false);
 
       wxString origImageFile =
-        node->GetAttribute(wxS("origImageFile"), wxEmptyString);
+        tag.GetAttribute(wxS("origImageFile"), wxEmptyString);
 
       if (!origImageFile.empty()) {
         imageCell->SetOrigImageFile(origImageFile);
       }
     } else {
-    if (node->GetAttribute(wxS("del"), wxS("yes")) != wxS("no")) {
+    if (tag.GetAttribute(wxS("del"), wxS("yes")) != wxS("no")) {
       SuppressErrorDialogs suppressor;
       if ((!wxFileExists(filename)) || (wxImage::GetImageCount(filename) < 2))
         imageCell = std::make_unique<ImgCell>(m_group, m_configuration,
@@ -401,33 +373,33 @@ std::unique_ptr<Cell> MathParser::ParseImageTag(wxXmlNode *node) {
     }
   }
 
-  wxString ppi = node->GetAttribute(wxS("ppi"), wxEmptyString);
+  wxString ppi = tag.GetAttribute(wxS("ppi"), wxEmptyString);
   long ppi_num;
   if (ppi.ToLong(&ppi_num) && (imageCell != NULL))
     imageCell->SetPPI(ppi_num);
 
   wxString gnuplotSource;
-  if(node->GetAttribute(wxS("gnuplotsource"), &gnuplotSource))
+  if(tag.GetAttribute(wxS("gnuplotsource"), &gnuplotSource))
     {
-      wxString gnuplotData = node->GetAttribute(wxS("gnuplotdata"), wxEmptyString);
+      wxString gnuplotData = tag.GetAttribute(wxS("gnuplotdata"), wxEmptyString);
       imageCell->GnuplotSource(gnuplotSource, gnuplotData, m_wxmxFile);
     }
-  if(node->GetAttribute(wxS("gnuplotsource_gz"), &gnuplotSource))
+  if(tag.GetAttribute(wxS("gnuplotsource_gz"), &gnuplotSource))
     {
-      wxString gnuplotData = node->GetAttribute(wxS("gnuplotdata_gz"), wxEmptyString);
+      wxString gnuplotData = tag.GetAttribute(wxS("gnuplotdata_gz"), wxEmptyString);
       imageCell->CompressedGnuplotSource(gnuplotSource, gnuplotData, m_wxmxFile);
     }
 
-  if (node->GetAttribute(wxS("rect"), wxS("true")) == wxS("false"))
+  if (tag.GetAttribute(wxS("rect"), wxS("true")) == wxS("false"))
     imageCell->DrawRectangle(false);
   wxString sizeString;
-  if ((sizeString = node->GetAttribute(wxS("maxWidth"), wxS("-1"))) !=
+  if ((sizeString = tag.GetAttribute(wxS("maxWidth"), wxS("-1"))) !=
       wxS("-1")) {
     double width;
     if (sizeString.ToDouble(&width))
       imageCell->SetMaxWidth(width);
   }
-  if ((sizeString = node->GetAttribute(wxS("maxHeight"), wxS("-1"))) !=
+  if ((sizeString = tag.GetAttribute(wxS("maxHeight"), wxS("-1"))) !=
       wxS("-1")) {
     double height;
     if (sizeString.ToDouble(&height))
@@ -437,16 +409,16 @@ std::unique_ptr<Cell> MathParser::ParseImageTag(wxXmlNode *node) {
   return imageCell;
 }
 
-std::unique_ptr<Cell> MathParser::ParseOutputLabelTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseOutputLabelTag(const XMLTag &tag, XMLTokenStream &xml) {
   std::unique_ptr<Cell> tmp;
   wxString user_lbl =
-    node->GetAttribute(wxS("userdefinedlabel"), m_userDefinedLabel);
-  wxString userdefined = node->GetAttribute(wxS("userdefined"), wxS("no"));
+    tag.GetAttribute(wxS("userdefinedlabel"), m_userDefinedLabel);
+  wxString userdefined = tag.GetAttribute(wxS("userdefined"), wxS("no"));
 
   if (userdefined != wxS("yes")) {
-    tmp = ParseText(node->GetChildren(), TS_LABEL);
+    tmp = ParseText(xml.ReadText(), TS_LABEL);
   } else {
-    tmp = ParseText(node->GetChildren(), TS_USERLABEL);
+    tmp = ParseText(xml.ReadText(), TS_USERLABEL);
 
     // Backwards compatibility to 17.04/17.12:
     // If we cannot find the user-defined label's text but still know that there
@@ -464,8 +436,8 @@ std::unique_ptr<Cell> MathParser::ParseOutputLabelTag(wxXmlNode *node) {
   return tmp;
 }
 
-std::unique_ptr<Cell> MathParser::ParseMthTag(wxXmlNode *node) {
-  auto retval = ParseTag(node->GetChildren());
+std::unique_ptr<Cell> MathParser::ParseMthTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml) {
+  auto retval = ParseTag(xml);
   if (retval)
     retval->ForceBreakLine(true);
   else
@@ -473,8 +445,8 @@ std::unique_ptr<Cell> MathParser::ParseMthTag(wxXmlNode *node) {
   return retval;
 }
 
-std::unique_ptr<Cell> MathParser::ParseStringTag(wxXmlNode *node) {
-  return ParseText(node->GetChildren(), TS_STRING);
+std::unique_ptr<Cell> MathParser::ParseStringTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml) {
+  return ParseText(xml.ReadText(), TS_STRING);
 }
 
 // ParseCellTag
@@ -483,52 +455,59 @@ std::unique_ptr<Cell> MathParser::ParseStringTag(wxXmlNode *node) {
 // Any changes in GroupCell structure or methods
 // has to be reflected here in order to ensure proper
 // loading of WXMX files.
-std::unique_ptr<Cell> MathParser::ParseCellTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseCellTag(const XMLTag &tag, XMLTokenStream &xml) {
   std::unique_ptr<GroupCell> group;
 
   // read hide status
-  bool hide = (node->GetAttribute(wxS("hide"), wxS("false")) == wxS("true"))
+  bool hide = (tag.GetAttribute(wxS("hide"), wxS("false")) == wxS("true"))
     ? true
     : false;
   // read (group)cell type
-  wxString type = node->GetAttribute(wxS("type"), wxS("text"));
+  wxString type = tag.GetAttribute(wxS("type"), wxS("text"));
 
-  auto function = m_groupTags[type];
-  if (function)
-    group = std::unique_ptr<GroupCell>(CALL_MEMBER_FN(*this, function)(node));
+  // Don't use m_groupTags[type] here: It would add unknown types to the hash
+  // which would be a race condition if several parsers work in parallel.
+  auto function = m_groupTags.find(type);
+  if ((function != m_groupTags.end()) && (function->second))
+    group = std::unique_ptr<GroupCell>(CALL_MEMBER_FN(*this, function->second)(tag));
   else
     return group;
   SetGroup(group.get());
 
-  wxXmlNode *children = node->GetChildren();
-  children = SkipWhitespaceNode(children);
-  while (children) {
-    if (children->GetName() == wxS("editor")) {
-      std::unique_ptr<Cell> ed(ParseEditorTag(children));
+  while (AtChild(xml)) {
+    wxString childName;
+    if (xml.GetType() == XMLTokenStream::startTag)
+      childName = xml.GetName();
+    if ((childName != wxS("editor")) && (childName != wxS("fold")) &&
+        (childName != wxS("input"))) {
+      group->AppendOutput(HandleNullPointer(ParseTag(xml, false)));
+      continue;
+    }
+
+    std::size_t const depth = xml.GetDepth();
+    XMLTag const child = xml.TakeTag();
+    xml.Next();
+    if (childName == wxS("editor")) {
+      std::unique_ptr<Cell> ed(ParseEditorTag(child, xml));
       if (ed)
         group->SetEditableContent(ed->GetValue());
-    } else if (children->GetName() ==
+    } else if (childName ==
                wxS("fold")) { // This GroupCell contains folded groupcells
       CellListBuilder<GroupCell> tree;
-      wxXmlNode *xmlcells = children->GetChildren();
-      xmlcells = SkipWhitespaceNode(xmlcells);
-      for (; xmlcells; xmlcells = GetNextTag(xmlcells))
-        tree.DynamicAppend(ParseTag(xmlcells, false));
+      while (AtChild(xml))
+        tree.DynamicAppend(ParseTag(xml, false));
 
       if (tree)
         group->HideTree(std::move(tree));
-    } else if (children->GetName() == wxS("input")) {
-      auto editor = ParseTag(children->GetChildren());
+    } else {
+      auto editor = ParseTag(xml);
       if (!editor)
         editor = std::make_unique<EditorCell>(group.get(), m_configuration,
                                               _("Bug: Missing contents"));
       if (editor)
         group->SetEditableContent(editor->GetValue());
-    } else {
-      group->AppendOutput(HandleNullPointer(ParseTag(children)));
     }
-
-    children = GetNextTag(children);
+    xml.SkipToEndOf(depth);
   }
 
   group->Hide(hide);
@@ -537,9 +516,9 @@ std::unique_ptr<Cell> MathParser::ParseCellTag(wxXmlNode *node) {
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellFromSubsectionTag(wxXmlNode *node) {
+MathParser::GroupCellFromSubsectionTag(const XMLTag &tag) {
   wxString sectioning_level =
-    node->GetAttribute(wxS("sectioning_level"), wxS("0"));
+    tag.GetAttribute(wxS("sectioning_level"), wxS("0"));
   std::unique_ptr<GroupCell> group;
   // We save subsubsections as subsections with a higher sectioning level:
   // This makes them backwards-compatible in the way that they are displayed
@@ -556,69 +535,69 @@ MathParser::GroupCellFromSubsectionTag(wxXmlNode *node) {
       std::make_unique<GroupCell>(m_configuration, GC_TYPE_HEADING5); //-V773
   if (group == NULL)
     group = std::make_unique<GroupCell>(m_configuration, GC_TYPE_HEADING6);
-  ParseCommonGroupCellAttrs(node, group);
+  ParseCommonGroupCellAttrs(tag, group);
   return group;
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellFromTextTag(wxXmlNode *WXUNUSED(node)) {
+MathParser::GroupCellFromTextTag(const XMLTag &WXUNUSED(tag)) {
   return std::make_unique<GroupCell>(m_configuration, GC_TYPE_TEXT);
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellHeading6Tag(wxXmlNode *WXUNUSED(node)) {
+MathParser::GroupCellHeading6Tag(const XMLTag &WXUNUSED(tag)) {
   return std::make_unique<GroupCell>(m_configuration, GC_TYPE_HEADING6);
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellHeading5Tag(wxXmlNode *WXUNUSED(node)) {
+MathParser::GroupCellHeading5Tag(const XMLTag &WXUNUSED(tag)) {
   return std::make_unique<GroupCell>(m_configuration, GC_TYPE_HEADING5);
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellFromSubsubsectionTag(wxXmlNode *WXUNUSED(node)) {
+MathParser::GroupCellFromSubsubsectionTag(const XMLTag &WXUNUSED(tag)) {
   return std::make_unique<GroupCell>(m_configuration, GC_TYPE_SUBSUBSECTION);
 }
 
-std::unique_ptr<GroupCell> MathParser::GroupCellFromImageTag(wxXmlNode *node) {
+std::unique_ptr<GroupCell> MathParser::GroupCellFromImageTag(const XMLTag &tag) {
   auto group = std::make_unique<GroupCell>(m_configuration, GC_TYPE_IMAGE);
-  ParseCommonGroupCellAttrs(node, group);
+  ParseCommonGroupCellAttrs(tag, group);
   return group;
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellFromPagebreakTag(wxXmlNode *WXUNUSED(node)) {
+MathParser::GroupCellFromPagebreakTag(const XMLTag &WXUNUSED(tag)) {
   return std::make_unique<GroupCell>(m_configuration, GC_TYPE_PAGEBREAK);
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellFromSectionTag(wxXmlNode *WXUNUSED(node)) {
+MathParser::GroupCellFromSectionTag(const XMLTag &WXUNUSED(tag)) {
   return std::make_unique<GroupCell>(m_configuration, GC_TYPE_SECTION);
 }
 
 std::unique_ptr<GroupCell>
-MathParser::GroupCellFromTitleTag(wxXmlNode *WXUNUSED(node)) {
+MathParser::GroupCellFromTitleTag(const XMLTag &WXUNUSED(tag)) {
   return std::make_unique<GroupCell>(m_configuration, GC_TYPE_TITLE);
 }
 
-std::unique_ptr<GroupCell> MathParser::GroupCellFromCodeTag(wxXmlNode *node) {
+std::unique_ptr<GroupCell> MathParser::GroupCellFromCodeTag(const XMLTag &tag) {
   auto group = std::make_unique<GroupCell>(m_configuration, GC_TYPE_CODE);
-  wxString isAutoAnswer = node->GetAttribute(wxS("auto_answer"), wxS("no"));
+  wxString isAutoAnswer = tag.GetAttribute(wxS("auto_answer"), wxS("no"));
   if (isAutoAnswer == wxS("yes"))
     group->SetAutoAnswer(true);
   size_t i = 1;
   wxString answer;
   wxString question;
-  while (node->GetAttribute(wxString::Format(wxS("answer%li"), static_cast<long>(i)),
-                            &answer)) {
-    if (node->GetAttribute(wxString::Format(wxS("question%li"), static_cast<long>(i)),
-                           &question))
+  while (tag.GetAttribute(wxString::Format(wxS("answer%li"), static_cast<long>(i)),
+                          &answer)) {
+    if (tag.GetAttribute(wxString::Format(wxS("question%li"), static_cast<long>(i)),
+                         &question))
       group->SetAnswer(question, answer);
     else
       group->SetAnswer(wxString::Format(wxS("Question #%li"), static_cast<long>(i)), answer);
     i++;
   }
-  ParseCommonGroupCellAttrs(node, group);
+  ParseCommonGroupCellAttrs(tag, group);
   return group;
 }
 
@@ -637,9 +616,9 @@ MathParser::HandleNullPointer(std::unique_ptr<Cell> &&cell) {
   return tmp;
 }
 
-std::unique_ptr<Cell> MathParser::ParseEditorTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseEditorTag(const XMLTag &tag, XMLTokenStream &xml) {
   auto editor = std::make_unique<EditorCell>(m_group, m_configuration);
-  wxString type = node->GetAttribute(wxS("type"), wxS("input"));
+  wxString type = tag.GetAttribute(wxS("type"), wxS("input"));
   if (type == wxS("input"))
     editor->SetType(MC_TYPE_INPUT);
   else if (type == wxS("text"))
@@ -658,55 +637,53 @@ std::unique_ptr<Cell> MathParser::ParseEditorTag(wxXmlNode *node) {
     editor->SetType(MC_TYPE_HEADING6);
 
   wxString text = wxEmptyString;
-  wxXmlNode *line = node->GetChildren();
-  while (line) {
-    if (line->GetName() == wxS("line")) {
+  while (xml.AtContent()) {
+    if ((xml.GetType() == XMLTokenStream::startTag) &&
+        (xml.GetName() == wxS("line"))) {
+      std::size_t const depth = xml.GetDepth();
+      xml.Next();
       if (!text.IsEmpty())
         text += wxS("\n");
-      text += line->GetNodeContent();
+      text += xml.ReadText();
+      xml.SkipToEndOf(depth);
     }
-    line = line->GetNext();
+    else
+      xml.Skip();
   } // end while
   editor->SetValue(text);
   return editor;
 }
 
-std::unique_ptr<Cell> MathParser::ParseFracTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseFracTag(const XMLTag &tag, XMLTokenStream &xml) {
   auto fracStyle = m_FracStyle;
   auto highlight = m_highlight;
 
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto num = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
-  auto denom = HandleNullPointer(ParseTag(child, false));
+  auto num = HandleNullPointer(ParseTag(xml, false));
+  auto denom = HandleNullPointer(ParseTag(xml, false));
 
   auto frac = std::make_unique<FracCell>(m_group, m_configuration,
                                          std::move(num), std::move(denom));
   frac->SetFracStyle(fracStyle);
   frac->SetHighlight(highlight);
-  if (node->GetAttribute(wxS("line")) == wxS("no"))
+  if (tag.GetAttribute(wxS("line")) == wxS("no"))
     frac->SetFracStyle(FracCell::FC_CHOOSE);
-  if (node->GetAttribute(wxS("diffstyle")) == wxS("yes"))
+  if (tag.GetAttribute(wxS("diffstyle")) == wxS("yes"))
     frac->SetFracStyle(FracCell::FC_DIFF);
   frac->SetType(m_ParserStyle);
   frac->SetupBreakUps();
-  ParseCommonAttrs(node, frac);
+  ParseCommonAttrs(tag, frac);
   return frac;
 }
 
-std::unique_ptr<Cell> MathParser::ParseDiffTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseDiffTag(const XMLTag &tag, XMLTokenStream &xml) {
   std::unique_ptr<DiffCell> diff;
 
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  if (child) {
+  if (AtChild(xml)) {
     auto fc = m_FracStyle;
     m_FracStyle = FracCell::FC_DIFF;
-    auto diffInner = HandleNullPointer(ParseTag(child, false));
+    auto diffInner = HandleNullPointer(ParseTag(xml, false));
     m_FracStyle = fc;
-    child = GetNextTag(child);
-    auto base = HandleNullPointer(ParseTag(child, true));
+    auto base = HandleNullPointer(ParseTag(xml, true));
 
     diff = std::make_unique<DiffCell>(m_group, m_configuration, std::move(base),
                                       std::move(diffInner));
@@ -717,20 +694,17 @@ std::unique_ptr<Cell> MathParser::ParseDiffTag(wxXmlNode *node) {
                                       Cell::MakeVisiblyInvalidCell(m_group, m_configuration),
                                       Cell::MakeVisiblyInvalidCell(m_group, m_configuration));
   }
-  ParseCommonAttrs(node, diff);
+  ParseCommonAttrs(tag, diff);
   return diff;
 }
 
-std::unique_ptr<Cell> MathParser::ParseSupTag(wxXmlNode *node) {
-  bool matrix = (node->GetAttribute(wxS("mat")) == wxS("true"));
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
+std::unique_ptr<Cell> MathParser::ParseSupTag(const XMLTag &tag, XMLTokenStream &xml) {
+  bool matrix = (tag.GetAttribute(wxS("mat")) == wxS("true"));
 
-  auto base = HandleNullPointer(ParseTag(child, false));
+  auto base = HandleNullPointer(ParseTag(xml, false));
   auto baseText = base->ToString();
-  child = GetNextTag(child);
 
-  auto power = HandleNullPointer(ParseTag(child, false));
+  auto power = HandleNullPointer(ParseTag(xml, false));
   power->SetIsExponentList();
   auto powerText = power->ToString();
 
@@ -739,27 +713,26 @@ std::unique_ptr<Cell> MathParser::ParseSupTag(wxXmlNode *node) {
   expt->IsMatrix(matrix);
   expt->SetType(m_ParserStyle);
 
-  ParseCommonAttrs(node, expt);
-  if (node->GetAttribute(wxS("mat"), wxS("false")) == wxS("true"))
+  ParseCommonAttrs(tag, expt);
+  if (tag.GetAttribute(wxS("mat"), wxS("false")) == wxS("true"))
     expt->SetAltCopyText(baseText + wxS("^^") + powerText);
 
   return expt;
 }
 
-std::unique_ptr<Cell> MathParser::ParseSubSupTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto base = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
+std::unique_ptr<Cell> MathParser::ParseSubSupTag(const XMLTag &tag, XMLTokenStream &xml) {
+  auto base = HandleNullPointer(ParseTag(xml, false));
 
   auto subsup =
     std::make_unique<SubSupCell>(m_group, m_configuration, std::move(base));
   wxString pos;
-  if ((child != NULL) &&
-      (child->GetAttribute("pos", wxEmptyString) != wxEmptyString)) {
-    while (child != NULL) {
-      auto cell = HandleNullPointer(ParseTag(child, false));
-      pos = child->GetAttribute("pos", wxEmptyString);
+  if (AtChild(xml) && (xml.GetType() == XMLTokenStream::startTag) &&
+      (xml.GetTag().GetAttribute("pos", wxEmptyString) != wxEmptyString)) {
+    while (AtChild(xml)) {
+      pos = wxEmptyString;
+      if (xml.GetType() == XMLTokenStream::startTag)
+        pos = xml.GetTag().GetAttribute("pos", wxEmptyString);
+      auto cell = HandleNullPointer(ParseTag(xml, false));
       if (pos == "presub")
         subsup->SetPreSub(std::move(cell));
       else if (pos == "presup")
@@ -768,126 +741,119 @@ std::unique_ptr<Cell> MathParser::ParseSubSupTag(wxXmlNode *node) {
         subsup->SetPostSup(std::move(cell));
       else if (pos == "postsub")
         subsup->SetPostSub(std::move(cell));
-      child = SkipWhitespaceNode(child);
-      child = GetNextTag(child);
     }
   } else {
-    auto index = HandleNullPointer(ParseTag(child, false));
+    auto index = HandleNullPointer(ParseTag(xml, false));
     index->SetIsExponentList();
     subsup->SetIndex(std::move(index));
-    child = GetNextTag(child);
-    auto power = HandleNullPointer(ParseTag(child, false));
+    auto power = HandleNullPointer(ParseTag(xml, false));
     power->SetIsExponentList();
     subsup->SetExponent(std::move(power));
     subsup->SetType(m_ParserStyle);
     subsup->SetStyle(TS_VARIABLE);
-    ParseCommonAttrs(node, subsup);
+    ParseCommonAttrs(tag, subsup);
   }
   return subsup;
 }
 
-std::unique_ptr<Cell> MathParser::ParseMmultiscriptsTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseMmultiscriptsTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml) {
   bool pre = false;
   bool subscript = true;
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto base = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
+  auto base = HandleNullPointer(ParseTag(xml, false));
 
   auto subsup =
     std::make_unique<SubSupCell>(m_group, m_configuration, std::move(base));
-  while (child != NULL) {
-    if (child->GetName() == "mprescripts") {
+  while (AtChild(xml)) {
+    wxString childName;
+    if (xml.GetType() == XMLTokenStream::startTag)
+      childName = xml.GetName();
+    if (childName == "mprescripts") {
       pre = true;
       subscript = true;
-      child = GetNextTag(child);
+      xml.Skip();
       continue;
     }
 
-    if (child->GetName() != "none") {
+    if (childName == "none")
+      xml.Skip();
+    else {
       if (pre && subscript)
-        subsup->SetPreSub(ParseTag(child, false));
+        subsup->SetPreSub(ParseTag(xml, false));
       if (pre && (!subscript))
-        subsup->SetPreSup(ParseTag(child, false));
+        subsup->SetPreSup(ParseTag(xml, false));
       if ((!pre) && subscript)
-        subsup->SetPostSub(ParseTag(child, false));
+        subsup->SetPostSub(ParseTag(xml, false));
       if ((!pre) && (!subscript))
-        subsup->SetPostSup(ParseTag(child, false));
+        subsup->SetPostSup(ParseTag(xml, false));
     }
     subscript = !subscript;
-    child = SkipWhitespaceNode(child);
-    child = GetNextTag(child);
   }
   return subsup;
 }
 
-std::unique_ptr<Cell> MathParser::ParseSubTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto base = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
-  auto index = HandleNullPointer(ParseTag(child, false));
+std::unique_ptr<Cell> MathParser::ParseSubTag(const XMLTag &tag, XMLTokenStream &xml) {
+  auto base = HandleNullPointer(ParseTag(xml, false));
+  auto index = HandleNullPointer(ParseTag(xml, false));
   index->SetIsExponentList();
 
   auto sub = std::make_unique<SubCell>(m_group, m_configuration,
                                        std::move(base), std::move(index));
   sub->SetType(m_ParserStyle);
-  ParseCommonAttrs(node, sub);
+  ParseCommonAttrs(tag, sub);
   return sub;
 }
 
-std::unique_ptr<Cell> MathParser::ParseAtTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto base = HandleNullPointer(ParseTag(child, false));
+std::unique_ptr<Cell> MathParser::ParseAtTag(const XMLTag &tag, XMLTokenStream &xml) {
+  auto base = HandleNullPointer(ParseTag(xml, false));
   auto highlight = m_highlight;
-  child = GetNextTag(child);
-  auto index = HandleNullPointer(ParseTag(child, false));
+  auto index = HandleNullPointer(ParseTag(xml, false));
 
   auto at = std::make_unique<AtCell>(m_group, m_configuration, std::move(base),
                                      std::move(index));
   at->SetHighlight(highlight);
   at->SetType(m_ParserStyle);
-  ParseCommonAttrs(node, at);
+  ParseCommonAttrs(tag, at);
   return at;
 }
 
-std::unique_ptr<Cell> MathParser::ParseFunTag(wxXmlNode *node) {
-  if (node->GetAttribute(wxS("interval")) == wxS("true")) {
-    wxXmlNode *fnm = node->GetChildren();
-    fnm = SkipWhitespaceNode(fnm);
-    wxXmlNode *mrow = GetNextTag(fnm);
-    if (mrow != NULL) {
-      wxXmlNode *parenthesis = mrow->GetChildren();
-      parenthesis = SkipWhitespaceNode(parenthesis);
-      if (CountChildren(parenthesis) == 3) {
-        wxXmlNode *child = parenthesis->GetChildren();
-        child = SkipWhitespaceNode(child);
-        auto start = HandleNullPointer(ParseTag(child, false));
-        child = GetNextTag(child);
-        // Skip the comma
-        child = GetNextTag(child);
-        auto end = HandleNullPointer(ParseTag(child, false));
-
-        auto interval = std::make_unique<IntervalCell>(
-                                                       m_group, m_configuration, std::move(start), std::move(end));
-        ParseCommonAttrs(node, interval);
-        return interval;
+std::unique_ptr<Cell> MathParser::ParseFunTag(const XMLTag &tag, XMLTokenStream &xml) {
+  if (tag.GetAttribute(wxS("interval")) == wxS("true")) {
+    // Look ahead: Only if the argument is a parenthesis with three children
+    // we can display the function as an interval.
+    XMLTokenStream const arguments = xml;
+    // Skip the function name
+    if (AtChild(xml))
+      xml.Skip();
+    // Enter the mrow and the parenthesis inside it
+    if (AtChild(xml) && (xml.GetType() == XMLTokenStream::startTag)) {
+      xml.Next();
+      if (AtChild(xml) && (xml.GetType() == XMLTokenStream::startTag)) {
+        xml.Next();
+        if (CountChildren(xml) == 3) {
+          auto start = HandleNullPointer(ParseTag(xml, false));
+          // Skip the comma
+          if (AtChild(xml))
+            xml.Skip();
+          auto end = HandleNullPointer(ParseTag(xml, false));
+
+          auto interval = std::make_unique<IntervalCell>(
+                                                         m_group, m_configuration, std::move(start), std::move(end));
+          ParseCommonAttrs(tag, interval);
+          return interval;
+        }
       }
     }
+    xml = arguments;
   }
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
 
-  auto name = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
-  auto arg = HandleNullPointer(ParseTag(child, false));
+  auto name = HandleNullPointer(ParseTag(xml, false));
+  auto arg = HandleNullPointer(ParseTag(xml, false));
 
   auto fun = std::make_unique<FunCell>(m_group, m_configuration,
                                        std::move(name), std::move(arg));
   fun->SetType(m_ParserStyle);
 
-  ParseCommonAttrs(node, fun);
+  ParseCommonAttrs(tag, fun);
   if (fun->ToString().Contains(")("))
     fun->SetToolTip(&T_("If this isn't a function returning a lambda() "
                         "expression a multiplication sign (*) between closing "
@@ -895,10 +861,9 @@ std::unique_ptr<Cell> MathParser::ParseFunTag(wxXmlNode *node) {
   return fun;
 }
 
-std::unique_ptr<Cell> MathParser::ParseText(wxXmlNode *node, TextStyle style) {
-  wxString str;
+std::unique_ptr<Cell> MathParser::ParseText(wxString str, TextStyle style) {
   CellListBuilder<TextCell> tree;
-  if ((node != NULL) && ((str = node->GetContent()) != wxEmptyString)) {
+  if (str != wxEmptyString) {
     str.Replace(wxS("-"), wxS("\u2212")); // unicode minus sign
 
     wxStringTokenizer lines(str, wxS('\n'));
@@ -949,40 +914,37 @@ std::unique_ptr<Cell> MathParser::ParseText(wxXmlNode *node, TextStyle style) {
     tree.Append(std::make_unique<TextCell>(m_group, m_configuration));
 
   std::unique_ptr<TextCell> head = std::move(tree);
-  ParseCommonAttrs(node, head);
   return head;
 }
 
-void MathParser::ParseCommonAttrs(wxXmlNode *node, Cell *cell) {
+void MathParser::ParseCommonAttrs(const XMLTag &tag, Cell *cell) {
   if (cell == NULL)
     return;
-  if (node == NULL)
-    return;
 
-  if (node->GetAttribute(wxS("breakline"), wxS("false")) == wxS("true"))
+  if (tag.GetAttribute(wxS("breakline"), wxS("false")) == wxS("true"))
     cell->ForceBreakLine(true);
 
   wxString val;
-  if (node->GetAttribute(wxS("altCopy"), &val))
+  if (tag.GetAttribute(wxS("altCopy"), &val))
     cell->SetAltCopyText(val);
-  if (node->GetAttribute(wxS("tooltip"), &val))
+  if (tag.GetAttribute(wxS("tooltip"), &val))
     if (!val.empty())
       cell->SetToolTip(std::move(val));
 }
 
 void MathParser::ParseCommonGroupCellAttrs(
-                                           wxXmlNode *node, const std::unique_ptr<GroupCell> &group) {
-  if (!group || !node)
+                                           const XMLTag &tag, const std::unique_ptr<GroupCell> &group) {
+  if (!group)
     return;
 
-  if (node->GetAttribute(wxS("hideToolTip")) == wxS("true"))
+  if (tag.GetAttribute(wxS("hideToolTip")) == wxS("true"))
     group->SetSuppressTooltipMarker(true);
 }
 
-std::unique_ptr<Cell> MathParser::ParseCharCode(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseCharCode(const XMLTag &tag, XMLTokenStream &xml) {
   auto cell = std::make_unique<TextCell>(m_group, m_configuration);
-  wxString str;
-  if ((node != NULL) && ((str = node->GetContent()) != wxEmptyString)) {
+  wxString str = xml.ReadText();
+  if (str != wxEmptyString) {
     long code;
     if (str.ToLong(&code))
       str = wxString::Format(wxS("%c"), code);
@@ -991,98 +953,81 @@ std::unique_ptr<Cell> MathParser::ParseCharCode(wxXmlNode *node) {
     cell->SetStyle(TS_MATH);
     cell->SetHighlight(m_highlight);
   }
-  ParseCommonAttrs(node, cell);
+  ParseCommonAttrs(tag, cell);
   return cell;
 }
 
-std::unique_ptr<Cell> MathParser::ParseSqrtTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-
-  auto inner = HandleNullPointer(ParseTag(child, true));
+std::unique_ptr<Cell> MathParser::ParseSqrtTag(const XMLTag &tag, XMLTokenStream &xml) {
+  auto inner = HandleNullPointer(ParseTag(xml, true));
   auto cell =
     std::make_unique<SqrtCell>(m_group, m_configuration, std::move(inner));
   cell->SetType(m_ParserStyle);
   cell->SetHighlight(m_highlight);
-  ParseCommonAttrs(node, cell);
+  ParseCommonAttrs(tag, cell);
   return cell;
 }
 
-std::unique_ptr<Cell> MathParser::ParseAbsTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto inner = HandleNullPointer(ParseTag(child, true));
+std::unique_ptr<Cell> MathParser::ParseAbsTag(const XMLTag &tag, XMLTokenStream &xml) {
+  auto inner = HandleNullPointer(ParseTag(xml, true));
 
   auto cell =
     std::make_unique<AbsCell>(m_group, m_configuration, std::move(inner));
   cell->SetType(m_ParserStyle);
   cell->SetHighlight(m_highlight);
-  ParseCommonAttrs(node, cell);
+  ParseCommonAttrs(tag, cell);
   return cell;
 }
 
-std::unique_ptr<Cell> MathParser::ParseConjugateTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto inner = HandleNullPointer(ParseTag(child, true));
+std::unique_ptr<Cell> MathParser::ParseConjugateTag(const XMLTag &tag, XMLTokenStream &xml) {
+  auto inner = HandleNullPointer(ParseTag(xml, true));
 
   auto cell = std::make_unique<ConjugateCell>(m_group, m_configuration,
                                               std::move(inner));
   cell->SetType(m_ParserStyle);
   cell->SetHighlight(m_highlight);
-  ParseCommonAttrs(node, cell);
+  ParseCommonAttrs(tag, cell);
   return cell;
 }
 
-std::unique_ptr<Cell> MathParser::ParseParenTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
+std::unique_ptr<Cell> MathParser::ParseParenTag(const XMLTag &tag, XMLTokenStream &xml) {
   // No special Handling for NULL args here: They are completely legal
   // here as they just indicate an empty parenthesis.
-  auto inner = ParseTag(child, true);
+  auto inner = ParseTag(xml, true);
   auto cell =
     std::make_unique<ParenCell>(m_group, m_configuration, std::move(inner));
   cell->SetType(m_ParserStyle);
   cell->SetHighlight(m_highlight);
   cell->SetStyle(TS_VARIABLE);
-  if (node->GetAttribute(wxS("print")) == wxS("no"))
+  if (tag.GetAttribute(wxS("print")) == wxS("no"))
     cell->SetPrint(false);
-  ParseCommonAttrs(node, cell);
+  ParseCommonAttrs(tag, cell);
   return cell;
 }
 
-std::unique_ptr<Cell> MathParser::ParseLimitTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  auto name = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
-  auto under = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
-  auto base = HandleNullPointer(ParseTag(child, false));
+std::unique_ptr<Cell> MathParser::ParseLimitTag(const XMLTag &tag, XMLTokenStream &xml) {
+  auto name = HandleNullPointer(ParseTag(xml, false));
+  auto under = HandleNullPointer(ParseTag(xml, false));
+  auto base = HandleNullPointer(ParseTag(xml, false));
 
   auto limit =
     std::make_unique<LimitCell>(m_group, m_configuration, std::move(base),
                                 std::move(under), std::move(name));
   limit->SetType(m_ParserStyle);
-  ParseCommonAttrs(node, limit);
+  ParseCommonAttrs(tag, limit);
   return limit;
 }
 
-std::unique_ptr<Cell> MathParser::ParseSumTag(wxXmlNode *node) {
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
-  wxString type = node->GetAttribute(wxS("type"), wxS("sum"));
+std::unique_ptr<Cell> MathParser::ParseSumTag(const XMLTag &tag, XMLTokenStream &xml) {
+  wxString type = tag.GetAttribute(wxS("type"), wxS("sum"));
   sumStyle style =
     ((type == wxS("prod")) || (type == wxS("lprod"))) ? SM_PROD : SM_SUM;
   auto highlight = m_highlight;
 
-  auto under = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
+  auto under = HandleNullPointer(ParseTag(xml, false));
   std::unique_ptr<Cell> over;
   if ((type != wxS("lsum")) && (type != wxS("lprod")))
-    over = HandleNullPointer(ParseTag(child, false));
-  child = GetNextTag(child);
-  auto base = HandleNullPointer(ParseTag(child, false));
+    over = HandleNullPointer(ParseTag(xml, false));
+  auto base = HandleNullPointer(ParseTag(xml, false));
 
   auto sum = std::make_unique<SumCell>(m_group, m_configuration, style,
                                        std::move(under), std::move(over),
@@ -1090,33 +1035,27 @@ std::unique_ptr<Cell> MathParser::ParseSumTag(wxXmlNode *node) {
   sum->SetHighlight(highlight);
   sum->SetType(m_ParserStyle);
   sum->SetStyle(TS_VARIABLE);
-  ParseCommonAttrs(node, sum);
+  ParseCommonAttrs(tag, sum);
   return sum;
 }
 
-std::unique_ptr<Cell> MathParser::ParseIntTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseIntTag(const XMLTag &tag, XMLTokenStream &xml) {
   std::unique_ptr<IntCell> in;
-  wxXmlNode *child = node->GetChildren();
-  child = SkipWhitespaceNode(child);
   auto highlight = m_highlight;
 
-  wxString definiteAtt = node->GetAttribute(wxS("def"), wxS("true"));
+  wxString definiteAtt = tag.GetAttribute(wxS("def"), wxS("true"));
   if (definiteAtt != wxS("true")) {
     // An Indefinite Integral
-    auto base = HandleNullPointer(ParseTag(child, false));
-    child = GetNextTag(child);
-    auto var = HandleNullPointer(ParseTag(child, true));
+    auto base = HandleNullPointer(ParseTag(xml, false));
+    auto var = HandleNullPointer(ParseTag(xml, true));
     in = std::make_unique<IntCell>(m_group, m_configuration, std::move(base),
                                    std::move(var));
   } else {
     // A Definite Integral
-    auto under = HandleNullPointer(ParseTag(child, false));
-    child = GetNextTag(child);
-    auto over = HandleNullPointer(ParseTag(child, false));
-    child = GetNextTag(child);
-    auto base = HandleNullPointer(ParseTag(child, false));
-    child = GetNextTag(child);
-    auto var = HandleNullPointer(ParseTag(child, true));
+    auto under = HandleNullPointer(ParseTag(xml, false));
+    auto over = HandleNullPointer(ParseTag(xml, false));
+    auto base = HandleNullPointer(ParseTag(xml, false));
+    auto var = HandleNullPointer(ParseTag(xml, true));
 
     in = std::make_unique<IntCell>(m_group, m_configuration, std::move(base),
                                    std::move(under), std::move(over),
@@ -1125,86 +1064,90 @@ std::unique_ptr<Cell> MathParser::ParseIntTag(wxXmlNode *node) {
   }
   in->SetType(m_ParserStyle);
   in->SetHighlight(highlight);
-  ParseCommonAttrs(node, in);
+  ParseCommonAttrs(tag, in);
   return in;
 }
 
-std::unique_ptr<Cell> MathParser::ParseTableTag(wxXmlNode *node) {
+std::unique_ptr<Cell> MathParser::ParseTableTag(const XMLTag &tag, XMLTokenStream &xml) {
   auto matrix = std::make_unique<MatrCell>(m_group, m_configuration);
   matrix->SetHighlight(m_highlight);
 
-  if (node->GetAttribute(wxS("special"), wxS("false")) == wxS("true"))
+  if (tag.GetAttribute(wxS("special"), wxS("false")) == wxS("true"))
     matrix->SetSpecialFlag(true);
-  if (node->GetAttribute(wxS("inference"), wxS("false")) == wxS("true")) {
+  if (tag.GetAttribute(wxS("inference"), wxS("false")) == wxS("true")) {
     matrix->SetInferenceFlag(true);
     matrix->SetSpecialFlag(true);
   }
-  if (node->GetAttribute(wxS("colnames"), wxS("false")) == wxS("true"))
+  if (tag.GetAttribute(wxS("colnames"), wxS("false")) == wxS("true"))
     matrix->ColNames(true);
-  if (node->GetAttribute(wxS("rownames"), wxS("false")) == wxS("true"))
+  if (tag.GetAttribute(wxS("rownames"), wxS("false")) == wxS("true"))
     matrix->RowNames(true);
-  if (node->GetAttribute(wxS("roundedParens")) == wxS("false"))
+  if (tag.GetAttribute(wxS("roundedParens")) == wxS("false"))
     matrix->BracketParens();
-  if (node->GetAttribute(wxS("roundedParens")) == wxS("true"))
+  if (tag.GetAttribute(wxS("roundedParens")) == wxS("true"))
     matrix->RoundedParens();
-  if (node->GetAttribute(wxS("bracketParens")) == wxS("true"))
+  if (tag.GetAttribute(wxS("bracketParens")) == wxS("true"))
     matrix->BracketParens();
-  if (node->GetAttribute(wxS("angledParens")) == wxS("true"))
+  if (tag.GetAttribute(wxS("angledParens")) == wxS("true"))
     matrix->AngledParens();
-  if (node->GetAttribute(wxS("straightParens")) == wxS("true"))
+  if (tag.GetAttribute(wxS("straightParens")) == wxS("true"))
     matrix->StraightParens();
 
-  wxXmlNode *rows = SkipWhitespaceNode(node->GetChildren());
-  while (rows) {
+  while (AtChild(xml)) {
     matrix->NewRow();
-    wxXmlNode *cells = SkipWhitespaceNode(rows->GetChildren());
-    while (cells) {
+    if (xml.GetType() != XMLTokenStream::startTag) {
+      xml.Next();
+      continue;
+    }
+    std::size_t const depth = xml.GetDepth();
+    xml.Next();
+    while (AtChild(xml)) {
       matrix->NewColumn();
-      matrix->AddNewCell(HandleNullPointer(ParseTag(cells, false)));
-      cells = GetNextTag(cells);
+      matrix->AddNewCell(HandleNullPointer(ParseTag(xml, false)));
     }
-    rows = GetNextTag(rows);
+    xml.SkipToEndOf(depth);
   }
   matrix->SetType(m_ParserStyle);
   matrix->SetStyle(TS_VARIABLE);
   matrix->SetDimension();
-  ParseCommonAttrs(node, matrix);
+  ParseCommonAttrs(tag, matrix);
   return matrix;
 }
 
-std::unique_ptr<Cell> MathParser::ParseTag(wxXmlNode *node, bool all) {
+std::unique_ptr<Cell> MathParser::ParseTag(XMLTokenStream &xml, bool all) {
   CellListBuilder<> tree;
   bool gotInvalid = false;
 
   Cell *last = NULL;
 
-  node = SkipWhitespaceNode(node);
-  for (; node; node = GetNextTag(node)) {
-    auto &tagName = node->GetName();
+  while (AtChild(xml)) {
     tree.ClearLastAppended();
-    if (node->GetType() == wxXML_ELEMENT_NODE) {
-      // Parse XML tags. The only other type of element we recognize are text
-      // nodes.
-
-      auto function = m_innerTags[tagName];
-      if (function)
-        tree.Append(CALL_MEMBER_FN(*this, function)(node));
-
-      if (false)
-        if (!tree.GetLastAppended() && node->GetChildren())
-          tree.Append(ParseTag(node->GetChildren()));
+    if (xml.GetType() == XMLTokenStream::startTag) {
+      // Parse XML tags. The only other type of token we recognize are texts.
+      std::size_t const depth = xml.GetDepth();
+      XMLTag const tag = xml.TakeTag();
+      xml.Next();
+
+      // Don't use m_innerTags[tag.name] here: It would add unknown tags to
+      // the hash which would be a race condition if several parsers work in
+      // parallel.
+      auto function = m_innerTags.find(tag.name);
+      if ((function != m_innerTags.end()) && (function->second))
+        tree.Append(CALL_MEMBER_FN(*this, function->second)(tag, xml));
+      // Whatever of the element the handler didn't read is of no interest.
+      xml.SkipToEndOf(depth);
 
       if (!tree.GetLastAppended() &&
-          (node->GetAttribute(wxS("listdelim")) != wxS("true"))) {
+          (tag.GetAttribute(wxS("listdelim")) != wxS("true"))) {
         auto tmp = std::make_unique<VisiblyInvalidCell>(
                                                         m_group, m_configuration,
-                                                        wxString::Format(m_unknownXMLTagToolTip, tagName));
+                                                        wxString::Format(m_unknownXMLTagToolTip, tag.name));
         tree.Append(std::move(tmp));
         gotInvalid = true;
       }
 
       if (tree.GetLastAppended())
-        ParseCommonAttrs(node, tree.GetLastAppended());
+        ParseCommonAttrs(tag, tree.GetLastAppended());
 
       // If our current cell begins with a minus and the last cell is a
       // multiplication sign we must not hide that sign.
@@ -1216,8 +1159,8 @@ std::unique_ptr<Cell> MathParser::ParseTag(wxXmlNode *node, bool all) {
       }
       last = tree.GetLastAppended();
     } else {
-      // We didn't get a tag but got a text cell => Parse the text.
-      tree.Append(ParseText(node));
+      // We didn't get a tag but got a text => Parse the text.
+      tree.Append(ParseText(xml.ReadText()));
     }
 
     if (gotInvalid && !all) {
@@ -1225,7 +1168,11 @@ std::unique_ptr<Cell> MathParser::ParseTag(wxXmlNode *node, bool all) {
       wxString msg;
       msg = tree.GetLastAppended()->ToString();
       if (!msg.empty()) {
-        LoggingMessageBox(msg, _("Warning"), wxOK | wxICON_WARNING);
+        // Background parsers must not open dialogues
+        if (wxThread::IsMain())
+          LoggingMessageBox(msg, _("Warning"), wxOK | wxICON_WARNING);
+        else
+          wxLogMessage("%s", msg);
         gotInvalid = false;
       }
     }
@@ -1238,11 +1185,7 @@ std::unique_ptr<Cell> MathParser::ParseTag(wxXmlNode *node, bool all) {
 }
 
 std::unique_ptr<Cell> MathParser::ParseLine(wxString s, CellType style) {
-  m_ParserStyle = style;
-  m_FracStyle = FracCell::FC_NORMAL;
-  m_highlight = false;
-  std::unique_ptr<Cell> cell;
-
+  WXM_TRACE_ZONE("MathParser::ParseLine");
   int showLength;
 
   switch (m_configuration->ShowLength()) {
@@ -1262,36 +1205,37 @@ std::unique_ptr<Cell> MathParser::ParseLine(wxString s, CellType style) {
     showLength = 50000;
   }
 
-  m_graphRegex.Replace(&s, wxS("\uFFFD"));
-
-  if (((long)s.Length() < showLength) || (showLength == 0)) {
-    wxXmlDocument xml;
+  if (((long)s.Length() < showLength) || (showLength == 0))
+    return ParseLineNow(s, style);
 
-    wxStringInputStream xmlStream(s);
-
-    {
-      wxLogNull suppressErrorMessages;
-      xml.Load(xmlStream, wxS("UTF-8"), wxXMLDOC_KEEP_WHITESPACE_NODES);
-    }
+  // Converting this line to cells and laying them out would be slow => only do
+  // so once the user actually looks at it.
+  return std::make_unique<LazyMathCell>(m_group, m_configuration, s, style,
+                                        m_userDefinedLabel);
+}
 
-    wxXmlNode *doc = xml.GetRoot();
+std::unique_ptr<Cell> MathParser::ParseLineNow(const wxString &s, CellType style) {
+  m_ParserStyle = style;
+  m_FracStyle = FracCell::FC_NORMAL;
+  m_highlight = false;
+  std::unique_ptr<Cell> cell;
 
-    if (doc != NULL)
-      cell = ParseTag(doc->GetChildren());
-  } else {
-    cell = std::make_unique<TextCell>(
-                                      m_group, m_configuration,
-                                      T_("(wxMaxima is configured not to show long expressions - which would be slow)"),
-                                      TS_WARNING);
-    cell->SetToolTip(&T_(
-                         "The maximum size of the expressions wxMaxima is allowed to display "
-                         "can be changed in the configuration dialogue."));
-    cell->ForceBreakLine(true);
-  }
+  XMLTokenStream xml(s);
+  // Find the root element
+  while (xml.Next() == XMLTokenStream::text) {}
+  if (xml.GetType() != XMLTokenStream::startTag)
+    return cell;
+  xml.Next();
+  cell = ParseTag(xml);
+  // Incomplete or broken XML is ignored as a whole.
+  while ((xml.GetType() != XMLTokenStream::end) &&
+         (xml.GetType() != XMLTokenStream::error))
+    xml.Next();
+  if (xml.GetType() == XMLTokenStream::error)
+    cell.reset();
   return cell;
 }
 
-wxRegEx MathParser::m_graphRegex(wxS("[[:cntrl:]]"));
 MathParser::MathCellFunctionHash MathParser::m_innerTags;
 MathParser::GroupCellFunctionHash MathParser::m_groupTags;
 wxString MathParser::m_unknownXMLTagToolTip;
@@ -42,6 +42,7 @@
 #include "EditorCell.h"
 #include "FracCell.h"
 #include "GroupCell.h"
+#include "XMLTokenStream.h"
 #include <unordered_map>
 
 /*! This class handles parsing the xml representation of a cell tree.
@@ -70,22 +71,32 @@ public:
    * Put the result in line.
    */
   std::unique_ptr<Cell> ParseLine(wxString s, CellType style = MC_TYPE_DEFAULT);
-  /***
-   * Parse the node and return the corresponding tag.
-   */
+  /*! Parse the string s like ParseLine() does, even if it is big
 
-  std::unique_ptr<Cell> ParseTag(wxXmlNode *node, bool all = true);
-  std::unique_ptr<Cell> ParseRowTag(wxXmlNode *node);
+    ParseLine() returns a LazyMathCell that defers the parsing instead if the
+    line is longer than the configuration allows.
+  */
+  std::unique_ptr<Cell> ParseLineNow(const wxString &s, CellType style = MC_TYPE_DEFAULT);
+  /*! Convert the children of an element to cells
+
+    Reads the children starting at the current token and stops at the end tag
+    of the element they belong to (without reading it).
+
+    \param xml The token stream to read from
+    \param all false = Only convert the next child
+  */
+  std::unique_ptr<Cell> ParseTag(XMLTokenStream &xml, bool all = true);
+  std::unique_ptr<Cell> ParseRowTag(const XMLTag &tag, XMLTokenStream &xml);
 
   //! Sets the group the newly parsed cells are provided with
   void SetGroup(GroupCell *group) { m_group = group; }
 
 private:
   //! A pointer to a method that handles an XML tag for a type of Cell
-  using MathCellFunc = std::unique_ptr<Cell> (MathParser::*)(wxXmlNode *node);
+  using MathCellFunc = std::unique_ptr<Cell> (MathParser::*)(const XMLTag &tag, XMLTokenStream &xml);
 
   //! A pointer to a method that handles an XML tag for a type of GroupCell
-  using GroupCellFunc = std::unique_ptr<GroupCell> (MathParser::*)(wxXmlNode *node);
+  using GroupCellFunc = std::unique_ptr<GroupCell> (MathParser::*)(const XMLTag &tag);
 
 #if wxCHECK_VERSION(3, 3, 0) || wxUSE_STL
   typedef std::unordered_map <wxString, MathCellFunc> MathCellFunctionHash;
@@ -101,40 +112,36 @@ private:
   static GroupCellFunctionHash m_groupTags;
 
   //! Parses attributes that apply to nearly all types of cells
-  static void ParseCommonAttrs(wxXmlNode *node, Cell *cell);
+  static void ParseCommonAttrs(const XMLTag &tag, Cell *cell);
   template <typename T>
-  static void ParseCommonAttrs(wxXmlNode *node, const std::unique_ptr<T> &cell)
-    { ParseCommonAttrs(node, cell.get()); }
+  static void ParseCommonAttrs(const XMLTag &tag, const std::unique_ptr<T> &cell)
+    { ParseCommonAttrs(tag, cell.get()); }
 
   //! Parses attributes that apply to nearly all types of cells
-  static void ParseCommonGroupCellAttrs(wxXmlNode *node, const std::unique_ptr<GroupCell> &group);
+  static void ParseCommonGroupCellAttrs(const XMLTag &tag, const std::unique_ptr<GroupCell> &group);
 
   //! Returns cell or, if cell==NULL, an empty text cell as a fallback.
   std::unique_ptr<Cell> HandleNullPointer(std::unique_ptr<Cell> &&cell);
 
-  /*! Get the next xml tag
-
-    wxXmlNode can operate in two modes:
-    - One mode skips all whitespace between the beginning of the line and the first
-    character if that character was escaped by a & for including it into the XML
-    stream. This obviously is a bad idea in our case.
-    - And the other mode inserts bogus whitespace text nodes if there is whitespace
-    between XML tags. This one is more helpful - but only if we provide a function
-    that skips these whitespace text nodes.
-    If we encounter a non-whitespace text node where we shouldn't we raise an
-    assertion that informs the user that we might want a bug report about this.
+  /*! Is a text only whitespace between two tags?
+
+    Texts that contain a single char in front of the whitespace count as
+    whitespace, too.
   */
-  static wxXmlNode *GetNextTag(wxXmlNode *node);
+  static bool IsWhitespaceText(const wxString &text);
 
-  /*! Counts the number of non-whitespace children of a node */
-  static int CountChildren(wxXmlNode *node);
+  /*! Skips whitespace texts
+
+    \return true, if the stream is at a start tag or a text afterwards, false,
+    if the element ended.
+  */
+  static bool AtChild(XMLTokenStream &xml);
 
-  /*! Returns node - or (if node is a whitespace-only text node) the next one.
+  /*! Counts the number of non-whitespace children of the element we are in
 
-    If we encounter a non-whitespace text node where we shouldn't we raise an
-    assertion that informs the user that we might want a bug report about this.
+    Takes the stream by value as it needs to read all children.
   */
-  static wxXmlNode *SkipWhitespaceNode(wxXmlNode *node);
+  static int CountChildren(XMLTokenStream xml);
 
   /*! \defgroup GroupCellParsing Methods that generate GroupCells from XML
     @{
@@ -147,119 +154,117 @@ private:
     \attention Any changes in GroupCell structure or methods
     has to be reflected here in order to ensure proper loading of WXMX files.
   */
-  std::unique_ptr<Cell> ParseCellTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseCellTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Convert a code cell XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromCodeTag(wxXmlNode *node);
+  std::unique_ptr<GroupCell> GroupCellFromCodeTag(const XMLTag &tag);
   //! Convert an image XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromImageTag(wxXmlNode *node);
+  std::unique_ptr<GroupCell> GroupCellFromImageTag(const XMLTag &tag);
   //! Convert a title XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromTitleTag(wxXmlNode *WXUNUSED(node));
+  std::unique_ptr<GroupCell> GroupCellFromTitleTag(const XMLTag &WXUNUSED(tag));
   //! Convert a title XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromSectionTag(wxXmlNode *WXUNUSED(node));
+  std::unique_ptr<GroupCell> GroupCellFromSectionTag(const XMLTag &WXUNUSED(tag));
   //! Convert a pagebreak XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromPagebreakTag(wxXmlNode *WXUNUSED(node));
+  std::unique_ptr<GroupCell> GroupCellFromPagebreakTag(const XMLTag &WXUNUSED(tag));
   //! Convert a subsection XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromSubsectionTag(wxXmlNode *node);
+  std::unique_ptr<GroupCell> GroupCellFromSubsectionTag(const XMLTag &tag);
   //! Convert a subsubsection XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromSubsubsectionTag(wxXmlNode *WXUNUSED(node));
+  std::unique_ptr<GroupCell> GroupCellFromSubsubsectionTag(const XMLTag &WXUNUSED(tag));
   //! Convert a heading5 XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellHeading5Tag(wxXmlNode *WXUNUSED(node));
+  std::unique_ptr<GroupCell> GroupCellHeading5Tag(const XMLTag &WXUNUSED(tag));
   //! Convert a heading6 XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellHeading6Tag(wxXmlNode *WXUNUSED(node));
+  std::unique_ptr<GroupCell> GroupCellHeading6Tag(const XMLTag &WXUNUSED(tag));
   //! Convert a text cell XML tag to a GroupCell
-  std::unique_ptr<GroupCell> GroupCellFromTextTag(wxXmlNode *WXUNUSED(node));
+  std::unique_ptr<GroupCell> GroupCellFromTextTag(const XMLTag &WXUNUSED(tag));
   /* @} */
 
   /*! \defgroup MathCellParsing Methods that generate Cell objects from XML
     @{
   */
   //! Parse an editor XML tag to a Cell.
-  std::unique_ptr<Cell> ParseEditorTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseEditorTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an frac XML tag to a Cell.
-  std::unique_ptr<Cell> ParseFracTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseFracTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a text XML tag to a Cell.
-  std::unique_ptr<Cell> ParseText(wxXmlNode *node, TextStyle style = TS_MATH);
+  std::unique_ptr<Cell> ParseText(wxString str, TextStyle style = TS_MATH);
   /*! Parse a Variable name / operator tag to a Cell.
 
     Operators identify themself as variable.
   */
-  std::unique_ptr<Cell> ParseVariableNameTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseVariableNameTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an Operator name tag to a Cell.
-  std::unique_ptr<Cell> ParseOperatorNameTag(wxXmlNode *node){return ParseText(node->GetChildren(), TS_FUNCTION);}
+  std::unique_ptr<Cell> ParseOperatorNameTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml){return ParseText(xml.ReadText(), TS_FUNCTION);}
   //! Parse a miscellaneous text tag to a Cell.
-  std::unique_ptr<Cell> ParseMiscTextTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseMiscTextTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a number tag to a Cell.
-  std::unique_ptr<Cell> ParseNumberTag(wxXmlNode *node){return ParseText(node->GetChildren(), TS_NUMBER);}
+  std::unique_ptr<Cell> ParseNumberTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml){return ParseText(xml.ReadText(), TS_NUMBER);}
   //! Parse a hidden operator tag to a Cell.
-  std::unique_ptr<Cell> ParseHiddenOperatorTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseHiddenOperatorTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an hidden operator tag to a Cell.
-  std::unique_ptr<Cell> ParseGreekTag(wxXmlNode *node){return ParseText(node->GetChildren(), TS_GREEK_CONSTANT);}
+  std::unique_ptr<Cell> ParseGreekTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml){return ParseText(xml.ReadText(), TS_GREEK_CONSTANT);}
   //! Parse a special constant tag to a Cell.
-  std::unique_ptr<Cell> ParseSpecialConstantTag(wxXmlNode *node){return ParseText(node->GetChildren(), TS_SPECIAL_CONSTANT);}
+  std::unique_ptr<Cell> ParseSpecialConstantTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml){return ParseText(xml.ReadText(), TS_SPECIAL_CONSTANT);}
   //! Parse a function name tag to a Cell.
-  std::unique_ptr<Cell> ParseFunctionNameTag(wxXmlNode *node){return ParseText(node->GetChildren(), TS_FUNCTION);}
+  std::unique_ptr<Cell> ParseFunctionNameTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &xml){return ParseText(xml.ReadText(), TS_FUNCTION);}
   //! Parse a space tag to a Cell.
-  std::unique_ptr<Cell> ParseSpaceTag(wxXmlNode *WXUNUSED(node)){return std::make_unique<TextCell>(m_group, m_configuration, wxS(" "));}
+  std::unique_ptr<Cell> ParseSpaceTag(const XMLTag &WXUNUSED(tag), XMLTokenStream &WXUNUSED(xml)){return std::make_unique<TextCell>(m_group, m_configuration, wxS(" "));}
   /*! Parse a math-in-maths tag to a Cell.
 
     \todo Does such a thing actually exist?
   */
-  std::unique_ptr<Cell> ParseMthTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseMthTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an output label tag to a Cell.
-  std::unique_ptr<Cell> ParseOutputLabelTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseOutputLabelTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a string tag to a Cell.
-  std::unique_ptr<Cell> ParseStringTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseStringTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a highlight tag to a Cell.
-  std::unique_ptr<Cell> ParseHighlightTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseHighlightTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an image tag to a Cell.
-  std::unique_ptr<Cell> ParseImageTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseImageTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an animation tag to a Cell.
-  std::unique_ptr<Cell> ParseAnimationTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseAnimationTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a charcode tag to a Cell.
-  std::unique_ptr<Cell> ParseCharCode(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseCharCode(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a superscript tag to a Cell.
-  std::unique_ptr<Cell> ParseSupTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseSupTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a subscript tag to a Cell.
-  std::unique_ptr<Cell> ParseSubTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseSubTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an abs tag to a Cell.
-  std::unique_ptr<Cell> ParseAbsTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseAbsTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a conjugate cell tag to a Cell.
-  std::unique_ptr<Cell> ParseConjugateTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseConjugateTag(const XMLTag &tag, XMLTokenStream &xml);
 #if 0
   //! Parse an index tag to a Cell. FIXME this is unused, without implementation.
-  std::unique_ptr<Cell> ParseUnderTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseUnderTag(const XMLTag &tag, XMLTokenStream &xml);
 #endif
   //! Parse an table tag to a Cell.
-  std::unique_ptr<Cell> ParseTableTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseTableTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an atcell tag to a Cell.
-  std::unique_ptr<Cell> ParseAtTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseAtTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a diff tag to a Cell.
-  std::unique_ptr<Cell> ParseDiffTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseDiffTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a sum tag to a Cell.
-  std::unique_ptr<Cell> ParseSumTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseSumTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an integral tag to a Cell.
-  std::unique_ptr<Cell> ParseIntTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseIntTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a function tag to a Cell.
-  std::unique_ptr<Cell> ParseFunTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseFunTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a square root tag to a Cell.
-  std::unique_ptr<Cell> ParseSqrtTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseSqrtTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a lim() tag to a Cell.
-  std::unique_ptr<Cell> ParseLimitTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseLimitTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a parenthesis() tag to a Cell.
-  std::unique_ptr<Cell> ParseParenTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseParenTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a super-and-subscript cell tag to a Cell.
-  std::unique_ptr<Cell> ParseSubSupTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseSubSupTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse a pre-and-post-super-and-subscript cell tag to a Cell.
-  std::unique_ptr<Cell> ParseMmultiscriptsTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseMmultiscriptsTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an Output tag telling that the math is from maxima.
-  std::unique_ptr<Cell> ParseOutputTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseOutputTag(const XMLTag &tag, XMLTokenStream &xml);
   //! Parse an Matrix cell tag.
-  std::unique_ptr<Cell> ParseMtdTag(wxXmlNode *node);
+  std::unique_ptr<Cell> ParseMtdTag(const XMLTag &tag, XMLTokenStream &xml);
   // @}
   //! The last user defined label
   wxString m_userDefinedLabel;
-  //! A RegEx that catches the last graphics placeholder
-  static wxRegEx m_graphRegex;
 
   CellType m_ParserStyle;
   FracCell::FracType m_FracStyle;
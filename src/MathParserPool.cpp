@@ -0,0 +1,139 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class MathParserPool that converts maxima's XML output
+  to cells in background threads.
+*/
+
+#include "MathParserPool.h"
+#include <chrono>
+#include <utility>
+
+wxDEFINE_EVENT(EVT_MATH_PARSED, wxThreadEvent);
+
+MathParserPool::MathParserPool(Configuration *cfg, wxEvtHandler *resultHandler)
+  : m_resultHandler(resultHandler) {
+  // One core is needed for the GUI, and output typically arrives slower than
+  // a few threads can parse it.
+  int threads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  if (threads < 1)
+    threads = 1;
+  if (threads > 4)
+    threads = 4;
+  // The parsers are created here, not in the threads: The MathParser
+  // constructor fills static tables.
+  for (int i = 0; i < threads; i++)
+    m_parsers.emplace_back(std::make_unique<MathParser>(cfg));
+  for (auto &parser : m_parsers)
+    m_threads.emplace_back(&MathParserPool::WorkerThread, this, parser.get());
+}
+
+MathParserPool::~MathParserPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_exit = true;
+  }
+  m_jobAvailable.notify_all();
+  for (auto &thread : m_threads)
+    thread.join();
+}
+
+bool MathParserPool::CanParse(const wxString &s) {
+  // Image and animation cells load files and start timers which only the GUI
+  // thread may do.
+  return (!s.Contains(wxS("<img"))) && (!s.Contains(wxS("<slide")));
+}
+
+void MathParserPool::Submit(const wxString &s, CellType style,
+                            const wxString &userLabel, int userData) {
+  Job job;
+  job.serial = m_nextSerial++;
+  job.xml = s;
+  job.style = style;
+  job.userLabel = userLabel;
+  job.userData = userData;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_jobs.emplace_back(std::move(job));
+  }
+  m_jobAvailable.notify_one();
+}
+
+bool MathParserPool::PopResult(Result &result, bool wait) {
+  if (!HasPending())
+    return false;
+  std::unique_lock<std::mutex> lock(m_lock);
+  auto it = m_results.find(m_nextResult);
+  if (wait)
+    while (it == m_results.end()) {
+      m_resultReady.wait(lock);
+      it = m_results.find(m_nextResult);
+    }
+  if (it == m_results.end())
+    return false;
+  result = std::move(it->second);
+  m_results.erase(it);
+  m_nextResult++;
+  return true;
+}
+
+void MathParserPool::Clear() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_jobs.clear();
+  m_results.clear();
+  // Results of lines that are currently being parsed will now be discarded
+  // as soon as they are ready.
+  m_nextResult = m_nextSerial;
+}
+
+void MathParserPool::WorkerThread(MathParser *parser) {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_jobAvailable.wait(lock, [this] { return m_exit || !m_jobs.empty(); });
+      if (m_exit)
+        return;
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    parser->SetUserLabel(job.userLabel);
+    Result result;
+    auto const start = std::chrono::steady_clock::now();
+    result.cell = parser->ParseLine(job.xml, job.style);
+    auto const parseTime = std::chrono::steady_clock::now() - start;
+    m_parseMicroseconds +=
+      std::chrono::duration_cast<std::chrono::microseconds>(parseTime).count();
+    result.userData = job.userData;
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (job.serial < m_nextResult)
+        continue;
+      m_results[job.serial] = std::move(result);
+    }
+    m_resultReady.notify_all();
+    m_resultHandler->QueueEvent(new wxThreadEvent(EVT_MATH_PARSED));
+  }
+}
@@ -0,0 +1,143 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  The header file for the pool of threads that convert maxima's XML output to cells
+*/
+
+#ifndef MATHPARSERPOOL_H
+#define MATHPARSERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <wx/event.h>
+#include <wx/string.h>
+#include "MathParser.h"
+
+//! Sent to the result handler of a MathParserPool if a new result is available
+wxDECLARE_EVENT(EVT_MATH_PARSED, wxThreadEvent);
+
+/*! A pool of background threads that convert maxima's XML output to cells
+
+  Each thread owns its own MathParser. The lines are parsed in parallel, but
+  PopResult() returns them in the order they have been submitted in.
+
+  The cells are created without a GroupCell, as GroupCells belong to the
+  worksheet which only the GUI thread may touch. Cell::SetGroupList() has to
+  be called on the result before it is inserted into the worksheet.
+
+  Only XML that doesn't create cells that need the GUI (images, animations)
+  may be submitted, see CanParse().
+*/
+class MathParserPool
+{
+public:
+  //! The result of parsing a line
+  struct Result
+  {
+    //! The parsed cells, or nullptr if the XML wasn't valid
+    std::unique_ptr<Cell> cell;
+    //! The data that was passed to Submit() alongside the XML
+    int userData = 0;
+  };
+
+  /*! The constructor
+
+    \param cfg The configuration the cells are created with
+    \param resultHandler The object that is sent an EVT_MATH_PARSED event each
+    time a result becomes ready
+  */
+  MathParserPool(Configuration *cfg, wxEvtHandler *resultHandler);
+  MathParserPool(const MathParserPool&) = delete;
+  MathParserPool& operator=(const MathParserPool&) = delete;
+  ~MathParserPool();
+
+  //! True, if the cells the XML in s describes may be created by a background thread
+  static bool CanParse(const wxString &s);
+
+  /*! Queues a line of XML for parsing
+
+    \param s The XML, see MathParser::ParseLine()
+    \param style The cell type, see MathParser::ParseLine()
+    \param userLabel The user label, see MathParser::SetUserLabel()
+    \param userData Data that is handed back unchanged alongside the result
+  */
+  void Submit(const wxString &s, CellType style, const wxString &userLabel,
+              int userData = 0);
+  /*! Returns the result for the oldest submitted line
+
+    \param wait true = wait for the oldest line to be parsed
+    \return false, if the oldest line still is being parsed and we don't
+    wait for it, or if there are no lines to be parsed.
+  */
+  bool PopResult(Result &result, bool wait = false);
+  //! True, if there are submitted lines whose result hasn't been popped, yet
+  bool HasPending() const { return m_nextSerial != m_nextResult; }
+  //! Drops all lines that haven't been parsed and all results that haven't been popped
+  void Clear();
+  //! The time the threads have spent parsing in total, in seconds
+  double GetParseTime() const { return m_parseMicroseconds.load() / 1e6; }
+
+private:
+  //! A line that waits to be parsed
+  struct Job
+  {
+    std::size_t serial = 0;
+    wxString xml;
+    CellType style = MC_TYPE_DEFAULT;
+    wxString userLabel;
+    int userData = 0;
+  };
+
+  //! The main loop of a thread in the pool
+  void WorkerThread(MathParser *parser);
+
+  wxEvtHandler *m_resultHandler;
+  //! The parser of each thread
+  std::vector<std::unique_ptr<MathParser>> m_parsers;
+  std::vector<std::thread> m_threads;
+  //! Guards m_jobs, m_results, m_nextResult and m_exit
+  std::mutex m_lock;
+  //! Tells the threads that there is a new job
+  std::condition_variable m_jobAvailable;
+  //! Tells PopResult() that a new result is ready
+  std::condition_variable m_resultReady;
+  std::deque<Job> m_jobs;
+  //! The results that are ready, by their serial number
+  std::map<std::size_t, Result> m_results;
+  //! The serial number the next Submit() will assign. Only used by the GUI thread.
+  std::size_t m_nextSerial = 0;
+  //! The serial number of the next result PopResult() will return.
+  std::size_t m_nextResult = 0;
+  //! Tells the threads to exit
+  bool m_exit = false;
+  //! The time the threads have spent parsing in total
+  std::atomic<long long> m_parseMicroseconds{0};
+};
+
+#endif // MATHPARSERPOOL_H
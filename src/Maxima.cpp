@@ -22,12 +22,18 @@
 //
 //  SPDX-License-Identifier: GPL-2.0+
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <utility>
 #include "Maxima.h"
-#include "wxMaxima.h"
+#include "StringUtils.h"
+#include "Trace.h"
 #include <iostream>
 #include <wx/app.h>
 #include <wx/debug.h>
+#include <wx/intl.h>
+#include <wx/log.h>
 
 //! The time, in ms, we'll wait for an end of string to arrive from maxima after
 //! the input was first read.
@@ -39,21 +45,48 @@ static constexpr int INPUT_RESTART_PERIOD = 3000;
 #else
 static constexpr int INPUT_RESTART_PERIOD = -1;
 #endif
+//! The number of bytes we try to read from the socket in one go.
+static constexpr std::size_t READ_BUFFER_SIZE = 65536;
+//! The number of complete frames that may wait for the GUI thread
+static constexpr std::size_t FRAME_QUEUE_SIZE = 1024;
+//! The start of the header of a length-prefixed frame from wxMathML.lisp
+static const char FRAME_HEADER[] = "<wxframe length=\"";
+//! The end of the header of a length-prefixed frame
+static const char FRAME_HEADER_END[] = "\">";
+//! The string that follows the contents of a length-prefixed frame
+static const char FRAME_TRAILER[] = "</wxframe>";
+//! The number of digits we accept in the length of a frame
+static constexpr std::size_t FRAME_LENGTH_MAX_DIGITS = 9;
+
+const std::vector<Maxima::FrameTag> &Maxima::FrameTags()
+{
+  static const std::vector<FrameTag> tags = {
+    {wxS("<mth>"), wxS("</mth>")},
+    {wxS("<math>"), wxS("</math>")},
+    {wxS("<wxtext>"), wxS("</wxtext>")},
+    {wxS("<PROMPT>"), wxS("</PROMPT>")},
+    {wxS("<statusbar>"), wxS("</statusbar>\n")},
+    {wxS("<variables>"), wxS("</variables>")},
+    {wxS("<watch_variables_add>"), wxS("</watch_variables_add>")},
+    {wxS("<wxxml-symbols>"), wxS("</wxxml-symbols>")},
+    {wxS("<suppressOutput>"), wxS("</suppressOutput>")},
+    {wxS("<html-manual-keywords>"), wxS("</html-manual-keywords>\n")},
+    {wxS("<ipc>"), wxS("</ipc>")}
+  };
+  return tags;
+}
 
 wxDEFINE_EVENT(EVT_MAXIMA, MaximaEvent);
 
-// Attention: 'wxS("\n"), wxConvUTF8' should be the default and one might think, one can omit these
-// parameters, but don't do it. wxWidgets (at least older versions, which are still used in Linux
-// distributions) had a bug, so that without these parameters one get wrong characters.
-// See: https://github.com/wxWidgets/wxWidgets/issues/14720#issuecomment-1010968576
 Maxima::Maxima(wxSocketBase *socket) :
   m_socket(socket),
-  m_socketInput(*m_socket),
-  m_textInput(m_socketInput, wxS("\n"), wxConvUTF8)
+  m_readBuffer(READ_BUFFER_SIZE),
+  m_frames(FRAME_QUEUE_SIZE)
 {
   wxASSERT(socket);
   Bind(wxEVT_TIMER, wxTimerEventHandler(Maxima::TimerEvent), this);
   Bind(wxEVT_SOCKET, wxSocketEventHandler(Maxima::SocketEvent), this);
+  Bind(wxEVT_THREAD, &Maxima::FramesReady, this);
   m_socket->SetEventHandler(*this);
   m_socket->SetNotify(wxSOCKET_INPUT_FLAG | wxSOCKET_OUTPUT_FLAG |
                       wxSOCKET_LOST_FLAG);
@@ -68,9 +101,48 @@ Maxima::Maxima(wxSocketBase *socket) :
   // came.
   if (INPUT_RESTART_PERIOD > 0)
     m_readIdleTimer.Start(INPUT_RESTART_PERIOD);
+
+  m_framingThread = std::thread(&Maxima::FramingThread, this);
+}
+
+Maxima::~Maxima() {
+  {
+    std::lock_guard<std::mutex> lock(m_rawInputLock);
+    m_abortFraming = true;
+  }
+  m_rawInputAvailable.notify_one();
+  m_framesTaken.notify_one();
+  if (m_framingThread.joinable())
+    m_framingThread.join();
+  m_socket->Close();
+}
+
+bool Maxima::RecordTo(const wxString &filename) {
+  m_recording = std::make_unique<wxFile>();
+  if (!m_recording->Create(filename, true)) {
+    wxLogMessage(_("Cannot record the session with maxima to %s"),
+                 filename.utf8_str());
+    m_recording.reset();
+    return false;
+  }
+  m_recordingStart = std::chrono::steady_clock::now();
+  m_recording->Write(wxS("wxMaxima-recording 1\n"));
+  wxLogMessage(_("Recording the session with maxima to %s"),
+               filename.utf8_str());
+  return true;
 }
 
-Maxima::~Maxima() { m_socket->Close(); }
+void Maxima::Record(char direction, const void *data, std::size_t length) {
+  if (!m_recording || !length)
+    return;
+  auto const time = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - m_recordingStart);
+  m_recording->Write(wxString::Format(wxS("%c %lld %lu\n"), direction,
+                                      static_cast<long long>(time.count()),
+                                      static_cast<unsigned long>(length)));
+  m_recording->Write(data, length);
+  m_recording->Write("\n", 1);
+}
 
 bool Maxima::Write(const void *buffer, std::size_t length) {
   if (!m_socketOutputData.IsEmpty()) {
@@ -89,6 +161,7 @@ bool Maxima::Write(const void *buffer, std::size_t length) {
     return true;
   }
   auto const wrote = m_socket->LastWriteCount();
+  Record('W', buffer, wrote);
   if (wrote < length) {
     auto *const source = reinterpret_cast<const char *>(buffer);
     auto const leftToWrite = length - wrote;
@@ -127,56 +200,352 @@ void Maxima::SocketEvent(wxSocketEvent &event) {
 }
 
 void Maxima::TimerEvent(wxTimerEvent &event) {
-  if (&event.GetTimer() == &m_stringEndTimer) {
-    MaximaEvent *sendevent = new MaximaEvent(MaximaEvent::READ_TIMEOUT, this,
-                                             std::move(m_socketInputData));
-    QueueEvent(sendevent);
-  } else if (&event.GetTimer() == &m_readIdleTimer) {
+  if (&event.GetTimer() == &m_readIdleTimer) {
     // Let's keep the input from Maxima flowing in. This is a platform-specific
     // workaround, so this timer is not guaranteed to fire at all.
     ReadSocket();
   }
 }
 
+void Maxima::FramesReady(wxThreadEvent &WXUNUSED(event)) {
+  // Reset the flag before looking at the queue: A frame that is pushed after
+  // this point will cause a new event to be sent.
+  m_framesEventPending = false;
+
+  // Consecutive frames are sent as one event so wxMaxima doesn't have to
+  // process each statusbar update separately.
+  wxString data;
+  MaximaOutputBuffer::KnownFrames knownFrames;
+  auto sendData = [&]() {
+    if (data.IsEmpty())
+      return;
+    auto *event = new MaximaEvent(MaximaEvent::READ_DATA, this, std::move(data));
+    event->SetKnownFrames(std::move(knownFrames));
+    QueueEvent(event);
+    data.Clear();
+    knownFrames.clear();
+  };
+  Frame frame;
+  bool framesTaken = false;
+  while (m_frames.Pop(frame)) {
+    framesTaken = true;
+    if (frame.timedOut) {
+      sendData();
+      QueueEvent(new MaximaEvent(MaximaEvent::READ_TIMEOUT, this,
+                                 std::move(frame.data)));
+      continue;
+    }
+    if (frame.known)
+      knownFrames.push_back({data.length(), frame.data.length()});
+    if (data.IsEmpty())
+      data.swap(frame.data);
+    else
+      data.append(frame.data);
+  }
+  sendData();
+  if (framesTaken) {
+    // Taking the lock makes sure that the framing thread is either waiting for
+    // the notification or hasn't yet found the queue to be full.
+    { std::lock_guard<std::mutex> lock(m_rawInputLock); }
+    m_framesTaken.notify_one();
+  }
+}
+
+/*! The length of the longest end of data that is the start of prefix
+
+  Tells how many bytes at the end of the data we have received might be the
+  start of a frame header whose rest hasn't arrived, yet.
+*/
+static std::size_t PartialPrefixLength(const char *data, std::size_t length,
+                                       const char *prefix, std::size_t prefixLength) {
+  std::size_t count = std::min(length, prefixLength - 1);
+  for (; count > 0; count--)
+    if (memcmp(data + length - count, prefix, count) == 0)
+      break;
+  return count;
+}
+
+wxString Maxima::DecodeBytes(char *data, std::size_t length) {
+  // Maxima sometimes sends \r where we expect a \n and NUL chars we don't want
+  // to see. Both are plain ASCII, which means that they never can be part of a
+  // multibyte UTF-8 sequence and can be handled before decoding the data.
+  std::size_t out = 0;
+  for (std::size_t in = 0; in < length; in++) {
+    char ch = data[in];
+    if (ch == '\r')
+      ch = '\n';
+    if (ch != '\0')
+      data[out++] = ch;
+  }
+  length = out;
+  if (length == 0)
+    return wxEmptyString;
+
+  wxString text = wxString::FromUTF8(data, length);
+  if (text.IsEmpty()) {
+    // Not valid UTF-8. Don't lose the data, but map the offending bytes to
+    // Unicode's private use area instead.
+    static wxMBConvUTF8 lossyUTF8(wxMBConvUTF8::MAP_INVALID_UTF8_TO_PUA);
+    text = wxString(data, lossyUTF8, length);
+  }
+  if (m_pipeToStderr)
+    {
+      std::cerr << text;
+      std::cerr.flush();
+    }
+  return text;
+}
+
+bool Maxima::SendPendingInput() {
+  if (m_pendingInput.IsEmpty())
+    return true;
+  Frame frame;
+  frame.data.swap(m_pendingInput);
+  m_openFrameTag = -1;
+  m_frameSearchStart = 0;
+  return SendFrame(std::move(frame));
+}
+
+void Maxima::ProcessUndecodedInput(bool flush) {
+  std::size_t const headerLength = sizeof(FRAME_HEADER) - 1;
+  std::size_t const headerEndLength = sizeof(FRAME_HEADER_END) - 1;
+  std::size_t const trailerLength = sizeof(FRAME_TRAILER) - 1;
+  char *const data = m_undecoded.data();
+  std::size_t const length = m_undecoded.size();
+  // The first byte that hasn't been handled, yet
+  std::size_t start = 0;
+
+  while (start < length) {
+    std::size_t const headerStart =
+      std::search(data + start, data + length, FRAME_HEADER, FRAME_HEADER + headerLength) - data;
+
+    // Everything before a frame is text we have to search for tags in
+    std::size_t plainEnd = headerStart;
+    if ((headerStart == length) && (!flush)) {
+      // Don't cut a header or a multibyte char in half
+      plainEnd -= PartialPrefixLength(data + start, length - start, FRAME_HEADER, headerLength);
+      plainEnd = start + wxm::CompleteUTF8Length(data + start, plainEnd - start);
+    }
+    if (plainEnd > start) {
+      m_pendingInput.append(DecodeBytes(data + start, plainEnd - start));
+      start = plainEnd;
+    }
+    if (headerStart == length)
+      break;
+
+    // Read the frame's length
+    std::size_t pos = headerStart + headerLength;
+    std::size_t payloadLength = 0;
+    while ((pos < length) && (pos - headerStart - headerLength < FRAME_LENGTH_MAX_DIGITS) &&
+           (data[pos] >= '0') && (data[pos] <= '9'))
+      payloadLength = payloadLength * 10 + static_cast<std::size_t>(data[pos++] - '0');
+    if ((pos + headerEndLength > length) && (!flush) &&
+        (pos - headerStart - headerLength < FRAME_LENGTH_MAX_DIGITS))
+      break;
+    if ((pos == headerStart + headerLength) || (pos + headerEndLength > length) ||
+        (memcmp(data + pos, FRAME_HEADER_END, headerEndLength) != 0)) {
+      // Not a header we understand => Treat it as text.
+      m_pendingInput.append(DecodeBytes(data + start, 1));
+      start++;
+      continue;
+    }
+    std::size_t const payloadStart = pos + headerEndLength;
+
+    // Find the end of the frame
+    std::size_t payloadEnd = payloadStart + payloadLength;
+    if (payloadEnd + trailerLength > length) {
+      if (!flush)
+        break;
+      payloadEnd = length;
+    }
+    bool complete = true;
+    if ((payloadEnd + trailerLength > length) ||
+        (memcmp(data + payloadEnd, FRAME_TRAILER, trailerLength) != 0)) {
+      // The length was wrong, which happens if the lisp translates newlines
+      // to CR/LF. Fall back to searching for the end of the frame.
+      payloadEnd = std::search(data + payloadStart, data + length,
+                               FRAME_TRAILER, FRAME_TRAILER + trailerLength) - data;
+      complete = payloadEnd < length;
+      if ((!complete) && (!flush))
+        break;
+    }
+
+    // The data before the frame is complete, even if it doesn't end in a newline.
+    SendCompleteFrames(false);
+    if (!SendPendingInput())
+      return;
+    Frame frame;
+    frame.data = DecodeBytes(data + payloadStart, payloadEnd - payloadStart);
+    frame.known = complete;
+    frame.timedOut = !complete && !m_first;
+    if (!SendFrame(std::move(frame)))
+      return;
+    start = std::min(payloadEnd + trailerLength, length);
+  }
+
+  m_undecoded.erase(m_undecoded.begin(), m_undecoded.begin() + start);
+  SendCompleteFrames(flush);
+}
+
+bool Maxima::SendFrame(Frame &&frame) {
+  while (!m_frames.Push(std::move(frame))) {
+    // The GUI thread is lagging behind. Wait for it to catch up.
+    std::unique_lock<std::mutex> lock(m_rawInputLock);
+    m_framesTaken.wait(lock, [this] { return m_abortFraming || !m_frames.Full(); });
+    if (m_abortFraming)
+      return false;
+  }
+  if (!m_framesEventPending.exchange(true))
+    QueueEvent(new wxThreadEvent());
+  return true;
+}
+
+void Maxima::SendCompleteFrames(bool flush) {
+  auto const &tags = FrameTags();
+  std::size_t const length = m_pendingInput.length();
+  // The start of the first char that hasn't been sent, yet
+  std::size_t frameStart = 0;
+  // Everything before this position has been searched for the end of the frame
+  std::size_t pos = m_frameSearchStart;
+
+  // Before the first prompt wxMaxima wants to see everything maxima says
+  // immediately.
+  if (m_first)
+    flush = true;
+
+  while (!flush && (pos < length)) {
+    if (m_openFrameTag >= 0) {
+      wxString const &suffix = tags[m_openFrameTag].suffix;
+      std::size_t const end = m_pendingInput.find(suffix, pos);
+      if (end == wxString::npos) {
+        // Next time only the last few chars need to be searched again: They
+        // might be the start of the suffix.
+        if (length > pos + suffix.length())
+          pos = length - suffix.length();
+        break;
+      }
+      pos = end + suffix.length();
+      if (!SendFrame({m_pendingInput.substr(frameStart, pos - frameStart)}))
+        return;
+      frameStart = pos;
+      m_openFrameTag = -1;
+      continue;
+    }
+
+    std::size_t const tagStart = m_pendingInput.find(wxS('<'), pos);
+    if (tagStart == wxString::npos) {
+      // Plain text: Only send complete lines.
+      std::size_t const lineEnd = m_pendingInput.rfind(wxS('\n'));
+      if ((lineEnd != wxString::npos) && (lineEnd >= frameStart)) {
+        if (!SendFrame({m_pendingInput.substr(frameStart, lineEnd + 1 - frameStart)}))
+          return;
+        frameStart = lineEnd + 1;
+      }
+      pos = length;
+      break;
+    }
+
+    bool maybeTag = false;
+    int tag = -1;
+    for (std::size_t i = 0; i < tags.size(); i++) {
+      wxString const &prefix = tags[i].prefix;
+      if (length - tagStart >= prefix.length()) {
+        if (m_pendingInput.compare(tagStart, prefix.length(), prefix) == 0) {
+          tag = static_cast<int>(i);
+          break;
+        }
+      }
+      else if (prefix.compare(0, length - tagStart,
+                              m_pendingInput, tagStart, length - tagStart) == 0)
+        maybeTag = true;
+    }
+    if ((tag < 0) && (!maybeTag)) {
+      // Just a "<" in the text
+      pos = tagStart + 1;
+      continue;
+    }
+
+    // The text before a tag is complete.
+    if (tagStart > frameStart) {
+      if (!SendFrame({m_pendingInput.substr(frameStart, tagStart - frameStart)}))
+        return;
+      frameStart = tagStart;
+    }
+    if (tag < 0) {
+      // Wait for the rest of the tag's name
+      pos = tagStart;
+      break;
+    }
+    m_openFrameTag = tag;
+    pos = tagStart + tags[tag].prefix.length();
+  }
+
+  if (flush && (frameStart < length)) {
+    Frame frame;
+    frame.data = m_pendingInput.substr(frameStart);
+    frame.timedOut = !m_first;
+    if (!SendFrame(std::move(frame)))
+      return;
+    frameStart = pos = length;
+    m_openFrameTag = -1;
+  }
+
+  m_pendingInput.erase(0, frameStart);
+  m_frameSearchStart = pos - frameStart;
+}
+
+void Maxima::FramingThread() {
+  std::vector<char> rawInput;
+  while (true) {
+    bool gotData;
+    {
+      std::unique_lock<std::mutex> lock(m_rawInputLock);
+      gotData = m_rawInputAvailable.wait_for(
+        lock, std::chrono::milliseconds(STRING_END_TIMEOUT),
+        [this] { return m_abortFraming || !m_rawInput.empty(); });
+      if (m_abortFraming)
+        return;
+      rawInput.swap(m_rawInput);
+    }
+
+    if (!gotData) {
+      // Maxima didn't complete the frame in time => send what we have got.
+      if ((!m_undecoded.empty()) || (!m_pendingInput.IsEmpty()))
+        ProcessUndecodedInput(true);
+      continue;
+    }
+
+    m_undecoded.insert(m_undecoded.end(), rawInput.begin(), rawInput.end());
+    rawInput.clear();
+    ProcessUndecodedInput(false);
+  }
+}
+
 void Maxima::ReadSocket() {
+  WXM_TRACE_ZONE("Maxima::ReadSocket");
   // It is theoretically possible that the client has exited after sending us
   // data and before we had been able to process it.
   if (!m_socket->IsConnected() || !m_socket->IsData())
     return;
 
-  // std::cerr<<"------ transmission start ------\n";
-  wxString line;
-  wxString newLine = wxS("\n");
-  wxChar ch;
+  // Drain the socket in big blocks and leave everything else to the framing
+  // thread.
+  std::size_t bytesRead;
   do
     {
-      ch = m_textInput.GetChar();
-      if(ch == wxS('\r'))
-        ch = wxS('\n');
-      if(ch != wxS('\0'))
-        m_socketInputData.append(ch);
-    }  while (m_socket->LastReadCount() > 0);
-  {
-    MaximaEvent *event = new MaximaEvent(MaximaEvent::READ_PENDING, this);
-    QueueEvent(event);
-  }
-  // std::cerr<<m_socketInputData<<"\n";
-  // std::cerr<<"------ transmission end ------\n";
+      m_socket->Read(m_readBuffer.data(), m_readBuffer.size());
+      bytesRead = m_socket->LastReadCount();
+      if (bytesRead > 0) {
+        Record('M', m_readBuffer.data(), bytesRead);
+        std::lock_guard<std::mutex> lock(m_rawInputLock);
+        m_rawInput.insert(m_rawInput.end(), m_readBuffer.data(),
+                          m_readBuffer.data() + bytesRead);
+      }
+    } while (bytesRead > 0);
+  m_rawInputAvailable.notify_one();
 
-  if ((m_pipeToStderr) && (!m_socketInputData.IsEmpty()))
-    {
-      std::cerr << m_socketInputData;
-      std::cerr.flush();
-    }
-
-  if (m_first || wxm::EndsWithChar(m_socketInputData, '\n') ||
-      m_socketInputData.EndsWith(wxMaxima::m_promptSuffix)) {
-    m_stringEndTimer.Stop();
-    MaximaEvent *event = new MaximaEvent(MaximaEvent::READ_DATA, this,
-                                         std::move(m_socketInputData));
-    QueueEvent(event);
-  } else
-    m_stringEndTimer.StartOnce(STRING_END_TIMEOUT);
+  MaximaEvent *event = new MaximaEvent(MaximaEvent::READ_PENDING, this);
+  QueueEvent(event);
 }
 
 MaximaEvent::MaximaEvent(MaximaEvent::Cause cause, Maxima *source,
@@ -191,5 +560,6 @@ MaximaEvent::MaximaEvent(MaximaEvent::Cause cause, Maxima *source)
 wxEvent *MaximaEvent::Clone() const {
   auto event = std::make_unique<MaximaEvent>(GetCause(), GetSource());
   event->SetData(GetData());
+  event->SetKnownFrames(GetKnownFrames());
   return event.release();
 }
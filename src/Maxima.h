@@ -32,12 +32,22 @@
 #include <wx/defs.h>
 #include <wx/buffer.h>
 #include <wx/event.h>
+#include <wx/file.h>
 #include <wx/sckstrm.h>
 #include <wx/txtstrm.h>
 #include <wx/socket.h>
 #include <wx/string.h>
 #include <wx/timer.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "MaximaOutputBuffer.h"
+#include "SPSCQueue.h"
 
 /*! Interface to the Maxima process
  *
@@ -46,8 +56,20 @@
  * socket I/O.
  *
  * It is a source of EVT_MAXIMA events, used to asynchronously
- * decouple the I/O from the front-end. In the future, this class could run
- * on a worker thread perhaps (after it'd do more work in string processing).
+ * decouple the I/O from the front-end.
+ *
+ * The socket itself is only ever touched by the GUI thread: wxSocketBase
+ * doesn't allow one thread to read while another one writes. The GUI thread
+ * therefore only moves the raw bytes out of the socket. Decoding them and
+ * splitting the result into complete frames (a <mth>, <PROMPT>, <statusbar>,
+ * ... element or a run of complete lines of plain text) is done by a
+ * background thread that hands the finished frames back through a lock-free
+ * queue. Every READ_DATA event therefore only contains complete frames.
+ *
+ * If wxMathML.lisp has been told to send its XML output in length-prefixed
+ * frames (<wxframe length="N">...</wxframe>) these frames are cut out of the
+ * raw bytes without looking at their contents and the READ_DATA event tells
+ * where they are. Everything else is framed by searching for the tags.
  */
 class Maxima : public wxEvtHandler
 {
@@ -63,6 +85,17 @@ public:
 
   void SetPipeToStdOut(bool pipe) { m_pipeToStderr = pipe; }
 
+  /*! Records all data exchanged with maxima to a file
+
+    The file can be played back by test/replay/maxima-replay which then
+    stands in for maxima. Each block of data is stored as a line
+    "<direction> <microseconds since the recording started> <bytes>", followed
+    by the bytes themselves and a newline. The direction is 'M' for data
+    maxima has sent and 'W' for data wxMaxima has sent.
+    \return false, if the file couldn't be opened.
+  */
+  bool RecordTo(const wxString &filename);
+
   /*! Write more data to be sent to maxima.
    *
    * \param buffer is the data's location, can be null if length is zero
@@ -81,24 +114,116 @@ public:
   //! This is called from prompt recognizer code in the wxMaxima class.
   void ClearFirstPrompt() { m_first = false; }
 
+  //! A tag that starts a frame and the string that ends it
+  struct FrameTag
+  {
+    wxString prefix;
+    wxString suffix;
+  };
+  /*! The tags maxima's output is split into frames at
+
+    Must match the tags wxMaxima::InterpretDataFromMaxima() knows about: If
+    the framing thread didn't know a tag it would split its contents into
+    lines.
+  */
+  static const std::vector<FrameTag> &FrameTags();
+
 private:
+  //! A piece of Maxima's output the framing thread has found to be complete
+  struct Frame
+  {
+    wxString data;
+    //! True = we gave up waiting for the end of this frame
+    bool timedOut = false;
+    //! True = maxima has told us the length of this frame
+    bool known = false;
+  };
+
+  //! Appends a block of data to the recording, if we record this session
+  void Record(char direction, const void *data, std::size_t length);
+
   //! Handles events on the open client socket
   void SocketEvent(wxSocketEvent &event);
   //! Handles timer events
   void TimerEvent(wxTimerEvent &event);
+  //! Moves the frames the framing thread has completed to EVT_MAXIMA events
+  void FramesReady(wxThreadEvent &event);
+
+  //! The main loop of the thread that decodes and frames the data from maxima
+  void FramingThread();
+  /*! Converts UTF-8 bytes to text
+
+    Called from the framing thread only. Modifies the bytes.
+  */
+  wxString DecodeBytes(char *data, std::size_t length);
+  /*! Cuts the length-prefixed frames out of m_undecoded
+
+    The frames are sent to the GUI thread directly, everything else is decoded
+    and appended to m_pendingInput. Called from the framing thread only.
+    \param flush true = don't wait for incomplete frames or chars to be completed.
+  */
+  void ProcessUndecodedInput(bool flush);
+  /*! Sends all of m_pendingInput to the GUI thread
+
+    Called from the framing thread only, if the next data is known to belong
+    to a different frame.
+    \return false, if the thread was told to exit.
+  */
+  bool SendPendingInput();
+  /*! Sends all complete frames from m_pendingInput to the GUI thread
+
+    Called from the framing thread only.
+    \param flush true = send the data even if it doesn't form a complete frame.
+  */
+  void SendCompleteFrames(bool flush);
+  /*! Hands a frame to the GUI thread
+
+    Called from the framing thread only.
+    \return false, if the thread was told to exit before the frame could be queued.
+  */
+  bool SendFrame(Frame &&frame);
 
   std::unique_ptr<wxSocketBase> m_socket;
-  wxSocketInputStream m_socketInput;
-  wxTextInputStream m_textInput;
 
-  wxString m_socketInputData;
+  //! The buffer the raw bytes from the socket are read into
+  std::vector<char> m_readBuffer;
   wxMemoryBuffer m_socketOutputData;
 
-  bool m_first = true;
-  bool m_pipeToStderr = false;
+  //! The raw bytes the GUI thread has read, but the framing thread hasn't processed, yet
+  std::vector<char> m_rawInput;
+  //! Guards m_rawInput and m_abortFraming
+  std::mutex m_rawInputLock;
+  //! Tells the framing thread that there is new data in m_rawInput
+  std::condition_variable m_rawInputAvailable;
+  //! Tells the framing thread that the GUI thread has taken frames from m_frames
+  std::condition_variable m_framesTaken;
+  //! Tells the framing thread to exit
+  bool m_abortFraming = false;
+
+  //! The raw bytes the framing thread hasn't decoded, yet
+  std::vector<char> m_undecoded;
+  //! The decoded text the framing thread hasn't sent as a frame, yet
+  wxString m_pendingInput;
+  //! Where in m_pendingInput the search for the end of the current frame has to continue
+  std::size_t m_frameSearchStart = 0;
+  //! The index of the tag the current frame started with, or -1 for plain text
+  int m_openFrameTag = -1;
+  //! The frames that wait for the GUI thread to pick them up
+  SPSCQueue<Frame> m_frames;
+  //! True, if a FramesReady() event is already queued
+  std::atomic<bool> m_framesEventPending{false};
+
+  std::atomic<bool> m_first{true};
+  std::atomic<bool> m_pipeToStderr{false};
+
+  //! The file the session is recorded to, see RecordTo()
+  std::unique_ptr<wxFile> m_recording;
+  //! The time the recording has been started at
+  std::chrono::steady_clock::time_point m_recordingStart;
 
-  wxTimer m_stringEndTimer{this};
   wxTimer m_readIdleTimer{this};
+  //! The thread that decodes and frames the data from maxima
+  std::thread m_framingThread;
 };
 
 class MaximaEvent : public wxEvent
@@ -126,10 +251,14 @@ public:
   const wxString &GetData() const { return m_data; }
   wxString &GetData() { return m_data; }
   void SetData(const wxString &data) { m_data = data; }
+  //! The frames in the data maxima has told us the extent of
+  const MaximaOutputBuffer::KnownFrames &GetKnownFrames() const { return m_knownFrames; }
+  void SetKnownFrames(MaximaOutputBuffer::KnownFrames frames) { m_knownFrames = std::move(frames); }
 private:
   Cause m_cause;
   Maxima *m_source;
   wxString m_data;
+  MaximaOutputBuffer::KnownFrames m_knownFrames;
 };
 
 wxDECLARE_EVENT(EVT_MAXIMA, MaximaEvent);
@@ -87,7 +87,7 @@ static void LookupName(Val *val, const wxString &name, const T &names) {
     *val = it->second;
 }
 
-void MaximaIPC::ReadInputData(wxString &data) {
+void MaximaIPC::ReadInputData(MaximaOutputBuffer &data) {
   if (!GetEnableIPC())
     return;
   if (!data.StartsWith(ipcPrefix))
@@ -97,7 +97,7 @@ void MaximaIPC::ReadInputData(wxString &data) {
     return;
   auto const ipcSize = end + ipcSuffix.size();
   wxString xml = data.Left(ipcSize);
-  data.Remove(0, ipcSize);
+  data.Consume(ipcSize);
 
   wxXmlDocument xmldoc;
   wxStringInputStream xmlStream(xml);
@@ -28,6 +28,7 @@
 #include <utility>
 #include <wx/hashmap.h>
 #include <wx/string.h>
+#include "MaximaOutputBuffer.h"
 
 class wxMaxima;
 class wxEvent;
@@ -47,7 +48,7 @@ public:
    *
    * Since it may be unsafe, it must be enabled via command line.
    */
-  void ReadInputData(wxString &data);
+  void ReadInputData(MaximaOutputBuffer &data);
   static void EnableIPC() { m_enabled = true; }
   static bool  GetEnableIPC() { return m_enabled; }
 
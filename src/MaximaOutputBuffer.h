@@ -0,0 +1,220 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  The buffer maxima's not-yet-interpreted output is kept in
+*/
+
+#ifndef MAXIMAOUTPUTBUFFER_H
+#define MAXIMAOUTPUTBUFFER_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <wx/string.h>
+
+/*! Maxima's output that still waits to be interpreted
+
+  The functions that interpret maxima's output consume it from the front. If
+  they did so by removing the interpreted part from a wxString each small
+  piece of output would cause the whole rest of the output to be copied,
+  which makes a burst of many small outputs O(n²). This buffer instead only
+  advances an offset and drops the consumed data only once it makes up the
+  bigger part of the buffer.
+
+  All positions and lengths this class accepts or returns are relative to
+  the first char that hasn't been consumed, yet.
+
+  If maxima sends its output in length-prefixed frames the buffer also
+  remembers where these frames end, so the end of a frame can be found
+  without searching for its closing tag.
+*/
+class MaximaOutputBuffer
+{
+public:
+  //! A piece of the data whose extent maxima has told us
+  struct KnownFrame
+  {
+    std::size_t start;
+    std::size_t length;
+  };
+  using KnownFrames = std::vector<KnownFrame>;
+
+  //! Appends newly arrived data to the buffer
+  void Append(const wxString &data) { m_data.append(data); }
+  /*! Appends newly arrived data to the buffer
+
+    \param data The data
+    \param frames The frames maxima has told us the extent of. Their positions
+    are relative to the start of data.
+  */
+  void Append(const wxString &data, const KnownFrames &frames)
+    {
+      for (auto const &frame : frames)
+        m_knownFrames.push_back({m_data.length() + frame.start, frame.length});
+      m_data.append(data);
+    }
+  //! Drops all data
+  void Clear() { m_data.clear(); m_offset = 0; m_knownFrames.clear(); }
+
+  //! The number of chars that haven't been consumed, yet
+  std::size_t Length() const { return m_data.length() - m_offset; }
+  bool IsEmpty() const { return Length() == 0; }
+
+  //! Does the unconsumed data start with the string prefix?
+  bool StartsWith(const wxString &prefix) const
+    {
+      return (Length() >= prefix.length()) &&
+        (m_data.compare(m_offset, prefix.length(), prefix) == 0);
+    }
+  //! Does the unconsumed data equal the string str?
+  bool IsSameAs(const wxString &str) const
+    {
+      return (Length() == str.length()) && StartsWith(str);
+    }
+  //! The position of str in the unconsumed data, or wxNOT_FOUND
+  long Find(const wxString &str, std::size_t start = 0) const
+    {
+      std::size_t const pos = m_data.find(str, m_offset + start);
+      if (pos == wxString::npos)
+        return wxNOT_FOUND;
+      return static_cast<long>(pos - m_offset);
+    }
+  //! The position of ch in the unconsumed data, or wxNOT_FOUND
+  long FindChar(wxUniChar ch, std::size_t start = 0) const
+    {
+      std::size_t const pos = m_data.find(ch, m_offset + start);
+      if (pos == wxString::npos)
+        return wxNOT_FOUND;
+      return static_cast<long>(pos - m_offset);
+    }
+  //! The char at position pos of the unconsumed data
+  wxUniChar GetChar(std::size_t pos) const { return m_data.GetChar(m_offset + pos); }
+
+  /*! The position of the first tag "<name>" whose name isKnown accepts
+
+    Only the chars up to this tag are looked at, which means that consuming
+    the output text by text and tag by tag stays linear in its length.
+
+    \param isKnown Is called with the name of each tag that is found and
+    returns true, if it is one the caller looks for.
+    \return The position of the tag, or Length() if there is none.
+  */
+  template <class Predicate>
+  std::size_t FindKnownTag(Predicate isKnown) const
+    {
+      std::size_t const length = Length();
+      std::size_t pos = 0;
+      while (pos < length) {
+        long const tagPos = FindChar(wxS('<'), pos);
+        if (tagPos == wxNOT_FOUND)
+          return length;
+        std::size_t const tagStart = static_cast<std::size_t>(tagPos);
+        // Find the end of the tag name first so the name is only copied once
+        std::size_t nameEnd = tagStart + 1;
+        for (; nameEnd < length; ++nameEnd) {
+          wxUniChar const ch = GetChar(nameEnd);
+          if (!(((ch >= wxS('a')) && (ch <= wxS('z'))) ||
+                ((ch >= wxS('A')) && (ch <= wxS('Z'))) || (ch == wxS('_')) ||
+                (ch == wxS('-'))))
+            break;
+        }
+        if ((nameEnd < length) && (GetChar(nameEnd) == wxS('>')) &&
+            isKnown(Mid(tagStart + 1, nameEnd - tagStart - 1)))
+          return tagStart;
+        pos = nameEnd;
+      }
+      return length;
+    }
+
+  //! Does the unconsumed data contain the string str at position pos?
+  bool IsAt(std::size_t pos, const wxString &str) const
+    {
+      return (Length() >= pos + str.length()) &&
+        (m_data.compare(m_offset + pos, str.length(), str) == 0);
+    }
+
+  /*! The length of the known frame the unconsumed data starts with
+
+    \return wxNOT_FOUND, if maxima hasn't told us where the data at the
+    current position ends.
+  */
+  long KnownFrameLength() const
+    {
+      if (m_knownFrames.empty() || (m_knownFrames.front().start != m_offset))
+        return wxNOT_FOUND;
+      return static_cast<long>(m_knownFrames.front().length);
+    }
+
+  //! A copy of count chars starting at pos
+  wxString Mid(std::size_t pos, std::size_t count = wxString::npos) const
+    {
+      return m_data.substr(m_offset + pos, count);
+    }
+  //! A copy of the first count unconsumed chars
+  wxString Left(std::size_t count) const { return Mid(0, count); }
+  //! A copy of the last count unconsumed chars
+  wxString Right(std::size_t count) const
+    {
+      if (count > Length())
+        count = Length();
+      return m_data.substr(m_data.length() - count);
+    }
+  //! A copy of all data that hasn't been consumed, yet
+  wxString GetString() const { return Mid(0); }
+
+  //! Marks the first count chars as interpreted
+  void Consume(std::size_t count)
+    {
+      if (count > Length())
+        count = Length();
+      m_offset += count;
+      // A frame we have started to consume no more starts at a position
+      // anybody will ask for.
+      while ((!m_knownFrames.empty()) && (m_knownFrames.front().start < m_offset))
+        m_knownFrames.pop_front();
+      if (m_offset == m_data.length())
+        Clear();
+      else if ((m_offset > COMPACT_THRESHOLD) && (m_offset > m_data.length() / 2))
+        {
+          // Most of the buffer is garbage => drop it. As this only happens
+          // after we consumed more than we copy here this keeps the cost of
+          // consuming the data linear.
+          m_data.erase(0, m_offset);
+          for (auto &frame : m_knownFrames)
+            frame.start -= m_offset;
+          m_offset = 0;
+        }
+    }
+
+private:
+  //! The number of consumed chars that we allow to stay in memory
+  static constexpr std::size_t COMPACT_THRESHOLD = 65536;
+  //! The data. The first m_offset chars of it have already been interpreted.
+  wxString m_data;
+  //! The number of chars at the start of m_data that are already interpreted
+  std::size_t m_offset = 0;
+  //! The frames in m_data whose extent we know. Their start is relative to m_data.
+  std::deque<KnownFrame> m_knownFrames;
+};
+
+#endif // MAXIMAOUTPUTBUFFER_H
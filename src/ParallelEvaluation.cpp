@@ -0,0 +1,715 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class ParallelEvaluation that evaluates independent
+  sections of a worksheet in several maxima processes at once.
+*/
+
+#include "ParallelEvaluation.h"
+#include "CellDependencies.h"
+#include "EvaluationQueue.h"
+#include "MathParser.h"
+#include "Maxima.h"
+#include "MaximaOutputBuffer.h"
+#include "TextCell.h"
+#include "Worksheet.h"
+#include "wxMathml.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <wx/intl.h>
+#include <wx/log.h>
+#include <wx/process.h>
+#include <wx/socket.h>
+#include <wx/tokenzr.h>
+#include <wx/window.h>
+
+namespace {
+//! The code cells of a section and the names they define and use
+struct Section
+{
+  ParallelEvaluation::Chain cells;
+  CellDependencies::Symbols symbols;
+};
+
+//! Finds the representative of a section in a union-find forest
+std::size_t FindRoot(std::vector<std::size_t> &parent, std::size_t i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+} // namespace
+
+/*! One maxima process that evaluates a chain of sections
+
+  Does the same handshake with maxima the main window does, sends the
+  commands one by one, each after maxima has answered the previous one with
+  a prompt, and appends the output to the cells.
+*/
+class ParallelEvaluation::Backend : public wxEvtHandler
+{
+public:
+  Backend(ParallelEvaluation *owner, Worksheet *worksheet,
+          Configuration *config, const std::vector<CellPtr<GroupCell>> &preamble,
+          WaitingChain &&chain);
+  ~Backend() override;
+
+  //! Starts maxima. Returns false if that failed.
+  bool Start(const wxString &command, const wxEnvVariableHashMap &environment,
+             const wxString &authString, long firstPort);
+
+private:
+  void OnConnect(wxSocketEvent &event);
+  void OnMaximaEvent(MaximaEvent &event);
+  void OnProcessEnd(wxProcessEvent &event);
+  //! Reads out maxima's stdout and stderr so maxima never has to wait for us
+  void DrainStreams();
+  //! Interprets everything in m_output
+  void Interpret();
+  void ReadText(const wxString &text);
+  void ReadMath(const wxString &xml);
+  //! Reads a <PROMPT> element
+  void ReadPromptTag(const wxString &xml);
+  //! Reads a <wxtext> element: A result maxima has displayed as plain text
+  void ReadText1D(const wxString &xml);
+  //! Reads a <suppressOutput> element, which may authenticate maxima
+  void ReadSuppressedOutput(const wxString &xml);
+  //! Called when maxima has sent a prompt
+  void ReadPrompt(const wxString &label);
+  //! Sends the next command to maxima, if there is one
+  void SendNextCommand();
+  //! Appends a cell to the output of the cell that is currently evaluated
+  void AppendOutput(std::unique_ptr<Cell> &&cell);
+  //! Is the output of the current cell to be shown?
+  bool ShowOutput() const { return m_group && m_showOutput; }
+  //! Tells the owner that we are done
+  void Finish(const wxString &error = wxEmptyString);
+
+  //! Servers with pending events must be destroyed, not deleted
+  struct ServerDeleter {
+    void operator()(wxSocketServer* server) const {
+      server->Close();
+      server->Destroy();
+    }
+  };
+
+  ParallelEvaluation *m_owner;
+  Worksheet *m_worksheet;
+  Configuration *m_configuration;
+  //! The cells that still have to be evaluated
+  std::list<CellPtr<GroupCell>> m_cells;
+  //! The preamble cells in m_cells
+  std::unordered_set<GroupCell *> m_preamble;
+  //! Is the output of the preamble to be shown?
+  bool m_showPreambleOutput;
+  //! The cell that currently is evaluated
+  CellPtr<GroupCell> m_group;
+  //! Is the output of m_group to be shown?
+  bool m_showOutput = false;
+  //! The commands of m_group that haven't been sent to maxima, yet
+  EvaluationQueue m_queue;
+  MathParser m_parser;
+  std::unique_ptr<wxSocketServer, ServerDeleter> m_server;
+  std::unique_ptr<Maxima> m_client;
+  wxProcess *m_process = NULL;
+  int m_processId = wxID_ANY;
+  wxString m_authString;
+  MaximaOutputBuffer m_output;
+  bool m_firstPromptSeen = false;
+  bool m_authenticated = false;
+  bool m_finished = false;
+
+  //! A method that reads an element maxima has sent, including its tags
+  using TagHandler = void (Backend::*)(const wxString &xml);
+  //! A tag maxima's output may contain
+  struct KnownTag
+  {
+    wxString name;
+    wxString suffix;
+    //! nullptr = the contents of this tag only are of interest to the main window
+    TagHandler handler;
+  };
+  /*! The tags we split maxima's output at
+
+    These are the tags Maxima frames maxima's output at, which means that
+    each of them arrives in one piece.
+  */
+  static const std::vector<KnownTag> &KnownTags();
+
+  static const wxString m_firstPrompt;
+  static const wxString m_promptPrefix;
+  static const wxString m_promptSuffix;
+};
+
+const wxString ParallelEvaluation::Backend::m_firstPrompt(wxS("(%i1) "));
+const wxString ParallelEvaluation::Backend::m_promptPrefix(wxS("<PROMPT>"));
+const wxString ParallelEvaluation::Backend::m_promptSuffix(wxS("</PROMPT>"));
+
+const std::vector<ParallelEvaluation::Backend::KnownTag> &
+ParallelEvaluation::Backend::KnownTags() {
+  static const std::vector<KnownTag> tags = [] {
+    std::vector<KnownTag> tags;
+    for (auto const &tag : Maxima::FrameTags()) {
+      TagHandler handler = nullptr;
+      if ((tag.prefix == wxS("<mth>")) || (tag.prefix == wxS("<math>")))
+        handler = &Backend::ReadMath;
+      else if (tag.prefix == m_promptPrefix)
+        handler = &Backend::ReadPromptTag;
+      else if (tag.prefix == wxS("<wxtext>"))
+        handler = &Backend::ReadText1D;
+      else if (tag.prefix == wxS("<suppressOutput>"))
+        handler = &Backend::ReadSuppressedOutput;
+      // "<name>" => "name"
+      tags.push_back({tag.prefix.Mid(1, tag.prefix.Length() - 2), tag.suffix,
+                      handler});
+    }
+    return tags;
+  }();
+  return tags;
+}
+
+ParallelEvaluation::Backend::Backend(
+  ParallelEvaluation *owner, Worksheet *worksheet, Configuration *config,
+  const std::vector<CellPtr<GroupCell>> &preamble, WaitingChain &&chain)
+  : m_owner(owner), m_worksheet(worksheet), m_configuration(config),
+    m_showPreambleOutput(chain.showPreambleOutput), m_parser(config) {
+  for (auto const &cell : preamble) {
+    if (!cell)
+      continue;
+    m_cells.emplace_back(cell.get());
+    m_preamble.insert(cell.get());
+  }
+  for (auto &cell : chain.cells)
+    m_cells.emplace_back(std::move(cell));
+  Bind(wxEVT_SOCKET, &Backend::OnConnect, this);
+}
+
+ParallelEvaluation::Backend::~Backend() {
+  m_server.reset();
+  if (m_client)
+    m_client->Unbind(EVT_MAXIMA, &Backend::OnMaximaEvent, this);
+  // Maxima exits when its connection is closed.
+  m_client.reset();
+  if (!m_process)
+    return;
+  Unbind(wxEVT_END_PROCESS, &Backend::OnProcessEnd, this, m_processId);
+  long const pid = m_process->GetPid();
+  m_process->Detach();
+  m_process = NULL;
+  if (pid > 0) {
+    wxLogNull logNull;
+    if (wxProcess::Kill(static_cast<int>(pid), wxSIGKILL, wxKILL_CHILDREN) != wxKILL_OK)
+      wxProcess::Kill(static_cast<int>(pid), wxSIGKILL);
+  }
+}
+
+bool ParallelEvaluation::Backend::Start(const wxString &command,
+                                        const wxEnvVariableHashMap &environment,
+                                        const wxString &authString,
+                                        long firstPort) {
+  long port = firstPort;
+  for (; (port < firstPort + 1000) && (port < 65535) && (!m_server); port++) {
+    wxIPV4address addr;
+    addr.LocalHost();
+    addr.Service(port);
+    m_server = std::unique_ptr<wxSocketServer, ServerDeleter>(
+      new wxSocketServer(addr, wxSOCKET_WAITALL_WRITE));
+    if (!m_server->IsOk())
+      m_server.reset();
+  }
+  if (!m_server) {
+    wxLogMessage(_("Cannot open a port for a maxima that evaluates in parallel."));
+    return false;
+  }
+  port--;
+  m_server->SetEventHandler(*this);
+  m_server->SetNotify(wxSOCKET_CONNECTION_FLAG);
+  m_server->Notify(true);
+
+  m_authString = authString;
+  m_processId = wxWindow::NewControlId();
+  m_process = new wxProcess(this, m_processId);
+  m_process->Redirect();
+  Bind(wxEVT_END_PROCESS, &Backend::OnProcessEnd, this, m_processId);
+
+  wxExecuteEnv env;
+  env.env = environment;
+  wxString const fullCommand = command + wxString::Format(wxS(" -s %li "), port);
+  wxLogMessage(_("Starting a maxima that evaluates in parallel as: %s"),
+               fullCommand.utf8_str());
+  if (wxExecute(fullCommand, wxEXEC_ASYNC | wxEXEC_MAKE_GROUP_LEADER, m_process,
+                &env) <= 0) {
+    Unbind(wxEVT_END_PROCESS, &Backend::OnProcessEnd, this, m_processId);
+    delete m_process;
+    m_process = NULL;
+    m_server.reset();
+    return false;
+  }
+  return true;
+}
+
+void ParallelEvaluation::Backend::OnConnect(wxSocketEvent &event) {
+  if ((event.GetSocketEvent() != wxSOCKET_CONNECTION) || (!m_server))
+    return;
+  if (m_client) {
+    // Somebody else has connected to our port
+    std::unique_ptr<wxSocketBase>(m_server->Accept(false));
+    return;
+  }
+  m_client = std::make_unique<Maxima>(m_server->Accept(false));
+  m_server.reset();
+  if (!m_client->IsConnected()) {
+    Finish(_("Maxima couldn't connect."));
+    return;
+  }
+  m_client->Bind(EVT_MAXIMA, &Backend::OnMaximaEvent, this);
+
+  // The same setup the main window does, as far as it matters for the output.
+  wxMathML wxmathml(m_configuration);
+  wxString setup = wxmathml.GetLoadCmd();
+  setup.Trim(true);
+  setup += wxS("\n:lisp-quiet (setf *prompt-suffix* \"") + m_promptSuffix +
+    wxS("\") (setf *prompt-prefix* \"") + m_promptPrefix +
+    wxS("\") (setf $in_netmath nil) (setf $show_openplot t)\n");
+  wxScopedCharBuffer const data = setup.utf8_str();
+  m_client->Write(data.data(), data.length());
+}
+
+void ParallelEvaluation::Backend::OnProcessEnd(wxProcessEvent &event) {
+  if (event.GetId() != m_processId)
+    return;
+  Unbind(wxEVT_END_PROCESS, &Backend::OnProcessEnd, this, m_processId);
+  // wxWidgets deletes the process object after this event has been skipped.
+  m_process = NULL;
+  event.Skip();
+  Finish(_("Maxima has exited."));
+}
+
+void ParallelEvaluation::Backend::DrainStreams() {
+  if (!m_process)
+    return;
+  for (wxInputStream *stream :
+         {m_process->GetInputStream(), m_process->GetErrorStream()}) {
+    if (!stream)
+      continue;
+    char buffer[4096];
+    while (stream->CanRead()) {
+      stream->Read(buffer, sizeof(buffer));
+      std::size_t const length = stream->LastRead();
+      if (length == 0)
+        break;
+      wxLogMessage(_("A maxima that evaluates in parallel says: %s"),
+                   wxString::FromUTF8(buffer, length).utf8_str());
+    }
+  }
+}
+
+void ParallelEvaluation::Backend::OnMaximaEvent(MaximaEvent &event) {
+  DrainStreams();
+  switch (event.GetCause()) {
+  case MaximaEvent::READ_DATA:
+  case MaximaEvent::READ_TIMEOUT:
+    m_output.Append(event.GetData(), event.GetKnownFrames());
+    Interpret();
+    break;
+  case MaximaEvent::WRITE_ERROR:
+    Finish(_("Error writing to Maxima"));
+    break;
+  case MaximaEvent::DISCONNECTED:
+    Finish(_("Connection to Maxima lost."));
+    break;
+  default:
+    break;
+  }
+}
+
+void ParallelEvaluation::Backend::Interpret() {
+  if (!m_firstPromptSeen) {
+    long const end = m_output.Find(m_firstPrompt);
+    if (end == wxNOT_FOUND)
+      return;
+    m_output.Consume(static_cast<std::size_t>(end) + m_firstPrompt.Length());
+    m_client->ClearFirstPrompt();
+    m_firstPromptSeen = true;
+  }
+
+  auto const &tags = KnownTags();
+  while ((!m_finished) && (!m_output.IsEmpty())) {
+    // Everything up to the next tag we know is text.
+    auto tag = tags.end();
+    std::size_t const textEnd = m_output.FindKnownTag([&tags, &tag](const wxString &name) {
+      tag = std::find_if(tags.begin(), tags.end(),
+                         [&name](const KnownTag &known) { return known.name == name; });
+      return tag != tags.end();
+    });
+    if (textEnd > 0) {
+      ReadText(m_output.Left(textEnd));
+      m_output.Consume(textEnd);
+      continue;
+    }
+
+    // Maxima frames all of these tags => the whole element has arrived.
+    long length = m_output.KnownFrameLength();
+    if (length == wxNOT_FOUND) {
+      long const end = m_output.Find(tag->suffix);
+      if (end == wxNOT_FOUND)
+        return;
+      length = end + static_cast<long>(tag->suffix.Length());
+    }
+    wxString const xml = m_output.Left(static_cast<std::size_t>(length));
+    m_output.Consume(static_cast<std::size_t>(length));
+    if (tag->handler)
+      (this->*(tag->handler))(xml);
+  }
+}
+
+void ParallelEvaluation::Backend::ReadPromptTag(const wxString &xml) {
+  ReadPrompt(xml.Mid(m_promptPrefix.Length(),
+                     xml.Length() - m_promptPrefix.Length() - m_promptSuffix.Length()));
+}
+
+void ParallelEvaluation::Backend::ReadText1D(const wxString &xml) {
+  wxString const prefix = wxS("<wxtext>");
+  wxString const suffix = wxS("</wxtext>");
+  ReadText(xml.Mid(prefix.Length(),
+                   xml.Length() - prefix.Length() - suffix.Length()));
+}
+
+void ParallelEvaluation::Backend::ReadSuppressedOutput(const wxString &xml) {
+  if (m_authenticated || !xml.Contains(wxS("<wxxml-key>")))
+    return;
+  if (!xml.Contains(wxS("<wxxml-key>") + m_authString + wxS("</wxxml-key>"))) {
+    Finish(_("Cannot authenticate Maxima!"));
+    return;
+  }
+  m_authenticated = true;
+  SendNextCommand();
+}
+
+void ParallelEvaluation::Backend::ReadText(const wxString &text) {
+  // Before maxima has authenticated itself everything it says is discarded,
+  // as is the output of the preamble in all processes but one.
+  if ((!m_authenticated) || (!ShowOutput()))
+    return;
+  wxString merged = wxS("\n") + text;
+  merged.Replace(wxS("\t"), wxS(" "));
+  bool const error =
+    merged.Contains(wxS("\n-- an error.")) ||
+    merged.Contains(wxS(":incorrect syntax:")) ||
+    merged.Contains(wxS("\nincorrect syntax")) ||
+    merged.Contains(wxS("\nMaxima encountered a Lisp error"));
+
+  wxStringTokenizer lines(text, wxS("\n"));
+  while (lines.HasMoreTokens()) {
+    wxString const line = lines.GetNextToken();
+    wxString trimmed = line;
+    trimmed.Trim(true);
+    trimmed.Trim(false);
+    if (trimmed.IsEmpty())
+      continue;
+    auto cell = std::make_unique<TextCell>(m_group, m_configuration, line);
+    cell->SetType(error ? MC_TYPE_ERROR : MC_TYPE_ASCIIMATHS);
+    AppendOutput(std::move(cell));
+  }
+
+  if (error) {
+    m_worksheet->GetErrorList().Add(m_group);
+    if (m_configuration->GetAbortOnError())
+      Finish(_("Maxima has issued an error."));
+  }
+}
+
+void ParallelEvaluation::Backend::ReadMath(const wxString &xml) {
+  if ((!m_authenticated) || (!ShowOutput()))
+    return;
+  m_parser.SetGroup(m_group);
+  m_parser.SetUserLabel(m_queue.GetUserLabel());
+  AppendOutput(m_parser.ParseLine(wxS("<span>") + xml + wxS("</span>")));
+}
+
+void ParallelEvaluation::Backend::ReadPrompt(const wxString &prompt) {
+  wxString label = prompt;
+  label.Trim(true);
+  label.Trim(false);
+  if (!label.StartsWith(wxS("(%"))) {
+    // We cannot answer questions: The user would have to know which of the
+    // sections that are evaluated at the same time has asked it.
+    if (ShowOutput()) {
+      auto cell = std::make_unique<TextCell>(m_group, m_configuration, label);
+      cell->SetType(MC_TYPE_ERROR);
+      AppendOutput(std::move(cell));
+    }
+    Finish(_("Maxima has asked a question. Please evaluate this section "
+             "normally in order to answer it."));
+    return;
+  }
+  // The command is done
+  m_queue.RemoveFirst();
+  SendNextCommand();
+}
+
+void ParallelEvaluation::Backend::AppendOutput(std::unique_ptr<Cell> &&cell) {
+  if ((!cell) || (!m_group))
+    return;
+  cell->ForceBreakLine(true);
+  m_group->AppendOutput(std::move(cell));
+  m_worksheet->Recalculate(m_group);
+  m_worksheet->OutputChanged();
+  m_worksheet->RequestRedraw(m_group);
+}
+
+void ParallelEvaluation::Backend::SendNextCommand() {
+  if ((m_finished) || (!m_authenticated))
+    return;
+  while (true) {
+    if (m_queue.Empty()) {
+      if (m_cells.empty()) {
+        Finish();
+        return;
+      }
+      m_group = std::move(m_cells.front());
+      m_cells.pop_front();
+      // Has the cell been deleted since the evaluation was started?
+      if (!m_group)
+        continue;
+      m_showOutput = (m_preamble.count(m_group.get()) == 0) || m_showPreambleOutput;
+      m_queue.Clear();
+      m_queue.AddToQueue(m_group);
+      if (m_group->AddEnding())
+        m_queue.AddEnding();
+      if (m_showOutput) {
+        m_group->RemoveOutput();
+        m_worksheet->GetErrorList().Remove(m_group);
+        m_worksheet->Recalculate(m_group);
+        m_worksheet->RequestRedraw(m_group);
+      }
+      continue;
+    }
+
+    wxString command = m_queue.GetCommand();
+    command = m_worksheet->UnicodeToMaxima(command);
+    if (command.StartsWith(wxS(":lisp ")) || command.StartsWith(wxS(":lisp\n")))
+      command.Replace(wxS("\n"), wxS(" "));
+    command.Trim(true);
+    command.Trim(false);
+    if (command.IsEmpty() || (command == wxS(";")) || (command == wxS("$"))) {
+      m_queue.RemoveFirst();
+      continue;
+    }
+    command += wxS("\n");
+    wxScopedCharBuffer const data = command.utf8_str();
+    m_client->Write(data.data(), data.length());
+    return;
+  }
+}
+
+void ParallelEvaluation::Backend::Finish(const wxString &error) {
+  if (m_finished)
+    return;
+  m_finished = true;
+  if ((!error.IsEmpty()) && m_group) {
+    auto cell = std::make_unique<TextCell>(m_group, m_configuration, error);
+    cell->SetType(MC_TYPE_ERROR);
+    m_showOutput = true;
+    AppendOutput(std::move(cell));
+    m_worksheet->GetErrorList().Add(m_group);
+  }
+  m_owner->BackendFinished(this, error);
+}
+
+ParallelEvaluation::ParallelEvaluation(Worksheet *worksheet,
+                                       Configuration *config,
+                                       StatusFunction status)
+  : m_worksheet(worksheet), m_configuration(config),
+    m_status(std::move(status)) {}
+
+ParallelEvaluation::~ParallelEvaluation() { Abort(); }
+
+std::vector<ParallelEvaluation::Chain> ParallelEvaluation::FindIndependentChains(
+  GroupCell *tree, Chain &preamble,
+  const std::function<bool(const wxString &name)> &isOptionVariable) {
+  preamble.clear();
+  std::vector<Chain> chains;
+  if (!tree)
+    return chains;
+
+  // The topmost sectioning level the worksheet uses
+  GroupType splitLevel = GC_TYPE_INVALID;
+  for (auto &cell : OnList(tree))
+    if (cell.IsHeading() &&
+        ((splitLevel == GC_TYPE_INVALID) || (cell.GetGroupType() < splitLevel)))
+      splitLevel = cell.GetGroupType();
+  if (splitLevel == GC_TYPE_INVALID)
+    return chains;
+
+  std::vector<Section> sections;
+  for (auto &cell : OnList(tree)) {
+    if (cell.GetGroupType() == splitLevel)
+      sections.emplace_back();
+    Chain cells;
+    CellDependencies::AppendWithHiddenTree(&cell, cells);
+    for (auto *code : cells) {
+      if ((code->GetGroupType() != GC_TYPE_CODE) || (!code->GetEditable()))
+        continue;
+      if (sections.empty())
+        preamble.push_back(code);
+      else {
+        sections.back().cells.push_back(code);
+        sections.back().symbols.Merge(
+          CellDependencies::Analyze(code, isOptionVariable));
+      }
+    }
+  }
+
+  std::vector<std::size_t> parent(sections.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  auto const join = [&parent](std::size_t a, std::size_t b) {
+    parent[FindRoot(parent, a)] = FindRoot(parent, b);
+  };
+  for (std::size_t i = 0; i < sections.size(); i++) {
+    for (std::size_t j = 0; j < i; j++) {
+      if (sections[j].symbols.changesGlobalState ||
+          sections[i].symbols.usesLabels ||
+          sections[i].symbols.Uses(sections[j].symbols.defines))
+        join(i, j);
+    }
+  }
+
+  // The chains are ordered by their first section
+  std::vector<std::size_t> chainOfRoot(sections.size(), sections.size());
+  for (std::size_t i = 0; i < sections.size(); i++) {
+    if (sections[i].cells.empty())
+      continue;
+    std::size_t const root = FindRoot(parent, i);
+    if (chainOfRoot[root] == sections.size()) {
+      chainOfRoot[root] = chains.size();
+      chains.emplace_back();
+    }
+    Chain &chain = chains[chainOfRoot[root]];
+    chain.insert(chain.end(), sections[i].cells.begin(), sections[i].cells.end());
+  }
+  return chains;
+}
+
+std::size_t ParallelEvaluation::Start(const wxString &command,
+                                      const EnvironmentFunction &environment,
+                                      const AuthStringFunction &newAuthString,
+                                      long firstPort) {
+  Abort();
+  Chain preamble;
+  std::vector<Chain> chains = FindIndependentChains(
+    m_worksheet->GetTree(), preamble, [this](const wxString &name) {
+      return !m_worksheet->GetHelpfileAnchorName(name).IsEmpty();
+    });
+  if (chains.size() < 2)
+    return 0;
+
+  m_command = command;
+  m_environment = environment;
+  m_newAuthString = newAuthString;
+  m_firstPort = firstPort;
+  for (auto *cell : preamble)
+    m_preamble.emplace_back(cell);
+  bool first = true;
+  for (auto const &chain : chains) {
+    WaitingChain waiting;
+    for (auto *cell : chain)
+      waiting.cells.emplace_back(cell);
+    waiting.showPreambleOutput = first;
+    first = false;
+    m_waiting.emplace_back(std::move(waiting));
+  }
+  // One core is needed for the GUI.
+  m_maxBackends = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+  m_chainsStarted = 0;
+  m_chainsFailed = 0;
+  m_chainsTotal = chains.size();
+  wxLogMessage(_("Evaluating %li independent parts of the worksheet in up to %li maxima processes"),
+               static_cast<long>(m_chainsTotal), static_cast<long>(m_maxBackends));
+  StartWaitingChains();
+  return m_chainsTotal;
+}
+
+void ParallelEvaluation::StartWaitingChains() {
+  while ((m_backends.size() < m_maxBackends) && (!m_waiting.empty())) {
+    WaitingChain chain = std::move(m_waiting.front());
+    m_waiting.pop_front();
+    m_chainsStarted++;
+    auto backend = std::make_unique<Backend>(this, m_worksheet, m_configuration,
+                                             m_preamble, std::move(chain));
+    wxString const authString = m_newAuthString();
+    if (!backend->Start(m_command, m_environment(authString), authString,
+                        m_firstPort)) {
+      m_chainsFailed++;
+      continue;
+    }
+    m_backends.emplace_back(std::move(backend));
+  }
+  UpdateStatus();
+}
+
+void ParallelEvaluation::BackendFinished(Backend *backend, const wxString &error) {
+  if (!error.IsEmpty()) {
+    m_chainsFailed++;
+    wxLogMessage(_("A maxima that evaluates in parallel has failed: %s"),
+                 error.utf8_str());
+  }
+  // The backend still is on the call stack: It is deleted later.
+  auto it = std::find_if(m_backends.begin(), m_backends.end(),
+                         [backend](const std::unique_ptr<Backend> &b) {
+                           return b.get() == backend;
+                         });
+  if (it != m_backends.end()) {
+    m_finishedBackends.emplace_back(std::move(*it));
+    m_backends.erase(it);
+    CallAfter([this] { m_finishedBackends.clear(); });
+  }
+  StartWaitingChains();
+  if (!IsRunning())
+    m_preamble.clear();
+}
+
+void ParallelEvaluation::UpdateStatus() {
+  if (!m_status)
+    return;
+  if (IsRunning())
+    m_status(wxString::Format(_("Evaluating in parallel: %li of %li parts done"),
+                              static_cast<long>(m_chainsStarted - m_backends.size()),
+                              static_cast<long>(m_chainsTotal)));
+  else if (m_chainsFailed > 0)
+    m_status(wxString::Format(_("Parallel evaluation done, %li of %li parts failed"),
+                              static_cast<long>(m_chainsFailed),
+                              static_cast<long>(m_chainsTotal)));
+  else
+    m_status(_("Parallel evaluation done"));
+}
+
+void ParallelEvaluation::Abort() {
+  m_waiting.clear();
+  m_backends.clear();
+  m_finishedBackends.clear();
+  m_preamble.clear();
+}
@@ -0,0 +1,160 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class ParallelEvaluation that evaluates independent
+  sections of a worksheet in several maxima processes at once.
+*/
+
+#ifndef PARALLELEVALUATION_H
+#define PARALLELEVALUATION_H
+
+#include "GroupCell.h"
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+#include <wx/event.h>
+#include <wx/string.h>
+#include <wx/utils.h>
+
+class Worksheet;
+
+/*! Evaluates independent sections of the worksheet in parallel
+
+  The worksheet is split into sections at the headings of its topmost
+  sectioning level. The code cells before the first of these headings are the
+  preamble. A section depends on an earlier one if
+  - it uses a variable or function the earlier section defines or
+  - the earlier section changes maxima's global state: It contains lisp code,
+    calls a function like load(), kill() or declare() or assigns a value to
+    one of maxima's option variables.
+  Sections that depend on each other form a chain that is evaluated in one
+  maxima process, in the order the sections appear in the worksheet. Chains
+  that are independent of each other are evaluated in separate, freshly
+  started maxima processes, each of which evaluates the preamble first. The
+  number of maxima processes that run at the same time is limited by the
+  number of CPU cores.
+
+  The results of each process are written to the worksheet as they arrive.
+  The main maxima of the window doesn't learn about the values the sections
+  have computed.
+
+  The dependency analysis only looks at the names that appear in the code: A
+  name that is built from a string at runtime or a function that silently
+  changes a global variable can hide a dependency. In this case the results
+  may differ from a sequential evaluation, which is why this only is
+  available as a separate command.
+*/
+class ParallelEvaluation : public wxEvtHandler
+{
+public:
+  //! Returns the environment a maxima that authenticates with the key is run in
+  using EnvironmentFunction =
+    std::function<wxEnvVariableHashMap(const wxString &authString)>;
+  //! Generates a new authentication key
+  using AuthStringFunction = std::function<wxString()>;
+  //! Informs the user about our progress
+  using StatusFunction = std::function<void(const wxString &status)>;
+
+  //! The code cells that have to be evaluated in one maxima process, in order
+  using Chain = std::vector<GroupCell *>;
+
+  ParallelEvaluation(Worksheet *worksheet, Configuration *config,
+                     StatusFunction status);
+  ~ParallelEvaluation() override;
+
+  /*! Splits the worksheet into chains of sections that depend on each other
+
+    \param tree The first cell of the worksheet
+    \param preamble Is filled with the code cells before the first heading of
+           the topmost sectioning level.
+    \param isOptionVariable Tells if an assignment to a name changes one of
+           maxima's option variables.
+    \return The chains, in the order their first section appears in the
+            worksheet. Chains that contain no code cell are omitted.
+  */
+  static std::vector<Chain> FindIndependentChains(
+    GroupCell *tree, Chain &preamble,
+    const std::function<bool(const wxString &name)> &isOptionVariable);
+
+  /*! Starts evaluating the worksheet's independent sections
+
+    \param command The command that starts maxima, without the "-s <port>"
+    \param environment Generates the environment for each maxima process
+    \param newAuthString Generates the authentication key for each process
+    \param firstPort The first port to try to open a socket server on
+    \return The number of independent chains. 0 means that nothing has been
+            started.
+  */
+  std::size_t Start(const wxString &command,
+                    const EnvironmentFunction &environment,
+                    const AuthStringFunction &newAuthString, long firstPort);
+
+  //! Is there a maxima process that still evaluates something?
+  bool IsRunning() const { return !m_backends.empty() || !m_waiting.empty(); }
+
+  //! Kills all maxima processes and discards the chains that haven't been started
+  void Abort();
+
+private:
+  class Backend;
+
+  //! Starts chains until the limit of parallel processes is reached
+  void StartWaitingChains();
+  //! Called by a backend that is done
+  void BackendFinished(Backend *backend, const wxString &error);
+  //! Tells the user how many chains are left
+  void UpdateStatus();
+
+  //! A chain that waits for a free maxima process
+  struct WaitingChain
+  {
+    std::vector<CellPtr<GroupCell>> cells;
+    bool showPreambleOutput = false;
+  };
+
+  Worksheet *m_worksheet;
+  Configuration *m_configuration;
+  StatusFunction m_status;
+  //! The preamble each maxima evaluates before its chain
+  std::vector<CellPtr<GroupCell>> m_preamble;
+  //! The chains that haven't been started, yet
+  std::list<WaitingChain> m_waiting;
+  //! The backends that currently run
+  std::list<std::unique_ptr<Backend>> m_backends;
+  //! The backends that have finished and can be deleted
+  std::vector<std::unique_ptr<Backend>> m_finishedBackends;
+  //! How many maxima processes may run at once
+  std::size_t m_maxBackends = 1;
+  //! How many chains have been started
+  std::size_t m_chainsStarted = 0;
+  //! How many chains there are in total
+  std::size_t m_chainsTotal = 0;
+  //! How many chains have failed
+  std::size_t m_chainsFailed = 0;
+  wxString m_command;
+  EnvironmentFunction m_environment;
+  AuthStringFunction m_newAuthString;
+  long m_firstPort = 0;
+};
+
+#endif // PARALLELEVALUATION_H
@@ -0,0 +1,312 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class ProfilingPane, the sidebar that shows how long
+  the stages of evaluating each cell took.
+*/
+
+#include "ProfilingPane.h"
+#include <algorithm>
+#include <wx/button.h>
+#include <wx/filedlg.h>
+#include <wx/msgdlg.h>
+#include <wx/sizer.h>
+#include <wx/wfstream.h>
+
+ProfilingPane::ProfilingPane(wxWindow *parent, int id)
+  : wxPanel(parent, id) {
+  wxBoxSizer *vbox = new wxBoxSizer(wxVERTICAL);
+  m_sessionTotals = new wxStaticText(this, wxID_ANY, _("No cell has been evaluated, yet."));
+  vbox->Add(m_sessionTotals, wxSizerFlags().Expand().Border(wxALL, 5));
+
+  m_list = new wxListCtrl(this, wxID_ANY, wxDefaultPosition, wxDefaultSize,
+                          wxLC_REPORT | wxLC_SINGLE_SEL);
+  m_list->AppendColumn(_("Cell"));
+  for (int stage = 0; stage < stageCount; stage++)
+    m_list->AppendColumn(StageName(stage), wxLIST_FORMAT_RIGHT);
+  m_list->AppendColumn(_("Total"), wxLIST_FORMAT_RIGHT);
+  m_list->AppendColumn(_("CPU"), wxLIST_FORMAT_RIGHT);
+  m_list->AppendColumn(_("Memory [MB]"), wxLIST_FORMAT_RIGHT);
+  vbox->Add(m_list, wxSizerFlags(1).Expand());
+
+  wxBoxSizer *buttons = new wxBoxSizer(wxHORIZONTAL);
+  wxButton *exportCSV = new wxButton(this, wxID_ANY, _("Export as CSV"));
+  exportCSV->Bind(wxEVT_BUTTON, &ProfilingPane::OnExportCSV, this);
+  buttons->Add(exportCSV, wxSizerFlags().Border(wxALL, 2));
+  wxButton *exportTrace = new wxButton(this, wxID_ANY, _("Export as Chrome trace"));
+  exportTrace->SetToolTip(_("A file chrome://tracing and https://ui.perfetto.dev can display"));
+  exportTrace->Bind(wxEVT_BUTTON, &ProfilingPane::OnExportChromeTrace, this);
+  buttons->Add(exportTrace, wxSizerFlags().Border(wxALL, 2));
+  wxButton *clear = new wxButton(this, wxID_ANY, _("Clear"));
+  clear->Bind(wxEVT_BUTTON, &ProfilingPane::OnClear, this);
+  buttons->Add(clear, wxSizerFlags().Border(wxALL, 2));
+  vbox->Add(buttons, wxSizerFlags().Expand());
+
+  SetSizerAndFit(vbox);
+}
+
+void ProfilingPane::AddEvaluation(GroupCell *cell) {
+  if ((!cell) || (!cell->GetEvaluationTimes()))
+    return;
+  wxString label;
+  if (cell->GetEditable())
+    label = cell->GetEditable()->GetValue().BeforeFirst(wxS('\n'));
+  if (label.Length() > 40)
+    label = label.Left(39) + wxS("…");
+  if (m_records.size() >= m_maxRecords)
+    m_records.erase(m_records.begin());
+  m_records.emplace_back(cell, label, *cell->GetEvaluationTimes());
+  m_recordsAdded = true;
+}
+
+wxString ProfilingPane::StageName(int stage) {
+  switch (stage) {
+  case maxima:
+    return _("Maxima");
+  case transfer:
+    return _("Output");
+  case parse:
+    return _("Parse");
+  case layout:
+    return _("Layout");
+  case paint:
+    return _("Paint");
+  default:
+    return wxEmptyString;
+  }
+}
+
+EvaluationTimes::Clock::time_point ProfilingPane::StageStart(const EvaluationTimes &times,
+                                                             int stage) {
+  switch (stage) {
+  case maxima:
+    return times.sent;
+  case transfer:
+    return times.firstByte;
+  case parse:
+    return times.lastByte;
+  case layout:
+    return times.parsed;
+  case paint:
+    return times.laidOut;
+  default:
+    return {};
+  }
+}
+
+EvaluationTimes::Clock::time_point ProfilingPane::StageEnd(const EvaluationTimes &times,
+                                                           int stage) {
+  if (stage + 1 < stageCount)
+    return StageStart(times, stage + 1);
+  return times.painted;
+}
+
+double ProfilingPane::Duration(const EvaluationTimes &times, int stage) {
+  auto const start = StageStart(times, stage);
+  auto const end = StageEnd(times, stage);
+  if ((!EvaluationTimes::Reached(start)) || (!EvaluationTimes::Reached(end)))
+    return -1;
+  // Output that has been parsed before the last data arrived is parsed
+  // while the transfer still is running.
+  if (end < start)
+    return 0;
+  return std::chrono::duration<double>(end - start).count();
+}
+
+bool ProfilingPane::Complete(const EvaluationTimes &times) {
+  return EvaluationTimes::Reached(times.painted) && (times.painted >= times.laidOut);
+}
+
+bool ProfilingPane::UpdateNeeded() const {
+  if (m_recordsAdded)
+    return true;
+  // The times of the cells that haven't been drawn yet still change. But
+  // re-reading them a few times a second is enough.
+  if (EvaluationTimes::Clock::now() - m_lastUpdate < std::chrono::milliseconds(500))
+    return false;
+  for (auto const &record : m_records)
+    if (record.cell && !Complete(record.times))
+      return true;
+  return false;
+}
+
+void ProfilingPane::UpdateContents() {
+  m_lastUpdate = EvaluationTimes::Clock::now();
+  m_recordsAdded = false;
+  double totals[stageCount] = {};
+  double cpuTotal = 0;
+  std::size_t peakMemory = 0;
+  for (auto &record : m_records) {
+    // The cell still exists and hasn't been evaluated again since
+    if (record.cell && record.cell->GetEvaluationTimes() &&
+        (record.cell->GetEvaluationTimes()->serial == record.times.serial))
+      record.times = *record.cell->GetEvaluationTimes();
+    for (int stage = 0; stage < stageCount; stage++) {
+      double const duration = Duration(record.times, stage);
+      if (duration > 0)
+        totals[stage] += duration;
+    }
+    if (record.times.cpuTime > 0)
+      cpuTotal += record.times.cpuTime;
+    peakMemory = std::max(peakMemory, record.times.peakMemory);
+  }
+
+  wxString summary = wxString::Format(_("%li evaluations."), static_cast<long>(m_records.size()));
+  for (int stage = 0; stage < stageCount; stage++)
+    summary += wxString::Format(wxS(" %s: %.3fs"), StageName(stage), totals[stage]);
+  summary += wxString::Format(_(" CPU: %.3fs Peak memory: %li MB"), cpuTotal,
+                              static_cast<long>(peakMemory / 1000000));
+  m_sessionTotals->SetLabel(summary);
+  m_sessionTotals->SetToolTip(summary);
+
+  m_list->Freeze();
+  // The newest evaluation comes first
+  long const rows = static_cast<long>(m_records.size());
+  while (m_list->GetItemCount() > rows)
+    m_list->DeleteItem(m_list->GetItemCount() - 1);
+  while (m_list->GetItemCount() < rows)
+    m_list->InsertItem(m_list->GetItemCount(), wxEmptyString);
+  for (long row = 0; row < rows; row++) {
+    const Record &record = m_records[static_cast<std::size_t>(rows - 1 - row)];
+    m_list->SetItem(row, 0, record.label);
+    double total = 0;
+    for (int stage = 0; stage < stageCount; stage++) {
+      double const duration = Duration(record.times, stage);
+      if (duration >= 0) {
+        total += duration;
+        m_list->SetItem(row, stage + 1, wxString::Format(wxS("%.3f"), duration));
+      } else
+        m_list->SetItem(row, stage + 1, wxS("-"));
+    }
+    m_list->SetItem(row, stageCount + 1, wxString::Format(wxS("%.3f"), total));
+    if (record.times.cpuTime >= 0)
+      m_list->SetItem(row, stageCount + 2, wxString::Format(wxS("%.3f"), record.times.cpuTime));
+    else
+      m_list->SetItem(row, stageCount + 2, wxS("-"));
+    if (record.times.peakMemory > 0)
+      m_list->SetItem(row, stageCount + 3,
+                      wxString::Format(wxS("%li"),
+                                       static_cast<long>(record.times.peakMemory / 1000000)));
+    else
+      m_list->SetItem(row, stageCount + 3, wxS("-"));
+  }
+  m_list->Thaw();
+}
+
+wxString ProfilingPane::ToCSV() const {
+  wxString csv = wxS("cell");
+  for (int stage = 0; stage < stageCount; stage++)
+    csv += wxS(",") + StageName(stage);
+  csv += wxS(",CPU,peak memory [bytes],major page faults\n");
+  for (auto const &record : m_records) {
+    wxString label = record.label;
+    label.Replace(wxS("\""), wxS("\"\""));
+    csv += wxS("\"") + label + wxS("\"");
+    for (int stage = 0; stage < stageCount; stage++) {
+      double const duration = Duration(record.times, stage);
+      csv += wxS(",");
+      if (duration >= 0)
+        csv += wxString::Format(wxS("%.6f"), duration);
+    }
+    csv += wxS(",");
+    if (record.times.cpuTime >= 0)
+      csv += wxString::Format(wxS("%.6f"), record.times.cpuTime);
+    csv += wxS(",");
+    if (record.times.peakMemory > 0)
+      csv += wxString::Format(wxS("%llu"),
+                              static_cast<unsigned long long>(record.times.peakMemory));
+    csv += wxS(",");
+    if (record.times.majorPageFaults >= 0)
+      csv += wxString::Format(wxS("%lld"), record.times.majorPageFaults);
+    csv += wxS("\n");
+  }
+  return csv;
+}
+
+wxString ProfilingPane::ToChromeTrace() const {
+  wxString json = wxS("{\"traceEvents\":[");
+  bool first = true;
+  for (auto const &record : m_records) {
+    wxString label;
+    for (auto ch : record.label) {
+      if ((ch == wxS('"')) || (ch == wxS('\\')))
+        label += wxS("\\");
+      if (ch < 32)
+        label += wxString::Format(wxS("\\u%04x"), static_cast<int>(ch));
+      else
+        label += ch;
+    }
+    for (int stage = 0; stage < stageCount; stage++) {
+      double const duration = Duration(record.times, stage);
+      if (duration < 0)
+        continue;
+      auto const start = std::chrono::duration_cast<std::chrono::microseconds>(
+        StageStart(record.times, stage) - m_sessionStart).count();
+      if (!first)
+        json += wxS(",\n");
+      first = false;
+      wxString resources;
+      if ((stage == maxima) && (record.times.cpuTime >= 0))
+        resources = wxString::Format(wxS(",\"cpu\":%.6f,\"peakMemory\":%llu"),
+                                     record.times.cpuTime,
+                                     static_cast<unsigned long long>(record.times.peakMemory));
+      json += wxString::Format(
+        wxS("{\"name\":\"%s\",\"cat\":\"evaluation\",\"ph\":\"X\",\"ts\":%lld,"
+            "\"dur\":%lld,\"pid\":1,\"tid\":1,\"args\":{\"cell\":\"%s\"%s}}"),
+        StageName(stage), static_cast<long long>(start),
+        static_cast<long long>(duration * 1e6), label, resources);
+    }
+  }
+  json += wxS("]}\n");
+  return json;
+}
+
+void ProfilingPane::Export(const wxString &text, const wxString &wildcard) {
+  wxFileDialog fileDialog(this, _("Export As"), wxEmptyString, wxEmptyString,
+                          wildcard, wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+  if (fileDialog.ShowModal() != wxID_OK)
+    return;
+  wxFileOutputStream output(fileDialog.GetPath());
+  wxScopedCharBuffer const data = text.utf8_str();
+  if (output.IsOk())
+    output.Write(data.data(), data.length());
+  if (!output.IsOk() || !output.Close())
+    wxMessageBox(_("Exporting to the file failed."), _("Error"), wxOK | wxICON_ERROR, this);
+}
+
+void ProfilingPane::OnExportCSV(wxCommandEvent &WXUNUSED(event)) {
+  UpdateContents();
+  Export(ToCSV(), _("CSV file (*.csv)|*.csv"));
+}
+
+void ProfilingPane::OnExportChromeTrace(wxCommandEvent &WXUNUSED(event)) {
+  UpdateContents();
+  Export(ToChromeTrace(), _("Trace (*.json)|*.json"));
+}
+
+void ProfilingPane::OnClear(wxCommandEvent &WXUNUSED(event)) {
+  m_records.clear();
+  m_sessionStart = EvaluationTimes::Clock::now();
+  m_recordsAdded = true;
+  UpdateContents();
+  m_sessionTotals->SetLabel(_("No cell has been evaluated, yet."));
+}
@@ -0,0 +1,124 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class ProfilingPane, the sidebar that shows how long
+  the stages of evaluating each cell took.
+*/
+
+#ifndef PROFILINGPANE_H
+#define PROFILINGPANE_H
+
+#include "precomp.h"
+#include "EvaluationTimes.h"
+#include "GroupCell.h"
+#include <vector>
+#include <wx/listctrl.h>
+#include <wx/panel.h>
+#include <wx/stattext.h>
+
+/*! The sidebar that shows the time each stage of evaluating a cell took
+
+  For each cell that has been sent to maxima the pane shows
+  - how long maxima took until its first output arrived,
+  - how long it took until its last output arrived,
+  - how long converting the output to cells took,
+  - how long the layout of the cell took and
+  - how long it took until the cell was drawn,
+  - how much CPU time maxima has used for the cell and
+  - how much memory maxima occupied at most while evaluating the cell.
+  The sum over all evaluations of this session is shown above the list.
+  Both can be exported as CSV or in the Chrome trace event format that
+  chrome://tracing and https://ui.perfetto.dev can display.
+*/
+class ProfilingPane : public wxPanel
+{
+public:
+  ProfilingPane(wxWindow *parent, int id);
+
+  //! Adds the evaluation of a cell that has just been started
+  void AddEvaluation(GroupCell *cell);
+
+  //! Does the display need to be updated?
+  bool UpdateNeeded() const;
+  //! Reads the current times from the cells and updates the display
+  void UpdateContents();
+
+  //! Returns all evaluations in the CSV format
+  wxString ToCSV() const;
+  //! Returns all evaluations in Chrome's trace event format
+  wxString ToChromeTrace() const;
+
+private:
+  //! One evaluation of a cell
+  struct Record
+  {
+    Record(GroupCell *group, const wxString &cellLabel, const EvaluationTimes &evaluationTimes)
+      : cell(group), label(cellLabel), times(evaluationTimes) {}
+    //! The cell, as long as it exists
+    CellPtr<GroupCell> cell;
+    //! The beginning of the cell's input
+    wxString label;
+    EvaluationTimes times;
+  };
+  //! The stages of an evaluation
+  enum Stage
+  {
+    maxima,
+    transfer,
+    parse,
+    layout,
+    paint,
+    stageCount
+  };
+  //! The name of a stage
+  static wxString StageName(int stage);
+  //! The duration of a stage in seconds, or a negative number if it hasn't ended
+  static double Duration(const EvaluationTimes &times, int stage);
+  //! The time a stage has begun at
+  static EvaluationTimes::Clock::time_point StageStart(const EvaluationTimes &times, int stage);
+  //! The time a stage has ended at
+  static EvaluationTimes::Clock::time_point StageEnd(const EvaluationTimes &times, int stage);
+  //! Is this evaluation complete?
+  static bool Complete(const EvaluationTimes &times);
+
+  void OnExportCSV(wxCommandEvent &event);
+  void OnExportChromeTrace(wxCommandEvent &event);
+  void OnClear(wxCommandEvent &event);
+  //! Asks for a file name and saves text to it
+  void Export(const wxString &text, const wxString &wildcard);
+
+  std::vector<Record> m_records;
+  //! The list of evaluations
+  wxListCtrl *m_list;
+  //! The sums for the whole session
+  wxStaticText *m_sessionTotals;
+  //! Have evaluations been added since the last update?
+  bool m_recordsAdded = false;
+  //! When the display was last updated
+  EvaluationTimes::Clock::time_point m_lastUpdate;
+  //! The time the trace export counts from
+  EvaluationTimes::Clock::time_point m_sessionStart = EvaluationTimes::Clock::now();
+  //! The most evaluations that are kept
+  static constexpr std::size_t m_maxRecords = 10000;
+};
+
+#endif // PROFILINGPANE_H
@@ -0,0 +1,243 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the functions that tell how many resources wxMaxima and
+  Maxima use
+*/
+
+#include "ResourceUsage.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#if defined __WXMSW__
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+std::size_t ResourceUsage::PeakResidentSetSize() {
+#if defined __WXMSW__
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#if defined __WXOSX__
+  // MacOS reports the size in bytes, everybody else in kilobytes
+  return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::size_t ResourceUsage::PhysicalMemory() {
+#if defined __WXMSW__
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (!GlobalMemoryStatusEx(&status))
+    return 0;
+  return static_cast<std::size_t>(status.ullTotalPhys);
+#else
+  long const pages = sysconf(_SC_PHYS_PAGES);
+  long const pageSize = sysconf(_SC_PAGESIZE);
+  if ((pages <= 0) || (pageSize <= 0))
+    return 0;
+  return static_cast<std::size_t>(pages) * static_cast<std::size_t>(pageSize);
+#endif
+}
+
+ProcessMonitor::~ProcessMonitor() { Close(); }
+
+void ProcessMonitor::Close() {
+#ifdef __WXMSW__
+  if (m_process)
+    CloseHandle(m_process);
+  m_process = nullptr;
+#else
+  if (m_systemStat >= 0)
+    close(m_systemStat);
+  if (m_processStat >= 0)
+    close(m_processStat);
+  m_systemStat = -1;
+  m_processStat = -1;
+#endif
+  m_pid = -1;
+}
+
+double ProcessMonitor::CpuTimeUnitsPerSecond() {
+#ifdef __WXMSW__
+  // Windows counts in units of 100ns
+  return 1e7;
+#else
+  static long const ticks = sysconf(_SC_CLK_TCK);
+  return (ticks > 0) ? ticks : 100;
+#endif
+}
+
+#ifdef __WXMSW__
+std::size_t ProcessMonitor::ReadFile(int WXUNUSED(fd)) { return 0; }
+
+ProcessMonitor::Sample ProcessMonitor::Read(long pid) {
+  Sample sample;
+  if (pid != m_pid) {
+    Close();
+    if (pid > 0)
+      m_process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, pid);
+    m_pid = pid;
+  }
+
+  FILETIME systemTime;
+  GetSystemTimeAsFileTime(&systemTime);
+  sample.totalCpuTime = static_cast<long long>(systemTime.dwLowDateTime) +
+    (static_cast<long long>(systemTime.dwHighDateTime) << 32);
+  if (!m_process)
+    return sample;
+
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if (GetProcessTimes(m_process, &creationTime, &exitTime, &kernelTime, &userTime))
+    sample.processCpuTime =
+      static_cast<long long>(kernelTime.dwLowDateTime) + userTime.dwLowDateTime +
+      (1LL << 32) * (static_cast<long long>(kernelTime.dwHighDateTime) +
+                     userTime.dwHighDateTime);
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(m_process, &counters, sizeof(counters))) {
+    sample.residentSetSize = counters.WorkingSetSize;
+    // Windows doesn't tell major and minor page faults apart.
+    sample.majorPageFaults = counters.PageFaultCount;
+  }
+  return sample;
+}
+#else
+std::size_t ProcessMonitor::ReadFile(int fd) {
+  if (fd < 0)
+    return 0;
+  // The files in /proc are generated anew each time they are read from their
+  // beginning.
+  ssize_t const bytesRead = pread(fd, m_buffer, sizeof(m_buffer) - 1, 0);
+  if (bytesRead <= 0)
+    return 0;
+  m_buffer[bytesRead] = '\0';
+  return static_cast<std::size_t>(bytesRead);
+}
+
+namespace {
+//! Skips the whitespace at pos and reads the number that follows it
+bool ParseNumber(const char *&pos, const char *end, long long &number) {
+  while ((pos < end) && (*pos == ' '))
+    pos++;
+  if ((pos >= end) || (*pos < '0') || (*pos > '9'))
+    return false;
+  number = 0;
+  while ((pos < end) && (*pos >= '0') && (*pos <= '9'))
+    number = number * 10 + (*pos++ - '0');
+  return true;
+}
+
+//! Skips the field at pos and the whitespace in front of it
+void SkipField(const char *&pos, const char *end) {
+  while ((pos < end) && (*pos == ' '))
+    pos++;
+  while ((pos < end) && (*pos != ' '))
+    pos++;
+}
+} // namespace
+
+ProcessMonitor::Sample ProcessMonitor::Read(long pid) {
+  Sample sample;
+  if (pid != m_pid) {
+    Close();
+    m_systemStat = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+    if (pid > 0) {
+      char fileName[64];
+      std::snprintf(fileName, sizeof(fileName), "/proc/%li/stat", pid);
+      m_processStat = open(fileName, O_RDONLY | O_CLOEXEC);
+    }
+    m_pid = pid;
+  }
+
+  // The first line of /proc/stat is "cpu", followed by the time all CPUs
+  // have spent in user mode, in user mode with low priority and in system
+  // mode.
+  std::size_t length = ReadFile(m_systemStat);
+  if ((length > 4) && (std::equal(m_buffer, m_buffer + 4, "cpu "))) {
+    const char *pos = m_buffer + 4;
+    const char *end = m_buffer + length;
+    long long total = 0;
+    int i;
+    for (i = 0; i < 3; i++) {
+      long long jiffies;
+      if (!ParseNumber(pos, end, jiffies))
+        break;
+      total += jiffies;
+    }
+    if (i == 3)
+      sample.totalCpuTime = total;
+  }
+
+  // /proc/<pid>/stat contains the process name in parenthesis. As the name
+  // may contain spaces and parenthesis we search the last closing parenthesis
+  // and count the fields from there, as described in "man 5 proc".
+  length = ReadFile(m_processStat);
+  if (length == 0)
+    return sample;
+  const char *end = m_buffer + length;
+  const char *pos = std::find(std::reverse_iterator<const char *>(end),
+                              std::reverse_iterator<const char *>(m_buffer), ')').base();
+  if (pos == m_buffer)
+    return sample;
+  // Field 3 (the state) to field 11 (cminflt)
+  for (int field = 3; field <= 11; field++)
+    SkipField(pos, end);
+  long long majorFaults;
+  if (!ParseNumber(pos, end, majorFaults))
+    return sample;
+  // Field 13: cmajflt
+  SkipField(pos, end);
+  // Fields 14 to 17: utime, stime, cutime and cstime
+  long long cpuTime = 0;
+  for (int field = 14; field <= 17; field++) {
+    long long jiffies;
+    if (!ParseNumber(pos, end, jiffies))
+      return sample;
+    cpuTime += jiffies;
+  }
+  sample.majorPageFaults = majorFaults;
+  sample.processCpuTime = cpuTime;
+  // Fields 18 (priority) to 23 (vsize), then field 24: rss in pages
+  for (int field = 18; field <= 23; field++)
+    SkipField(pos, end);
+  long long residentPages;
+  static long const pageSize = sysconf(_SC_PAGESIZE);
+  if (ParseNumber(pos, end, residentPages) && (pageSize > 0))
+    sample.residentSetSize = static_cast<std::size_t>(residentPages) *
+      static_cast<std::size_t>(pageSize);
+  return sample;
+}
+#endif
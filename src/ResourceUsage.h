@@ -0,0 +1,102 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  The header file for the functions that tell how many resources wxMaxima
+  and Maxima use
+*/
+
+#ifndef RESOURCEUSAGE_H
+#define RESOURCEUSAGE_H
+
+#include <cstddef>
+#include <wx/defs.h>
+
+//! Tells how many resources wxMaxima uses
+class ResourceUsage
+{
+public:
+  /*! The most memory wxMaxima has occupied at any time, in bytes
+
+    \return 0, if the operating system doesn't tell us.
+  */
+  static std::size_t PeakResidentSetSize();
+  /*! The memory this computer has, in bytes
+
+    \return 0, if the operating system doesn't tell us.
+  */
+  static std::size_t PhysicalMemory();
+};
+
+/*! Tells how many resources another process uses
+
+  Meant to be asked every few seconds: On Linux the files in /proc are kept
+  open and re-read from their start, which means that each call to Read()
+  doesn't open files and doesn't allocate memory.
+*/
+class ProcessMonitor
+{
+public:
+  //! What a process had used at the time Read() was called
+  struct Sample
+  {
+    //! The CPU time the whole system has used in the same unit as processCpuTime; -1 = unknown
+    long long totalCpuTime = -1;
+    //! The CPU time the process and its children have used; -1 = unknown
+    long long processCpuTime = -1;
+    //! The memory the process occupies, in bytes; 0 = unknown
+    std::size_t residentSetSize = 0;
+    //! The number of page faults that caused the process to wait for the disk; -1 = unknown
+    long long majorPageFaults = -1;
+  };
+
+  ProcessMonitor() = default;
+  ~ProcessMonitor();
+  ProcessMonitor(const ProcessMonitor &) = delete;
+  ProcessMonitor &operator=(const ProcessMonitor &) = delete;
+
+  //! Finds out what the process with the id pid currently uses
+  Sample Read(long pid);
+  //! The number of units of Sample::processCpuTime per second
+  static double CpuTimeUnitsPerSecond();
+
+private:
+  //! Closes the files of the process we have watched before
+  void Close();
+  //! Reads a file from its beginning into m_buffer. Returns the number of bytes read.
+  std::size_t ReadFile(int fd);
+  //! The process we watch
+  long m_pid = -1;
+#ifdef __WXMSW__
+  //! The handle of the process we watch
+  void *m_process = nullptr;
+#else
+  //! /proc/stat
+  int m_systemStat = -1;
+  //! /proc/<pid>/stat
+  int m_processStat = -1;
+  //! Holds the contents of the file we have read last
+  char m_buffer[1024];
+#endif
+};
+
+#endif // RESOURCEUSAGE_H
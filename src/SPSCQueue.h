@@ -0,0 +1,110 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  A lock-free queue that passes objects from one thread to exactly one other thread
+*/
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/*! A bounded lock-free single-producer single-consumer queue
+
+  Exactly one thread may call Push() and exactly one (other) thread may call
+  Pop(). Neither of them ever has to wait for a lock: The producer only writes
+  m_tail, the consumer only writes m_head and both publish their progress using
+  release/acquire ordering.
+
+  One slot of the ring buffer always stays empty so a full queue can be told
+  apart from an empty one.
+*/
+template <class T> class SPSCQueue
+{
+public:
+  explicit SPSCQueue(std::size_t capacity) : m_slots(capacity + 1) {}
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  /*! Appends an item to the queue. Must only be called by the producer thread.
+
+    \return false, if the queue is full. In this case item is left untouched.
+  */
+  bool Push(T &&item)
+    {
+      std::size_t const tail = m_tail.load(std::memory_order_relaxed);
+      std::size_t const next = Next(tail);
+      if (next == m_head.load(std::memory_order_acquire))
+        return false;
+      m_slots[tail] = std::move(item);
+      m_tail.store(next, std::memory_order_release);
+      return true;
+    }
+
+  /*! Removes the oldest item from the queue. Must only be called by the consumer thread.
+
+    \return false, if the queue was empty.
+  */
+  bool Pop(T &item)
+    {
+      std::size_t const head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire))
+        return false;
+      item = std::move(m_slots[head]);
+      // Don't keep the moved-from object's memory alive until the slot is reused
+      m_slots[head] = T();
+      m_head.store(Next(head), std::memory_order_release);
+      return true;
+    }
+
+  //! Is the queue empty? Only reliable if called from the consumer thread.
+  bool Empty() const
+    {
+      return m_head.load(std::memory_order_acquire) ==
+        m_tail.load(std::memory_order_acquire);
+    }
+
+  //! Is the queue full? Only reliable if called from the producer thread.
+  bool Full() const
+    {
+      return Next(m_tail.load(std::memory_order_acquire)) ==
+        m_head.load(std::memory_order_acquire);
+    }
+
+private:
+  std::size_t Next(std::size_t index) const
+    {
+      return (index + 1 < m_slots.size()) ? index + 1 : 0;
+    }
+
+  std::vector<T> m_slots;
+  //! The slot the consumer will read next
+  std::atomic<std::size_t> m_head{0};
+  //! The slot the producer will write next
+  std::atomic<std::size_t> m_tail{0};
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,212 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class SpareMaxima that keeps a maxima process ready
+  for the next window or restart.
+*/
+
+#include "SpareMaxima.h"
+#include <wx/intl.h>
+#include <wx/log.h>
+#include <wx/window.h>
+
+std::unique_ptr<SpareMaxima> SpareMaxima::m_spareMaxima;
+
+SpareMaxima &SpareMaxima::Get() {
+  if (!m_spareMaxima)
+    m_spareMaxima.reset(new SpareMaxima());
+  return *m_spareMaxima;
+}
+
+void SpareMaxima::Destroy() { m_spareMaxima.reset(); }
+
+SpareMaxima::SpareMaxima() : m_limitTimer(this) {
+  Bind(wxEVT_SOCKET, &SpareMaxima::OnConnect, this);
+  Bind(wxEVT_TIMER, &SpareMaxima::OnCheckLimits, this);
+}
+
+SpareMaxima::~SpareMaxima() { Stop(); }
+
+bool SpareMaxima::MemoryIsLow() const {
+  wxMemorySize const freeMemory = wxGetFreeMemory();
+  // -1 = the OS doesn't tell us
+  if (freeMemory < 0)
+    return false;
+  return freeMemory / (1024 * 1024) < m_limits.minFreeMegabytes;
+}
+
+void SpareMaxima::Start(const wxString &command,
+                        const wxEnvVariableHashMap &environment,
+                        const wxString &authString, long firstPort,
+                        Limits limits) {
+  m_limits = limits;
+  wxEnvVariableHashMap::const_iterator const folder =
+    environment.find(wxS("MAXIMA_INITIAL_FOLDER"));
+  wxString const initialFolder =
+    (folder != environment.end()) ? folder->second : wxString(wxEmptyString);
+  if (m_process) {
+    if ((command == m_command) && (initialFolder == m_initialFolder))
+      return;
+    // The spare maxima has been started for different settings and therefore
+    // never will be of any use.
+    Stop();
+  }
+  if (MemoryIsLow()) {
+    wxLogMessage(_("Not starting a spare maxima as there is too little free memory."));
+    return;
+  }
+
+  long port = firstPort;
+  for (; (port < firstPort + 1000) && (port < 65535) && (!m_server); port++) {
+    wxIPV4address addr;
+    addr.LocalHost();
+    addr.Service(port);
+    m_server = std::unique_ptr<wxSocketServer, ServerDeleter>(
+      new wxSocketServer(addr, wxSOCKET_WAITALL_WRITE));
+    if (!m_server->IsOk())
+      m_server.reset();
+  }
+  if (!m_server) {
+    wxLogMessage(_("Cannot open a port for a spare maxima."));
+    return;
+  }
+  port--;
+  m_server->SetEventHandler(*this);
+  m_server->SetNotify(wxSOCKET_CONNECTION_FLAG);
+  m_server->Notify(true);
+
+  m_processId = wxWindow::NewControlId();
+  m_process = new wxProcess(this, m_processId);
+  m_process->Redirect();
+  Bind(wxEVT_END_PROCESS, &SpareMaxima::OnProcessEnd, this, m_processId);
+
+  wxExecuteEnv env;
+  env.env = environment;
+  m_initialFolder = initialFolder;
+  m_command = command;
+  m_authString = authString;
+  wxString const fullCommand =
+    command + wxString::Format(wxS(" -s %li "), port);
+  wxLogMessage(_("Starting a spare maxima as: %s"), fullCommand.utf8_str());
+  if (wxExecute(fullCommand, wxEXEC_ASYNC | wxEXEC_MAKE_GROUP_LEADER, m_process,
+                &env) <= 0) {
+    wxLogMessage(_("Cannot start a spare maxima."));
+    delete m_process;
+    m_process = NULL;
+    m_server.reset();
+    return;
+  }
+  m_startTime = std::chrono::steady_clock::now();
+  m_limitTimer.Start(60 * 1000);
+}
+
+void SpareMaxima::OnConnect(wxSocketEvent &event) {
+  if (event.GetSocketEvent() != wxSOCKET_CONNECTION)
+    return;
+  if (!m_server)
+    return;
+  if (m_socket || !m_process) {
+    // Somebody else has connected to our port
+    std::unique_ptr<wxSocketBase>(m_server->Accept(false));
+    return;
+  }
+  m_socket.reset(m_server->Accept(false));
+  if (!m_socket || !m_socket->IsConnected()) {
+    wxLogMessage(_("The spare maxima couldn't connect."));
+    Stop();
+    return;
+  }
+  // Everything maxima sends stays in the socket until a window takes this
+  // maxima over.
+  m_socket->Notify(false);
+  // Nobody else needs to connect to us.
+  m_server.reset();
+  wxLogMessage(_("A spare maxima is ready."));
+}
+
+void SpareMaxima::OnProcessEnd(wxProcessEvent &event) {
+  if (event.GetId() != m_processId)
+    return;
+  wxLogMessage(_("The spare maxima has exited."));
+  Unbind(wxEVT_END_PROCESS, &SpareMaxima::OnProcessEnd, this, m_processId);
+  // wxWidgets deletes the process object after this event has been skipped.
+  m_process = NULL;
+  event.Skip();
+  Stop();
+}
+
+void SpareMaxima::OnCheckLimits(wxTimerEvent &WXUNUSED(event)) {
+  if (!m_process) {
+    m_limitTimer.Stop();
+    return;
+  }
+  if (std::chrono::steady_clock::now() - m_startTime >
+      std::chrono::minutes(m_limits.idleMinutes)) {
+    wxLogMessage(_("Killing the spare maxima as it hasn't been used for %li minutes."),
+                 m_limits.idleMinutes);
+    Stop();
+  } else if (MemoryIsLow()) {
+    wxLogMessage(_("Killing the spare maxima as there is too little free memory."));
+    Stop();
+  }
+}
+
+bool SpareMaxima::Take(const wxString &command, const wxString &initialFolder,
+                       Connection &connection) {
+  if (!m_process || !m_socket || !m_socket->IsConnected())
+    return false;
+  if ((command != m_command) || (initialFolder != m_initialFolder)) {
+    // The spare maxima has been started for different settings and therefore
+    // never will be of any use.
+    Stop();
+    return false;
+  }
+  wxLogMessage(_("Using the spare maxima."));
+  Unbind(wxEVT_END_PROCESS, &SpareMaxima::OnProcessEnd, this, m_processId);
+  connection.process = m_process;
+  connection.socket = m_socket.release();
+  connection.authString = m_authString;
+  connection.processId = m_processId;
+  m_process = NULL;
+  m_limitTimer.Stop();
+  return true;
+}
+
+void SpareMaxima::Stop() {
+  m_limitTimer.Stop();
+  m_server.reset();
+  // Maxima exits when its connection is closed, if it is connected.
+  if (m_socket)
+    m_socket->Close();
+  m_socket.reset();
+  if (!m_process)
+    return;
+  Unbind(wxEVT_END_PROCESS, &SpareMaxima::OnProcessEnd, this, m_processId);
+  long const pid = m_process->GetPid();
+  m_process->Detach();
+  m_process = NULL;
+  if (pid > 0) {
+    wxLogNull logNull;
+    if (wxProcess::Kill(static_cast<int>(pid), wxSIGKILL, wxKILL_CHILDREN) != wxKILL_OK)
+      wxProcess::Kill(static_cast<int>(pid), wxSIGKILL);
+  }
+}
@@ -0,0 +1,166 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class SpareMaxima that keeps a maxima process ready
+  for the next window or restart.
+*/
+
+#ifndef SPAREMAXIMA_H
+#define SPAREMAXIMA_H
+
+#include <chrono>
+#include <memory>
+#include <wx/event.h>
+#include <wx/process.h>
+#include <wx/socket.h>
+#include <wx/string.h>
+#include <wx/timer.h>
+#include <wx/utils.h>
+
+/*! A maxima process that is started in advance
+
+  Starting maxima can take several seconds, most of which the lisp spends
+  loading maxima. If the user has enabled this in the config dialogue
+  wxMaxima therefore keeps one spare maxima process that has already been
+  started and has connected to its own socket server. "Restart Maxima" and
+  new windows then take over this process instead of starting a new one.
+
+  The spare maxima has not exchanged any data with wxMaxima when it is taken
+  over: Its first prompt still waits in the socket. The window that takes it
+  over therefore does the usual handshake and is told everything a freshly
+  started maxima would tell it.
+
+  There is only one spare maxima for all windows. It is killed
+  - if nobody has taken it over for the configured number of minutes,
+  - if the system's free memory drops below the configured limit or
+  - if it dies or loses its connection.
+  In these cases no new spare maxima is started before a maxima is started
+  the next time.
+*/
+class SpareMaxima : public wxEvtHandler
+{
+public:
+  //! Everything a window needs in order to take over the spare maxima
+  struct Connection
+  {
+    /*! The process. Sends its wxEVT_END_PROCESS events with the id processId.
+
+      The new owner has to make itself the next handler of its events.
+    */
+    wxProcess *process = NULL;
+    //! The connection maxima has opened. Has to be deleted by the new owner.
+    wxSocketBase *socket = NULL;
+    //! The authentication string maxima has been started with
+    wxString authString;
+    //! The id the process sends its events with
+    int processId = wxID_ANY;
+  };
+
+  //! The limits the spare maxima is kept within
+  struct Limits
+  {
+    //! Kill the spare maxima if it hasn't been used for this long
+    long idleMinutes = 30;
+    //! Don't keep a spare maxima if less memory is free
+    long minFreeMegabytes = 1024;
+  };
+
+  //! The spare maxima all windows share
+  static SpareMaxima &Get();
+  //! Kills the spare maxima. To be called on exit.
+  static void Destroy();
+
+  ~SpareMaxima() override;
+
+  /*! Starts a spare maxima, if there isn't one for these settings, yet
+
+    A spare maxima that has been started with another command or initial
+    folder is replaced. The limits always apply from now on.
+
+    \param command The command that starts maxima, without the "-s <port>"
+    \param environment The environment to run maxima in
+    \param authString The authentication key that is in the environment
+    \param firstPort The first port to try to open the socket server on
+    \param limits The limits for keeping the spare maxima
+  */
+  void Start(const wxString &command, const wxEnvVariableHashMap &environment,
+             const wxString &authString, long firstPort, Limits limits);
+
+  /*! Hands over the spare maxima, if it matches
+
+    \param command The command the maxima has to have been started with,
+           without the "-s <port>"
+    \param initialFolder The MAXIMA_INITIAL_FOLDER maxima has to have been
+           started with
+    \param connection Is filled with what is needed to use the spare maxima.
+    \return false, if there is no matching spare maxima that has connected
+            to us, yet.
+  */
+  bool Take(const wxString &command, const wxString &initialFolder,
+            Connection &connection);
+
+  //! Kills the spare maxima, if there is one
+  void Stop();
+
+private:
+  SpareMaxima();
+  //! Called when the spare maxima connects to our socket server
+  void OnConnect(wxSocketEvent &event);
+  //! Called when the spare maxima has exited
+  void OnProcessEnd(wxProcessEvent &event);
+  //! Checks if the spare maxima is to be killed
+  void OnCheckLimits(wxTimerEvent &event);
+  //! Is there less memory free than the limit allows for?
+  bool MemoryIsLow() const;
+
+  static std::unique_ptr<SpareMaxima> m_spareMaxima;
+
+  //! Servers with pending events must be destroyed, not deleted
+  struct ServerDeleter {
+    void operator()(wxSocketServer* server) const {
+      server->Close();
+      server->Destroy();
+    }
+  };
+  //! The server the spare maxima connects to
+  std::unique_ptr<wxSocketServer, ServerDeleter> m_server;
+  //! The connection the spare maxima has opened, or NULL
+  std::unique_ptr<wxSocketBase> m_socket;
+  //! The spare maxima process, or NULL
+  wxProcess *m_process = NULL;
+  //! The id m_process sends its events with
+  int m_processId = wxID_ANY;
+  //! The command maxima was started with
+  wxString m_command;
+  //! The MAXIMA_INITIAL_FOLDER maxima was started with
+  wxString m_initialFolder;
+  //! The authentication key maxima was started with
+  wxString m_authString;
+  //! The limits we keep the spare maxima within
+  Limits m_limits;
+  //! Checks the limits every now and then
+  wxTimer m_limitTimer;
+  //! When the spare maxima was started
+  std::chrono::steady_clock::time_point m_startTime;
+};
+
+#endif // SPAREMAXIMA_H
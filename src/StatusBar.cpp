@@ -320,6 +320,9 @@ void StatusBar::NetworkStatus(networkState status) {
         toolTip += wxString::Format(
                                     _("\n\nMaxima is currently using %3.3f%% of all available CPUs."),
                                     m_maximaPercentage);
+      if (m_maximaMemory > 0)
+        toolTip += wxString::Format(_("\nMaxima occupies %li MB of memory."),
+                                    static_cast<long>(m_maximaMemory / 1000000));
       m_networkStatus->SetToolTip(toolTip);
     } break;
     case error:
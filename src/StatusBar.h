@@ -79,6 +79,9 @@ public:
       m_maximaPercentage = percentage;
       NetworkStatus(m_oldNetworkState);
     }
+  //! Inform the status bar how much memory maxima occupies, in bytes. 0 = unknown.
+  void SetMaximaMemory(std::size_t bytes)
+    { m_maximaMemory = bytes; }
 
   enum MaximaStatus
   {
@@ -118,6 +121,8 @@ private:
     See m_maximaPercentage and SetMaximaCPUPercentage()
   */
   float m_oldmaximaPercentage;
+  //! How much memory does maxima occupy? See SetMaximaMemory()
+  std::size_t m_maximaMemory = 0;
   networkState m_oldNetworkState;
   wxString m_stdToolTip;
   wxString m_networkErrToolTip;
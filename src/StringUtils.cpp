@@ -111,4 +111,29 @@ namespace wxm {
     swap(*str, normalized);
   }
 
+  // UTF-8
+
+  std::size_t CompleteUTF8Length(const char *data, std::size_t length) {
+    // A UTF-8 char is at most 4 bytes long => we only need to look at the last 3
+    // bytes in order to find out if the last char is incomplete.
+    for (std::size_t back = 1; (back <= 3) && (back <= length); back++) {
+      auto const ch = static_cast<unsigned char>(data[length - back]);
+      // Continuation bytes (10xxxxxx) tell us to continue searching for the
+      // byte that starts the char.
+      if ((ch & 0xC0) == 0x80)
+        continue;
+      std::size_t charLength = 1;
+      if ((ch & 0xE0) == 0xC0)
+        charLength = 2;
+      else if ((ch & 0xF0) == 0xE0)
+        charLength = 3;
+      else if ((ch & 0xF8) == 0xF0)
+        charLength = 4;
+      if (charLength > back)
+        return length - back;
+      return length;
+    }
+    return length;
+  }
+
 } // namespace wxm
@@ -53,6 +53,7 @@
 #ifndef WXMAXIMA_STRINGUTILS_H
 #define WXMAXIMA_STRINGUTILS_H
 
+#include <cstddef>
 #include <wx/string.h>
 #include <wx/translation.h>
 
@@ -101,6 +102,16 @@ namespace wxm {
 //! Removes all NULs from the string, converts "\r\n" to "\n", and lone "\r" to "\n".
   void NormalizeEOLsRemoveNULs(wxString &str);
 
+// UTF-8
+
+/*! The length of the part of a UTF-8 byte sequence that contains only complete chars
+
+  If data arrives in chunks a chunk might end in the middle of a multibyte
+  character. The bytes of this character aren't counted and must be kept until
+  the rest of the character has arrived.
+*/
+  std::size_t CompleteUTF8Length(const char *data, std::size_t length);
+
 } // namespace wxm
 
 #endif
@@ -0,0 +1,76 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class TextExtentCache that remembers the sizes of
+  texts that have been measured by a wxDC.
+*/
+
+#include "TextExtentCache.h"
+#include <wx/hashmap.h>
+
+TextExtentCache &TextExtentCache::Get() {
+  static TextExtentCache cache(65536);
+  return cache;
+}
+
+std::size_t TextExtentCache::KeyHash::operator()(const Key &key) const {
+  return wxStringHash()(key.text) ^ (key.fontId * std::size_t(0x9E3779B9));
+}
+
+std::uint32_t TextExtentCache::GetFontId(const FontKey &font) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto const id = m_fontIds.find(font);
+  if (id != m_fontIds.end())
+    return id->second;
+  return m_fontIds[font] = m_nextFontId++;
+}
+
+bool TextExtentCache::Find(std::uint32_t fontId, const wxString &text,
+                           wxSize &size) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto const entry = m_entries.find(Key{fontId, text});
+  if (entry == m_entries.end())
+    return false;
+  m_ages.splice(m_ages.begin(), m_ages, entry->second.age);
+  size = entry->second.size;
+  return true;
+}
+
+void TextExtentCache::Add(std::uint32_t fontId, const wxString &text,
+                          wxSize size) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto const inserted = m_entries.emplace(Key{fontId, text}, Value());
+  Value &value = inserted.first->second;
+  value.size = size;
+  if (!inserted.second) {
+    m_ages.splice(m_ages.begin(), m_ages, value.age);
+    return;
+  }
+  m_ages.push_front(&inserted.first->first);
+  value.age = m_ages.begin();
+
+  if (m_entries.size() > m_capacity) {
+    auto const oldest = m_entries.find(*m_ages.back());
+    m_ages.pop_back();
+    m_entries.erase(oldest);
+  }
+}
@@ -0,0 +1,109 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class TextExtentCache that remembers the sizes of
+  texts that have been measured by a wxDC.
+*/
+
+#ifndef TEXTEXTENTCACHE_H
+#define TEXTEXTENTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <wx/gdicmn.h>
+#include <wx/string.h>
+#include "FontAttribs.h"
+
+/*! A process-wide cache of the sizes of texts, by font
+
+  TextMetrics measures most texts by adding up the widths of their glyphs.
+  Texts in scripts whose glyphs change shape depending on their neighbours
+  need to be measured by wxDC::GetTextExtent() instead, which is slow and only
+  the GUI thread may call. This cache remembers the results, for all windows
+  at once, and lets every thread look them up.
+
+  The cache holds at most a fixed number of texts. If it is full the text
+  that has been looked up least recently is dropped.
+*/
+class TextExtentCache
+{
+public:
+  /*! Everything that determines the size a text is displayed at
+
+    The face name, family, weight, style and scaled size of a font and the
+    horizontal resolution of the device it is displayed on.
+  */
+  using FontKey = std::tuple<wxString, int, int, int, AFontSize, int>;
+
+  //! A cache of its own that holds at most capacity texts. wxMaxima uses Get().
+  explicit TextExtentCache(std::size_t capacity) : m_capacity(capacity) {}
+  //! The cache all windows share
+  static TextExtentCache &Get();
+
+  //! A number that identifies a font in all windows
+  std::uint32_t GetFontId(const FontKey &font);
+
+  /*! Looks up the size of a text
+
+    \return false, if the text isn't in the cache
+  */
+  bool Find(std::uint32_t fontId, const wxString &text, wxSize &size);
+  //! Remembers the size of a text
+  void Add(std::uint32_t fontId, const wxString &text, wxSize size);
+
+private:
+  struct Key
+  {
+    std::uint32_t fontId;
+    wxString text;
+    bool operator==(const Key &other) const
+      { return (fontId == other.fontId) && (text == other.text); }
+  };
+  struct KeyHash
+  {
+    std::size_t operator()(const Key &key) const;
+  };
+  struct Value
+  {
+    wxSize size;
+    //! Our place in m_ages
+    std::list<const Key *>::iterator age;
+  };
+
+  //! The maximum number of texts
+  std::size_t m_capacity;
+  //! Guards all other members
+  std::mutex m_lock;
+  std::unordered_map<Key, Value, KeyHash> m_entries;
+  //! The keys of m_entries, the most recently used one first
+  std::list<const Key *> m_ages;
+  std::map<FontKey, std::uint32_t> m_fontIds;
+  //! The font id GetFontId() will assign next
+  std::uint32_t m_nextFontId = 0;
+};
+
+#endif // TEXTEXTENTCACHE_H
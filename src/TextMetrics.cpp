@@ -0,0 +1,226 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class TextMetrics that measures text without needing
+  a wxDC.
+*/
+
+#include "TextMetrics.h"
+#include "Configuration.h"
+#include "Trace.h"
+#include <cmath>
+
+TextMetrics::TextMetrics(Configuration *config) : m_configuration(config) {}
+
+bool TextMetrics::IsComplex(wxUniChar ch) {
+  wxUint32 const c = ch.GetValue();
+  if (c < 0x20)
+    return true;
+  if (c < 0x300)
+    return false;
+  return
+    (c <= 0x036F) ||                   // Combining diacritical marks
+    ((c >= 0x0483) && (c <= 0x0489)) || // Cyrillic combining marks
+    ((c >= 0x0591) && (c <= 0x05C7)) || // Hebrew points
+    ((c >= 0x0600) && (c <= 0x08FF)) || // Arabic, Syriac, Thaana, ...
+    ((c >= 0x0900) && (c <= 0x109F)) || // Indic scripts, Thai, Tibetan, Myanmar
+    ((c >= 0x1100) && (c <= 0x11FF)) || // Hangul Jamo
+    ((c >= 0x1780) && (c <= 0x17FF)) || // Khmer
+    ((c >= 0x1AB0) && (c <= 0x1AFF)) || // Combining marks
+    ((c >= 0x1DC0) && (c <= 0x1DFF)) || // Combining marks
+    ((c >= 0x200B) && (c <= 0x200F)) || // Zero-width chars and direction marks
+    ((c >= 0x202A) && (c <= 0x202E)) || // Bidirectional embeddings
+    ((c >= 0x20D0) && (c <= 0x20FF)) || // Combining marks for symbols
+    ((c >= 0xD800) && (c <= 0xDFFF)) || // Surrogates
+    ((c >= 0xFE00) && (c <= 0xFE0F)) || // Variation selectors
+    ((c >= 0xFE20) && (c <= 0xFE2F)) || // Combining half marks
+    (c > 0xFFFF);
+}
+
+const TextMetrics::Glyph *TextMetrics::GlyphTable::Find(wxUint32 ch) const {
+  const Glyph *glyph = const_cast<GlyphTable *>(this)->Slot(ch);
+  if (!glyph) {
+    auto const other = others.find(ch);
+    if (other == others.end())
+      return nullptr;
+    glyph = &other->second;
+  }
+  return (glyph->advance < 0) ? nullptr : glyph;
+}
+
+TextMetrics::Result TextMetrics::GetTextSize(TextStyle style,
+                                             AFontSize fontSize,
+                                             const wxString &text,
+                                             wxSize &size) {
+  Key const key(style, fontSize);
+  auto const table = m_tables.find(key);
+  if (table == m_tables.end()) {
+    std::lock_guard<std::mutex> lock(m_missingLock);
+    m_missing[key];
+    return missing;
+  }
+
+  float width = 0;
+  int height = 0;
+  for (auto const &ch : text) {
+    const Glyph *glyph = table->second->Find(ch.GetValue());
+    if (!glyph) {
+      if (IsComplex(ch)) {
+        if (TextExtentCache::Get().Find(table->second->fontId, text, size))
+          return measured;
+        std::lock_guard<std::mutex> lock(m_missingLock);
+        m_missing[key].texts.insert(text);
+        return missing;
+      }
+      std::lock_guard<std::mutex> lock(m_missingLock);
+      m_missing[key].glyphs.insert(ch.GetValue());
+      return missing;
+    }
+    width += glyph->advance;
+    height = wxMax(height, glyph->height);
+  }
+  size = wxSize(static_cast<int>(std::lround(width)), height);
+  return measured;
+}
+
+wxSize TextMetrics::GetTextSize(wxDC *dc, TextStyle style, AFontSize fontSize,
+                                const wxString &text) {
+  Key const key(style, fontSize);
+  GlyphTable &table = GetTable(dc, key);
+
+  float width = 0;
+  int height = 0;
+  for (auto const &ch : text) {
+    wxUint32 const c = ch.GetValue();
+    const Glyph *glyph = table.Slot(c);
+    if (!glyph || (glyph->advance < 0)) {
+      glyph = table.Find(c);
+      if (!glyph) {
+        if (IsComplex(ch)) {
+          wxSize size;
+          if (TextExtentCache::Get().Find(table.fontId, text, size))
+            return size;
+          SetFont(dc, key);
+          return AddText(dc, table, text);
+        }
+        SetFont(dc, key);
+        glyph = &AddGlyph(dc, table, c);
+      }
+    }
+    width += glyph->advance;
+    height = wxMax(height, glyph->height);
+  }
+  return wxSize(static_cast<int>(std::lround(width)), height);
+}
+
+void TextMetrics::SetFont(wxDC *dc, const Key &key) const {
+  const wxFont &font = m_configuration->GetStyle(key.first)->GetFont(key.second);
+  if (!dc->GetFont().IsSameAs(font))
+    dc->SetFont(font);
+}
+
+TextMetrics::Glyph TextMetrics::MeasureGlyph(wxDC *dc, wxUniChar ch) {
+  // The advance of a single glyph isn't a whole number of pixels: Measuring a
+  // run of them tells us the fraction, as well.
+  constexpr int run = 8;
+  Glyph glyph;
+  glyph.height = dc->GetTextExtent(wxString(ch)).GetHeight();
+  glyph.advance =
+    static_cast<float>(dc->GetTextExtent(wxString(ch, run)).GetWidth()) / run;
+  return glyph;
+}
+
+const TextMetrics::Glyph &TextMetrics::AddGlyph(wxDC *dc, GlyphTable &table,
+                                                wxUint32 ch) {
+  Glyph *slot = table.Slot(ch);
+  if (!slot)
+    slot = &table.others[ch];
+  *slot = MeasureGlyph(dc, wxUniChar(ch));
+  return *slot;
+}
+
+wxSize TextMetrics::AddText(wxDC *dc, const GlyphTable &table,
+                            const wxString &text) {
+  wxSize const size = dc->GetTextExtent(text);
+  TextExtentCache::Get().Add(table.fontId, text, size);
+  return size;
+}
+
+TextMetrics::GlyphTable &TextMetrics::GetTable(wxDC *dc, const Key &key) {
+  auto const existing = m_tables.find(key);
+  if (existing != m_tables.end())
+    return *existing->second;
+
+  // Each zoom factor needs tables of its own. Tables for zoom factors that
+  // are no more in use aren't worth keeping forever.
+  if (m_fontTables.size() >= 256) {
+    m_tables.clear();
+    m_fontTables.clear();
+  }
+
+  const wxFont &font = m_configuration->GetStyle(key.first)->GetFont(key.second);
+  TextExtentCache::FontKey const fontKey(font.GetFaceName(), font.GetFamily(),
+                                         font.GetWeight(), font.GetStyle(),
+                                         Style::GetFontSize(font),
+                                         dc->GetPPI().x);
+  auto &table = m_fontTables[fontKey];
+  if (!table) {
+    WXM_TRACE_ZONE("TextMetrics::GetTable");
+    table = std::make_unique<GlyphTable>();
+    table->fontId = TextExtentCache::Get().GetFontId(fontKey);
+    // Most text is ASCII, which is worth measuring all at once.
+    SetFont(dc, key);
+    for (wxUint32 ch = 0x20; ch < 0x7F; ch++)
+      table->latin[ch] = MeasureGlyph(dc, wxUniChar(ch));
+  }
+  m_tables[key] = table.get();
+  return *table;
+}
+
+bool TextMetrics::AddMissingGlyphs(wxDC *dc) {
+  std::map<Key, Missing> missing;
+  {
+    std::lock_guard<std::mutex> lock(m_missingLock);
+    missing.swap(m_missing);
+  }
+  if (missing.empty() || !dc)
+    return false;
+
+  WXM_TRACE_ZONE("TextMetrics::AddMissingGlyphs");
+  for (auto const &font : missing) {
+    GlyphTable &table = GetTable(dc, font.first);
+    SetFont(dc, font.first);
+    for (auto const ch : font.second.glyphs)
+      if (!table.Find(ch))
+        AddGlyph(dc, table, ch);
+    for (auto const &text : font.second.texts)
+      AddText(dc, table, text);
+  }
+  return true;
+}
+
+void TextMetrics::Clear() {
+  m_tables.clear();
+  m_fontTables.clear();
+  std::lock_guard<std::mutex> lock(m_missingLock);
+  m_missing.clear();
+}
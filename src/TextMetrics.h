@@ -0,0 +1,189 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class TextMetrics that measures text without needing
+  a wxDC.
+*/
+
+#ifndef TEXTMETRICS_H
+#define TEXTMETRICS_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <wx/dc.h>
+#include <wx/string.h>
+#include "FontAttribs.h"
+#include "TextExtentCache.h"
+#include "TextStyle.h"
+
+class Configuration;
+
+/*! Measures text using tables of the advance widths of the glyphs of a font
+
+  wxDC::GetTextExtent() is slow, may only be called by the GUI thread, and
+  only on the one wxDC Configuration::GetRecalcDC() knows about. This class
+  keeps a table of the advance widths of the glyphs of each font (face,
+  weight, style and size) which is filled using this DC, one glyph at a time
+  when it is first needed. Measuring a text then is a loop that adds up the
+  widths of its characters. Once a table is filled any thread can measure text
+  with it, which allows to lay out GroupCells in parallel, see LayoutPool.
+
+  The width of a text is the sum of the advance widths of its characters,
+  which ignores kerning. Characters that are shaped together with their
+  neighbours (combining marks, scripts like arabic or devanagari, characters
+  outside the basic multilingual plane) cannot be measured this way: The GUI
+  thread measures texts containing them with the wxDC, instead, and keeps the
+  result in the TextExtentCache.
+
+  Thread safety: The GetTextSize() that doesn't take a wxDC may be called from
+  any number of threads at once. All other functions may only be called by
+  the GUI thread while no other thread measures text.
+*/
+class TextMetrics
+{
+public:
+  explicit TextMetrics(Configuration *config);
+  TextMetrics(const TextMetrics &) = delete;
+  TextMetrics &operator=(const TextMetrics &) = delete;
+
+  //! The result of GetTextSize()
+  enum Result
+  {
+    measured, //!< The size has been determined
+    missing   //!< A glyph or text hasn't been measured yet. AddMissingGlyphs() will do so.
+  };
+
+  /*! Determines the size of a text without using a wxDC
+
+    \param style The text style the text is displayed in
+    \param fontSize The scaled font size, see Cell::Scale_Px()
+    \param text The text to measure
+    \param size Receives the size of the text, if it could be measured
+  */
+  Result GetTextSize(TextStyle style, AFontSize fontSize, const wxString &text,
+                     wxSize &size);
+
+  /*! Determines the size of a text, measuring glyphs that are new to us
+
+    \param dc The wxDC that is used for measuring new glyphs and texts that
+    contain complex characters. Its font may be changed.
+    \param style The text style the text is displayed in
+    \param fontSize The scaled font size, see Cell::Scale_Px()
+    \param text The text to measure
+  */
+  wxSize GetTextSize(wxDC *dc, TextStyle style, AFontSize fontSize,
+                     const wxString &text);
+
+  /*! Measures all glyphs and texts the GetTextSize() without a wxDC didn't find
+
+    \return true, if there were missing glyphs or texts
+  */
+  bool AddMissingGlyphs(wxDC *dc);
+
+  //! Forget all glyph tables, for example because a font has changed
+  void Clear();
+
+  //! True if the character can only be measured together with its neighbours
+  static bool IsComplex(wxUniChar ch);
+
+private:
+  //! The width and height of a glyph, in pixels
+  struct Glyph
+  {
+    //! The advance width; less than 0 = not measured, yet
+    float advance = -1;
+    int height = 0;
+  };
+
+  /*! The glyphs of one font
+
+    The glyphs of the blocks most text and maths are made of are kept in
+    arrays, all other glyphs in a hash map.
+  */
+  struct GlyphTable
+  {
+    //! Latin-1
+    Glyph latin[0x100];
+    //! Greek, from U+0370
+    Glyph greek[0x90];
+    //! Punctuation, super- and subscripts, letterlike symbols, arrows and
+    //! mathematical operators, from U+2000
+    Glyph symbols[0x400];
+    //! All other glyphs that have been measured
+    std::unordered_map<wxUint32, Glyph> others;
+    //! The font's id in the TextExtentCache
+    std::uint32_t fontId = 0;
+
+    //! The array element for a glyph, or nullptr if it lives in others
+    Glyph *Slot(wxUint32 ch)
+      {
+        if (ch < 0x100)
+          return &latin[ch];
+        if (ch - 0x370 < 0x90)
+          return &greek[ch - 0x370];
+        if (ch - 0x2000 < 0x400)
+          return &symbols[ch - 0x2000];
+        return nullptr;
+      }
+    //! The glyph, if it has been measured, or nullptr
+    const Glyph *Find(wxUint32 ch) const;
+  };
+
+  using Key = std::pair<TextStyle, AFontSize>;
+
+  //! What GetTextSize() couldn't measure, for one font
+  struct Missing
+  {
+    //! The glyphs that aren't in the table
+    std::set<wxUint32> glyphs;
+    //! The texts with complex characters that aren't in the TextExtentCache
+    std::set<wxString> texts;
+  };
+
+  //! Sets the font of a style at a size, if it isn't set, already
+  void SetFont(wxDC *dc, const Key &key) const;
+  //! Determines the size of a glyph, using the font the dc is set to
+  static Glyph MeasureGlyph(wxDC *dc, wxUniChar ch);
+  //! Measures a glyph and adds it to the table
+  const Glyph &AddGlyph(wxDC *dc, GlyphTable &table, wxUint32 ch);
+  //! Measures a text with complex characters and adds it to the TextExtentCache
+  wxSize AddText(wxDC *dc, const GlyphTable &table, const wxString &text);
+  //! Returns the table for a font, creating it if necessary
+  GlyphTable &GetTable(wxDC *dc, const Key &key);
+
+  Configuration *m_configuration;
+  //! The table each text style and size uses
+  std::map<Key, GlyphTable *> m_tables;
+  //! The tables, by the font they describe. Text styles often share a font.
+  std::map<TextExtentCache::FontKey, std::unique_ptr<GlyphTable>> m_fontTables;
+  //! Guards m_missing
+  std::mutex m_missingLock;
+  //! What GetTextSize() has missed, by style and size. An entry without
+  //! glyphs and texts means that the whole table is missing.
+  std::map<Key, Missing> m_missing;
+};
+
+#endif // TEXTMETRICS_H
@@ -0,0 +1,140 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the tracing facility that records how long parts of
+  wxMaxima took.
+*/
+
+#include "Trace.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <wx/intl.h>
+#include <wx/log.h>
+#include <wx/thread.h>
+#include <wx/txtstrm.h>
+#include <wx/wfstream.h>
+
+namespace {
+//! A zone that has been recorded
+struct Zone
+{
+  const char *name;
+  Trace::Clock::time_point start;
+  Trace::Clock::time_point end;
+};
+
+//! The zones one thread has recorded
+struct ThreadBuffer
+{
+  explicit ThreadBuffer(long threadId, bool mainThread)
+    : id(threadId), isMainThread(mainThread) {}
+  //! The number of zones one thread remembers
+  static constexpr std::size_t size = 16384;
+  std::array<Zone, size> zones;
+  //! The number of zones that have been recorded, including overwritten ones
+  std::atomic<std::size_t> count{0};
+  long id;
+  bool isMainThread;
+};
+
+//! Guards buffers, filename and traceStart
+std::mutex traceMutex;
+//! The buffers of all threads that have recorded zones. Outlives the threads.
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+wxString traceFilename;
+Trace::Clock::time_point traceStart;
+//! The buffer of the current thread, if it already has one
+thread_local ThreadBuffer *threadBuffer = nullptr;
+
+ThreadBuffer *GetThreadBuffer() {
+  if (!threadBuffer) {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    buffers.emplace_back(new ThreadBuffer(static_cast<long>(buffers.size()) + 1,
+                                          wxThread::IsMain()));
+    threadBuffer = buffers.back().get();
+  }
+  return threadBuffer;
+}
+} // namespace
+
+std::atomic<bool> Trace::m_enabled{false};
+
+void Trace::Start(const wxString &filename) {
+  std::lock_guard<std::mutex> lock(traceMutex);
+  traceFilename = filename;
+  traceStart = Clock::now();
+  m_enabled = true;
+}
+
+void Trace::AddZone(const char *name, Clock::time_point start, Clock::time_point end) {
+  ThreadBuffer *buffer = GetThreadBuffer();
+  // Only this thread ever writes to the buffer => no lock is needed.
+  std::size_t const count = buffer->count.load(std::memory_order_relaxed);
+  buffer->zones[count % ThreadBuffer::size] = {name, start, end};
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+bool Trace::Write() {
+  if (!m_enabled.exchange(false))
+    return false;
+  std::lock_guard<std::mutex> lock(traceMutex);
+  wxFileOutputStream output(traceFilename);
+  if (!output.IsOk()) {
+    wxLogMessage(_("Cannot write the trace to %s"), traceFilename);
+    return false;
+  }
+  wxTextOutputStream text(output);
+  auto const microseconds = [](Clock::duration duration) {
+    return static_cast<long long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+  };
+
+  text << wxS("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  for (auto const &buffer : buffers) {
+    if (!first)
+      text << wxS(",\n");
+    first = false;
+    text << wxString::Format(
+      wxS("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%li,"
+          "\"args\":{\"name\":\"%s\"}}"),
+      buffer->id,
+      buffer->isMainThread ? wxString(wxS("GUI")) : wxString::Format(wxS("Worker %li"), buffer->id));
+    std::size_t const count = buffer->count.load(std::memory_order_acquire);
+    std::size_t const begin = (count > ThreadBuffer::size) ? count - ThreadBuffer::size : 0;
+    for (std::size_t i = begin; i < count; i++) {
+      const Zone &zone = buffer->zones[i % ThreadBuffer::size];
+      if (zone.start < traceStart)
+        continue;
+      text << wxString::Format(
+        wxS(",\n{\"name\":\"%s\",\"cat\":\"wxMaxima\",\"ph\":\"X\",\"ts\":%lld,"
+            "\"dur\":%lld,\"pid\":1,\"tid\":%li}"),
+        wxString::FromUTF8(zone.name), microseconds(zone.start - traceStart),
+        microseconds(zone.end - zone.start), buffer->id);
+    }
+  }
+  text << wxS("]}\n");
+  text.Flush();
+  return output.Close();
+}
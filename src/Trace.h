@@ -0,0 +1,99 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the tracing facility that records how long parts of
+  wxMaxima took.
+
+  A trace is recorded only if wxMaxima has been started with the --trace
+  command-line option. If wxMaxima has been compiled with WXM_ENABLE_TRACING
+  switched off WXM_TRACE_ZONE() expands to nothing.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Version.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <wx/string.h>
+
+/*! Records scoped zones and writes them to a file in Chrome's trace event format
+
+  Each thread writes its zones to a ring buffer of its own, which means that
+  recording a zone needs no lock. If a thread records more zones than its
+  buffer can hold the oldest ones are overwritten. The trace can be opened in
+  https://ui.perfetto.dev or chrome://tracing.
+*/
+class Trace
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  //! Starts recording; the trace will be written to filename
+  static void Start(const wxString &filename);
+  //! Is a trace being recorded?
+  static bool IsEnabled() { return m_enabled.load(std::memory_order_relaxed); }
+  //! Stops recording and writes the trace to the file
+  static bool Write();
+
+  //! Records a zone. name needs to be a string literal.
+  static void AddZone(const char *name, Clock::time_point start, Clock::time_point end);
+
+private:
+  static std::atomic<bool> m_enabled;
+};
+
+//! Records the time between its creation and its destruction as a zone
+class TraceZone
+{
+public:
+  explicit TraceZone(const char *name)
+    : m_name(Trace::IsEnabled() ? name : nullptr)
+    {
+      if (m_name)
+        m_start = Trace::Clock::now();
+    }
+  ~TraceZone()
+    {
+      if (m_name)
+        Trace::AddZone(m_name, m_start, Trace::Clock::now());
+    }
+  TraceZone(const TraceZone &) = delete;
+  TraceZone &operator=(const TraceZone &) = delete;
+
+private:
+  //! The name of the zone, or nullptr, if no trace is recorded
+  const char *m_name;
+  Trace::Clock::time_point m_start;
+};
+
+#define WXM_TRACE_CONCAT_(a, b) a##b
+#define WXM_TRACE_CONCAT(a, b) WXM_TRACE_CONCAT_(a, b)
+#ifdef USE_TRACING
+//! Records the time until the end of the current scope under the name name
+#define WXM_TRACE_ZONE(name) TraceZone WXM_TRACE_CONCAT(traceZone_, __LINE__)(name)
+#else
+#define WXM_TRACE_ZONE(name)
+#endif
+
+#endif // TRACE_H
@@ -33,21 +33,25 @@
 #include "Worksheet.h"
 #include "AnimationCell.h"
 #include "BitmapOut.h"
+#include "CellDependencies.h"
 #include "CellList.h"
 #include "CompositeDataObject.h"
 #include "EMFout.h"
 #include "ErrorRedirector.h"
 #include "ImgCell.h"
+#include "LazyMathCell.h"
 #include "MarkDown.h"
 #include "MaxSizeChooser.h"
 #include "ResolutionChooser.h"
 #include "SVGout.h"
+#include "Trace.h"
 #include "Version.h"
 #include "WXMformat.h"
 #include "levenshtein/levenshtein.h"
 #include "wxMaxima.h"
 #include "wxMaximaFrame.h"
 #include <algorithm>
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <utility>
@@ -123,7 +127,6 @@ Worksheet::Worksheet(wxWindow *parent, int id,
   m_scrollToTopOfCell = false;
   m_pointer_x = -1;
   m_pointer_y = -1;
-  m_recalculateStart = NULL;
   m_mouseMotionWas = false;
   m_configuration->SetWorkSheet(this);
   m_configuration->ReadConfig();
@@ -142,8 +145,8 @@ Worksheet::Worksheet(wxWindow *parent, int id,
   m_hCaretBlinkVisible = true;
   m_hasFocus = true;
   m_windowActive = true;
-  m_lastTop = 0;
-  m_lastBottom = 0;
+  m_imageCacheTop = 0;
+  m_imageCacheBottom = -1;
   m_followEvaluation = true;
   TreeUndo_ActiveCell = NULL;
   m_questionPrompt = false;
@@ -296,13 +299,10 @@ bool Worksheet::RedrawIfRequested() {
         m_cellPointers.m_groupCellUnderPointer;
 
       // find out which group cell lies under the pointer
-      for (auto &tmp : OnList(GetTree())) {
-        auto rect = tmp.GetRect();
-        if (m_pointer_y <= rect.GetBottom()) {
-          GetTree()->CellUnderPointer(&tmp);
-          break;
-        }
-      }
+      GroupCell *underPointer =
+        GetHeightIndex().FirstCellEndingBelow(m_pointer_y - 1);
+      if (underPointer)
+        GetTree()->CellUnderPointer(underPointer);
 
       // Make the right brackets autohide
       if ((m_configuration->HideBrackets()) &&
@@ -469,6 +469,7 @@ Worksheet::~Worksheet() {
 #endif
 
 void Worksheet::OnPaint(wxPaintEvent &WXUNUSED(event)) {
+  WXM_TRACE_ZONE("Worksheet::OnPaint");
   m_configuration->ClearAndEnableRedrawTracing();
   m_configuration->SetBackgroundBrush(*(wxTheBrushList->FindOrCreateBrush(
                                                                           m_configuration->DefaultBackgroundColor(), wxBRUSHSTYLE_SOLID)));
@@ -503,6 +504,8 @@ void Worksheet::OnPaint(wxPaintEvent &WXUNUSED(event)) {
   // one for drawing text as on MS Windows it doesn't support all fonts
   dc.SetMapMode(wxMM_TEXT);
 
+  ClearFarAwayImageCaches();
+
   // Now iterate over all single parts of the region we need to redraw and
   // redraw the worksheet
   wxRegionIterator region(GetUpdateRegion());
@@ -552,34 +555,16 @@ void Worksheet::OnPaint(wxPaintEvent &WXUNUSED(event)) {
     // Draw the cell contents
     //
     if (GetTree()) {
-      wxPoint point;
-      point.x = m_configuration->GetIndent();
-      point.y = m_configuration->GetBaseIndent() + GetTree()->GetCenterList();
       dc.SetPen(*(wxThePenList->FindOrCreatePen(
                                                 m_configuration->GetColor(TS_MATH), 1, wxPENSTYLE_SOLID)));
       dc.SetBrush(*(wxTheBrushList->FindOrCreateBrush(
                                                       m_configuration->GetColor(TS_MATH))));
-      bool atStart = true;
-      for (auto &cell : OnList(GetTree())) {
-        if (!atStart) {
-          cell.UpdateYPosition();
-          point = cell.GetCurrentPoint();
-        }
-        atStart = false;
-
-        wxRect cellRect = cell.GetRect();
-
-        // Clear the image cache of all cells above or below the viewport.
-        if (cellRect.GetTop() >= bottom || cellRect.GetBottom() <= top) {
-          // Only actually clear the image cache if there is a screen's height
-          // between us and the image's position: Else the chance is too high
-          // that we will very soon have to generated a scaled image again.
-          if ((cellRect.GetBottom() <= m_lastBottom - 2 * height) ||
-              (cellRect.GetTop() >= m_lastTop + 2 * height)) {
-            if (cell.GetOutput())
-              cell.GetOutput()->ClearCacheList();
-          }
-        }
+      // Only look at the cells that intersect the region we draw
+      HeightIndex &index = GetHeightIndex();
+      for (std::size_t slot = index.FindSlot(top);
+           (slot < index.Size()) && (index.GetTop(slot) <= bottom); slot++) {
+        GroupCell &cell = *index.GetCell(slot);
+        cell.UpdateYPosition();
         //      m_drawThreads.push_back(std::thread(&Worksheet::DrawGroupCell_UsingBitmap,
         //                                  this,
         //                                  &dc, &cell, unscrolledRect));
@@ -633,8 +618,6 @@ void Worksheet::OnPaint(wxPaintEvent &WXUNUSED(event)) {
       }
     }
 
-    m_lastTop = top;
-    m_lastBottom = bottom;
     for(auto &i:m_drawThreads)
       if(i.joinable())
         i.join();
@@ -644,6 +627,49 @@ void Worksheet::OnPaint(wxPaintEvent &WXUNUSED(event)) {
   m_configuration->ReportMultipleRedraws();
 }
 
+void Worksheet::ClearFarAwayImageCaches() {
+  if (!GetTree())
+    return;
+  int width;
+  int height;
+  GetClientSize(&width, &height);
+  int top;
+  CalcUnscrolledPosition(0, 0, NULL, &top);
+  int const bottom = top + height;
+
+  // Only the cells we have drawn since the last time we cleared the caches
+  // can have cached scaled images. We only clear the image cache of the ones
+  // that are more than a screen's height away from the visible area: Else the
+  // chance is too high that we will very soon have to generate a scaled image
+  // again.
+  if (m_imageCacheBottom >= m_imageCacheTop) {
+    HeightIndex &index = GetHeightIndex();
+    for (std::size_t slot = index.FindSlot(m_imageCacheTop);
+         (slot < index.Size()) && (index.GetTop(slot) <= m_imageCacheBottom);
+         slot++) {
+      if ((index.GetBottom(slot) <= top - 2 * height) ||
+          (index.GetTop(slot) >= bottom + 2 * height)) {
+        GroupCell *cell = index.GetCell(slot);
+        if (cell->GetOutput())
+          cell->GetOutput()->ClearCacheList();
+      }
+    }
+    m_imageCacheTop = wxMin(top, wxMax(m_imageCacheTop, top - 2 * height));
+    m_imageCacheBottom = wxMax(bottom, wxMin(m_imageCacheBottom, bottom + 2 * height));
+  } else {
+    m_imageCacheTop = top;
+    m_imageCacheBottom = bottom;
+  }
+}
+
+HeightIndex &Worksheet::GetHeightIndex() {
+  // If GroupCells have been added they need to be recalculated
+  if (m_heightIndex.Sync(GetTree(), m_configuration->GetBaseIndent(),
+                         m_configuration->GetGroupSkip()))
+    m_recalculateAll = true;
+  return m_heightIndex;
+}
+
 void Worksheet::PrepareDrawGC(wxDC &dc)
 {
   dc.SetMapMode(wxMM_TEXT);
@@ -877,6 +903,11 @@ GroupCell *Worksheet::GetWorkingGroup(bool resortToLast) const {
 }
 
 GroupCell *Worksheet::GetInsertGroup() const {
+  // Output from a cell that has been deleted while maxima was evaluating it
+  // must not end up in another cell.
+  if (m_evaluationQueue.DiscardsOutput())
+    return NULL;
+
   GroupCell *cell = GetWorkingGroup(true);
 
   if (!cell && GetActiveCell())
@@ -895,6 +926,8 @@ void Worksheet::InsertLine(std::unique_ptr<Cell> &&newCell, bool forceNewLine) {
 
   newCell->ForceBreakLine(forceNewLine);
   cell->AppendOutput(std::move(newCell));
+  if (cell->GetEvaluationTimes())
+    cell->GetEvaluationTimes()->Parsed();
 
   Recalculate(cell);
   OutputChanged();
@@ -936,13 +969,7 @@ void Worksheet::SetZoomFactor(double newzoom, bool recalc) {
   if (!cellToScrollTo) {
     wxPoint topleft;
     CalcUnscrolledPosition(0, 0, &topleft.x, &topleft.y);
-    cellToScrollTo = GetTree();
-    while (cellToScrollTo != NULL) {
-      wxRect rect = cellToScrollTo->GetRect();
-      if (rect.GetBottom() > topleft.y)
-        break;
-      cellToScrollTo = cellToScrollTo->GetNext();
-    }
+    cellToScrollTo = GetHeightIndex().FirstCellEndingBelow(topleft.y);
   }
   if (recalc) {
     RecalculateForce();
@@ -952,73 +979,169 @@ void Worksheet::SetZoomFactor(double newzoom, bool recalc) {
 }
 
 bool Worksheet::RecalculateIfNeeded(bool timeout) {
+  WXM_TRACE_ZONE("Worksheet::RecalculateIfNeeded");
   if (m_configuration->GetCanvasSize().x < 1)
     return (false);
   if (m_configuration->GetCanvasSize().y < 1)
     return (false);
 
-  if (!m_recalculateStart || !GetTree()) {
-    m_recalculateStart = {};
+  UpdateLazyCells();
+
+  if (!GetTree()) {
+    m_cellsToRecalculate.clear();
+    m_recalculateAll = false;
     return false;
   }
 
-  if (!GetTree()->Contains(m_recalculateStart))
-    m_recalculateStart = GetTree();
-
-  int width;
-  int height;
-  GetClientSize(&width, &height);
+  HeightIndex &index = GetHeightIndex();
+  bool const searchedAll = m_recalculateAll;
+  if (m_recalculateAll) {
+    m_recalculateAll = false;
+    for (auto &cell : OnList(GetTree()))
+      if (cell.NeedsRecalculation())
+        m_cellsToRecalculate.emplace_back(&cell);
+  }
+  if (m_cellsToRecalculate.empty() && !searchedAll)
+    return false;
 
-  wxPoint upperLeftScreenCorner;
-  CalcScrolledPosition(0, 0, &upperLeftScreenCorner.x,
-                       &upperLeftScreenCorner.y);
+  auto const recalculationStart = std::chrono::steady_clock::now();
   m_configuration->SetWorksheetPosition(GetPosition());
 
-  if(timeout)
-    {
-      wxStopWatch stopwatch;
-      bool recalculated = false;
-      bool stopwatchStarted = false;
-      for (auto &cell : OnList(m_recalculateStart)) {
-        recalculated |= cell.Recalculate();
-        if((cell.GetRect().GetTop() > m_configuration->GetVisibleRegion().GetBottom()) &&
-           recalculated)
-          {
-            if(!stopwatchStarted)
-              stopwatch.Start();
-          }
-        if(cell.GetNext() != NULL)
-          m_recalculateStart = cell.GetNext();
-        else
-          {
-            wxLogMessage(_("Recalculation hit the end of the worksheet => Updating its size"));
-            m_recalculateStart = {};
-            UpdateMLast(&cell);
-            AdjustSize();
-          }
-        if(stopwatch.Time() > 50)
-          break;
-      }
-    }
-  else
-    {
-      for (auto &cell : OnList(m_recalculateStart)) {
-        m_adjustWorksheetSizeNeeded |= cell.Recalculate();
-        if(cell.GetNext() == NULL)
-          {
-            wxLogMessage(_("Recalculated the whole worksheet at once => Updating its size"));
+  // Cells that have been deleted or moved to the undo buffer don't need to be
+  // laid out.
+  std::vector<std::size_t> slots;
+  for (auto const &cell : m_cellsToRecalculate)
+    if (index.Contains(cell.get()))
+      slots.push_back(index.GetSlot(cell.get()));
+  m_cellsToRecalculate.clear();
+  std::sort(slots.begin(), slots.end());
+  slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+  // Lay out the visible cells first
+  wxRect const visibleRegion = m_configuration->GetVisibleRegion();
+  auto const firstInvisible =
+    std::stable_partition(slots.begin(), slots.end(), [&](std::size_t slot) {
+      return (index.GetTop(slot) <= visibleRegion.GetBottom()) &&
+        (index.GetBottom(slot) >= visibleRegion.GetTop());
+    });
+  std::size_t const visibleCount = firstInvisible - slots.begin();
+
+  wxStopWatch stopwatch;
+  std::size_t firstMoved = index.Size();
+  std::size_t done = 0;
+  // After opening a file, zooming or resizing the window all cells need to be
+  // laid out, which is worth to be done in parallel.
+  if (m_layoutPool.IsWorthIt(slots.size())) {
+    firstMoved = RecalculateInParallel(slots);
+    m_adjustWorksheetSizeNeeded = true;
+    done = slots.size();
+  }
+  while (done < slots.size()) {
+    std::size_t const slot = slots[done++];
+    int const oldHeight = index.GetHeight(slot);
+    m_adjustWorksheetSizeNeeded |= index.GetCell(slot)->Recalculate();
+    if (index.GetHeight(slot) != oldHeight)
+      firstMoved = wxMin(firstMoved, slot);
+    if (timeout && (done >= visibleCount) && (stopwatch.Time() > 50))
+      break;
+  }
+  // The rest of the cells will be laid out the next time we are idle
+  for (std::size_t i = done; i < slots.size(); i++)
+    m_cellsToRecalculate.emplace_back(index.GetCell(slots[i]));
 
-            UpdateMLast(&cell);
-          }
-      }
-      m_recalculateStart = {};
-    }
+  // The cells below a cell that has changed its height or below a cell that
+  // has been inserted needn't be touched: They read their new position from
+  // the index when they are drawn or clicked at.
+  if (searchedAll || (firstMoved < index.Size()))
+    m_adjustWorksheetSizeNeeded = true;
   if (m_adjustWorksheetSizeNeeded)
     AdjustSize();
 
+  m_recalculationTime += std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - recalculationStart).count();
   return true;
 }
 
+std::size_t Worksheet::RecalculateInParallel(const std::vector<std::size_t> &slots) {
+  WXM_TRACE_ZONE("Worksheet::RecalculateInParallel");
+  HeightIndex &index = m_heightIndex;
+  std::vector<std::size_t> recalculated;
+  std::vector<int> oldHeights;
+  std::vector<GroupCell *> cells;
+  // The input and the cell as a whole are laid out by the GUI thread, as
+  // EditorCells need the wxDC. Only the outputs are distributed between
+  // threads.
+  for (auto const slot : slots) {
+    GroupCell *cell = index.GetCell(slot);
+    if (!cell->NeedsRecalculation())
+      continue;
+    recalculated.push_back(slot);
+    oldHeights.push_back(index.GetHeight(slot));
+    if (cell->BeginRecalculation())
+      cells.push_back(cell);
+  }
+
+  TextMetrics &metrics = m_configuration->GetTextMetrics();
+  auto outcomes = m_layoutPool.Layout(cells);
+  metrics.AddMissingGlyphs(m_configuration->GetRecalcDC());
+
+  // Cells that needed glyphs that haven't been measured before will work now
+  std::vector<GroupCell *> retry;
+  for (std::size_t i = 0; i < cells.size(); i++)
+    if (outcomes[i] == LayoutPool::retry) {
+      cells[i]->ResetOutputLayout();
+      retry.push_back(cells[i]);
+    }
+  std::vector<LayoutPool::Outcome> retryOutcomes;
+  if (!retry.empty()) {
+    retryOutcomes = m_layoutPool.Layout(retry);
+    metrics.AddMissingGlyphs(m_configuration->GetRecalcDC());
+  }
+
+  // All other cells are laid out by the GUI thread
+  std::size_t retried = 0;
+  for (std::size_t i = 0; i < cells.size(); i++) {
+    LayoutPool::Outcome outcome = outcomes[i];
+    if (outcome == LayoutPool::retry)
+      outcome = retryOutcomes[retried++];
+    if (outcome == LayoutPool::done)
+      continue;
+    cells[i]->ResetOutputLayout();
+    cells[i]->RecalculateOutput();
+  }
+
+  std::size_t firstMoved = index.Size();
+  for (std::size_t i = 0; i < recalculated.size(); i++) {
+    index.GetCell(recalculated[i])->EndRecalculation();
+    if (index.GetHeight(recalculated[i]) != oldHeights[i])
+      firstMoved = wxMin(firstMoved, recalculated[i]);
+  }
+  // Now that all heights are known the cells can be told their positions
+  for (auto const slot : recalculated)
+    index.GetCell(slot)->UpdateYPosition();
+  return firstMoved;
+}
+
+void Worksheet::UpdateLazyCells() {
+  if (m_cellPointers.m_lazyCellsToUpdate.empty())
+    return;
+  // Updating a cell may request updates of other cells
+  std::vector<CellPtr<LazyMathCell>> cells;
+  cells.swap(m_cellPointers.m_lazyCellsToUpdate);
+  for (auto &cell : cells) {
+    if (!cell)
+      continue;
+    if (!cell->Update())
+      continue;
+    // Cells that have been moved to the undo buffer don't need to be laid out
+    GroupCell *group = cell->GetGroup();
+    if (GetHeightIndex().Contains(group)) {
+      Recalculate(group);
+      RequestRedraw(group);
+    }
+  }
+}
+
 void Worksheet::Recalculate(Cell *start) {
   if (!GetTree())
     return;
@@ -1027,29 +1150,11 @@ void Worksheet::Recalculate(Cell *start) {
     return;
 
   GroupCell *group = start->GetGroup();
-
-  if (m_recalculateStart == group)
-    return;
-
   group->MarkNeedsRecalculate();
 
-  if (!m_recalculateStart)
-    m_recalculateStart = group;
-  else
-    // Move m_recalculateStart backwards to start, if start comes before
-    // m_recalculateStart.
-    for (auto &cell : OnList(GetTree())) {
-      if (&cell == group) {
-        m_recalculateStart = group;
-        return;
-      }
-
-      if (&cell == m_recalculateStart)
-        return;
-    }
-  // If the cells to recalculate neither contain the start nor the tree we
-  // should better recalculate all.
-  m_recalculateStart = GetTree();
+  // Editing a cell calls us once per keypress
+  if (m_cellsToRecalculate.empty() || (m_cellsToRecalculate.back() != group))
+    m_cellsToRecalculate.emplace_back(group);
 }
 
 /***
@@ -1073,34 +1178,14 @@ void Worksheet::OnSize(wxSizeEvent &event) {
   if (!CellToScrollTo) {
     wxPoint topleft;
     CalcUnscrolledPosition(0, 0, &topleft.x, &topleft.y);
-    CellToScrollTo = GetTree();
-    for (; CellToScrollTo; CellToScrollTo = CellToScrollTo->GetNext()) {
-      wxRect rect = CellToScrollTo->GetRect();
-      if (rect.GetBottom() > topleft.y)
-        break;
-    }
+    CellToScrollTo = GetHeightIndex().FirstCellEndingBelow(topleft.y);
   }
+  if (GetTree())
+    ClearSelection();
+  // Lays out all cells at once, which can be done in parallel, and assigns
+  // them their new positions.
   RecalculateForce();
-
-
-  GroupCell *prev = {};
-  for (auto &cell : OnList(GetTree())) {
-    if (!prev)
-      ClearSelection();
-
-    cell.OnSize();
-
-    if (!prev)
-      cell.SetCurrentPoint(m_configuration->GetIndent(),
-                           m_configuration->GetBaseIndent() +
-                           cell.GetCenterList());
-    else
-      cell.SetCurrentPoint(m_configuration->GetIndent(),
-                           prev->GetCurrentPoint().y + prev->GetMaxDrop() +
-                           cell.GetCenterList() +
-                           m_configuration->GetGroupSkip());
-    prev = &cell;
-  }
+  RecalculateIfNeeded();
 
   m_adjustWorksheetSizeNeeded = true;
   RequestRedraw();
@@ -1129,7 +1214,8 @@ void Worksheet::ClearDocument() {
   m_hCaretActive = false;
   SetHCaret(NULL); // horizontal caret at the top of document
   m_hCaretPositionStart = m_hCaretPositionEnd = NULL;
-  m_recalculateStart = NULL;
+  m_cellsToRecalculate.clear();
+  m_recalculateAll = false;
   m_evaluationQueue.Clear();
   TreeUndo_ClearBuffers();
 
@@ -2281,19 +2367,18 @@ void Worksheet::OnMouseLeftDown(wxMouseEvent &event) {
   SetActiveCell(NULL);
 
   wxRect rect;
-  GroupCell *previous = NULL;
+  GroupCell *previous = GetLastCellInWorksheet();
   GroupCell *clickedBeforeGC = NULL;
   GroupCell *clickedInGC = NULL;
-  for (auto &cell : OnList(GetTree())) { // go through all groupcells
-    rect = cell.GetRect();
-    if (m_down.y < rect.GetTop()) {
-      clickedBeforeGC = &cell;
-      break;
-    } else if (m_down.y <= rect.GetBottom()) {
-      clickedInGC = &cell;
-      break;
-    }
-    previous = &cell;
+  GroupCell *cell = GetHeightIndex().FirstCellEndingBelow(m_down.y - 1);
+  if (cell) {
+    cell->UpdateYPosition();
+    previous = cell->GetPrevious();
+    rect = cell->GetRect();
+    if (m_down.y < rect.GetTop())
+      clickedBeforeGC = cell;
+    else
+      clickedInGC = cell;
   }
 
   if (clickedBeforeGC) { // we clicked between groupcells, set hCaret
@@ -2326,13 +2411,7 @@ GroupCell *Worksheet::FirstVisibleGC() {
   wxPoint point;
   CalcUnscrolledPosition(0, 0, &point.x, &point.y);
 
-  for (auto &cell : OnList(GetTree())) { // go through all groupcells
-    wxRect rect = cell.GetRect();
-
-    if (point.y < rect.GetBottom())
-      return &cell;
-  }
-  return {};
+  return GetHeightIndex().FirstCellEndingBelow(point.y);
 }
 
 void Worksheet::OnMouseLeftUp(wxMouseEvent &event) {
@@ -2415,25 +2494,13 @@ void Worksheet::SelectGroupCells(wxPoint down, wxPoint up) {
   int ybottom = wxMax(down.y, up.y);
   m_cellPointers.m_selectionStart = m_cellPointers.m_selectionEnd = nullptr;
 
-  wxRect rect;
-
+  HeightIndex &index = GetHeightIndex();
   // find out the group cell the selection begins in
-  for (auto &cell : OnList(GetTree())) {
-    rect = cell.GetRect();
-    if (ytop <= rect.GetBottom()) {
-      m_cellPointers.m_selectionStart = &cell;
-      break;
-    }
-  }
+  m_cellPointers.m_selectionStart = index.FirstCellEndingBelow(ytop - 1);
 
   // find out the group cell the selection ends in
-  for (auto &cell : OnList(GetTree())) {
-    rect = cell.GetRect();
-    if (ybottom < rect.GetTop()) {
-      m_cellPointers.m_selectionEnd = cell.GetPrevious();
-      break;
-    }
-  }
+  if ((index.Size() > 0) && (index.GetTop(0) <= ybottom))
+    m_cellPointers.m_selectionEnd = index.GetCell(index.FindSlot(ybottom));
   if (!m_cellPointers.m_selectionEnd)
     m_cellPointers.m_selectionEnd = GetLastCellInWorksheet();
 
@@ -3792,22 +3859,21 @@ void Worksheet::OnCharNoActive(wxKeyEvent &event) {
       int width;
       int height;
       CalcUnscrolledPosition(0, 0, &topleft.x, &topleft.y);
-      GroupCell *CellToScrollTo = GetLastCellInWorksheet();
+      GroupCell *CellToScrollTo = {};
 
       GetClientSize(&width, &height);
 
-      // Scroll as many cells as are needed to make sure that
-      // the new cell is the upmost cell that begins on the new page.
-      while (CellToScrollTo) {
-        CellToScrollTo = CellToScrollTo->GetPrevious();
-
-        if (CellToScrollTo &&
-            CellToScrollTo->GetRect().GetTop() < (topleft.y - height))
-          break;
+      // Find the upmost cell that begins on the new page, not counting the
+      // last cell.
+      HeightIndex &index = GetHeightIndex();
+      int const pageTop = topleft.y - height;
+      if ((index.Size() > 1) && (index.GetTop(0) < pageTop)) {
+        std::size_t const slot =
+          wxMin(index.FindSlot(pageTop - 1), index.Size() - 2);
+        // We want to put the cursor in the space above the cell we found.
+        if (slot > 0)
+          CellToScrollTo = index.GetCell(slot - 1);
       }
-      // We want to put the cursor in the space above the cell we found.
-      if (CellToScrollTo)
-        CellToScrollTo = CellToScrollTo->GetPrevious();
 
       ScrolledAwayFromEvaluation();
       SetHCaret(CellToScrollTo);
@@ -3824,21 +3890,18 @@ void Worksheet::OnCharNoActive(wxKeyEvent &event) {
     int width;
     int height;
     CalcUnscrolledPosition(0, 0, &topleft.x, &topleft.y);
-    GroupCell *CellToScrollTo = GetTree();
     GetClientSize(&width, &height);
 
+    // Scroll far enough that the bottom of the cell we reach is the last
+    // bottom of a cell on the new page.
+    GroupCell *CellToScrollTo =
+      GetHeightIndex().FirstCellEndingBelow(topleft.y + 2 * height);
+    if (!CellToScrollTo)
+      CellToScrollTo = GetLastCellInWorksheet();
+
     // Make sure we scroll at least one cell
-    if (CellToScrollTo)
+    if (CellToScrollTo && (CellToScrollTo == GetTree()))
       CellToScrollTo = CellToScrollTo->GetNext();
-
-    // Now scroll far enough that the bottom of the cell we reach is the last
-    // bottom of a cell on the new page.
-    while (CellToScrollTo && CellToScrollTo != GetLastCellInWorksheet()) {
-      if (CellToScrollTo->GetRect().GetBottom() > topleft.y + 2 * height)
-        break;
-      else
-        CellToScrollTo = CellToScrollTo->GetNext();
-    }
     SetHCaret(CellToScrollTo);
     ScrollToCaret();
     ScrolledAwayFromEvaluation();
@@ -6435,6 +6498,24 @@ void Worksheet::AddEntireDocumentToEvaluationQueue() {
   SetHCaret(GetLastCellInWorksheet());
 }
 
+std::size_t Worksheet::AddChangedCellsToEvaluationQueue(long session) {
+  std::vector<GroupCell *> const cells = CellDependencies::CellsToUpdate(
+    GetTree(),
+    [this, session](GroupCell *cell) {
+      return cell->InputChangedSinceEvaluation(session) ||
+        GetErrorList().Contains(cell);
+    },
+    [this](const wxString &name) {
+      return !GetHelpfileAnchorName(name).IsEmpty();
+    });
+  if (cells.empty())
+    return 0;
+  FollowEvaluation(true);
+  for (auto *cell : cells)
+    AddToEvaluationQueue(cell);
+  return cells.size();
+}
+
 void Worksheet::AddSectionToEvaluationQueue(GroupCell *start) {
   // Find the begin of the current section
   start = StartOfSectioningUnit(start);
@@ -6552,6 +6633,9 @@ void Worksheet::ScrollToCellIfNeeded() {
     return;
   }
 
+  // The cell might have moved since it has been drawn the last time
+  if (GetHeightIndex().Contains(cell->GetGroup()))
+    cell->GetGroup()->UpdateOutputPositions();
   int cellY = cell->GetCurrentY();
 
   if (cellY < 0) {
@@ -7509,12 +7593,7 @@ bool Worksheet::FindNext(const wxString &str, bool down, bool ignoreCase,
   // Default the start of the search at the top or the bottom of the screen
   wxPoint topleft;
   CalcUnscrolledPosition(0, starty, &topleft.x, &topleft.y);
-  GroupCell *pos = GetTree();
-  for (; pos; pos = pos->GetNext()) {
-    wxRect rect = pos->GetRect();
-    if (rect.GetBottom() > topleft.y)
-      break;
-  }
+  GroupCell *pos = GetHeightIndex().FirstCellEndingBelow(topleft.y);
 
   if (!pos)
     pos = down ? GetTree() : GetLastCellInWorksheet();
@@ -7597,12 +7676,7 @@ bool Worksheet::FindNext_Regex(const wxString &str, bool down,
   // Default the start of the search at the top or the bottom of the screen
   wxPoint topleft;
   CalcUnscrolledPosition(0, starty, &topleft.x, &topleft.y);
-  GroupCell *pos = GetTree();
-  for (; pos; pos = pos->GetNext()) {
-    wxRect rect = pos->GetRect();
-    if (rect.GetBottom() > topleft.y)
-      break;
-  }
+  GroupCell *pos = GetHeightIndex().FirstCellEndingBelow(topleft.y);
 
   if (!pos)
     pos = down ? GetTree() : GetLastCellInWorksheet();
@@ -7672,8 +7746,11 @@ bool Worksheet::FindNext_Regex(const wxString &str, bool down,
 bool Worksheet::CaretVisibleIs() {
   if (m_hCaretActive) {
     int y = -1;
-    if (m_hCaretPosition)
+    if (m_hCaretPosition) {
+      // The cell might have moved since it has been drawn the last time
+      m_hCaretPosition->UpdateYPosition();
       y = m_hCaretPosition->GetCurrentY();
+    }
 
     int view_x, view_y;
     int height, width;
@@ -7685,6 +7762,7 @@ bool Worksheet::CaretVisibleIs() {
     return ((y >= view_y) && (y <= view_y + height));
   } else {
     if (GetActiveCell()) {
+      GetActiveCell()->GetGroup()->UpdateYPosition();
       wxPoint point = GetActiveCell()->PositionToPoint();
       if (point.y < 1) {
         RecalculateForce();
@@ -7707,6 +7785,8 @@ bool Worksheet::ScrollToCaretIfNeeded() {
     ScheduleScrollToCell(m_hCaretPosition, false);
   } else {
     if (GetActiveCell()) {
+      // The cell might have moved since it has been drawn the last time
+      GetActiveCell()->GetGroup()->UpdateYPosition();
       wxPoint point = GetActiveCell()->PositionToPoint();
 
       // Carets in output cells [maxima questions] get assigned a position
@@ -52,6 +52,8 @@
 #include "Cell.h"
 #include "EditorCell.h"
 #include "GroupCell.h"
+#include "HeightIndex.h"
+#include "LayoutPool.h"
 #include "TextCell.h"
 #include "EvaluationQueue.h"
 #include "FindReplaceDialog.h"
@@ -211,10 +213,10 @@ private:
 
 //! true, if we have the current focus.
   bool m_hasFocus;
-  //! The last beginning for the area being drawn
-  long m_lastTop;
-  //! The last ending for the area being drawn
-  long m_lastBottom;
+  //! The top of the area whose cells might still cache scaled images
+  long m_imageCacheTop;
+  //! The bottom of the area whose cells might still cache scaled images
+  long m_imageCacheBottom;
   /*! \defgroup UndoBufferFill Undo methods for cell additions/deletions:
 
     Each EditorCell has its own private undo buffer Additionally wxMaxima
@@ -491,6 +493,8 @@ private:
 
   //! All that has need to be done before drawing a GroupCell in a DC
   void PrepareDrawGC(wxDC &dc);
+  //! Frees the scaled images of cells that are far out of view
+  void ClearFarAwayImageCaches();
 
   void OnSize(wxSizeEvent &event);
 
@@ -617,6 +621,8 @@ private:
   mutable CellPtr<GroupCell> m_last;
   //! Request adjusting the worksheet size?
   mutable bool m_adjustWorksheetSizeNeeded = false;
+  //! The time RecalculateIfNeeded() has spent laying out cells in total, in seconds
+  double m_recalculationTime = 0;
   //! Returns a pointer to the last cell of this worksheet
   GroupCell *GetLastCellInWorksheet() const;
   int m_clickType;
@@ -900,11 +906,16 @@ public:
 
   // Actually recalculate the worksheet.
   bool RecalculateIfNeeded(bool timeout = false);
+  //! Converts the big outputs that have been scrolled into view to cells, and vice versa
+  void UpdateLazyCells();
+  //! The time RecalculateIfNeeded() has spent laying out cells in total, in seconds
+  double GetRecalculationTime() const { return m_recalculationTime; }
 
-  //! Schedule a recalculation of the worksheet starting with the cell start.
+  //! Schedule a recalculation of the GroupCell the cell start belongs to
   void Recalculate(Cell *start);
 
-  void Recalculate() { Recalculate(GetTree()); }
+  //! Schedule a recalculation of all GroupCells that need it
+  void Recalculate() { m_recalculateAll = true; }
 
   //! Schedule a full recalculation of the worksheet
   void RecalculateForce();
@@ -1211,6 +1222,9 @@ public:
   //! The first groupCell that is currently visible.
   GroupCell *FirstVisibleGC();
 
+  //! The index of the GroupCells' y positions, brought up to date
+  HeightIndex &GetHeightIndex();
+
   /*! Scrolls to a point on the worksheet
 
     \todo I have deactivated this assert for the release as it scares the users
@@ -1361,6 +1375,13 @@ public:
   //! Schedule all cells in the document for evaluation
   void AddEntireDocumentToEvaluationQueue();
 
+  /*! Schedule the cells that have changed and the cells that depend on them
+
+    \param session Identifies the maxima process that currently runs
+    \return The number of cells that have been scheduled
+  */
+  std::size_t AddChangedCellsToEvaluationQueue(long session);
+
   //! Schedule all cells stopping with the one the caret is in for evaluation
   void AddDocumentTillHereToEvaluationQueue();
 
@@ -1604,8 +1625,24 @@ protected:
   AccessibilityInfo *m_accessibilityInfo;
 #endif
   void UpdateConfigurationClientSize();
-  //! Where to start recalculation. NULL = No recalculation needed.
-  GroupCell *m_recalculateStart;
+  /*! Lays out the GroupCells in these slots of the height index using m_layoutPool
+
+    \return The first slot whose height has changed, or the size of the
+    index, if no height has changed
+  */
+  std::size_t RecalculateInParallel(const std::vector<std::size_t> &slots);
+  //! The GroupCells Recalculate() has been called for, in no particular order
+  std::vector<CellPtr<GroupCell>> m_cellsToRecalculate;
+  /*! Do we need to search the whole worksheet for GroupCells to recalculate?
+
+    True if Recalculate() has been called without a cell or if the list of
+    GroupCells has changed.
+  */
+  bool m_recalculateAll = false;
+  //! Knows the y position of every GroupCell, see GetHeightIndex()
+  HeightIndex m_heightIndex;
+  //! The threads that lay out many GroupCells at once, for example after zooming
+  LayoutPool m_layoutPool;
   //! The x position of the mouse pointer
   int m_pointer_x;
   //! The y position of the mouse pointer
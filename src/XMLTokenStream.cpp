@@ -0,0 +1,401 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class XMLTokenStream that reads XML one tag or text
+  at a time.
+*/
+
+#include "XMLTokenStream.h"
+
+bool XMLTag::GetAttribute(const wxString &attrName, wxString *value) const {
+  for (auto const &attribute : attributes)
+    if (attribute.first == attrName) {
+      *value = attribute.second;
+      return true;
+    }
+  return false;
+}
+
+wxString XMLTag::GetAttribute(const wxString &attrName,
+                              const wxString &defaultValue) const {
+  for (auto const &attribute : attributes)
+    if (attribute.first == attrName)
+      return attribute.second;
+  return defaultValue;
+}
+
+bool XMLTag::HasAttribute(const wxString &attrName) const {
+  for (auto const &attribute : attributes)
+    if (attribute.first == attrName)
+      return true;
+  return false;
+}
+
+XMLTokenStream::XMLTokenStream(const wxString &xml) :
+  m_it(xml.begin()), m_end(xml.end()) {}
+
+XMLTokenStream::XMLTokenStream(const wxXmlNode *root) :
+  m_readTree(true), m_root(root) {}
+
+XMLTokenStream::Type XMLTokenStream::Next() {
+  if ((m_type == end) || (m_type == error))
+    return m_type;
+  if (m_readTree)
+    return NextFromTree();
+  return NextFromString();
+}
+
+wxString XMLTokenStream::ReadText() {
+  wxString result;
+  if (m_type == text) {
+    result.swap(m_text);
+    Next();
+  }
+  return result;
+}
+
+void XMLTokenStream::Skip() {
+  if (m_type != startTag) {
+    Next();
+    return;
+  }
+  std::size_t const depth = GetDepth();
+  Next();
+  SkipToEndOf(depth);
+}
+
+void XMLTokenStream::SkipToEndOf(std::size_t depth) {
+  while ((m_type != end) && (m_type != error) &&
+         !((m_type == endTag) && (GetDepth() < depth)))
+    Next();
+  if (m_type == endTag)
+    Next();
+}
+
+//! Escapes the chars that have a special meaning in XML
+static wxString EscapeXML(wxString text) {
+  text.Replace(wxS("&"), wxS("&amp;"));
+  text.Replace(wxS("<"), wxS("&lt;"));
+  text.Replace(wxS(">"), wxS("&gt;"));
+  text.Replace(wxS("\""), wxS("&quot;"));
+  return text;
+}
+
+bool XMLTokenStream::ReadContentsAsXML(wxString &xml) {
+  if (m_type != startTag)
+    return false;
+  std::size_t const depth = GetDepth();
+  while (true) {
+    switch (Next()) {
+    case startTag:
+      xml += wxS("<") + m_tag.name;
+      for (auto const &attribute : m_tag.attributes)
+        xml += wxS(" ") + attribute.first + wxS("=\"") +
+          EscapeXML(attribute.second) + wxS("\"");
+      xml += wxS(">");
+      break;
+    case text:
+      xml += EscapeXML(m_text);
+      break;
+    case endTag:
+      if (GetDepth() < depth) {
+        Next();
+        return true;
+      }
+      xml += wxS("</") + m_tag.name + wxS(">");
+      break;
+    default:
+      return false;
+    }
+  }
+}
+
+XMLTokenStream::Type XMLTokenStream::CloseElement() {
+  m_tag.name = m_openTags.back();
+  m_tag.attributes.clear();
+  m_openTags.pop_back();
+  return m_type = endTag;
+}
+
+bool XMLTokenStream::EnterNode() {
+  switch (m_node->GetType()) {
+  case wxXML_ELEMENT_NODE:
+    m_tag.name = m_node->GetName();
+    m_tag.attributes.clear();
+    for (auto *attribute = m_node->GetAttributes(); attribute;
+         attribute = attribute->GetNext())
+      m_tag.attributes.emplace_back(attribute->GetName(), attribute->GetValue());
+    m_openTags.push_back(m_tag.name);
+    m_type = startTag;
+    return true;
+  case wxXML_TEXT_NODE:
+  case wxXML_CDATA_SECTION_NODE:
+    m_text = m_node->GetContent();
+    m_type = text;
+    return true;
+  default:
+    // Comments and processing instructions
+    return false;
+  }
+}
+
+XMLTokenStream::Type XMLTokenStream::NextFromTree() {
+  // Do we need to look at m_node, or has it been read completely?
+  bool enter;
+  switch (m_type) {
+  case none:
+    if (!m_root)
+      return m_type = end;
+    m_node = m_root;
+    enter = true;
+    break;
+  case startTag:
+    if (!m_node->GetChildren())
+      return CloseElement();
+    m_node = m_node->GetChildren();
+    enter = true;
+    break;
+  default:
+    enter = false;
+  }
+
+  while (true) {
+    if (enter && EnterNode())
+      return m_type;
+    if (m_node == m_root)
+      return m_type = end;
+    enter = (m_node->GetNext() != nullptr);
+    if (!enter) {
+      m_node = m_node->GetParent();
+      return CloseElement();
+    }
+    m_node = m_node->GetNext();
+  }
+}
+
+/*! Is ch a control char?
+
+  Maxima's output may contain control chars, for example if a string contains
+  them. They are displayed as a replacement character.
+*/
+static bool IsControlChar(wxUniChar ch) {
+  auto const value = ch.GetValue();
+  return (value < 0x20) || ((value >= 0x7F) && (value <= 0x9F));
+}
+
+static bool IsXMLWhitespace(wxUniChar ch) {
+  return (ch == wxS(' ')) || (ch == wxS('\t')) || (ch == wxS('\n')) ||
+    (ch == wxS('\r'));
+}
+
+/*! Appends the char at it to text, decoding entities and control chars
+
+  \return The position after the char or entity
+*/
+static wxString::const_iterator ReadXMLChar(wxString::const_iterator it,
+                                            wxString::const_iterator end,
+                                            wxString &text) {
+  wxUniChar const ch = *it;
+  ++it;
+  if (IsControlChar(ch)) {
+    text += wxS('\uFFFD');
+    return it;
+  }
+  if (ch != wxS('&')) {
+    text += ch;
+    return it;
+  }
+
+  // An entity. The names of entities are short => limit the search for the ";".
+  wxString name;
+  auto nameEnd = it;
+  while ((nameEnd != end) && (*nameEnd != wxS(';')) && (name.length() < 10)) {
+    name += *nameEnd;
+    ++nameEnd;
+  }
+  if ((nameEnd == end) || (*nameEnd != wxS(';'))) {
+    text += ch;
+    return it;
+  }
+  ++nameEnd;
+  if (name == wxS("amp"))
+    text += wxS('&');
+  else if (name == wxS("lt"))
+    text += wxS('<');
+  else if (name == wxS("gt"))
+    text += wxS('>');
+  else if (name == wxS("quot"))
+    text += wxS('"');
+  else if (name == wxS("apos"))
+    text += wxS('\'');
+  else if (name.StartsWith(wxS("#"))) {
+    unsigned long code;
+    bool ok;
+    if (name.StartsWith(wxS("#x")) || name.StartsWith(wxS("#X")))
+      ok = name.Mid(2).ToULong(&code, 16);
+    else
+      ok = name.Mid(1).ToULong(&code, 10);
+    if ((!ok) || (code > 0x10FFFF)) {
+      text += wxS("&") + name + wxS(";");
+      return nameEnd;
+    }
+    wxUniChar const decoded(static_cast<wxUint32>(code));
+    if (IsControlChar(decoded))
+      text += wxS('\uFFFD');
+    else
+      text += decoded;
+  } else
+    // Not an entity we know => keep it as it is
+    text += wxS("&") + name + wxS(";");
+  return nameEnd;
+}
+
+XMLTokenStream::Type XMLTokenStream::NextFromString() {
+  if (m_emptyElement) {
+    m_emptyElement = false;
+    return CloseElement();
+  }
+
+  while (m_it != m_end) {
+    if (*m_it != wxS('<')) {
+      m_text.Clear();
+      while ((m_it != m_end) && (*m_it != wxS('<')))
+        m_it = ReadXMLChar(m_it, m_end, m_text);
+      return m_type = text;
+    }
+
+    ++m_it;
+    if (m_it == m_end)
+      return Fail();
+
+    if ((*m_it == wxS('?')) || (*m_it == wxS('!'))) {
+      // A XML declaration, a comment or a doctype. None of them contains
+      // anything we need.
+      wxUniChar const kind = *m_it;
+      ++m_it;
+      bool const comment = (kind == wxS('!')) && (m_it != m_end) && (*m_it == wxS('-'));
+      wxUniChar prev1;
+      wxUniChar prev2;
+      bool closed = false;
+      while ((m_it != m_end) && (!closed)) {
+        wxUniChar const ch = *m_it;
+        ++m_it;
+        if (ch == wxS('>')) {
+          if (comment)
+            closed = (prev1 == wxS('-')) && (prev2 == wxS('-'));
+          else if (kind == wxS('?'))
+            closed = (prev1 == wxS('?'));
+          else
+            closed = true;
+        }
+        prev2 = prev1;
+        prev1 = ch;
+      }
+      if (!closed)
+        return Fail();
+      continue;
+    }
+
+    bool const closingTag = (*m_it == wxS('/'));
+    if (closingTag)
+      ++m_it;
+
+    wxString name;
+    while ((m_it != m_end) && (!IsXMLWhitespace(*m_it)) && (*m_it != wxS('/')) &&
+           (*m_it != wxS('>'))) {
+      name += *m_it;
+      ++m_it;
+    }
+    if (name.IsEmpty())
+      return Fail();
+
+    if (closingTag) {
+      while ((m_it != m_end) && IsXMLWhitespace(*m_it))
+        ++m_it;
+      if ((m_it == m_end) || (*m_it != wxS('>')) || m_openTags.empty() ||
+          (m_openTags.back() != name))
+        return Fail();
+      ++m_it;
+      return CloseElement();
+    }
+
+    if (m_openTags.empty()) {
+      // Only one root element is allowed
+      if (m_hadRoot)
+        return Fail();
+      m_hadRoot = true;
+    }
+    m_tag.name = name;
+    m_tag.attributes.clear();
+
+    // The attributes
+    while (true) {
+      while ((m_it != m_end) && IsXMLWhitespace(*m_it))
+        ++m_it;
+      if (m_it == m_end)
+        return Fail();
+      if (*m_it == wxS('>')) {
+        ++m_it;
+        break;
+      }
+      if (*m_it == wxS('/')) {
+        ++m_it;
+        if ((m_it == m_end) || (*m_it != wxS('>')))
+          return Fail();
+        ++m_it;
+        m_emptyElement = true;
+        break;
+      }
+      wxString attrName;
+      while ((m_it != m_end) && (!IsXMLWhitespace(*m_it)) && (*m_it != wxS('=')) &&
+             (*m_it != wxS('>')) && (*m_it != wxS('/'))) {
+        attrName += *m_it;
+        ++m_it;
+      }
+      while ((m_it != m_end) && IsXMLWhitespace(*m_it))
+        ++m_it;
+      if ((m_it == m_end) || (*m_it != wxS('=')) || attrName.IsEmpty())
+        return Fail();
+      ++m_it;
+      while ((m_it != m_end) && IsXMLWhitespace(*m_it))
+        ++m_it;
+      if ((m_it == m_end) || ((*m_it != wxS('"')) && (*m_it != wxS('\''))))
+        return Fail();
+      wxUniChar const quote = *m_it;
+      ++m_it;
+      wxString value;
+      while ((m_it != m_end) && (*m_it != quote))
+        m_it = ReadXMLChar(m_it, m_end, value);
+      if (m_it == m_end)
+        return Fail();
+      ++m_it;
+      m_tag.attributes.emplace_back(std::move(attrName), std::move(value));
+    }
+    m_openTags.push_back(name);
+    return m_type = startTag;
+  }
+
+  // Elements that haven't been closed mean that the XML is incomplete.
+  if (!m_openTags.empty())
+    return Fail();
+  return m_type = end;
+}
@@ -0,0 +1,158 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file declares the class XMLTokenStream that reads XML one tag or text
+  at a time.
+*/
+
+#ifndef XMLTOKENSTREAM_H
+#define XMLTOKENSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <wx/string.h>
+#include <wx/xml/xml.h>
+
+//! The name and the attributes of a start tag
+struct XMLTag
+{
+  wxString name;
+  std::vector<std::pair<wxString, wxString>> attributes;
+
+  //! Reads an attribute. Returns false, if the tag doesn't have it.
+  bool GetAttribute(const wxString &attrName, wxString *value) const;
+  //! Returns an attribute's value, or defaultValue if the tag doesn't have it.
+  wxString GetAttribute(const wxString &attrName,
+                        const wxString &defaultValue = {}) const;
+  bool HasAttribute(const wxString &attrName) const;
+};
+
+/*! Reads XML as a stream of start tags, texts and end tags
+
+  MathParser creates cells while it reads these tokens, which means that no
+  tree of XML nodes needs to be built for maxima's output first: Even for
+  huge outputs only the cells and the tags of the elements that are open at
+  the moment need to be kept in memory.
+
+  The stream either reads the XML dialect wxMathML.lisp emits from a string,
+  replacing control chars and decoding entities on the way, or walks a
+  wxXmlNode tree, which is what .wxmx files are loaded into.
+
+  Copying a stream remembers its position: Assigning the copy back returns
+  to it.
+*/
+class XMLTokenStream
+{
+public:
+  //! The types of tokens
+  enum Type : std::uint8_t
+  {
+    none,     //!< Next() hasn't been called, yet
+    startTag, //!< A start tag. Empty elements are read as a start and an end tag.
+    text,     //!< The text between two tags
+    endTag,   //!< An end tag
+    end,      //!< The XML has ended
+    error     //!< The XML isn't well-formed. Reading on returns error again.
+  };
+
+  //! Reads the XML in a string. The string must outlive the stream.
+  explicit XMLTokenStream(const wxString &xml);
+  //! A temporary string wouldn't outlive the stream
+  explicit XMLTokenStream(wxString &&xml) = delete;
+  //! Walks the tree a wxXmlNode is the root of. The tree must outlive the stream.
+  explicit XMLTokenStream(const wxXmlNode *root);
+
+  //! Advances to the next token
+  Type Next();
+  //! The type of the current token
+  Type GetType() const { return m_type; }
+  //! Is the current token a start tag or a text?
+  bool AtContent() const { return (m_type == startTag) || (m_type == text); }
+  //! The name of the start or end tag that is the current token
+  const wxString &GetName() const { return m_tag.name; }
+  //! The start tag that is the current token
+  const XMLTag &GetTag() const { return m_tag; }
+  //! Moves the start tag that is the current token out of the stream
+  XMLTag TakeTag() { return std::move(m_tag); }
+  //! The text that is the current token
+  const wxString &GetText() const { return m_text; }
+  /*! If the current token is a text: Returns it and advances to the next token.
+
+    \return The text, or an empty string if the current token is no text.
+  */
+  wxString ReadText();
+  //! The number of elements that are open after the current token
+  std::size_t GetDepth() const { return m_openTags.size(); }
+  //! Skips the current token. For a start tag this skips the whole element.
+  void Skip();
+  /*! Advances to the token after the end of an element
+
+    \param depth The GetDepth() the stream had at the element's start tag
+  */
+  void SkipToEndOf(std::size_t depth);
+  /*! Writes the contents of the element whose start tag is the current token back as XML
+
+    As entities and control chars are decoded while reading the result is
+    well-formed XML. Afterwards the current token is the one after the
+    element's end tag.
+    \param xml The string the contents are appended to
+    \return false, if the XML is broken.
+  */
+  bool ReadContentsAsXML(wxString &xml);
+
+private:
+  //! Reads the next token from m_it
+  Type NextFromString();
+  //! Reads the next token from m_node
+  Type NextFromTree();
+  //! Makes m_node the current token. Returns false, if it is of no interest.
+  bool EnterNode();
+  //! Makes the end tag of the innermost open element the current token
+  Type CloseElement();
+  Type Fail() { return m_type = error; }
+
+  Type m_type = none;
+  XMLTag m_tag;
+  wxString m_text;
+  //! The names of all elements that are open
+  std::vector<wxString> m_openTags;
+
+  //! The position in the string we read
+  wxString::const_iterator m_it;
+  //! The end of the string we read
+  wxString::const_iterator m_end;
+  //! True, if the last start tag read from the string was an empty element
+  bool m_emptyElement = false;
+  //! True, if a root element has been read from the string
+  bool m_hadRoot = false;
+
+  //! True, if we walk a tree of wxXmlNodes instead of reading a string
+  bool m_readTree = false;
+  //! The root of the tree we walk
+  const wxXmlNode *m_root = nullptr;
+  //! The node the current token belongs to
+  const wxXmlNode *m_node = nullptr;
+};
+
+#endif // XMLTOKENSTREAM_H
@@ -29,144 +29,233 @@
 
 #include "XmlInspector.h"
 
-#include <wx/regex.h>
+#include <wx/button.h>
 #include <wx/sizer.h>
+#include <wx/splitter.h>
 
-XmlInspector::XmlInspector(wxWindow *parent, int id)
-  : wxRichTextCtrl(parent, id, wxEmptyString, wxDefaultPosition,
-                   wxSize(wxSystemSettings::GetMetric(wxSYS_SCREEN_X) / 10,
-                          wxSystemSettings::GetMetric(wxSYS_SCREEN_Y) / 10),
-                   wxTE_READONLY | wxTE_RICH | wxHSCROLL | wxTE_MULTILINE) {
-  m_state = clear;
-  m_indentLevel = 0;
-  BeginSuppressUndo();
-  XmlInspector::Clear();
-  wxRichTextCtrl::Clear();
+XmlInspector::XmlInspector(wxWindow *parent, int id, Configuration *config)
+  : wxPanel(parent, id, wxDefaultPosition,
+            wxSize(wxSystemSettings::GetMetric(wxSYS_SCREEN_X) / 10,
+                   wxSystemSettings::GetMetric(wxSYS_SCREEN_Y) / 10)),
+    m_configuration(config) {
+  wxSplitterWindow *splitter = new wxSplitterWindow(this, wxID_ANY);
+  m_list = new FrameList(splitter, this, XmlInspector_ctrl_id);
+  m_details = new wxTextCtrl(splitter, wxID_ANY, wxEmptyString, wxDefaultPosition,
+                             wxDefaultSize, wxTE_READONLY | wxHSCROLL | wxTE_MULTILINE);
+  splitter->SplitHorizontally(m_list, m_details);
+  splitter->SetSashGravity(0.5);
+  splitter->SetMinimumPaneSize(20);
+
+  wxBoxSizer *searchSizer = new wxBoxSizer(wxHORIZONTAL);
+  m_regex = new RegexCtrl(this, XmlInspector_regex_id, config);
+  m_regex->SetToolTip(_("Input a RegEx here to search the communication with maxima"));
+  m_regex->Connect(REGEX_EVENT, wxCommandEventHandler(XmlInspector::OnRegexChanged),
+                   NULL, this);
+  searchSizer->Add(m_regex, wxSizerFlags(1).Expand());
+  wxButton *previous = new wxButton(this, wxID_ANY, _("Previous"));
+  previous->Bind(wxEVT_BUTTON, &XmlInspector::OnFindPrevious, this);
+  searchSizer->Add(previous, wxSizerFlags());
+  wxButton *next = new wxButton(this, wxID_ANY, _("Next"));
+  next->Bind(wxEVT_BUTTON, &XmlInspector::OnFindNext, this);
+  searchSizer->Add(next, wxSizerFlags());
+
+  wxBoxSizer *vbox = new wxBoxSizer(wxVERTICAL);
+  vbox->Add(splitter, wxSizerFlags(1).Expand());
+  vbox->Add(searchSizer, wxSizerFlags().Expand());
+  SetSizer(vbox);
+
+  m_list->Bind(wxEVT_LIST_ITEM_SELECTED, &XmlInspector::OnFrameSelected, this);
 }
 
 XmlInspector::~XmlInspector() {}
 
+XmlInspector::FrameList::FrameList(wxWindow *parent, XmlInspector *inspector,
+                                   wxWindowID id)
+  : wxListCtrl(parent, id, wxDefaultPosition, wxDefaultSize,
+               wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL),
+    m_inspector(inspector) {
+  AppendColumn(_("#"), wxLIST_FORMAT_RIGHT);
+  AppendColumn(_("Direction"));
+  AppendColumn(_("Length"), wxLIST_FORMAT_RIGHT);
+  AppendColumn(_("Contents"), wxLIST_FORMAT_LEFT, 600);
+  m_toMaximaAttr.SetTextColour(wxColour(128, 0, 0));
+  m_fromMaximaAttr.SetTextColour(wxColour(0, 128, 0));
+}
+
+wxString XmlInspector::FrameList::OnGetItemText(long item, long column) const {
+  if ((item < 0) || (static_cast<std::size_t>(item) >= m_inspector->m_frames.size()))
+    return wxEmptyString;
+  const Frame &frame = m_inspector->m_frames[static_cast<std::size_t>(item)];
+  switch (column) {
+  case 0:
+    return wxString::Format(wxS("%li"), m_inspector->m_droppedFrames + item + 1);
+  case 1:
+    return frame.toMaxima ? _("sent") : _("received");
+  case 2:
+    return wxString::Format(wxS("%li"), static_cast<long>(frame.text.Length()));
+  default: {
+    // Only the beginning of the frame fits into the column, anyway.
+    wxString preview = frame.text.Left(300);
+    preview.Replace(wxS("\n"), wxS("\u23CE"));
+    return preview;
+  }
+  }
+}
+
+wxListItemAttr *XmlInspector::FrameList::OnGetItemAttr(long item) const {
+  if ((item < 0) || (static_cast<std::size_t>(item) >= m_inspector->m_frames.size()))
+    return NULL;
+  if (m_inspector->m_frames[static_cast<std::size_t>(item)].toMaxima)
+    return &m_toMaximaAttr;
+  return &m_fromMaximaAttr;
+}
+
 void XmlInspector::Clear() {
-  m_clear = true;
-  m_fromMaxima = wxEmptyString;
-  m_toMaxima = wxEmptyString;
+  m_frames.clear();
+  m_bytes = 0;
+  m_droppedFrames = 0;
+  m_selectedFrame = -1;
   m_updateNeeded = true;
 }
 
+std::size_t XmlInspector::FrameSize(const Frame &frame) {
+  return sizeof(Frame) + frame.text.Length() * sizeof(wxStringCharType);
+}
+
+void XmlInspector::Add(bool toMaxima, const wxString &text) {
+  if (text.IsEmpty())
+    return;
+  if ((!toMaxima) && (!m_frames.empty()) && (!m_frames.back().toMaxima) &&
+      (m_frames.back().text.Length() < m_maxFrameLength)) {
+    m_frames.back().text += text;
+    m_bytes += text.Length() * sizeof(wxStringCharType);
+  } else {
+    m_frames.emplace_back(toMaxima, text);
+    m_bytes += FrameSize(m_frames.back());
+  }
+  DropOldFrames();
+  m_updateNeeded = true;
+}
+
+void XmlInspector::DropOldFrames() {
+  std::size_t const budget =
+    static_cast<std::size_t>(m_configuration->XmlInspectorMegabytes()) * 1024 * 1024;
+  // The newest frame is kept even if it alone exceeds the budget
+  while ((m_bytes > budget) && (m_frames.size() > 1)) {
+    m_bytes -= FrameSize(m_frames.front());
+    m_frames.pop_front();
+    m_droppedFrames++;
+  }
+}
+
+void XmlInspector::Add_ToMaxima(const wxString &text) { Add(true, text); }
+
+void XmlInspector::Add_FromMaxima(const wxString &text) { Add(false, text); }
+
 void XmlInspector::UpdateContents() {
   if (!m_updateNeeded)
     return;
   m_updateNeeded = false;
 
-  if (m_clear) {
-    wxRichTextCtrl::Clear();
-    m_lastChar = wxChar(0);
-    m_indentLevel = 0;
-    m_state = clear;
-    m_clear = false;
-  }
+  long const oldCount = m_list->GetItemCount();
+  long const count = static_cast<long>(m_frames.size());
+  // Follow the new frames if the last frame was visible
+  bool const follow = (m_list->GetTopItem() + m_list->GetCountPerPage() >= oldCount);
+  m_list->SetItemCount(count);
 
-  // Display all data we have sent to Maxima
-  if (m_toMaxima != wxEmptyString) {
-    if (m_state != toMaxima) {
-      if (GetValue() != wxEmptyString) {
-        Newline();
-        Newline();
-      }
-      SetInsertionPointEnd();
-      BeginTextColour(wxColour(0, 0, 0));
-      WriteText(_("SENT TO MAXIMA:"));
-      Newline();
-      Newline();
-      EndTextColour();
-      m_state = toMaxima;
-    } else {
-      SetInsertionPointEnd();
-      WriteText("\n");
+  // The list only knows indices, which change if old frames are dropped.
+  long const selected = m_list->GetNextItem(-1, wxLIST_NEXT_ALL, wxLIST_STATE_SELECTED);
+  long const wanted = m_selectedFrame - m_droppedFrames;
+  if (selected != wanted) {
+    if (selected >= 0)
+      m_list->SetItemState(selected, 0, wxLIST_STATE_SELECTED);
+    if ((wanted >= 0) && (wanted < count))
+      m_list->SetItemState(wanted, wxLIST_STATE_SELECTED, wxLIST_STATE_SELECTED);
+    else {
+      m_selectedFrame = -1;
+      m_details->Clear();
     }
-
-    SetInsertionPointEnd();
-    BeginTextColour(wxColour(128, 0, 0));
-    WriteText(m_toMaxima);
-    EndTextColour();
-    m_toMaxima = wxEmptyString;
   }
+  if (follow && (count > 0))
+    m_list->EnsureVisible(count - 1);
+  m_list->Refresh();
+}
 
-  // Display all data from Maxima
-  if (m_fromMaxima != wxEmptyString) {
-    if (m_state != fromMaxima) {
-      if (GetValue() != wxEmptyString) {
-        Newline();
-        Newline();
-      }
-      SetInsertionPointEnd();
-      BeginTextColour(wxColour(0, 0, 0));
-      WriteText(_("MAXIMA RESPONSE:"));
-      Newline();
-      Newline();
-      EndTextColour();
-      m_state = fromMaxima;
-    }
-    m_fromMaxima.Replace(wxS("$FUNCTION:"), wxS("\n$FUNCTION:"));
-
-    // Indent the XML
-    wxString textWithIndention;
-    std::size_t length = 0;
-    for (wxString::const_iterator it = m_fromMaxima.begin();
-         it != m_fromMaxima.end(); ++it) {
-      length++;
-      // Assume that all tags add indentation
-      if (*it == wxS('>'))
-        m_indentLevel++;
-
-      // A closing tag needs to remove the indentation of the opening tag
-      // plus the indentation of the closing tag
-      if ((m_lastChar == wxS('<')) && (*it == wxS('/')))
-        m_indentLevel -= 2;
-
-      // Self-closing Tags remove their own indentation
-      if ((m_lastChar == wxS('/')) && (*it == wxS('>')))
-        m_indentLevel -= 1;
-
-      // Add a linebreak and indent if we are at the space between 2 tags
-      if ((m_lastChar == wxS('>')) && (*it == wxS('<')))
-        textWithIndention += wxS("\n") + IndentString(m_indentLevel);
-
-      textWithIndention += *it;
-      m_lastChar = *it;
+wxString XmlInspector::IndentXml(const wxString &xml) {
+  wxString result;
+  result.reserve(xml.Length() * 2);
+  int indentLevel = 0;
+  wxChar lastChar = wxS('\0');
+  for (auto const ch : xml) {
+    // Assume that all tags add indentation
+    if (ch == wxS('>'))
+      indentLevel++;
+
+    // A closing tag needs to remove the indentation of the opening tag
+    // plus the indentation of the closing tag
+    if ((lastChar == wxS('<')) && (ch == wxS('/')))
+      indentLevel -= 2;
+
+    // Self-closing Tags remove their own indentation
+    if ((lastChar == wxS('/')) && (ch == wxS('>')))
+      indentLevel -= 1;
+
+    // Add a linebreak and indent if we are at the space between 2 tags
+    if ((lastChar == wxS('>')) && (ch == wxS('<'))) {
+      result += wxS("\n");
+      if (indentLevel >= 0)
+        result += wxString(wxS(' '), static_cast<std::size_t>(indentLevel) + 1);
     }
-    SetInsertionPointEnd();
-    BeginTextColour(wxColour(0, 128, 0));
-    WriteText(textWithIndention);
-    EndTextColour();
-    m_fromMaxima = wxEmptyString;
-
-    // Adding many chars to the XML inspector is slow => Warn our users if we do
-    // so.
-    if (length > 100000)
-      wxLogMessage(_("Added much text (%li chars) to the XML inspector."),
-                   static_cast<long>(length));
+
+    result += ch;
+    lastChar = ch;
   }
+  result.Replace(wxS("$FUNCTION:"), wxS("\n$FUNCTION:"));
+  return result;
 }
 
-wxString XmlInspector::IndentString(int level) {
-  wxString result;
-  for (int i = 0; i <= level; i++)
-    result += wxS(" ");
-  return result;
+void XmlInspector::SelectFrame(long number) {
+  long const index = number - m_droppedFrames;
+  if ((index < 0) || (static_cast<std::size_t>(index) >= m_frames.size()))
+    return;
+  m_list->SetItemState(index, wxLIST_STATE_SELECTED | wxLIST_STATE_FOCUSED,
+                       wxLIST_STATE_SELECTED | wxLIST_STATE_FOCUSED);
+  m_list->EnsureVisible(index);
+}
+
+void XmlInspector::OnFrameSelected(wxListEvent &event) {
+  long const index = event.GetIndex();
+  if ((index < 0) || (static_cast<std::size_t>(index) >= m_frames.size()))
+    return;
+  if (m_selectedFrame == m_droppedFrames + index)
+    return;
+  m_selectedFrame = m_droppedFrames + index;
+  const Frame &frame = m_frames[static_cast<std::size_t>(index)];
+  m_details->SetValue(frame.toMaxima ? frame.text : IndentXml(frame.text));
 }
 
-void XmlInspector::Add_ToMaxima(wxString text) {
-  if (m_toMaxima != wxEmptyString) {
-    m_toMaxima += wxS("\n\u2015\n");
-    if (m_fromMaxima != wxEmptyString)
-      m_fromMaxima += wxS("\n\u2015\n");
+void XmlInspector::Find(int direction) {
+  if (m_regex->GetValue().IsEmpty() || m_frames.empty())
+    return;
+  long const count = static_cast<long>(m_frames.size());
+  long index = m_selectedFrame - m_droppedFrames;
+  if ((index < 0) || (index >= count))
+    index = (direction > 0) ? -1 : count;
+  for (index += direction; (index >= 0) && (index < count); index += direction) {
+    if (m_regex->Matches(m_frames[static_cast<std::size_t>(index)].text)) {
+      SelectFrame(m_droppedFrames + index);
+      return;
+    }
   }
-  m_toMaxima += text;
-  m_updateNeeded = true;
+  wxBell();
 }
 
-void XmlInspector::Add_FromMaxima(wxString text) {
-  m_fromMaxima += text;
-  m_updateNeeded = true;
+void XmlInspector::OnRegexChanged(wxCommandEvent &WXUNUSED(event)) {
+  // Start searching at the newest frame
+  m_selectedFrame = -1;
+  Find(-1);
 }
+
+void XmlInspector::OnFindNext(wxCommandEvent &WXUNUSED(event)) { Find(1); }
+
+void XmlInspector::OnFindPrevious(wxCommandEvent &WXUNUSED(event)) { Find(-1); }
@@ -21,63 +21,113 @@
 
 /*! \file
 
-  This file contains the definition of the class XmlInspector that handles the
-  table of contents pane.
+  This file contains the definition of the class XmlInspector that displays
+  the communication between maxima and wxMaxima.
 */
 #include "precomp.h"
 #include <wx/wx.h>
-#include <wx/richtext/richtextctrl.h>
-#include <vector>
+#include <wx/listctrl.h>
+#include <deque>
+#include "Configuration.h"
+#include "RegexCtrl.h"
 
 #ifndef XMLINSPECTOR_H
 #define XMLINSPECTOR_H
 
 /*! This class generates a pane displaying the communication between maxima and wxMaxima.
 
-  The display of this data is only actually updated on calling XmlInspector::Update().
+  The data is kept in a list of frames whose size is limited to
+  Configuration::XmlInspectorMegabytes(): If adding a frame exceeds this limit
+  the oldest frames are dropped. The frames are shown in a virtual list that
+  only formats the frames that are visible; the frame that is selected is
+  shown indented below the list.
+
+  The display of this data is only actually updated on calling XmlInspector::UpdateContents().
 */
-class XmlInspector : public wxRichTextCtrl
+class XmlInspector : public wxPanel
 {
 public:
-  XmlInspector(wxWindow *parent, int id);
+  XmlInspector(wxWindow *parent, int id, Configuration *config);
 
   /*! The destructor
    */
   ~XmlInspector();
 
-  //! Remove all text from the editor.
-  virtual void Clear();
+  //! Remove all frames.
+  void Clear();
 
   //! Add some text we sent to maxima.
-  void Add_ToMaxima(wxString text);
+  void Add_ToMaxima(const wxString &text);
   //! Add some text we have received from maxima.
-  void Add_FromMaxima(wxString text);
+  void Add_FromMaxima(const wxString &text);
   //! Actually draw the updates
   void UpdateContents();
   //! Do we need to update the XmlInspector's display?
   bool UpdateNeeded(){return m_updateNeeded;}
+
 private:
-  bool m_updateNeeded;
-  wxString m_fromMaxima;
-  wxString m_toMaxima;
-  bool m_clear;
-  enum xmlInspectorIDs
+  //! A piece of the communication with maxima
+  struct Frame
   {
-    XmlInspector_ctrl_id = 4,
-    XmlInspector_regex_id
+    Frame(bool sent, const wxString &data) : toMaxima(sent), text(data) {}
+    //! Did we send this to maxima?
+    bool toMaxima;
+    wxString text;
   };
-  enum monitorState
+
+  //! The list that asks the XmlInspector for the text of the frames that are visible
+  class FrameList : public wxListCtrl
   {
-    clear,
-    fromMaxima,
-    toMaxima
+  public:
+    FrameList(wxWindow *parent, XmlInspector *inspector, wxWindowID id);
+  protected:
+    wxString OnGetItemText(long item, long column) const override;
+    wxListItemAttr *OnGetItemAttr(long item) const override;
+  private:
+    XmlInspector *m_inspector;
+    mutable wxListItemAttr m_toMaximaAttr;
+    mutable wxListItemAttr m_fromMaximaAttr;
   };
-  monitorState m_state;
 
-  wxChar m_lastChar = '\0';
-  int m_indentLevel;
+  //! Appends text to the last frame or starts a new frame
+  void Add(bool toMaxima, const wxString &text);
+  //! Drops the oldest frames until the frames fit into the configured memory
+  void DropOldFrames();
+  //! The memory a frame occupies, in bytes
+  static std::size_t FrameSize(const Frame &frame);
+  //! Adds linebreaks and indentation to the XML maxima sends
+  static wxString IndentXml(const wxString &xml);
+  //! Selects the next frame in direction (+1 or -1) the regex matches
+  void Find(int direction);
+  //! Selects a frame, identified by its number
+  void SelectFrame(long number);
 
-  wxString IndentString(int level);
+  void OnFrameSelected(wxListEvent &event);
+  void OnRegexChanged(wxCommandEvent &event);
+  void OnFindNext(wxCommandEvent &event);
+  void OnFindPrevious(wxCommandEvent &event);
+
+  Configuration *m_configuration;
+  bool m_updateNeeded = true;
+  //! All frames we still remember
+  std::deque<Frame> m_frames;
+  //! The memory m_frames occupies
+  std::size_t m_bytes = 0;
+  //! The number of frames that have been dropped. Frame numbers start after them.
+  long m_droppedFrames = 0;
+  //! The number of the frame that is shown in m_details; -1 = none
+  long m_selectedFrame = -1;
+  //! A frame from maxima grows until this length before a new one is started
+  static constexpr std::size_t m_maxFrameLength = 65536;
+  FrameList *m_list;
+  //! Shows the frame that is selected in m_list
+  wxTextCtrl *m_details;
+  RegexCtrl *m_regex;
+  enum xmlInspectorIDs
+  {
+    XmlInspector_ctrl_id = 4,
+    XmlInspector_regex_id
+  };
 };
 
 #endif // XMLINSPECTOR_H
@@ -35,6 +35,7 @@
 #include "CellImpl.h"
 #include "CellPointers.h"
 #include "ImgCell.h"
+#include "LayoutPool.h"
 #include "StringUtils.h"
 
 #include <memory>
@@ -255,6 +256,11 @@ void AnimationCell::SetMaxHeight(wxCoord height) {
 }
 
 void AnimationCell::Recalculate(AFontSize fontsize) {
+  // Images may still be being loaded by a thread of their own.
+  if (LayoutPool::InLayoutThread()) {
+    LayoutPool::Fail(LayoutPool::guiThread);
+    return;
+  }
   // Assuming a minimum size maybe isn't that bad.
   m_height = m_width = 10 + 2 * m_imageBorderWidth;
 
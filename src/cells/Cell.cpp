@@ -61,8 +61,11 @@ Cell::Cell(GroupCell *group, Configuration *config)
   wxASSERT((!group) || ((group->GetType() == MC_TYPE_GROUP || group == this)));
   InitBitFields();
   ResetSize();
+  m_cellsCreated.fetch_add(1, std::memory_order_relaxed);
 }
 
+std::atomic<std::size_t> Cell::m_cellsCreated{0};
+
 Cell::~Cell() {
   if (m_ownsToolTip)
     wxDELETE(m_toolTip);
@@ -189,6 +192,14 @@ void Cell::FontsChangedList() {
   }
 }
 
+void Cell::SetGroupList(GroupCell *group) {
+  for (Cell &tmp : OnList(this)) {
+    tmp.m_group = group;
+    for (Cell &cell : OnInner(&tmp))
+      cell.SetGroupList(group);
+  }
+}
+
 GroupCell *Cell::GetGroup() const {
   GroupCell *group = m_group;
   wxASSERT_MSG(
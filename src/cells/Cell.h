@@ -41,6 +41,7 @@
 #include <wx/access.h>
 #endif // wxUSE_ACCESSIBILITY
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <vector>
@@ -218,6 +219,10 @@ public:
   //! How many cells does this cell contain?
   unsigned long CellsInListRecursive() const;
 
+  //! How many cells have been created since the program was started?
+  static std::size_t GetCreatedCellCount()
+    { return m_cellsCreated.load(std::memory_order_relaxed); }
+
   //! The part of the rectangle rect that is in the region that is currently drawn
   wxRect CropToUpdateRegion(wxRect rect) const;
 
@@ -564,6 +569,12 @@ public:
 
   //! Returns the group cell this cell belongs to
   GroupCell *GetGroup() const;
+  /*! Tells this cell, all cells in its list and all their inner cells which group they belong to
+
+    Needed for cells that have been created without a group, for example by a
+    background thread that mustn't touch the worksheet's GroupCells.
+  */
+  void SetGroupList(GroupCell *group);
 
   //! For the bitmap export we sometimes want to know how big the result will be...
   struct SizeInMillimeters
@@ -1044,6 +1055,8 @@ protected:
 
 private:
   void RecalcCenterListAndMaxDropCache();
+  //! The number of cells created so far. Cells are created by several threads.
+  static std::atomic<std::size_t> m_cellsCreated;
 };
 
 // The static cast here requires Cell to be defined
@@ -63,6 +63,11 @@ std::unique_ptr<Cell> CellList::SetNext(Cell *cell, std::unique_ptr<Cell> &&next
   using std::swap;
   if (next)
     Check(next.get());
+  if (cell->GetType() == MC_TYPE_GROUP)
+    static_cast<GroupCell *>(cell)->ListChanged();
+  // The cells we link to might belong to the list of another HeightIndex
+  if (next && (next->GetType() == MC_TYPE_GROUP))
+    static_cast<GroupCell *>(next.get())->ListChanged();
 
   // Reset the previous pointers so they have no chance of dangling
   if (cell->m_next)
@@ -83,6 +88,8 @@ std::unique_ptr<Cell> CellList::SetNext(Cell *cell, std::unique_ptr<Cell> &&next
 }
 
 void CellList::DeleteList(Cell *afterMe) {
+  if (afterMe->GetType() == MC_TYPE_GROUP)
+    static_cast<GroupCell *>(afterMe)->ListChanged();
   for (auto next = std::move(afterMe->m_next); next;
        next = std::move(next->m_next)) {
     next->m_previous = nullptr;
@@ -46,9 +46,7 @@ DEFINE_CELL(DigitCell)
 void DigitCell::Recalculate(AFontSize fontsize) {
   if (NeedsRecalculation(fontsize)) {
     Cell::Recalculate(fontsize);
-    SetFont(m_configuration->GetRecalcDC(), m_fontSize_Scaled);
-    wxSize sz =
-      CalculateTextSize(m_configuration->GetRecalcDC(), m_displayedText, cellText);
+    wxSize sz = CalculateTextSize(m_displayedText);
     m_width = sz.GetWidth();
     m_height = sz.GetHeight();
     m_height += 2 * MC_TEXT_PADDING;
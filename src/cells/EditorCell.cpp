@@ -578,12 +578,6 @@ void EditorCell::ConvertNumToUNicodeChar() {
   CursorMove(newChar.Length());
 }
 
-bool EditorCell::IsZoomFactorChanged() const {
-  double constexpr eps = 0.04;
-  double diff = m_configuration->GetZoomFactor() - m_lastZoomFactor;
-  return diff < -eps || diff > eps;
-}
-
 bool EditorCell::NeedsRecalculation(AFontSize fontSize) const {
   return Cell::NeedsRecalculation(fontSize) || m_containsChanges || m_isDirty;
 }
@@ -593,22 +587,19 @@ void EditorCell::Recalculate(AFontSize fontsize) {
     {
       Cell::Recalculate(fontsize);
       m_isDirty = false;
-      if (IsZoomFactorChanged()) {
-        m_widths.clear();
-        m_lastZoomFactor = m_configuration->GetZoomFactor();
-      }
       StyleText();
       SetFont(m_configuration->GetRecalcDC());
 
       // Measure the text height using characters that might extend below or above
       // the region ordinary characters move in.
-      wxCoord charWidth;
-      m_configuration->GetRecalcDC()->GetTextExtent(wxS("äXÄgy"), &charWidth, &m_charHeight);
+      wxSize const charSize = GetTextSize(wxS("äXÄgy"));
+      wxCoord const charWidth = charSize.GetWidth();
+      m_charHeight = charSize.GetHeight();
 
       // We want a little bit of vertical space between two text lines (and between
       // two labels).
       m_charHeight += 2 * MC_TEXT_PADDING;
-      wxCoord width = 0, tokenwidth, tokenheight, linewidth = 0;
+      wxCoord width = 0, linewidth = 0;
 
       m_numberOfLines = 1;
 
@@ -618,7 +609,7 @@ void EditorCell::Recalculate(AFontSize fontsize) {
           m_numberOfLines++;
           linewidth = textSnippet.GetIndentPixels();
         } else {
-          m_configuration->GetRecalcDC()->GetTextExtent(textSnippet.GetText(), &tokenwidth, &tokenheight);
+          wxCoord const tokenwidth = GetTextSize(textSnippet.GetText()).GetWidth();
           textSnippet.SetWidth(tokenwidth);
           linewidth += tokenwidth;
           width = wxMax(width, linewidth);
@@ -924,16 +915,6 @@ void EditorCell::Draw(wxPoint point, wxDC *dc, wxDC *antialiassingDC) {
   }
 }
 
-void EditorCell::SetType(CellType type) {
-  m_widths.clear();
-  Cell::SetType(type);
-}
-
-void EditorCell::SetStyle(TextStyle style) {
-  m_widths.clear();
-  Cell::SetStyle(style);
-}
-
 void EditorCell::SetFont(wxDC *dc) const {
   if(!dc)
     return;
@@ -943,17 +924,10 @@ void EditorCell::SetFont(wxDC *dc) const {
 }
 
 wxSize EditorCell::GetTextSize(wxString const &text) {
-  wxDC *dc = m_configuration->GetRecalcDC();
-  StringHash::const_iterator it = m_widths.find(text);
-
-  // If we already know this text piece's size we return the cached value
-  if (it != m_widths.end())
-    return it->second;
-
-  // Ask wxWidgets to return this text piece's size (slow!)
-  wxSize sz = dc->GetTextExtent(text);
-  m_widths[text] = sz;
-  return sz;
+  // Adding up the widths of the characters is faster than asking wxWidgets,
+  // and even faster than looking the text up in a cache.
+  return m_configuration->GetTextMetrics().GetTextSize(
+    m_configuration->GetRecalcDC(), GetTextStyle(), m_fontSize_Scaled, text);
 }
 
 void EditorCell::SetForeground(wxDC *dc) {
@@ -1921,11 +1895,6 @@ bool EditorCell::HandleOrdinaryKey(wxKeyEvent &event) {
     return false;
   }
 
-  // It may be not too intelligent to cache all pieces of a word we arrived at
-  // during typing
-  if (keyCode == ' ')
-    m_widths.clear();
-
   // if we have a selection either put parens around it (and don't write the
   // letter afterwards) or delete selection and write letter (insertLetter =
   // true).
@@ -2731,7 +2700,6 @@ wxCoord EditorCell::GetLineWidth(size_t line, size_t pos) {
   // the indentation needed.
   size_t currentLine = 1;
   wxCoord indentPixels = 0;
-  SetFont(m_configuration->GetRecalcDC());
 
   // Determine how many pixels the line is indented.
   for (const auto &textSnippet : m_styledText) {
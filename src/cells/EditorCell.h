@@ -504,9 +504,6 @@ public:
       SetSelection(m_lastSelectionStart, 0);
     }
 
-  void SetType(CellType type) override;
-  void SetStyle(TextStyle style) override;
-
   bool NeedsRecalculation(AFontSize fontSize) const override;
 
   //! Return to the selection after the cell has been left downwards
@@ -524,10 +521,6 @@ private:
   size_t m_selectionStart = 0;
   size_t m_selectionEnd = 0;
   size_t m_lastSelectionStart = 0;
-  //! Did the zoom factor change since the last recalculation?
-  bool IsZoomFactorChanged() const;
-  //! The zoom factor we had the last time we recalculated this cell.
-  double m_lastZoomFactor = -1;
   /*! A piece of styled text for syntax highlighting
 
     A piece of styled text may be
@@ -598,7 +591,6 @@ private:
     {
       ResetSize();
       ResetData();
-      m_widths.clear();
     }
 
   /*! Adds soft line breaks to code cells, if needed.
@@ -640,14 +632,6 @@ private:
 
 //** Large fields
 //**
-#if wxCHECK_VERSION(3, 3, 0) || wxUSE_STL
-  typedef std::unordered_map <wxString, wxSize> StringHash;
-#else
-  WX_DECLARE_STRING_HASH_MAP(wxSize, StringHash);
-#endif
-  //! Cached widths of text snippets, one width per style
-  StringHash m_widths;
-
   //! A list of all potential autoComplete targets within this cell
   std::vector<wxString> m_wordList;
 
@@ -43,8 +43,10 @@
 #include "LabelCell.h"
 #include "MarkDown.h"
 #include "TextCell.h"
+#include "Trace.h"
 #include "stx/unique_cast.hpp"
 #include <wx/clipbrd.h>
+#include <wx/hashmap.h>
 #include <wx/log.h>
 #include <wx/string.h>
 #include <wx/config.h>
@@ -255,7 +257,10 @@ bool GroupCell::IsFoldable() const {
           (m_groupType == GC_TYPE_HEADING6));
 }
 
-GroupCell::~GroupCell() {}
+GroupCell::~GroupCell() {
+  // A HeightIndex might still point to us
+  ListChanged();
+}
 
 const wxString &GroupCell::GetAnswer(size_t answer) const {
   if ((!m_autoAnswer) && (!m_configuration->OfferKnownAnswers()))
@@ -358,6 +363,7 @@ void GroupCell::RemoveOutput() {
     m_width = m_inputLabel->GetFullWidth();
   else
     m_width = 50;
+  HeightChanged();
 
   // Move all cells that follow the current one up by the amount this cell has
   // shrunk.
@@ -438,29 +444,13 @@ void GroupCell::UpdateConfusableCharWarnings() {
 }
 
 bool GroupCell::Recalculate() {
+  WXM_TRACE_ZONE("GroupCell::Recalculate");
   bool retval = NeedsRecalculation(EditorFontSize());
 
   if (retval == true) {
-    // Recalculating pagebreaks is simple
-    if (m_groupType == GC_TYPE_PAGEBREAK) {
-      retval = NeedsRecalculation(EditorFontSize());
-      m_width = m_configuration->GetCellBracketWidth();
-      m_height = Scale_Px(2);
-      m_center = Scale_Px(1);
-    }
-    else {
-      m_mathFontSize = m_configuration->GetMathFontSize();
-
-      if (m_inputLabel != NULL)
-        RecalculateInput();
-
+    if (BeginRecalculation())
       RecalculateOutput();
-      m_height = m_outputRect.GetHeight() + m_inputHeight;
-    }
-    ClearNeedsToRecalculateWidths();
-    Cell::Recalculate(m_configuration->GetDefaultFontSize());
-    m_cellsAppended = false;
-    m_clientWidth_old = m_configuration->GetCanvasSize().x;
+    EndRecalculation();
   }
   // Move all cells that follow the current one down by the amount this cell
   // has grown.
@@ -469,6 +459,38 @@ bool GroupCell::Recalculate() {
   return retval;
 }
 
+bool GroupCell::BeginRecalculation() {
+  // Recalculating pagebreaks is simple
+  if (m_groupType == GC_TYPE_PAGEBREAK) {
+    m_width = m_configuration->GetCellBracketWidth();
+    m_height = Scale_Px(2);
+    m_center = Scale_Px(1);
+    return false;
+  }
+
+  m_mathFontSize = m_configuration->GetMathFontSize();
+  if (m_inputLabel != NULL)
+    RecalculateInput();
+  return true;
+}
+
+void GroupCell::EndRecalculation() {
+  if (m_groupType != GC_TYPE_PAGEBREAK)
+    m_height = m_outputRect.GetHeight() + m_inputHeight;
+  ClearNeedsToRecalculateWidths();
+  Cell::Recalculate(m_configuration->GetDefaultFontSize());
+  m_cellsAppended = false;
+  m_clientWidth_old = m_configuration->GetCanvasSize().x;
+  if (m_evaluationTimes)
+    m_evaluationTimes->LaidOut();
+  HeightChanged();
+}
+
+void GroupCell::ResetOutputLayout() {
+  if (m_output)
+    m_output->ResetDataList();
+}
+
 void GroupCell::InputHeightChanged() {
   ResetCellListSizes();
   if (m_inputLabel)
@@ -482,7 +504,9 @@ void GroupCell::InputHeightChanged() {
     m_outputRect.y = m_currentPoint.y + m_center;
     m_width = wxMax(m_width, m_output->GetLineWidth());
   }
-  UpdateYPositionList();
+  HeightChanged();
+  // The cells below us read their new position from the HeightIndex
+  UpdateYPosition();
 }
 
 // Called on resize events
@@ -616,7 +640,11 @@ void GroupCell::UpdateYPosition() {
   auto *const previous = GetPrevious();
 
   wxPoint point(m_configuration->GetIndent(), GetCenter());
-  if (!previous) {
+  if (m_heightIndex && m_heightIndex->Contains(this)) {
+    point.y += m_heightIndex->GetTop(m_heightIndexSlot);
+    if (!previous && m_inputLabel)
+      m_inputLabel->SetCurrentPoint(point);
+  } else if (!previous) {
     point.y += m_configuration->GetBaseIndent();
     if (m_inputLabel)
       m_inputLabel->SetCurrentPoint(point);
@@ -690,6 +718,9 @@ void GroupCell::Draw(wxPoint const point, wxDC *dc, wxDC *antialiassingDC) {
   if (!DrawThisCell(point))
     return;
 
+  if (m_evaluationTimes)
+    m_evaluationTimes->Painted();
+
   if (m_updateConfusableCharWarnings)
     UpdateConfusableCharWarnings();
 
@@ -763,7 +794,44 @@ bool GroupCell::AddEnding() {
   return GetEditable() && GetEditable()->AddEnding();
 }
 
+void GroupCell::InputSent(long session) {
+  m_evaluationSession = -1;
+  if (!GetEditable())
+    return;
+  m_sentInputHash = wxStringHash()(GetEditable()->GetValue());
+  m_sentSession = session;
+}
+
+void GroupCell::InputEvaluated() {
+  m_evaluatedInputHash = m_sentInputHash;
+  m_evaluationSession = m_sentSession;
+  m_sentSession = -1;
+}
+
+void GroupCell::InputNotEvaluated() {
+  m_sentSession = -1;
+  m_evaluationSession = -1;
+}
+
+EvaluationTimes &GroupCell::StartEvaluationTimes() {
+  static long serial = 0;
+  m_evaluationTimes = std::make_unique<EvaluationTimes>(++serial);
+  return *m_evaluationTimes;
+}
+
+bool GroupCell::InputChangedSinceEvaluation(long session) const {
+  if (!GetEditable())
+    return false;
+  return (m_evaluationSession != session) ||
+    (m_evaluatedInputHash != wxStringHash()(GetEditable()->GetValue()));
+}
+
 wxRect GroupCell::GetRect(bool WXUNUSED(all)) const {
+  // Cells below a cell that has changed its height update m_currentPoint only
+  // when they are drawn
+  if (m_heightIndex && m_heightIndex->Contains(this))
+    return wxRect(m_currentPoint.x, m_heightIndex->GetTop(m_heightIndexSlot),
+                  m_width, m_height);
   return wxRect(m_currentPoint.x, m_currentPoint.y - m_center, m_width,
                 m_height);
 }
@@ -1455,6 +1523,7 @@ bool GroupCell::SetEditableContent(const wxString &text) {
 }
 
 void GroupCell::BreakLines() {
+  WXM_TRACE_ZONE("GroupCell::BreakLines");
   Cell *cell = m_output.get();
 
   if (cell == NULL)
@@ -34,6 +34,8 @@
 #include <memory>
 #include "Cell.h"
 #include "EditorCell.h"
+#include "EvaluationTimes.h"
+#include "HeightIndex.h"
 #include <unordered_map>
 
 //! All types a GroupCell can be of
@@ -224,6 +226,22 @@ public:
   */
   void Recalculate(AFontSize WXUNUSED(fontsize)) override {Recalculate();}
   bool Recalculate();
+
+  /*! The part of Recalculate() that needs to be done before RecalculateOutput()
+
+    Recalculate() can be split into BeginRecalculation(), RecalculateOutput()
+    and EndRecalculation(), which allows a LayoutPool to lay out the outputs
+    of many GroupCells in parallel. Only RecalculateOutput() may be called by
+    a background thread.
+
+    \return false, if the cell has no output that RecalculateOutput() needs to
+    lay out.
+  */
+  bool BeginRecalculation();
+  //! The part of Recalculate() that needs to be done after RecalculateOutput()
+  void EndRecalculation();
+  //! Forgets the layout of the output, for example after a LayoutPool has failed to do it
+  void ResetOutputLayout();
   wxPoint CalculateInputPosition();
 
   //! Recalculate the height of the input part of the cell
@@ -364,12 +382,52 @@ public:
   //! Is this cell the last cell in the evaluation Queue?
   void LastInEvaluationQueue(bool last) { m_lastInEvaluationQueue = last; }
 
+  /*! Remembers that the current input is being sent to maxima
+
+    Until InputEvaluated() is called the cell counts as not evaluated.
+    \param session Identifies the maxima process the input is sent to
+  */
+  void InputSent(long session);
+  //! Maxima has answered the last command InputSent() has sent
+  void InputEvaluated();
+  //! The evaluation of the input has been interrupted or aborted
+  void InputNotEvaluated();
+  /*! Does the input need to be evaluated in order to bring maxima up to date?
+
+    \param session Identifies the maxima process that currently runs
+    \return true if the input has changed since it has been sent to this
+            maxima or if it never has been sent to it.
+  */
+  bool InputChangedSinceEvaluation(long session) const;
+
+  //! The times the stages of the last evaluation have ended at, or NULL
+  EvaluationTimes *GetEvaluationTimes() const { return m_evaluationTimes.get(); }
+  //! Starts recording the times of a new evaluation of this cell
+  EvaluationTimes &StartEvaluationTimes();
+
+  /*! Tells the HeightIndex that knows this cell that its list has changed
+
+    Called every time GroupCells are linked or unlinked and when a GroupCell
+    is deleted.
+  */
+  void ListChanged() { if (m_heightIndex) m_heightIndex->ListChanged(); }
+  //! Called by the HeightIndex that knows this cell's position
+  void SetHeightIndex(HeightIndex *index, std::size_t slot)
+    { m_heightIndex = index; m_heightIndexSlot = slot; }
+  //! The HeightIndex that last has been told about this cell, or NULL
+  const HeightIndex *GetHeightIndex() const { return m_heightIndex; }
+  //! The slot of the HeightIndex this cell has been put into
+  std::size_t GetHeightIndexSlot() const { return m_heightIndexSlot; }
+
   //! Called on MathCtrl resize
   void OnSize();
 
   //! Reset the data when the input size changes
   void InputHeightChanged();
 
+  //! Does Recalculate() need to lay out this cell?
+  bool NeedsRecalculation() const { return NeedsRecalculation(EditorFontSize()); }
+
 #if wxCHECK_VERSION(3, 3, 0) || wxUSE_STL
   typedef std::unordered_map <wxString, wxString> StringHash;
   typedef std::unordered_map <wxString, int> CmdsAndVariables;
@@ -386,7 +444,11 @@ public:
   wxAccStatus GetLocation (wxRect &rect, int elementId) override;
 #endif
 
-  //! Recalculate the cell's y position using the position and height of the last one.
+  /*! Recalculate the cell's y position
+
+    Uses the HeightIndex, if it knows about this cell, and the position and
+    height of the last cell, if it doesn't.
+  */
   void UpdateYPosition();
 
   void UpdateOutputPositions();
@@ -401,6 +463,9 @@ protected:
   int GetInputIndent();
   int GetLineIndent (const Cell *cell) const ;
   void UpdateCellsInGroup();
+  //! Tells m_heightIndex that our height might have changed
+  void HeightChanged()
+    { if (m_heightIndex) m_heightIndex->HeightChanged(this); }
 
 //** 16-byte objects (16 bytes)
 //**
@@ -412,6 +477,20 @@ protected:
 
   std::unique_ptr<GroupCell> m_hiddenTree; //!< here hidden (folded) tree of GCs is stored
   GroupCell *m_hiddenTreeParent = {}; //!< store linkage to the parent of the fold
+  //! A hash of the input that has been sent to maxima last
+  std::size_t m_evaluatedInputHash = 0;
+  //! The maxima process m_evaluatedInputHash has been sent to, or -1
+  long m_evaluationSession = -1;
+  //! A hash of the input that is being sent to maxima
+  std::size_t m_sentInputHash = 0;
+  //! The maxima process m_sentInputHash is being sent to, or -1
+  long m_sentSession = -1;
+  //! The times of the last evaluation, see StartEvaluationTimes()
+  std::unique_ptr<EvaluationTimes> m_evaluationTimes;
+  //! The index that knows our y position, see SetHeightIndex()
+  HeightIndex *m_heightIndex = {};
+  //! Our slot in m_heightIndex
+  std::size_t m_heightIndexSlot = 0;
 
   // The pointers below point to inner cells and must be kept contiguous.
   // ** All pointers must be the same: either Cell * or std::unique_ptr<Cell>.
@@ -35,6 +35,7 @@
 #include "ImgCell.h"
 #include "CellImpl.h"
 #include "CellPointers.h"
+#include "LayoutPool.h"
 #include "StringUtils.h"
 #include <memory>
 #include <wx/clipbrd.h>
@@ -141,6 +142,11 @@ const wxString &ImgCell::GetToolTip(const wxPoint point) const {
 }
 
 void ImgCell::Recalculate(AFontSize fontsize) {
+  // Images may still be being loaded by a thread of their own.
+  if (LayoutPool::InLayoutThread()) {
+    LayoutPool::Fail(LayoutPool::guiThread);
+    return;
+  }
   if (m_image) {
     // Here we recalculate the height, as well:
     //  - This doesn't cost much time and
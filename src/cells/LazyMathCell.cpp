@@ -0,0 +1,310 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  This file defines the class LazyMathCell
+
+  LazyMathCell is the Cell type that stands in for a big output of maxima
+  until it is scrolled into view.
+*/
+
+#include "LazyMathCell.h"
+#include "CellImpl.h"
+#include "CellPointers.h"
+#include "MathParser.h"
+#include "StringUtils.h"
+#include "TextCell.h"
+#include "XMLTokenStream.h"
+#include <utility>
+#include <vector>
+#include <wx/mstream.h>
+#include <wx/zstream.h>
+
+LazyMathCell::LazyMathCell(GroupCell *group, Configuration *config,
+                           const wxString &xml, CellType style,
+                           const wxString &userLabel)
+  : Cell(group, config), m_xmlLength(xml.Length()), m_userLabel(userLabel),
+    m_parserStyle(style) {
+  InitBitFields();
+  SetStyle(TS_WARNING);
+  {
+    wxMemoryOutputStream ostream;
+    {
+      wxZlibOutputStream zstream(ostream, wxZ_BEST_SPEED);
+      wxScopedCharBuffer const utf8 = xml.utf8_str();
+      zstream.Write(utf8.data(), utf8.length());
+    }
+    m_compressedXML.SetBufSize(ostream.GetSize());
+    m_compressedXML.SetDataLen(
+                               ostream.CopyTo(m_compressedXML.GetData(), ostream.GetSize()));
+  }
+  m_placeholder = std::make_unique<TextCell>(
+                                             group, config,
+                                             wxString::Format(T_("(An output of about %li kB. It is displayed once it is scrolled into view.)"),
+                                                              static_cast<long>(m_xmlLength / 1000 + 1)),
+                                             TS_WARNING);
+  m_placeholder->SetToolTip(&T_(
+                                "wxMaxima only converts big outputs to formulas when they "
+                                "are visible. The size outputs need to have in order to be "
+                                "treated this way can be changed in the configuration dialogue."));
+  ForceBreakLine(true);
+}
+
+// Old cppcheck bugs:
+// cppcheck-suppress uninitMemberVar symbolName=LazyMathCell::m_innerCell
+LazyMathCell::LazyMathCell(GroupCell *group, const LazyMathCell &cell)
+  : Cell(group, cell.m_configuration), m_compressedXML(cell.m_compressedXML),
+    m_xmlLength(cell.m_xmlLength), m_userLabel(cell.m_userLabel),
+    m_placeholder(cell.m_placeholder->CopyList(group)),
+    m_parserStyle(cell.m_parserStyle) {
+  InitBitFields();
+  CopyCommonData(cell);
+}
+
+DEFINE_CELL(LazyMathCell)
+
+wxString LazyMathCell::GetXML() const {
+  wxMemoryInputStream istream(m_compressedXML.GetData(),
+                              m_compressedXML.GetDataLen());
+  wxZlibInputStream zstream(istream);
+  std::vector<char> xml;
+
+  static constexpr auto chunkSize = 65536;
+  while (!zstream.Eof()) {
+    auto const baseSize = xml.size();
+    xml.resize(baseSize + chunkSize);
+    zstream.Read(xml.data() + baseSize, chunkSize);
+    if (zstream.LastRead() < chunkSize)
+      xml.resize(baseSize + zstream.LastRead());
+  }
+  return wxString::FromUTF8(xml.data(), xml.size());
+}
+
+std::unique_ptr<Cell> LazyMathCell::ParseXML() const {
+  MathParser parser(m_configuration);
+  parser.SetGroup(m_group);
+  parser.SetUserLabel(m_userLabel);
+  std::unique_ptr<Cell> cell = parser.ParseLineNow(GetXML(), m_parserStyle);
+  if (!cell)
+    cell = std::make_unique<TextCell>(m_group, m_configuration,
+                                      T_("(The output couldn't be read)"),
+                                      TS_ERROR);
+  return cell;
+}
+
+const Cell *LazyMathCell::GetContents() const {
+  if (m_innerCell)
+    return m_innerCell.get();
+  if (!m_exportedContents)
+    m_exportedContents = ParseXML();
+  else
+    // The cell may have been moved to another group since
+    m_exportedContents->SetGroupList(m_group);
+  return m_exportedContents.get();
+}
+
+void LazyMathCell::RequestUpdate(bool materialize) {
+  m_materialize = materialize;
+  if (m_updateRequested || !m_group || !m_configuration->GetWorkSheet())
+    return;
+  m_updateRequested = true;
+  GetCellPointers()->m_lazyCellsToUpdate.emplace_back(this);
+}
+
+bool LazyMathCell::Update() {
+  m_updateRequested = false;
+  if (m_materialize == IsMaterialized())
+    return false;
+
+  if (m_materialize) {
+    wxLogMessage(_("Converting an output of %li chars to formulas"),
+                 static_cast<long>(m_xmlLength));
+    if (m_exportedContents) {
+      // The contents have already been parsed for exporting them
+      m_innerCell = std::move(m_exportedContents);
+      m_innerCell->SetGroupList(m_group);
+    } else
+      m_innerCell = ParseXML();
+  } else {
+    ReserveSize();
+    Unbreak();
+    m_innerCell.reset();
+  }
+  ResetCellListSizes();
+  ResetSize();
+  return true;
+}
+
+void LazyMathCell::ReserveSize() {
+  if (!IsMaterialized())
+    return;
+  wxRect rect;
+  bool firstLine = true;
+  wxCoord center = m_center;
+  Cell *const end = GetNext();
+  for (Cell &tmp : OnDrawList(m_innerCell.get())) {
+    if (&tmp == end)
+      break;
+    if ((tmp.GetWidth() <= 0) || (tmp.GetHeight() <= 0) ||
+        !tmp.HasValidPosition())
+      continue;
+    if (firstLine) {
+      rect = tmp.GetRect();
+      center = tmp.GetCurrentPoint().y - rect.GetTop();
+      firstLine = false;
+    } else
+      rect.Union(tmp.GetRect());
+  }
+  if (firstLine) {
+    // Nothing of our contents has been laid out, yet.
+    m_reservedSize = {};
+    return;
+  }
+  m_reservedSize.width = rect.GetWidth();
+  m_reservedSize.height = rect.GetHeight();
+  m_reservedSize.center = center;
+  m_reservedSize.canvasWidth = m_configuration->GetCanvasSize().x;
+  m_reservedSize.zoomFactor = m_configuration->GetZoomFactor();
+}
+
+void LazyMathCell::ClearCache() {
+  // We are far out of view: Free the memory our contents occupy
+  m_exportedContents.reset();
+  if (IsMaterialized())
+    RequestUpdate(false);
+  else if (m_updateRequested)
+    m_materialize = false;
+}
+
+void LazyMathCell::Recalculate(AFontSize fontsize) {
+  if (m_innerCell) {
+    m_innerCell->RecalculateList(fontsize);
+    if (!IsBrokenIntoLines()) {
+      m_width = m_innerCell->GetFullWidth();
+      m_height = m_innerCell->GetHeightList();
+      m_center = m_innerCell->GetCenterList();
+    } else {
+      // The LazyMathCell itself isn't displayed if it is broken into lines,
+      // its contents are.
+      m_width = 0;
+      m_height = 0;
+      m_center = 0;
+    }
+  } else {
+    m_placeholder->RecalculateList(fontsize);
+    if ((m_reservedSize.height >= 0) &&
+        (m_reservedSize.canvasWidth == m_configuration->GetCanvasSize().x) &&
+        (m_reservedSize.zoomFactor == m_configuration->GetZoomFactor())) {
+      m_width = m_reservedSize.width;
+      m_height = m_reservedSize.height;
+      m_center = m_reservedSize.center;
+    } else {
+      m_reservedSize = {};
+      m_width = m_placeholder->GetFullWidth();
+      m_height = m_placeholder->GetHeightList();
+      m_center = m_placeholder->GetCenterList();
+    }
+  }
+  Cell::Recalculate(fontsize);
+}
+
+void LazyMathCell::Draw(wxPoint point, wxDC *dc, wxDC *antialiassingDC) {
+  Cell::Draw(point, dc, antialiassingDC);
+  if (DrawThisCell(point)) {
+    if (m_innerCell)
+      m_innerCell->DrawList(point, dc, antialiassingDC);
+    else {
+      wxPoint placeholder = point;
+      placeholder.y += m_placeholder->GetCenterList() - m_center;
+      m_placeholder->DrawList(placeholder, dc, antialiassingDC);
+      RequestUpdate(true);
+    }
+  }
+}
+
+wxString LazyMathCell::ToString() const {
+  if (IsBrokenIntoLines())
+    return wxEmptyString;
+  return GetContents()->ListToString();
+}
+
+wxString LazyMathCell::ToMatlab() const {
+  if (IsBrokenIntoLines())
+    return wxEmptyString;
+  return GetContents()->ListToMatlab();
+}
+
+wxString LazyMathCell::ToTeX() const {
+  if (IsBrokenIntoLines())
+    return wxEmptyString;
+  return GetContents()->ListToTeX();
+}
+
+wxString LazyMathCell::ToMathML() const {
+  if (IsBrokenIntoLines())
+    return wxEmptyString;
+  return GetContents()->ListToMathML();
+}
+
+wxString LazyMathCell::ToOMML() const {
+  if (IsBrokenIntoLines())
+    return wxEmptyString;
+  return GetContents()->ListToOMML();
+}
+
+wxString LazyMathCell::ToXML() const {
+  if (m_innerCell)
+    return m_innerCell->ListToXML();
+
+  // MathParser reads the XML maxima has sent as well as the XML cells are
+  // saved as => save the contents of its root element without converting
+  // them to cells. Writing them back token by token makes sure they are
+  // well-formed, even if maxima's output contained control chars.
+  wxString const xml = GetXML();
+  XMLTokenStream tokens(xml);
+  while (tokens.Next() == XMLTokenStream::text) {}
+  wxString result;
+  if (tokens.ReadContentsAsXML(result))
+    return result;
+  // Broken XML: Save what the user sees instead.
+  return GetContents()->ListToXML();
+}
+
+bool LazyMathCell::BreakUp() {
+  // A placeholder cannot be broken into lines.
+  if (IsBrokenIntoLines() || !m_innerCell)
+    return false;
+
+  Cell::BreakUpAndMark();
+  m_innerCell->last()->SetNextToDraw(m_nextToDraw);
+  m_nextToDraw = m_innerCell;
+  ResetCellListSizes();
+  m_height = 0;
+  m_center = 0;
+  return true;
+}
+
+void LazyMathCell::SetNextToDraw(Cell *next) {
+  if (IsBrokenIntoLines())
+    m_innerCell->last()->SetNextToDraw(next);
+  else
+    m_nextToDraw = next;
+}
@@ -0,0 +1,168 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#ifndef LAZYMATHCELL_H
+#define LAZYMATHCELL_H
+
+#include <memory>
+#include <wx/buffer.h>
+#include "Cell.h"
+
+/*! \file
+
+  This file defines the class for the cell that stands in for a big output
+  until it is displayed.
+*/
+
+/*! A cell that keeps a big output of maxima in its XML form
+
+  Parsing and laying out a really big output can take longer than
+  evaluating it. This cell therefore only keeps the compressed XML maxima
+  has sent and shows a short placeholder text instead. Once the placeholder
+  is drawn inside the visible region the cell asks the worksheet to convert
+  the XML to cells (see RequestUpdate()). If the output later is scrolled
+  far out of view ClearCache() asks the worksheet to drop these cells, again:
+  The cell then keeps the size the output had so the worksheet doesn't jump.
+
+  If the contents have been converted to cells and are broken into lines in
+  the order of m_nextToDraw this cell is represented by its contents. In all
+  other cases m_nextToDraw points to the cell that follows this Cell.
+*/
+class LazyMathCell final : public Cell
+{
+public:
+  /*! The constructor
+
+    \param group The group the cell belongs to
+    \param config The configuration
+    \param xml The line of XML maxima has sent, see MathParser::ParseLine()
+    \param style The cell type the XML is to be parsed with
+    \param userLabel The user label the XML is to be parsed with
+  */
+  LazyMathCell(GroupCell *group, Configuration *config, const wxString &xml,
+               CellType style, const wxString &userLabel);
+  LazyMathCell(GroupCell *group, const LazyMathCell &cell);
+  std::unique_ptr<Cell> Copy(GroupCell *group) const override;
+  const CellTypeInfo &GetInfo() override;
+
+  size_t GetInnerCellCount() const override { return 2; }
+  // cppcheck-suppress objectIndex
+  Cell *GetInnerCell(size_t index) const override { return (&m_placeholder)[index].get(); }
+
+  bool BreakUp() override;
+
+  void SetNextToDraw(Cell *next) override;
+
+  //! Have the contents been converted to cells?
+  bool IsMaterialized() const { return static_cast<bool>(m_innerCell); }
+
+  /*! Converts the contents to cells, or drops them, as requested by RequestUpdate()
+
+    Must be called by the worksheet only, as the group this cell belongs to
+    needs to be recalculated afterwards.
+    \return true, if the cells this cell contains have changed.
+  */
+  bool Update();
+
+  void ClearCache() override;
+
+  void FontsChanged() override
+    {
+      Cell::FontsChanged();
+      m_reservedSize = {};
+    }
+
+private:
+  //! Asks the worksheet to call Update() the next time it is idle.
+  void RequestUpdate(bool materialize);
+  //! Converts the compressed XML to a list of cells
+  std::unique_ptr<Cell> ParseXML() const;
+  /*! The contents as cells, for exporting them
+
+    If the contents haven't been converted to cells the XML is parsed once
+    and kept until ClearCache() is called, so exporting the cell in several
+    formats doesn't parse it again and again.
+  */
+  const Cell *GetContents() const;
+  //! The uncompressed XML
+  wxString GetXML() const;
+  //! Determine the size our contents currently take up in the worksheet
+  void ReserveSize();
+
+  //! The size of the released contents, and what it depends on
+  struct ReservedSize
+  {
+    wxCoord width = -1;
+    wxCoord height = -1;
+    wxCoord center = -1;
+    wxCoord canvasWidth = -1;
+    double zoomFactor = 0;
+  };
+
+  //! The XML, compressed by zlib
+  wxMemoryBuffer m_compressedXML;
+  //! The length of the uncompressed XML, in chars
+  std::size_t m_xmlLength = 0;
+  //! The user label MathParser needs for parsing the XML
+  wxString m_userLabel;
+  //! The size the contents had the last time they were displayed
+  ReservedSize m_reservedSize;
+  //! The contents GetContents() has parsed while they weren't displayed
+  mutable std::unique_ptr<Cell> m_exportedContents;
+
+  // The pointers below point to inner cells and must be kept contiguous.
+  // ** All pointers must be the same:
+  // ** either Cell * or std::unique_ptr<Cell>. NO OTHER TYPES are allowed.
+  //! The text that is displayed until the contents have been parsed
+  std::unique_ptr<Cell> m_placeholder;
+  //! The contents, or nullptr if they haven't been parsed, yet
+  std::unique_ptr<Cell> m_innerCell;
+  // The pointers above point to inner cells and must be kept contiguous.
+
+  //! The cell type the XML is parsed with
+  CellType m_parserStyle = MC_TYPE_DEFAULT;
+
+//** Bitfield objects (1 bytes)
+//**
+  void InitBitFields()
+    { // Keep the initialization order below same as the order
+      // of bit fields in this class!
+      m_updateRequested = false;
+      m_materialize = false;
+    }
+  //! Has the worksheet been asked to call Update()?
+  bool m_updateRequested : 1 /* InitBitFields */;
+  //! Shall Update() create the cells (true) or drop them (false)?
+  bool m_materialize : 1 /* InitBitFields */;
+
+  void Recalculate(AFontSize fontsize) override;
+
+  void Draw(wxPoint point, wxDC *dc, wxDC *antialiassingDC) override;
+
+  wxString ToMathML() const override;
+  wxString ToMatlab() const override;
+  wxString ToOMML() const override;
+  wxString ToString() const override;
+  wxString ToTeX() const override;
+  wxString ToXML() const override;
+};
+
+#endif // LAZYMATHCELL_H
@@ -64,7 +64,6 @@ void LongNumberCell::UpdateDisplayedText() {
     m_ellipsis.clear();
     m_numEnd.clear();
   }
-  m_sizeCache.clear();
   m_displayedDigits_old = m_configuration->GetDisplayedDigits();
 }
 
@@ -108,11 +107,9 @@ void LongNumberCell::Recalculate(AFontSize fontsize) {
       else {
         Cell::Recalculate(fontsize);
         m_keepPercent_last = m_configuration->CheckKeepPercent();
-        wxDC *dc = m_configuration->GetRecalcDC();
-        SetFont(dc, m_fontSize_Scaled);
-        auto numStartSize = CalculateTextSize(dc, m_numStart, numberStart);
-        auto ellipsisSize = CalculateTextSize(dc, m_ellipsis, ellipsis);
-        auto numEndSize = CalculateTextSize(dc, m_numEnd, numberEnd);
+        auto numStartSize = CalculateTextSize(m_numStart);
+        auto ellipsisSize = CalculateTextSize(m_ellipsis);
+        auto numEndSize = CalculateTextSize(m_numEnd);
         m_numStartWidth = numStartSize.GetWidth();
         m_ellipsisWidth = ellipsisSize.GetWidth();
         m_width = m_numStartWidth + m_ellipsisWidth + numEndSize.GetWidth();
@@ -30,6 +30,7 @@
 
 #include "ParenCell.h"
 #include "CellImpl.h"
+#include "TextCell.h"
 #include "VisiblyInvalidCell.h"
 
 ParenCell::ParenCell(GroupCell *group, Configuration *config,
@@ -84,7 +85,6 @@ void ParenCell::Recalculate(AFontSize fontsize) {
   m_open->RecalculateList(fontsize);
   m_close->RecalculateList(fontsize);
 
-  wxDC *dc = m_configuration->GetRecalcDC();
   auto fontsize1 = Scale_Px(fontsize);
   int size = 0;
   if(m_innerCell)
@@ -114,7 +114,10 @@ void ParenCell::Recalculate(AFontSize fontsize) {
   m_height = wxMax(m_signHeight, innerCellHeight) + Scale_Px(2);
   m_center = m_height / 2;
 
-  dc->GetTextExtent(wxS("("), &m_charWidth1, &m_charHeight1);
+  wxSize const charSize =
+    static_cast<TextCell &>(*m_open).CalculateTextSize(wxS("("));
+  m_charWidth1 = charSize.GetWidth();
+  m_charHeight1 = charSize.GetHeight();
   if (m_charHeight1 < 2)
     m_charHeight1 = 2;
 
@@ -31,9 +31,35 @@
 
 #include "TextCell.h"
 #include "CellImpl.h"
+#include "GroupCell.h"
+#include "LayoutPool.h"
 #include "StringUtils.h"
 #include <wx/config.h>
 
+/*! Does this number look like 0.1000000000000002 or 0.0999999999999998?
+
+  Doesn't use wxRegEx: A wxRegEx cannot be used by several threads at once, and
+  cells are also created by the threads that parse maxima's output.
+*/
+static bool LooksLikeRoundingError(const wxString &number) {
+  static const wxString zeros(wxS(".000000000000"));
+  static const wxString nines(wxS(".999999999999"));
+  for (const wxString *pattern : {&zeros, &nines}) {
+    std::size_t pos = 0;
+    while ((pos = number.find(*pattern, pos)) != wxString::npos) {
+      std::size_t const digitsStart = pos + pattern->length();
+      std::size_t digitsEnd = digitsStart;
+      while ((digitsEnd < number.length()) && wxIsdigit(number[digitsEnd]))
+        digitsEnd++;
+      if ((digitsEnd > digitsStart) &&
+          ((digitsEnd == number.length()) || (number[digitsEnd] == wxS('e'))))
+        return true;
+      pos++;
+    }
+  }
+  return false;
+}
+
 TextCell::TextCell(GroupCell *group, Configuration *config,
                    const wxString &text, TextStyle style)
   : Cell(group, config)
@@ -137,7 +163,6 @@ TextCell::TextCell(GroupCell *group, const TextCell &cell)
 DEFINE_CELL(TextCell)
 
 void TextCell::SetStyle(TextStyle style) {
-  m_sizeCache.clear();
   Cell::SetStyle(style);
   if ((m_text == wxS("gamma")) && (GetTextStyle() == TS_FUNCTION))
     m_displayedText = wxS("\u0393");
@@ -149,11 +174,6 @@ void TextCell::SetStyle(TextStyle style) {
   ResetSize();
 }
 
-void TextCell::SetType(CellType type) {
-  m_sizeCache.clear();
-  Cell::SetType(type);
-}
-
 void TextCell::UpdateToolTip() {
   if (m_promptTooltip)
     SetToolTip(
@@ -216,10 +236,7 @@ void TextCell::UpdateToolTip() {
   }
 
   else if (GetTextStyle() == TS_NUMBER) {
-    if ((m_roundingErrorRegEx1.Matches(m_text)) ||
-        (m_roundingErrorRegEx2.Matches(m_text)) ||
-        (m_roundingErrorRegEx3.Matches(m_text)) ||
-        (m_roundingErrorRegEx4.Matches(m_text)))
+    if (LooksLikeRoundingError(m_text))
       SetToolTip(&T_(
                      "As calculating 0.1^12 demonstrates maxima by default doesn't tend "
                      "to "
@@ -388,13 +405,45 @@ void TextCell::UpdateToolTip() {
 }
 
 void TextCell::SetValue(const wxString &text) {
-  m_sizeCache.clear();
   m_text = text;
   ResetSize();
   UpdateDisplayedText();
   UpdateToolTip();
 }
 
+void TextCell::AppendText(const wxString &text) {
+  if (text.IsEmpty())
+    return;
+
+  // Short texts might be symbols that are displayed differently as a
+  // whole. Only plain texts can be converted piece by piece.
+  bool canAppend = (m_text.Length() >= 16) && HasValidSize() &&
+    ((GetTextStyle() == TS_TEXT) || (GetTextStyle() == TS_ASCIIMATHS) ||
+     (GetTextStyle() == TS_MATH) || (GetTextStyle() == TS_WARNING) ||
+     (GetTextStyle() == TS_ERROR));
+  // An arrow might be split between the old and the new text.
+  if (canAppend) {
+    wxUniChar const last = m_text.Last();
+    canAppend = (last != wxS('-')) && (last != wxS(' ')) &&
+      (last != wxS('\u2212')) && (last != wxS('\u2192'));
+  }
+  if (!canAppend) {
+    SetValue(m_text + text);
+    return;
+  }
+
+  m_text += text;
+  wxString displayed = text;
+  ReplaceCharsForDisplay(displayed);
+  m_displayedText += displayed;
+  m_unmeasuredText += displayed;
+  // Our size stays valid: Recalculate() only needs to add the width of the
+  // new text. But the lines we are part of have changed.
+  ResetCellListSizes();
+  if (m_group)
+    GetGroup()->ResetSize();
+}
+
 AFontSize TextCell::GetScaledTextSize() const { return m_fontSize_Scaled; }
 
 bool TextCell::NeedsRecalculation(AFontSize fontSize) const {
@@ -402,28 +451,42 @@ bool TextCell::NeedsRecalculation(AFontSize fontSize) const {
     (m_keepPercent_last != m_configuration->CheckKeepPercent());
 }
 
-wxSize TextCell::CalculateTextSize(wxDC *const dc, const wxString &text,
-                                   TextCell::TextIndex const index) {
+wxSize TextCell::CalculateTextSize(const wxString &text) {
   AFontSize const fontSize = GetScaledTextSize();
   if (text.empty())
     return {};
 
-  auto const size = dc->GetTextExtent(text);
-  m_sizeCache.emplace_back(size, fontSize, index);
+  TextMetrics &metrics = m_configuration->GetTextMetrics();
+  wxSize size;
+  if (LayoutPool::InLayoutThread()) {
+    // Only the GUI thread may use the wxDC.
+    switch (metrics.GetTextSize(GetTextStyle(), fontSize, text, size)) {
+    case TextMetrics::measured:
+      break;
+    case TextMetrics::missing:
+      LayoutPool::Fail(LayoutPool::retry);
+      return {};
+    }
+  } else
+    size = metrics.GetTextSize(m_configuration->GetRecalcDC(), GetTextStyle(),
+                               fontSize, text);
   return size;
 }
 
+void TextCell::ReplaceCharsForDisplay(wxString &text) {
+  text.Replace(wxS("\xDCB6"), wxS("\u00A0")); // A non-breakable space
+  text.Replace(wxS("\n"), wxEmptyString);
+  text.Replace(wxS("-->"), wxS("\u2794"));
+  text.Replace(wxS(" -->"), wxS("\u2794"));
+  text.Replace(wxS(" \u2212\u2192 "), wxS("\u2794"));
+  text.Replace(wxS("->"), wxS("\u2192"));
+  text.Replace(wxS("\u2212>"), wxS("\u2192"));
+}
+
 void TextCell::UpdateDisplayedText() {
   m_displayedText = m_text;
-
-  m_displayedText.Replace(wxS("\xDCB6"),
-                          wxS("\u00A0")); // A non-breakable space
-  m_displayedText.Replace(wxS("\n"), wxEmptyString);
-  m_displayedText.Replace(wxS("-->"), wxS("\u2794"));
-  m_displayedText.Replace(wxS(" -->"), wxS("\u2794"));
-  m_displayedText.Replace(wxS(" \u2212\u2192 "), wxS("\u2794"));
-  m_displayedText.Replace(wxS("->"), wxS("\u2192"));
-  m_displayedText.Replace(wxS("\u2212>"), wxS("\u2192"));
+  m_unmeasuredText.clear();
+  ReplaceCharsForDisplay(m_displayedText);
 
   if (GetTextStyle() == TS_FUNCTION) {
     if (m_text == wxS("ilt"))
@@ -462,10 +525,8 @@ void TextCell::Recalculate(AFontSize fontsize) {
   if (NeedsRecalculation(fontsize)) {
     Cell::Recalculate(fontsize);
     m_keepPercent_last = m_configuration->CheckKeepPercent();
-    SetFont(m_configuration->GetRecalcDC(), m_fontSize_Scaled);
 
-    wxSize sz =
-      CalculateTextSize(m_configuration->GetRecalcDC(), m_displayedText, cellText);
+    wxSize sz = CalculateTextSize(m_displayedText);
     m_width = sz.GetWidth();
     m_height = sz.GetHeight();
 
@@ -481,6 +542,17 @@ void TextCell::Recalculate(AFontSize fontsize) {
     if (m_height < Scale_Px(4))
       m_height = Scale_Px(4);
     m_center = m_height / 2;
+    m_unmeasuredText.clear();
+  }
+  else if (!m_unmeasuredText.IsEmpty()) {
+    // Only text has been appended since we were measured last. Measuring
+    // only the new text ignores the kerning between the old and the new
+    // text, which is less than a pixel.
+    wxSize const sz = CalculateTextSize(m_unmeasuredText);
+    m_width += sz.GetWidth();
+    m_height = wxMax(m_height, sz.GetHeight() + 2 * MC_TEXT_PADDING);
+    m_center = m_height / 2;
+    m_unmeasuredText.clear();
   }
 }
 
@@ -1588,7 +1660,3 @@ wxString TextCell::GetSymbolTeX() const {
 
 // RegExes all TextCells share.
 wxRegEx TextCell::m_unescapeRegEx(wxS("\\\\(.)"));
-wxRegEx TextCell::m_roundingErrorRegEx1(wxS("\\.000000000000[0-9]+$"));
-wxRegEx TextCell::m_roundingErrorRegEx2(wxS("\\.999999999999[0-9]+$"));
-wxRegEx TextCell::m_roundingErrorRegEx3(wxS("\\.000000000000[0-9]+e"));
-wxRegEx TextCell::m_roundingErrorRegEx4(wxS("\\.999999999999[0-9]+e"));
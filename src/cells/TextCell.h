@@ -49,6 +49,14 @@ public:
   //! Set the text contained in this cell
   void SetValue(const wxString &text) override;
 
+  /*! Append text to the text contained in this cell
+
+    For a long plain text only the appended text is converted for display
+    and measured, which makes streaming output into a cell cost a constant
+    amount of time per appended piece.
+  */
+  void AppendText(const wxString &text);
+
   virtual void Recalculate(AFontSize fontsize) override;
 
   void Draw(wxPoint point, wxDC *dc, wxDC *antialiassingDC) override;
@@ -57,6 +65,12 @@ public:
   }
   //cppcheck-suppress functionConst
   void SetFont(wxDC *dc, AFontSize fontsize);
+  /*! Determines the size of a text in this cell's font
+
+    Adds up the widths of the characters Configuration::GetTextMetrics()
+    knows, which in the GUI thread measures characters that are new to it.
+  */
+  wxSize CalculateTextSize(const wxString &text);
 
   /*! Calling this function signals that the "(" this cell ends in isn't part of the function name
 
@@ -86,8 +100,6 @@ public:
 
   bool IsShortNum() const override;
 
-  void SetType(CellType type) override;
-
   void SetAltCopyText(const wxString &text) override {m_altCopyText = text;}
 
   void SetPromptTooltip(bool use) { m_promptTooltip = use; }
@@ -98,6 +110,8 @@ protected:
   virtual wxString GetXMLFlags() const;
   //! The text we actually display depends on many factors, unfortunately
   virtual void UpdateDisplayedText();
+  //! The character replacements for display that don't depend on the text as a whole
+  static void ReplaceCharsForDisplay(wxString &text);
   //! Update the tooltip for this cell
   void UpdateToolTip();
   const wxString &GetAltCopyText() const override { return m_altCopyText; }
@@ -106,37 +120,11 @@ protected:
     {
       ResetSize();
       ResetData();
-      m_sizeCache.clear();
     }
 
   virtual bool NeedsRecalculation(AFontSize fontSize) const override;
 
-  enum TextIndex : int8_t
-  {
-    noText,
-    cellText,
-    userLabelText,
-    numberStart,
-    ellipsis,
-    numberEnd
-  };
-
-  struct SizeEntry {
-    wxSize textSize;
-    AFontSize fontSize;
-    TextIndex index = cellText;
-    SizeEntry(wxSize textSize, AFontSize fontSize, TextIndex index) :
-      textSize(textSize), fontSize(fontSize), index(index) {}
-    SizeEntry() = default;
-  };
-
-  wxSize CalculateTextSize(wxDC *dc, const wxString &text, TextCell::TextIndex const index);
-
   static wxRegEx m_unescapeRegEx;
-  static wxRegEx m_roundingErrorRegEx1;
-  static wxRegEx m_roundingErrorRegEx2;
-  static wxRegEx m_roundingErrorRegEx3;
-  static wxRegEx m_roundingErrorRegEx4;
 
 //** Large objects (120 bytes)
 //**
@@ -144,7 +132,8 @@ protected:
   wxString m_text;
   //! The text we display: We might want to convert some characters or do similar things
   wxString m_displayedText;
-  std::vector<SizeEntry> m_sizeCache;
+  //! The part of m_displayedText AppendText() has added since the last measurement
+  wxString m_unmeasuredText;
 
 //** Bitfield objects (1 bytes)
 //**
@@ -27,6 +27,8 @@
 
 #include "main.h"
 #include "Dirstructure.h"
+#include "SpareMaxima.h"
+#include "Trace.h"
 #include "wxMathml.h"
 #include <iostream>
 #include <wx/cmdline.h>
@@ -82,6 +84,7 @@ wxDECLARE_APP(MyApp);
 int CommonMain() {
   wxTheApp->CallOnInit();
   wxTheApp->OnRun();
+  Trace::Write();
   wxConfigBase *config = wxConfig::Get();
   config->Flush();
   delete config;
@@ -125,6 +128,13 @@ static const wxCmdLineEntryDesc cmdLineDesc[] = {
    wxCMD_LINE_VAL_NONE, 0},
   {wxCMD_LINE_SWITCH, "", "exit-on-error",
    "Close the program on any Maxima error.", wxCMD_LINE_VAL_NONE, 0},
+  {wxCMD_LINE_OPTION, "", "record",
+   "Record all data exchanged with Maxima to the file <str>.",
+   wxCMD_LINE_VAL_STRING, 0},
+  {wxCMD_LINE_SWITCH, "", "benchmark",
+   "Log how many cells the output of each command has created, how long it "
+   "took to parse and to lay them out and the peak memory usage.",
+   wxCMD_LINE_VAL_NONE, 0},
   {wxCMD_LINE_OPTION, "f", "ini",
    "Allows to specify a file to store the configuration in.",
    wxCMD_LINE_VAL_STRING, 0},
@@ -142,6 +152,12 @@ static const wxCmdLineEntryDesc cmdLineDesc[] = {
    "Lets Maxima control wxMaxima via interprocess communications. Use this "
    "option with care.",
    wxCMD_LINE_VAL_NONE, 0},
+#ifdef USE_TRACING
+  {wxCMD_LINE_OPTION, "", "trace",
+   "Record a trace of what takes how long to the file <str>. It can be "
+   "displayed by https://ui.perfetto.dev or chrome://tracing.",
+   wxCMD_LINE_VAL_STRING, 0},
+#endif
   {wxCMD_LINE_OPTION, "", "wxmathml-lisp",
    "Location of wxMathML.lisp (if not the built-in should be used, mainly for developers).",
    wxCMD_LINE_VAL_STRING, 0},
@@ -338,6 +354,17 @@ bool MyApp::OnInit() {
 
   wxString extraMaximaArgs;
   wxString arg;
+  if (cmdLineParser.Found(wxS("record"), &arg))
+    wxMaxima::RecordMaximaSession(arg);
+
+  if (cmdLineParser.Found(wxS("benchmark")))
+    wxMaxima::Benchmark();
+
+#ifdef USE_TRACING
+  if (cmdLineParser.Found(wxS("trace"), &arg))
+    Trace::Start(arg);
+#endif
+
   if (cmdLineParser.Found(wxS("l"), &arg))
     extraMaximaArgs += " -l " + arg;
 
@@ -454,7 +481,10 @@ bool MyApp::OnInit() {
   return true;
 }
 
-int MyApp::OnExit() { return 0; }
+int MyApp::OnExit() {
+  SpareMaxima::Destroy();
+  return 0;
+}
 
 int MyApp::OnRun() {
   wxLogStderr noErrorDialogs;
@@ -94,6 +94,48 @@
 (defvar $wxplot_usesvg nil "Create scalable plots?")
 (defvar $wxplot_pngcairo nil "Use gnuplot's pngcairo terminal for new plots?")
 (defmvar $wxplot_old_gnuplot nil)
+(defvar *wx-framed-output* nil
+  "Tell wxMaxima the length of each piece of XML output before sending it?")
+
+;; The number of bytes the UTF-8 representation of a string occupies
+;;
+;; GCL doesn't know about unicode: Its strings already consist of the bytes
+;; it will send.
+(defun wx-utf8-length (str)
+  #+gcl (length str)
+  #-gcl (let ((len 0))
+	  (loop for c across str do
+	       (let ((code (char-code c)))
+		 (incf len (cond ((< code #x80) 1)
+				 ((< code #x800) 2)
+				 ((< code #x10000) 3)
+				 (t 4)))))
+	  len))
+
+;; Sends a piece of output to wxMaxima, preceded by its length in bytes:
+;;
+;;   <wxframe length="N">payload</wxframe>
+;;
+;; This way wxMaxima can cut the payload from the data it receives without
+;; having to search for its end. If the length doesn't match (if, for
+;; example, the lisp converts newlines to CR/LF) wxMaxima falls back to
+;; searching for the </wxframe>.
+(defun wx-write-frame (payload)
+  (format t "<wxframe length=\"~d\">~a</wxframe>" (wx-utf8-length payload) payload))
+
+;; Runs body. If wxMaxima has asked for framed output everything body prints
+;; is sent as one frame. Frames aren't nested: Output of a nested
+;; wx-with-frame simply becomes part of the outer frame.
+(defmacro wx-with-frame (&body body)
+  (let ((result (gensym)))
+    `(if *wx-framed-output*
+	 (let (,result)
+	   (wx-write-frame
+	    (with-output-to-string (*standard-output*)
+	      (let ((*wx-framed-output* nil))
+		(setq ,result (progn ,@body)))))
+	   ,result)
+	 (progn ,@body))))
 
 ;; A string replace function that we later use excessively
 (defun wxxml-string-substitute (newstring oldchar x &aux matchpos)
@@ -109,12 +151,13 @@
 
 ;; Tell maxima how to send a list of manual topics to show to us
 (defun display-frontend-topics (topiclist)
-  (format t "<html-manual-keywords>")
-  (mapcar #'(lambda (&rest x) (format t "<keyword>~a</keyword>"
-				      (wxxml-fix-string
-				       (first (second (first x))))))
-	  topiclist)
-  (format t "</html-manual-keywords>~%"))
+  (wx-with-frame
+    (format t "<html-manual-keywords>")
+    (mapcar #'(lambda (&rest x) (format t "<keyword>~a</keyword>"
+					(wxxml-fix-string
+					 (first (second (first x))))))
+	    topiclist)
+    (format t "</html-manual-keywords>~%")))
 
 ;; Escapes all chars that need escaping in XML
 ;;
@@ -150,8 +193,9 @@
 ;; the current program is running
 (defun $wxstatusbar (&rest status)
   (finish-output)
-  (format t "<statusbar>~a</statusbar>~%" (wxxml-fix-string
-					   (apply '$sconcat status)))
+  (wx-with-frame
+    (format t "<statusbar>~a</statusbar>~%" (wxxml-fix-string
+					     (apply '$sconcat status))))
   (finish-output)
   t
   )
@@ -1445,16 +1489,32 @@ Submit bug reports by following the 'New issue' link on that page."))
 ;; surprisingly small.
 (defun mydispla (x)
   (finish-output)
-  (let ((*print-circle* nil)
-	(*wxxml-mratp* (format nil "~{~a~}" (cdr (checkrat x)))))
-    (mapc #'princ
-	  (wxxml x '("<math>") '("</math>") 'mparen 'mparen)))
+  (wx-with-frame
+    (let ((*print-circle* nil)
+	  (*wxxml-mratp* (format nil "~{~a~}" (cdr (checkrat x)))))
+      (mapc #'princ
+	    (wxxml x '("<math>") '("</math>") 'mparen 'mparen))))
   (finish-output)
   )
 
 ;; Default to use wxMaxima's 2d XML display
 (setf *alt-display2d* 'mydispla)
 
+;; With display2d:false results are sent as plain text in a length-prefixed
+;; frame: wxMaxima then neither has to search the text for XML tags nor to
+;; parse it, but can put it into text cells directly.
+;;
+;; wxMaxima installs this as *alt-display1d* if it has asked for framed
+;; output.
+(defun wx-display1d (x)
+  (finish-output)
+  (wx-write-frame
+   (concatenate 'string "<wxtext>"
+		(with-output-to-string (*standard-output*)
+		  (linear-displa x))
+		"</wxtext>"))
+  (finish-output))
+
 ;; Allow the user to switch between display schemes.
 (defun $set_display (tp)
   (cond
@@ -2138,44 +2198,47 @@ Submit bug reports by following the 'New issue' link on that page."))
   (format t "<variable>~a</variable>~%" (symbol-to-xml val)))
 ;; Add all currently defined variables to the watch list
 (defun wx-add-all-variables ()
-  (format t "<watch_variables_add>~%")
-  (mapcar #'wx-add-variable-name (cdr $values))
-  (format t "</watch_variables_add>~%"))
+  (wx-with-frame
+    (format t "<watch_variables_add>~%")
+    (mapcar #'wx-add-variable-name (cdr $values))
+    (format t "</watch_variables_add>~%")))
 
 (defun print_value (val)
   (format nil "<value>~a</value>" (symbol-to-xml val)))
 
 (defun $add_function_template (&rest functs)
   (let ((*print-circle* nil))
-    (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>" (mapcar #'$print_function functs))
+    (wx-with-frame
+      (format t "<wxxml-symbols>~{~a~^$~}</wxxml-symbols>" (mapcar #'$print_function functs)))
     (cons '(mlist simp) functs)))
 
 
 ;; A function that determines all symbols for autocompletion
 (defun wxPrint_autocompletesymbols ()
   (finish-output)
-  (format t "<wxxml-symbols>")
-  ;; Function names and rules
-  (format t "~{~a~^$~}"
+  (wx-with-frame
+    (format t "<wxxml-symbols>")
+    ;; Function names and rules
+    (format t "~{~a~^$~}"
 	  (append (mapcar #'$print_function (cdr ($append (eval '$functions) (eval '$macros))))
 		  (mapcar #'print_value (cdr ($append (eval '$values) (eval '$rules))))))
-  ;; Idea from Robert Dodier:
-  ;; Variables defined with mdef don't appear in $values nor do they in $myoptions
-  ;; but they appear in *variable-initial-values*
-  (maphash (lambda (key val)
+    ;; Idea from Robert Dodier:
+    ;; Variables defined with mdef don't appear in $values nor do they in $myoptions
+    ;; but they appear in *variable-initial-values*
+    (maphash (lambda (key val)
 	     (declare (ignore val))
 	     (if (eq (char (format nil "~a" key) 0) #\$ )
 		 (format t "~a" (print_value key))))
 	   *variable-initial-values*)
 
-  ;;    (mapcar (lambda(key) (if (eq (char (format nil "~a" key) 0) #\$ ) (symbol-to-xml (make-symbol key)))) (wx-list-all-maxima-vars))
+    ;;    (mapcar (lambda(key) (if (eq (char (format nil "~a" key) 0) #\$ ) (symbol-to-xml (make-symbol key)))) (wx-list-all-maxima-vars))
 
-  ;; ezunits publishes all known units in a function.
-  (if (boundp '$known_units)
-      (no-warning
-       (format t "~{~a~^$~}"
-    	       (mapcar #'print_unit (cdr ($known_units))))))
-  (format t "</wxxml-symbols>")
+    ;; ezunits publishes all known units in a function.
+    (if (boundp '$known_units)
+        (no-warning
+         (format t "~{~a~^$~}"
+      	       (mapcar #'print_unit (cdr ($known_units))))))
+    (format t "</wxxml-symbols>"))
   (finish-output)
   )
 
@@ -2200,33 +2263,35 @@ Submit bug reports by following the 'New issue' link on that page."))
   (format t "</value></variable>~%"))
 
 (defun wx-query-variable (var)
-  (format t "<variables>~%<variable>~%<name>~a</name>" (wxxml-fix-string (maybe-invert-string-case var)))
-  (ignore-errors
-    (let (($display2d nil))
-      (mtell "<value>~M</value>" (wxxml-fix-string(meval (intern var))))))
-  (format t "</variable>~%</variables>~%"))
+  (wx-with-frame
+    (format t "<variables>~%<variable>~%<name>~a</name>" (wxxml-fix-string (maybe-invert-string-case var)))
+    (ignore-errors
+      (let (($display2d nil))
+        (mtell "<value>~M</value>" (wxxml-fix-string(meval (intern var))))))
+    (format t "</variable>~%</variables>~%")))
 
 (defun wx-print-variables ()
   (finish-output)
-  (format t "<variables>")
+  (wx-with-frame
+    (format t "<variables>")
 					;  (wx-print-variable '*maxima-topdir*)
-  (wx-print-variable '$gnuplot_command)
-  (wx-print-variable '$gentranlang)
-  (wx-print-variable '*maxima-demodir*)
-  (wx-print-variable '*autoconf-version*) ; Must be queried before maxima-sharedir is
-  (wx-print-variable '$maxima_userdir)
-  (wx-print-variable '$maxima_tempdir)
-  (wx-print-variable '*maxima-sharedir*)
-  (wx-print-variable '*maxima-infodir*)
-  (wx-print-variable '*maxima-htmldir*)
-  (wx-print-variable '*autoconf-host*)
-  (format t "<variable><name>*lisp-name*</name><value>~a</value></variable>"
+    (wx-print-variable '$gnuplot_command)
+    (wx-print-variable '$gentranlang)
+    (wx-print-variable '*maxima-demodir*)
+    (wx-print-variable '*autoconf-version*) ; Must be queried before maxima-sharedir is
+    (wx-print-variable '$maxima_userdir)
+    (wx-print-variable '$maxima_tempdir)
+    (wx-print-variable '*maxima-sharedir*)
+    (wx-print-variable '*maxima-infodir*)
+    (wx-print-variable '*maxima-htmldir*)
+    (wx-print-variable '*autoconf-host*)
+    (format t "<variable><name>*lisp-name*</name><value>~a</value></variable>"
 	  #+sbcl (ensure-readably-printable-string (lisp-implementation-type))
 	  #-sbcl (lisp-implementation-type))
-  (format t "<variable><name>*lisp-version*</name><value>~a</value></variable>"
+    (format t "<variable><name>*lisp-version*</name><value>~a</value></variable>"
 	  #+sbcl (ensure-readably-printable-string (lisp-implementation-version))
 	  #-sbcl (lisp-implementation-version))
-  (format t "</variables>~%")
+    (format t "</variables>~%"))
   (finish-output)
   )
 
@@ -2242,30 +2307,31 @@ Submit bug reports by following the 'New issue' link on that page."))
 
 (defun wx-print-gui-variables ()
   (finish-output)
-  (format t "<variables>")
-  (wx-print-variable '$output_format_for_help)
-  (wx-print-variable '$wxsubscripts)
-  (wx-print-variable '$opsubst)
-  (wx-print-variable '$logexpand)
-  (wx-print-variable '$sinnpiflag)
-  (wx-print-variable '$lmxchar)
-  (wx-print-variable '$numer)
-  (wx-print-variable '$stringdisp)
-  (wx-print-variable '$domain)
-  (wx-print-variable '$showtime)
-  (wx-print-variable '$algebraic)
-  (wx-print-variable '$debugmode)
-  (wx-print-variable '$engineering_format_floats)
-  (wx-print-variable '$wxanimate_autoplay)
-  (wx-print-display2d)
-  (wx-print-variable '*alt-display2d*)
-  (format t "<variable><name>*maxima-operators*</name><value>&lt;operators&gt;")
-  (do-symbols
-      (s :maxima)
-    (if (wxxml-get s 'op)
+  (wx-with-frame
+    (format t "<variables>")
+    (wx-print-variable '$output_format_for_help)
+    (wx-print-variable '$wxsubscripts)
+    (wx-print-variable '$opsubst)
+    (wx-print-variable '$logexpand)
+    (wx-print-variable '$sinnpiflag)
+    (wx-print-variable '$lmxchar)
+    (wx-print-variable '$numer)
+    (wx-print-variable '$stringdisp)
+    (wx-print-variable '$domain)
+    (wx-print-variable '$showtime)
+    (wx-print-variable '$algebraic)
+    (wx-print-variable '$debugmode)
+    (wx-print-variable '$engineering_format_floats)
+    (wx-print-variable '$wxanimate_autoplay)
+    (wx-print-display2d)
+    (wx-print-variable '*alt-display2d*)
+    (format t "<variable><name>*maxima-operators*</name><value>&lt;operators&gt;")
+    (do-symbols
+        (s :maxima)
+      (if (wxxml-get s 'op)
 	(format t "&lt;operator&gt;~a&lt;/operator&gt;~%" (wxxml-fix-string( wxxml-fix-string (format nil "~A" (get s 'op)))))))
-  (format t "&lt;/operators&gt;</value></variable>")
-  (format t "</variables>~%")
+    (format t "&lt;/operators&gt;</value></variable>")
+    (format t "</variables>~%"))
   (finish-output)
   )
 
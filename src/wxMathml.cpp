@@ -25,9 +25,16 @@
 //  SPDX-License-Identifier: GPL-2.0+
 
 #include "wxMathml.h"
+#include "Dirstructure.h"
 #include "wxMathML_lisp.h"
+#include <cstdint>
 #include <iostream>
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/filefn.h>
+#include <wx/filename.h>
 #include <wx/mstream.h>
+#include <wx/stdpaths.h>
 #include <wx/string.h>
 #include <wx/txtstrm.h>
 #include <wx/wfstream.h>
@@ -36,9 +43,9 @@
 wxMathML::wxMathML(Configuration *config) : m_configuration(config) {
 }
 
-wxString wxMathML::GetCmd() {
-  m_maximaCMD = wxEmptyString;
-
+void wxMathML::ReadSource() {
+  if (!m_wxMathML.IsEmpty())
+    return;
   if (Get_MathML_Filename().IsEmpty()) {
     wxLogMessage(_("Reading the Lisp part of wxMaxima from the included header file."));
     wxMemoryInputStream istream(WXMATHML_LISP, WXMATHML_LISP_SIZE);
@@ -63,6 +70,12 @@ wxString wxMathML::GetCmd() {
       m_wxMathML += line + wxS("\n");
     }
   }
+}
+
+wxString wxMathML::GetCmd() {
+  m_maximaCMD = wxEmptyString;
+
+  ReadSource();
   wxStringTokenizer lines(m_wxMathML, wxS("\n"));
   while (lines.HasMoreTokens()) {
     wxString line = lines.GetNextToken();
@@ -104,5 +117,125 @@ wxString wxMathML::GetCmd() {
 
   return m_maximaCMD;
 }
+
+wxString wxMathML::CacheDir() {
+#if wxCHECK_VERSION(3, 1, 0)
+  wxString const userCacheDir =
+    wxStandardPaths::Get().GetUserDir(wxStandardPaths::Dir_Cache);
+  if (!userCacheDir.IsEmpty())
+    return userCacheDir + wxFileName::GetPathSeparator() + wxS("wxmaxima") +
+      wxFileName::GetPathSeparator();
+#endif
+  return Dirstructure::Get()->UserConfDir() + wxS("wxmaxima-cache/");
+}
+
+void wxMathML::RemoveStaleCacheFiles(const wxString &baseName) {
+  wxDateTime const staleBefore = wxDateTime::Now() - wxDateSpan::Month();
+  wxArrayString files;
+  wxDir::GetAllFiles(CacheDir(), &files, wxS("wxMathML-*"), wxDIR_FILES);
+  for (auto const &file : files) {
+    // The files that belong to a source share its name up to the hash
+    wxString const otherBaseName = file.Left(baseName.Length());
+    if (otherBaseName == baseName)
+      continue;
+    // The source of a version that is still being written doesn't exist, yet
+    wxString usedFile = otherBaseName + wxS(".lisp");
+    if (!wxFileExists(usedFile))
+      usedFile = file;
+    wxDateTime const lastUsed = wxFileName(usedFile).GetModificationTime();
+    if (lastUsed.IsValid() && (lastUsed < staleBefore))
+      wxRemoveFile(file);
+  }
+}
+
+wxString wxMathML::GetLoadCmd() {
+  // Maxima might not be able to read the files we write, and then it cannot
+  // load the source from the cache, either.
+  if (!m_configuration->CacheCompiledLisp())
+    return GetCmd();
+
+  ReadSource();
+  wxScopedCharBuffer const source = m_wxMathML.utf8_str();
+
+  // The name of the cached source contains a hash of its contents (FNV-1a)
+  // so a changed wxMathML.lisp never is mistaken for an old one.
+  std::uint64_t hash = UINT64_C(14695981039346656037);
+  for (std::size_t i = 0; i < source.length(); i++) {
+    hash ^= static_cast<unsigned char>(source.data()[i]);
+    hash *= UINT64_C(1099511628211);
+  }
+  wxString const baseName =
+    CacheDir() + wxString::Format(wxS("wxMathML-%08lx%08lx"),
+                                  static_cast<unsigned long>(hash >> 32),
+                                  static_cast<unsigned long>(hash & 0xffffffff));
+  wxString const sourceFile = baseName + wxS(".lisp");
+
+  if (wxFileExists(sourceFile))
+    // Tell RemoveStaleCacheFiles() that this source is still in use
+    wxFileName(sourceFile).Touch();
+  else {
+    if (!wxDirExists(CacheDir()) &&
+        !wxFileName::Mkdir(CacheDir(), wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)) {
+      wxLogMessage(_("Cannot create %s, sending maxima the whole Lisp part of wxMaxima"),
+                   CacheDir().mb_str());
+      return GetCmd();
+    }
+    RemoveStaleCacheFiles(baseName);
+    // Write to a temporary file first so a maxima that is started in
+    // parallel never sees a half-written file.
+    wxString const tmpFile = sourceFile + wxS(".tmp");
+    {
+      wxFFile file(tmpFile, wxS("wb"));
+      if (!file.IsOpened() ||
+          (file.Write(source.data(), source.length()) != source.length())) {
+        wxLogMessage(_("Cannot write %s, sending maxima the whole Lisp part of wxMaxima"),
+                     tmpFile.mb_str());
+        return GetCmd();
+      }
+    }
+    if (!wxRenameFile(tmpFile, sourceFile)) {
+      wxRemoveFile(tmpFile);
+      if (!wxFileExists(sourceFile))
+        return GetCmd();
+    }
+  }
+
+  wxString sourceFile_lisp = sourceFile;
+  sourceFile_lisp.Replace(wxS("\\"), wxS("\\\\"));
+  sourceFile_lisp.Replace(wxS("\""), wxS("\\\""));
+  wxString baseName_lisp = baseName;
+  baseName_lisp.Replace(wxS("\\"), wxS("\\\\"));
+  baseName_lisp.Replace(wxS("\""), wxS("\\\""));
+
+  // Several maxima processes may compile the source at the same time. Each of
+  // them compiles to a name of its own and then renames the result, so no
+  // maxima ever loads a half-written compiled file.
+  static unsigned long compilations = 0;
+  wxString const tmpSuffix = wxString::Format(wxS("-tmp%lu-%lu"),
+                                              static_cast<unsigned long>(wxGetProcessId()),
+                                              compilations++);
+
+  wxLogMessage(_("Asking maxima to load the compiled Lisp part of wxMaxima from %s"),
+               CacheDir().mb_str());
+  // The compiled file depends on the lisp, its version and the maxima version.
+  // Compiler messages would be read as maxima's output => they are discarded.
+  // If anything fails the source is loaded, which is what GetCmd() does, too.
+  return wxS(":lisp-quiet (let* ((src \"") + sourceFile_lisp +
+    wxS("\") (name (concatenate 'string \"") + baseName_lisp +
+    wxS("-\" (substitute-if #\\_ (lambda (c) (not (alphanumericp c))) "
+        "(format nil \"~a-~a-~a\" (lisp-implementation-type) "
+        "(lisp-implementation-version) *autoconf-version*)))) "
+        "(fasl (compile-file-pathname (concatenate 'string name \".lisp\"))) "
+        "(tmp (compile-file-pathname (concatenate 'string name \"") + tmpSuffix +
+    wxS(".lisp\")))) "
+        "(unless (probe-file fasl) (ignore-errors "
+        "(let ((*standard-output* (make-broadcast-stream)) "
+        "(*error-output* (make-broadcast-stream))) "
+        "(when (compile-file src :output-file tmp) "
+        "(rename-file tmp fasl)))) "
+        "(ignore-errors (when (probe-file tmp) (delete-file tmp)))) "
+        "(unless (and (probe-file fasl) (ignore-errors (load fasl))) "
+        "(load src)))\n");
+}
 wxString wxMathML::m_maximaCMD;
 wxString wxMathML::m_wxMathML_file;
@@ -37,12 +37,38 @@ class wxMathML
 {
 public:
   explicit wxMathML(Configuration *config);
+  //! The command that sends maxima the whole of wxMathML.lisp
   wxString GetCmd();
+  /*! The command that makes maxima load wxMathML.lisp
+
+    If the configuration allows for it (see Configuration::CacheCompiledLisp())
+    this is a short command that makes maxima load a compiled wxMathML.lisp:
+    The source is written to the cache directory once. Maxima compiles it
+    the first time a session with that lisp, lisp version and maxima version
+    asks for it. Later sessions only load the compiled file. If that fails
+    maxima loads the source instead.
+
+    \return GetCmd() if the cache isn't used or if the source cannot be
+    written to the cache directory.
+  */
+  wxString GetLoadCmd();
   //! Read the wxMathML.lisp from the file filename instead from the builtin data.
   static void Set_MathML_Filename(wxString filename) {m_wxMathML_file = filename;}
   //! The name to read wxMathML.lisp from. If empty we use the builtin file.
   static const wxString& Get_MathML_Filename() {return m_wxMathML_file;}
 private:
+  //! Reads wxMathML.lisp into m_wxMathML, if that hasn't happened yet
+  void ReadSource();
+  //! The directory compiled versions of wxMathML.lisp are kept in
+  static wxString CacheDir();
+  /*! Removes the files of wxMathML.lisp versions no wxMaxima has used for a while
+
+    Other wxMaxima versions may run in parallel and still need their files.
+    Therefore only files whose source hasn't been used for a month are removed.
+
+    \param baseName The name all files that belong to the current source start with
+  */
+  static void RemoveStaleCacheFiles(const wxString &baseName);
   //! If we read wxMathml.lisp from a file this variable is not-empty and contains its name
   static wxString m_wxMathML_file;
   wxString m_wxMathML;
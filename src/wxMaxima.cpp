@@ -37,7 +37,10 @@
 #if defined __WXMSW__
 //#include <wchar.h>
 #endif
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <limits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -74,12 +77,15 @@
 #include "PlotFormatWiz.h"
 #include "Printout.h"
 #include "ResolutionChooser.h"
+#include "ResourceUsage.h"
 #include "SeriesWiz.h"
+#include "SpareMaxima.h"
 #include "StringUtils.h"
 #include "SubstituteWiz.h"
 #include "SumWiz.h"
 #include "SystemWiz.h"
 #include "TipOfTheDay.h"
+#include "Trace.h"
 #include "Version.h"
 #include "WXMformat.h"
 #include "wxMathml.h"
@@ -170,6 +176,13 @@ void wxMaxima::ConfigChanged() {
 
   m_configCommands += wxS(":lisp-quiet (setq $wxsubscripts ") +
     m_configuration.GetAutosubscript_string() + wxS(")\n");
+  if (m_configuration.FramedMaximaOutput()) {
+    m_configCommands += wxS(":lisp-quiet (setq *wx-framed-output* t)\n");
+    m_configCommands += wxS(":lisp-quiet (setq *alt-display1d* 'wx-display1d)\n");
+  } else {
+    m_configCommands += wxS(":lisp-quiet (setq *wx-framed-output* nil)\n");
+    m_configCommands += wxS(":lisp-quiet (setq *alt-display1d* nil)\n");
+  }
 
   // A few variables for additional debug info in wxbuild_info();
   m_configCommands += wxString::Format(wxS(":lisp-quiet (setq wxUserConfDir \"%s\")\n"),
@@ -196,8 +209,10 @@ wxMaxima::wxMaxima(wxWindow *parent, int id,
                   wxDEFAULT_FRAME_STYLE | wxSYSTEM_MENU | wxCAPTION,
                   m_topLevelWindows.empty()),
     m_openFile(filename), m_gnuplotcommand("gnuplot"),
-    m_parser(&m_configuration) {
+    m_parser(&m_configuration),
+    m_parserPool(&m_configuration, this) {
   GnuplotCommandName("gnuplot");
+  Bind(EVT_MATH_PARSED, &wxMaxima::OnMathParsed, this);
   if (m_knownXMLTags.empty()) {
     m_knownXMLTags[wxS("PROMPT")] = &wxMaxima::ReadPrompt;
     m_knownXMLTags[wxS("suppressOutput")] = &wxMaxima::ReadSuppressedOutput;
@@ -209,6 +224,7 @@ wxMaxima::wxMaxima(wxWindow *parent, int id,
       &wxMaxima::ReadManualTopicNames;
     m_knownXMLTags[wxS("mth")] = &wxMaxima::ReadMath;
     m_knownXMLTags[wxS("math")] = &wxMaxima::ReadMath;
+    m_knownXMLTags[wxS("wxtext")] = &wxMaxima::ReadText1D;
     m_knownXMLTags[wxS("ipc")] = &wxMaxima::ReadMaximaIPC;
   }
 
@@ -1412,6 +1428,10 @@ wxMaxima::wxMaxima(wxWindow *parent, int id,
           wxCommandEventHandler(wxMaxima::MaximaMenu), NULL, this);
   Connect(EventIDs::menu_evaluate_all, wxEVT_MENU,
           wxCommandEventHandler(wxMaxima::MaximaMenu), NULL, this);
+  Connect(EventIDs::menu_evaluate_all_parallel, wxEVT_MENU,
+          wxCommandEventHandler(wxMaxima::MaximaMenu), NULL, this);
+  Connect(EventIDs::menu_evaluate_changed, wxEVT_MENU,
+          wxCommandEventHandler(wxMaxima::MaximaMenu), NULL, this);
   Connect(ToolBar::tb_evaltillhere, wxEVT_MENU,
           wxCommandEventHandler(wxMaxima::MaximaMenu), NULL, this);
   Connect(EventIDs::menu_list_create_from_elements, wxEVT_MENU,
@@ -1911,17 +1931,7 @@ TextCell *wxMaxima::ConsoleAppend(wxString s, CellType type,
                     userLabel);
   } else if (type == MC_TYPE_ERROR) {
     lastLine = DoRawConsoleAppend(s, MC_TYPE_ERROR);
-    GroupCell *tmp = m_worksheet->GetWorkingGroup(true);
-
-    if (tmp == NULL) {
-      if (m_worksheet->GetActiveCell())
-        tmp = m_worksheet->GetActiveCell()->GetGroup();
-    }
-
-    if (tmp != NULL) {
-      m_worksheet->GetErrorList().Add(tmp);
-      tmp->GetEditable()->SetErrorIndex(m_commandIndex - 1);
-    }
+    MarkErroneousGroup();
   } else if (type == MC_TYPE_WARNING) {
     lastLine = DoRawConsoleAppend(s, MC_TYPE_WARNING);
   } else if (type == MC_TYPE_TEXT) {
@@ -1935,18 +1945,51 @@ TextCell *wxMaxima::ConsoleAppend(wxString s, CellType type,
   return lastLine;
 }
 
+void wxMaxima::MarkErroneousGroup() {
+  // Errors from a deleted cell don't concern the cell that runs now
+  if (m_worksheet->m_evaluationQueue.DiscardsOutput())
+    return;
+  GroupCell *tmp = m_worksheet->GetWorkingGroup(true);
+
+  if (tmp == NULL) {
+    if (m_worksheet->GetActiveCell())
+      tmp = m_worksheet->GetActiveCell()->GetGroup();
+  }
+
+  if (tmp != NULL) {
+    m_worksheet->GetErrorList().Add(tmp);
+    tmp->GetEditable()->SetErrorIndex(m_commandIndex - 1);
+  }
+}
+
 void wxMaxima::DoConsoleAppend(wxString s, CellType type, AppendOpt opts,
                                const wxString &userLabel) {
-  if (s.IsEmpty())
+  if (s.IsEmpty() || m_worksheet->m_evaluationQueue.DiscardsOutput())
     return;
 
   s.Replace(wxS("\n"), wxS(" "), true);
 
+  if ((type == MC_TYPE_DEFAULT) && MathParserPool::CanParse(s)) {
+    // Big results take a while to convert to cells => do that in the
+    // background. InsertParsedMath() appends them to the worksheet.
+    m_parserPool.Submit(s, type, userLabel, opts);
+    return;
+  }
+
+  // The maths the pool is still working on comes first.
+  InsertParsedMath(true);
+
   m_parser.SetUserLabel(userLabel);
   m_parser.SetGroup(m_worksheet->GetInsertGroup());
+  auto const parseStart = std::chrono::steady_clock::now();
   std::unique_ptr<Cell> cell(m_parser.ParseLine(s, type));
+  m_parseTime += std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - parseStart).count();
   m_parser.SetGroup(nullptr);
+  InsertParsedCell(std::move(cell), opts);
+}
 
+void wxMaxima::InsertParsedCell(std::unique_ptr<Cell> &&cell, AppendOpt opts) {
   if (!cell)
     {
       DoRawConsoleAppend(_("There was an error in the XML maxima has generated.\n"
@@ -1964,8 +2007,49 @@ void wxMaxima::DoConsoleAppend(wxString s, CellType type, AppendOpt opts,
                           (opts & AppendOpt::NewLine) || cell->BreakLineHere());
 }
 
+void wxMaxima::InsertParsedMath(bool wait) {
+  if (m_insertingParsedMath)
+    return;
+  m_insertingParsedMath = true;
+  MathParserPool::Result result;
+  while (m_parserPool.PopResult(result, wait)) {
+    if (result.cell)
+      result.cell->SetGroupList(m_worksheet->GetInsertGroup());
+    InsertParsedCell(std::move(result.cell), AppendOpt(result.userData));
+  }
+  m_insertingParsedMath = false;
+}
+
+void wxMaxima::LogOutputStatistics() {
+  OutputStatistics now;
+  now.cellsCreated = Cell::GetCreatedCellCount();
+  now.parseTime = m_parseTime + m_parserPool.GetParseTime();
+  now.recalculationTime = m_worksheet->GetRecalculationTime();
+  wxLogMessage(_("Output statistics: %li new cells, %.3f s parsing, %.3f s "
+                 "layout, %li MB peak memory usage"),
+               static_cast<long>(now.cellsCreated - m_lastOutputStatistics.cellsCreated),
+               now.parseTime - m_lastOutputStatistics.parseTime,
+               now.recalculationTime - m_lastOutputStatistics.recalculationTime,
+               static_cast<long>(ResourceUsage::PeakResidentSetSize() / 1000000));
+  m_lastOutputStatistics = now;
+}
+
+void wxMaxima::OnMathParsed(wxThreadEvent &WXUNUSED(event)) {
+  InsertParsedMath();
+  // Resume interpreting the output that had to wait for the maths
+  if (!m_parserPool.HasPending())
+    InterpretDataFromMaxima();
+}
+
 TextCell *wxMaxima::DoRawConsoleAppend(wxString s, CellType type,
                                        AppendOpt opts) {
+  // The maths the pool is still working on comes first.
+  InsertParsedMath(true);
+  // Output from a cell that has been deleted while maxima was evaluating it
+  // belongs to no cell.
+  if (m_worksheet->m_evaluationQueue.DiscardsOutput())
+    return NULL;
+
   TextCell *cell = nullptr;
   // If we want to append an error message to the worksheet and there is no cell
   // that can contain it we need to create such a cell.
@@ -1990,26 +2074,30 @@ TextCell *wxMaxima::DoRawConsoleAppend(wxString s, CellType type,
     std::unique_ptr<LabelCell> ownedCell;
     TextCell *incompleteTextCell = nullptr;
     if (type == MC_TYPE_PROMPT) {
-      incompleteTextCell = new LabelCell(m_worksheet->GetTree(),
-                                         &m_configuration,
-                                         wxEmptyString, TS_OTHER_PROMPT);
+      ownedCell = std::make_unique<LabelCell>(m_worksheet->GetTree(),
+                                              &m_configuration,
+                                              wxEmptyString, TS_OTHER_PROMPT);
+      incompleteTextCell = ownedCell.get();
       incompleteTextCell->ForceBreakLine(true);
     } else
       incompleteTextCell = m_worksheet->GetCurrentTextCell();
 
     if (incompleteTextCell) {
       int pos = s.Find("\n");
-      wxString newVal = incompleteTextCell->GetValue();
+      wxString restOfLine;
       if (pos != wxNOT_FOUND) {
-        newVal += s.Left(pos);
+        restOfLine = s.Left(pos);
         s = s.Right(s.Length() - pos - 1);
       } else {
-        newVal += s;
+        restOfLine = s;
         s = wxEmptyString;
       }
 
-      incompleteTextCell->SetValue(newVal);
-      m_worksheet->InsertLine(std::move(ownedCell));
+      if (ownedCell) {
+        incompleteTextCell->SetValue(restOfLine);
+        m_worksheet->InsertLine(std::move(ownedCell));
+      } else
+        incompleteTextCell = AppendToTextCell(incompleteTextCell, restOfLine);
       if (s.IsEmpty()) {
         return incompleteTextCell;
       }
@@ -2055,6 +2143,38 @@ TextCell *wxMaxima::DoRawConsoleAppend(wxString s, CellType type,
   return cell;
 }
 
+TextCell *wxMaxima::AppendToTextCell(TextCell *cell, const wxString &text) {
+  // The number of chars a text cell that is streamed into may grow to.
+  // Plain text results are split after the same number of chars.
+  std::size_t maxChunkLength =
+    static_cast<std::size_t>(m_configuration.Output1DChunkLength());
+  if (maxChunkLength == 0)
+    maxChunkLength = std::numeric_limits<std::size_t>::max();
+
+  std::size_t pos = 0;
+  while (pos < text.Length()) {
+    std::size_t const cellLength = cell->GetValue().Length();
+    if (cellLength >= maxChunkLength) {
+      // Continue the line in a new cell instead of making this one longer.
+      auto owned = std::make_unique<TextCell>(m_worksheet->GetTree(),
+                                              &m_configuration);
+      owned->SetType(cell->GetType());
+      owned->SetBigSkip(false);
+      cell = owned.get();
+      m_worksheet->InsertLine(std::move(owned));
+      m_worksheet->SetCurrentTextCell(cell);
+      continue;
+    }
+    std::size_t const chunkLength = std::min(maxChunkLength - cellLength,
+                                             text.Length() - pos);
+    cell->AppendText(text.Mid(pos, chunkLength));
+    pos += chunkLength;
+  }
+  m_worksheet->Recalculate(cell);
+  m_worksheet->RequestRedraw();
+  return cell;
+}
+
 /*! Remove empty statements
  *
  * We need to remove any statement which would be considered empty
@@ -2174,6 +2294,12 @@ void wxMaxima::SendMaxima(wxString s, bool addToHistory) {
 
 void wxMaxima::MaximaEvent(::MaximaEvent &event) {
   using std::swap;
+  if ((event.GetCause() == MaximaEvent::READ_DATA) ||
+      (event.GetCause() == MaximaEvent::READ_TIMEOUT)) {
+    GroupCell *group = m_worksheet->GetWorkingGroup();
+    if (group && group->GetEvaluationTimes())
+      group->GetEvaluationTimes()->DataReceived();
+  }
   switch (event.GetCause()) {
   case MaximaEvent::READ_DATA:
     // Read out stderr: We will do that in the background on a regular basis,
@@ -2181,7 +2307,7 @@ void wxMaxima::MaximaEvent(::MaximaEvent &event) {
     // are presented to the user in chronological order increases a bit.
     ReadStdErr();
     m_statusBar->NetworkStatus(StatusBar::receive);
-    InterpretDataFromMaxima(event.GetData());
+    InterpretDataFromMaxima(event.GetData(), event.GetKnownFrames());
     break;
   case MaximaEvent::READ_PENDING:
     ReadStdErr();
@@ -2234,12 +2360,19 @@ void wxMaxima::OnMaximaConnect() {
 
   m_statusBar->NetworkStatus(StatusBar::idle);
   m_worksheet->QuestionAnswered();
-  m_currentOutput = wxEmptyString;
+  m_currentOutput.Clear();
+  m_parserPool.Clear();
 
-  m_client = std::make_unique<Maxima>(m_server->Accept(false));
+  UseMaximaConnection(m_server->Accept(false));
+}
+
+void wxMaxima::UseMaximaConnection(wxSocketBase *socket) {
+  m_client = std::make_unique<Maxima>(socket);
   if (m_client->IsConnected()) {
     m_client->Bind(EVT_MAXIMA, &wxMaxima::MaximaEvent, this);
     m_client->SetPipeToStdOut(GetPipeToStdout());
+    if (!GetRecordingFile().IsEmpty())
+      m_client->RecordTo(GetRecordingFile());
     SetupVariables();
   } else {
     wxLogMessage(_("Connection attempt, but connection failed."));
@@ -2364,6 +2497,11 @@ bool wxMaxima::StartMaxima(bool force) {
     m_maximaStdoutPollTimer.StartOnce(MAXIMAPOLLMSECS);
 
     wxString command = GetCommand();
+    if (!command.IsEmpty() && UseSpareMaxima(command)) {
+      m_worksheet->GetErrorList().Clear();
+      GetMaximaCPUPercentage();
+      return true;
+    }
     if (!command.IsEmpty()) {
       command.Append(wxString::Format(wxS(" -s %d "), (int)m_port));
 
@@ -2374,28 +2512,11 @@ bool wxMaxima::StartMaxima(bool force) {
       m_pid = -1;
       wxLogMessage(_("Running maxima as: %s"), command.utf8_str());
 
-      wxEnvVariableHashMap environment;
-      environment = m_configuration.MaximaEnvVars();
-      wxGetEnvMap(&environment);
-      // Tell maxima we want to be able to kill it on Ctrl+G by sending it a
-      // signal Strictly necessary only on MS Windows where we don'r have a
-      // kill() command.
-      environment["MAXIMA_SIGNALS_THREAD"] = "1";
-      // TODO: Is this still necessary for gnuplot on MacOs?
-#if defined __WXOSX__
-      environment["DISPLAY"] = ":0.0";
-#endif
       m_maximaAuthenticated = false;
       m_discardAllData = false;
-      std::uniform_real_distribution<double> urd(0.0, 256.0);
+      m_maximaAuthString = NewMaximaAuthString();
       std::unique_ptr<wxExecuteEnv> env = std::unique_ptr<wxExecuteEnv>(new wxExecuteEnv);
-      wxMemoryBuffer membuf(512);
-      for(auto i = 0 ; i < 512; i++)
-        membuf.AppendByte(static_cast<char>(urd(m_configuration.m_eng)));
-      m_maximaAuthString = wxBase64Encode(membuf);
-      environment["MAXIMA_AUTH_CODE"] = m_maximaAuthString;
-
-      env->env = std::move(environment);
+      env->env = MaximaEnvironment(m_maximaAuthString);
       if (wxExecute(command, wxEXEC_ASYNC | wxEXEC_MAKE_GROUP_LEADER, m_process,
                     env.get()) <= 0) {
         StatusMaximaBusy(StatusBar::MaximaStatus::process_wont_start);
@@ -2433,8 +2554,84 @@ bool wxMaxima::StartMaxima(bool force) {
   return true;
 }
 
+wxEnvVariableHashMap wxMaxima::MaximaEnvironment(const wxString &authString) {
+  wxEnvVariableHashMap environment;
+  environment = m_configuration.MaximaEnvVars();
+  wxGetEnvMap(&environment);
+  // Tell maxima we want to be able to kill it on Ctrl+G by sending it a
+  // signal Strictly necessary only on MS Windows where we don'r have a
+  // kill() command.
+  environment["MAXIMA_SIGNALS_THREAD"] = "1";
+  // TODO: Is this still necessary for gnuplot on MacOs?
+#if defined __WXOSX__
+  environment["DISPLAY"] = ":0.0";
+#endif
+  environment["MAXIMA_AUTH_CODE"] = authString;
+  return environment;
+}
+
+wxString wxMaxima::NewMaximaAuthString() {
+  std::uniform_real_distribution<double> urd(0.0, 256.0);
+  wxMemoryBuffer membuf(512);
+  for(auto i = 0 ; i < 512; i++)
+    membuf.AppendByte(static_cast<char>(urd(m_configuration.m_eng)));
+  return wxBase64Encode(membuf);
+}
+
+bool wxMaxima::UseSpareMaxima(const wxString &command) {
+  if (!m_configuration.WarmSpareMaxima())
+    return false;
+  wxString initialFolder;
+  wxGetEnv(wxS("MAXIMA_INITIAL_FOLDER"), &initialFolder);
+  SpareMaxima::Connection spare;
+  if (!SpareMaxima::Get().Take(command, initialFolder, spare))
+    return false;
+
+  m_process = spare.process;
+  m_process->SetNextHandler(this);
+  Bind(wxEVT_END_PROCESS, &wxMaxima::OnProcessEvent, this, spare.processId);
+  m_first = true;
+  m_pid = -1;
+  m_maximaAuthenticated = false;
+  m_discardAllData = false;
+  m_maximaAuthString = spare.authString;
+  m_maximaStdout = m_process->GetInputStream();
+  m_maximaStderr = m_process->GetErrorStream();
+  m_lastPrompt = wxS("(%i1) ");
+  StatusMaximaBusy(StatusBar::MaximaStatus::wait_for_start);
+  m_statusBar->NetworkStatus(StatusBar::idle);
+  m_worksheet->QuestionAnswered();
+  m_currentOutput.Clear();
+  m_parserPool.Clear();
+  // The spare maxima has connected long ago and waits for us to read its
+  // first prompt.
+  UseMaximaConnection(spare.socket);
+  return true;
+}
+
+void wxMaxima::StartSpareMaxima() {
+  if (!m_configuration.WarmSpareMaxima()) {
+    SpareMaxima::Get().Stop();
+    return;
+  }
+  wxString const command = GetCommand();
+  if (command.IsEmpty())
+    return;
+  SpareMaxima::Limits limits;
+  limits.idleMinutes = m_configuration.WarmSpareMaximaIdleMinutes();
+  limits.minFreeMegabytes = m_configuration.WarmSpareMaximaMinFreeMegabytes();
+  wxString const authString = NewMaximaAuthString();
+  // The spare maxima starts in the folder this window's maxima has been
+  // started in which is the one the next restart will most probably need.
+  SpareMaxima::Get().Start(command, MaximaEnvironment(authString), authString,
+                           m_port + 1, limits);
+}
+
 void wxMaxima::Interrupt(wxCommandEvent &WXUNUSED(event)) {
   m_worksheet->CloseAutoCompletePopup();
+  // The cell maxima is working on won't be evaluated completely.
+  if (m_worksheet->m_evaluationQueue.GetCell())
+    m_worksheet->m_evaluationQueue.GetCell()->InputNotEvaluated();
 
   if (m_pid < 0) {
     m_MenuBar->EnableItem(EventIDs::menu_interrupt_id, false);
@@ -2582,7 +2779,8 @@ void wxMaxima::KillMaxima(bool logMessage) {
   m_statusBar->SetMaximaCPUPercentage(0);
   m_CWD = wxEmptyString;
   m_worksheet->QuestionAnswered();
-  m_currentOutput = wxEmptyString;
+  m_currentOutput.Clear();
+  m_parserPool.Clear();
   if(m_process)
     m_process->Detach();
   m_process = NULL;
@@ -2773,10 +2971,11 @@ void wxMaxima::OnProcessEvent(wxProcessEvent &event) {
 ///  Dealing with stuff read from the socket
 ///--------------------------------------------------------------------------------
 
-void wxMaxima::ReadFirstPrompt(wxString &data) {
+void wxMaxima::ReadFirstPrompt(MaximaOutputBuffer &buffer) {
   int end;
-  if ((end = m_currentOutput.Find(m_firstPrompt)) == wxNOT_FOUND)
+  if ((end = buffer.Find(m_firstPrompt)) == wxNOT_FOUND)
     return;
+  wxString const data = buffer.Left(static_cast<std::size_t>(end) + m_firstPrompt.Length());
 
   m_bytesFromMaxima = 0;
 
@@ -2805,6 +3004,10 @@ void wxMaxima::ReadFirstPrompt(wxString &data) {
   m_first = false;
   StatusMaximaBusy(StatusBar::MaximaStatus::waiting);
   m_closing = false; // when restarting maxima this is temporarily true
+  // This maxima knows nothing about the cells the last one has evaluated.
+  m_maximaSession++;
+  // Now that our maxima runs a spare one doesn't slow down its startup
+  StartSpareMaxima();
 
   wxString prompt_compact = data.Left(start + static_cast<std::size_t>(end) +
                                       m_firstPrompt.Length() - 1);
@@ -2814,7 +3017,7 @@ void wxMaxima::ReadFirstPrompt(wxString &data) {
 
   wxLogMessage(_("Maxima's PID is %li"), static_cast<long>(m_pid));
   // Remove the first prompt from Maxima's answer.
-  data = data.Right(data.Length() - end - m_firstPrompt.Length());
+  buffer.Consume(data.Length());
 
   if (m_worksheet->m_evaluationQueue.Empty()) {
     // Inform the user that the evaluation queue is empty.
@@ -2839,53 +3042,22 @@ void wxMaxima::ReadFirstPrompt(wxString &data) {
     TriggerEvaluation();
 }
 
-bool wxMaxima::ParseNextChunkFromMaxima(wxString &data) {
-  wxString miscText;
-  miscText.reserve(data.Length());
-  wxString tagName;
-  tagName.reserve(64);
+bool wxMaxima::ParseNextChunkFromMaxima(MaximaOutputBuffer &data) {
+  // Everything up to the next known tag is miscellaneous text.
   auto tagIndex = m_knownXMLTags.end();
-  bool tagFound = false;
-  wxString::const_iterator it;
-  for (it = data.begin(); (it < data.end()) && (!tagFound); ++it) {
-    if (*it == wxS('<')) {
-      tagName = wxEmptyString;
-      wxString::const_iterator it2 = it;
-      ++it2;
-      for (; (it2 != data.end()); ++it2) {
-        if (((*it2 >= wxS('a')) && (*it2 <= wxS('z'))) ||
-            ((*it2 >= wxS('A')) && (*it2 <= wxS('Z'))) || (*it2 == wxS('_')) ||
-            (*it2 == wxS('-')))
-          tagName += *it2;
-        else {
-          if (*it2 == wxS('>')) {
-            tagIndex = m_knownXMLTags.find(tagName);
-            tagFound = tagIndex != m_knownXMLTags.end();
-            if (!tagFound) {
-              miscText += wxS("<") + tagName + wxS(">");
-              tagName = wxEmptyString;
-            }
-            break;
-          } else {
-            miscText += wxS("<") + tagName;
-            tagName = wxEmptyString;
-            break;
-          }
-        }
-      }
-      it = it2;
-      if ((!tagFound) && (!tagName.IsEmpty()))
-        miscText += wxS("<") + tagName;
-    } else
-      miscText += *it;
-  }
+  std::size_t const miscTextEnd =
+    data.FindKnownTag([&tagIndex](const wxString &name) {
+      tagIndex = m_knownXMLTags.find(name);
+      return tagIndex != m_knownXMLTags.end();
+    });
+  bool const tagFound = (miscTextEnd < data.Length());
   bool retval = false;
-  if (!miscText.IsEmpty()) {
+  if (miscTextEnd > 0) {
     retval = true;
-    ReadMiscText(miscText);
+    ReadMiscText(data.Left(miscTextEnd));
 
     // Remove the miscellaneous text we just have processed
-    data = data.Right(data.Length() - miscText.Length());
+    data.Consume(miscTextEnd);
   }
   if (tagFound) {
     if((m_maximaAuthenticated) || (tagIndex->second == &wxMaxima::ReadSuppressedOutput))
@@ -2897,24 +3069,12 @@ bool wxMaxima::ParseNextChunkFromMaxima(wxString &data) {
   return retval;
 }
 
-void wxMaxima::ReadMiscText(const wxString &data) {
-  if(!m_maximaAuthenticated)
-    return;
-
+CellType wxMaxima::ClassifyText(const wxString &data) const {
   auto style = MC_TYPE_ASCIIMATHS;
 
   if (data.StartsWith(wxS("(%")))
     style = MC_TYPE_TEXT;
 
-  if (data.IsEmpty())
-    return;
-
-  if (data == "\r")
-    return;
-
-  if (data.StartsWith("\n"))
-    m_worksheet->SetCurrentTextCell(nullptr);
-
   // A version of the text where each line begins with non-whitespace and
   // whitespace characters are merged.
   wxString mergedWhitespace = wxS("\n");
@@ -2962,6 +3122,24 @@ void wxMaxima::ReadMiscText(const wxString &data) {
       style = MC_TYPE_ERROR;
   }
 
+  return style;
+}
+
+void wxMaxima::ReadMiscText(const wxString &data) {
+  if(!m_maximaAuthenticated)
+    return;
+
+  if (data.IsEmpty())
+    return;
+
+  if (data == "\r")
+    return;
+
+  if (data.StartsWith("\n"))
+    m_worksheet->SetCurrentTextCell(nullptr);
+
+  auto const style = ClassifyText(data);
+
   // Add all text lines to the console
   wxStringTokenizer lines(data, wxS("\n"));
   while (lines.HasMoreTokens()) {
@@ -2987,7 +3165,12 @@ void wxMaxima::ReadMiscText(const wxString &data) {
     m_worksheet->SetCurrentTextCell(nullptr);
 }
 
-long wxMaxima::FindTagEnd(const wxString &data, const wxString &tag) {
+long wxMaxima::FindTagEnd(const MaximaOutputBuffer &data, const wxString &tag) {
+  long const frameLength = data.KnownFrameLength();
+  if ((frameLength != wxNOT_FOUND) &&
+      (static_cast<std::size_t>(frameLength) >= tag.Length()) &&
+      data.IsAt(frameLength - tag.Length(), tag))
+    return frameLength - tag.Length();
   if ((m_currentOutputEnd.IsEmpty()) ||
       (m_currentOutputEnd.Find(tag) != wxNOT_FOUND))
     return data.Find(tag);
@@ -2995,7 +3178,7 @@ long wxMaxima::FindTagEnd(const wxString &data, const wxString &tag) {
     return wxNOT_FOUND;
 }
 
-void wxMaxima::ReadStatusBar(wxString &data) {
+void wxMaxima::ReadStatusBar(MaximaOutputBuffer &data) {
   if (!data.StartsWith(m_statusbarPrefix))
     return;
 
@@ -3027,11 +3210,11 @@ void wxMaxima::ReadStatusBar(wxString &data) {
         }
       }
     // Remove the status bar info from the data string
-    data = data.Right(data.Length() - end - m_statusbarSuffix.Length());
+    data.Consume(end + m_statusbarSuffix.Length());
   }
 }
 
-void wxMaxima::ReadManualTopicNames(wxString &data) {
+void wxMaxima::ReadManualTopicNames(MaximaOutputBuffer &data) {
   if (!data.StartsWith(m_jumpManualPrefix))
     return;
 
@@ -3089,14 +3272,14 @@ void wxMaxima::ReadManualTopicNames(wxString &data) {
       }
 
     // Remove the status bar info from the data string
-    data = data.Right(data.Length() - end - m_jumpManualPrefix.Length());
+    data.Consume(end + m_jumpManualSuffix.Length());
   }
 }
 
 /***
  * Checks if maxima displayed a new chunk of math
  */
-void wxMaxima::ReadMath(wxString &data) {
+void wxMaxima::ReadMath(MaximaOutputBuffer &data) {
   if ((!data.StartsWith(m_mathPrefix1)) && (!data.StartsWith(m_mathPrefix2)))
     return;
 
@@ -3104,17 +3287,23 @@ void wxMaxima::ReadMath(wxString &data) {
 
   // Append everything from the "beginning of math" to the "end of math" marker
   // to the console and remove it from the data we got.
+  // Look for the end tag that matches the start tag first: That one can be
+  // found without searching if maxima has told us the length of the output.
+  wxString const *suffix1 = &m_mathSuffix1;
+  wxString const *suffix2 = &m_mathSuffix2;
+  if (data.StartsWith(m_mathPrefix2))
+    std::swap(suffix1, suffix2);
   int mthTagLen;
-  int end = FindTagEnd(data, m_mathSuffix1);
+  int end = FindTagEnd(data, *suffix1);
   if (end >= 0)
-    mthTagLen = m_mathSuffix1.Length();
+    mthTagLen = suffix1->Length();
   else {
-    end = FindTagEnd(data, m_mathSuffix2);
-    mthTagLen = m_mathSuffix2.Length();
+    end = FindTagEnd(data, *suffix2);
+    mthTagLen = suffix2->Length();
   }
   if (end >= 0) {
     wxString o = data.Left(static_cast<std::size_t>(end) + mthTagLen);
-    data = data.Right(data.Length() - static_cast<std::size_t>(end) - mthTagLen);
+    data.Consume(static_cast<std::size_t>(end) + mthTagLen);
     o.Trim(true);
     o.Trim(false);
     if (o.Length() > 0) {
@@ -3128,7 +3317,77 @@ void wxMaxima::ReadMath(wxString &data) {
   }
 }
 
-void wxMaxima::ReadSuppressedOutput(wxString &data) {
+void wxMaxima::ReadText1D(MaximaOutputBuffer &data) {
+  if (!data.StartsWith(m_text1DPrefix))
+    return;
+
+  m_worksheet->SetCurrentTextCell(nullptr);
+
+  int const end = FindTagEnd(data, m_text1DSuffix);
+  if (end == wxNOT_FOUND)
+    return;
+  std::size_t const textStart = m_text1DPrefix.Length();
+  wxString const text = data.Mid(textStart, static_cast<std::size_t>(end) - textStart);
+  data.Consume(static_cast<std::size_t>(end) + m_text1DSuffix.Length());
+  if (m_worksheet->m_evaluationQueue.DiscardsOutput())
+    return;
+
+  if (m_maxOutputCellsPerCommand > 0) {
+    if (m_outputCellsFromCurrentCommand == m_maxOutputCellsPerCommand)
+      DoRawConsoleAppend(_("... [suppressed additional lines as the output "
+                           "is longer than allowed in the wxMaxima configuration] "),
+                         MC_TYPE_ERROR);
+    if (m_outputCellsFromCurrentCommand++ >= m_maxOutputCellsPerCommand)
+      return;
+  }
+
+  // The maths the pool is still working on comes first.
+  InsertParsedMath(true);
+  if (m_worksheet->GetTree() == NULL)
+    m_worksheet->InsertGroupCells(
+                                  std::make_unique<GroupCell>(&m_configuration, GC_TYPE_CODE));
+  StatusMaximaBusy(StatusBar::MaximaStatus::parsing);
+
+  // Each line becomes a text cell of its own. Lines that are too long to be
+  // laid out and drawn fast are split into several cells the worksheet can
+  // break between.
+  CellType const type = ClassifyText(text);
+  std::size_t const chunkLength =
+    static_cast<std::size_t>(m_configuration.Output1DChunkLength());
+  CellListBuilder<Cell> tree;
+  TextCell *lastLine = nullptr;
+  std::size_t lineStart = 0;
+  while (lineStart < text.Length()) {
+    std::size_t lineEnd = text.find(wxS('\n'), lineStart);
+    if (lineEnd == wxString::npos)
+      lineEnd = text.Length();
+    for (std::size_t chunkStart = lineStart; chunkStart < lineEnd;) {
+      std::size_t length = lineEnd - chunkStart;
+      if ((chunkLength > 0) && (length > chunkLength))
+        length = chunkLength;
+      auto cell = std::make_unique<TextCell>(m_worksheet->GetTree(), &m_configuration,
+                                             text.substr(chunkStart, length));
+      cell->SetType(type);
+      bool const newLine = (chunkStart == lineStart) && static_cast<bool>(tree);
+      if (newLine && lastLine)
+        lastLine->SetBigSkip(false);
+      lastLine = cell.get();
+      tree.Append(std::move(cell));
+      if (newLine)
+        tree.GetLastAppended()->ForceBreakLine(true);
+      chunkStart += length;
+    }
+    lineStart = lineEnd + 1;
+  }
+  if (tree)
+    m_worksheet->InsertLine(std::move(tree), true);
+  if (type == MC_TYPE_ERROR) {
+    MarkErroneousGroup();
+    AbortOnError();
+  }
+}
+
+void wxMaxima::ReadSuppressedOutput(MaximaOutputBuffer &data) {
   if (!data.StartsWith(m_suppressOutputPrefix))
     return;
 
@@ -3152,7 +3411,7 @@ void wxMaxima::ReadSuppressedOutput(wxString &data) {
   int end = FindTagEnd(data, m_suppressOutputSuffix);
 
   if (end != wxNOT_FOUND) {
-    data = data.Right(data.Length() - end - m_suppressOutputSuffix.Length());
+    data.Consume(end + m_suppressOutputSuffix.Length());
     if(!m_maximaAuthenticated)
       {
         wxLogMessage(_("Maxima didn't attempt to authenticate!"));
@@ -3165,7 +3424,7 @@ void wxMaxima::ReadSuppressedOutput(wxString &data) {
   }
 }
 
-void wxMaxima::ReadLoadSymbols(wxString &data) {
+void wxMaxima::ReadLoadSymbols(MaximaOutputBuffer &data) {
   if (!data.StartsWith(m_symbolsPrefix))
     return;
 
@@ -3179,11 +3438,11 @@ void wxMaxima::ReadLoadSymbols(wxString &data) {
     m_worksheet->AddSymbols(symbols);
 
     // Remove the symbols from the data string
-    data = data.Right(data.Length() - end - m_symbolsSuffix.Length());
+    data.Consume(end + m_symbolsSuffix.Length());
   }
 }
 
-void wxMaxima::ReadVariables(wxString &data) {
+void wxMaxima::ReadVariables(MaximaOutputBuffer &data) {
   if (!data.StartsWith(m_variablesPrefix))
     return;
 
@@ -3261,7 +3520,7 @@ void wxMaxima::ReadVariables(wxString &data) {
           wxLogMessage(_("Maxima has sent a new variable value."));
       }
     // Remove the symbols from the data string
-    data = data.Right(data.Length() - end - m_variablesSuffix.Length());
+    data.Consume(end + m_variablesSuffix.Length());
     TriggerEvaluation();
     QueryVariableValue();
   }
@@ -3676,7 +3935,7 @@ void wxMaxima::VariableActionOperators(const wxString &value) {
     }
 }
 
-void wxMaxima::ReadAddVariables(wxString &data) {
+void wxMaxima::ReadAddVariables(MaximaOutputBuffer &data) {
   if (!data.StartsWith(m_addVariablesPrefix))
     return;
 
@@ -3715,7 +3974,7 @@ void wxMaxima::ReadAddVariables(wxString &data) {
             var = var->GetNext();
           }
         }
-        data = data.Right(data.Length() - end - m_addVariablesSuffix.Length());
+        data.Consume(end + m_addVariablesSuffix.Length());
       }
   }
 }
@@ -3753,7 +4012,7 @@ bool wxMaxima::QueryVariableValue() {
 /***
  * Checks if maxima displayed a new prompt.
  */
-void wxMaxima::ReadPrompt(wxString &data) {
+void wxMaxima::ReadPrompt(MaximaOutputBuffer &data) {
   m_evalOnStartup = false;
   if (!data.StartsWith(m_promptPrefix))
     return;
@@ -3772,11 +4031,12 @@ void wxMaxima::ReadPrompt(wxString &data) {
   m_maximaBusy = false;
   m_bytesFromMaxima = 0;
 
-  wxString label = data.SubString(m_promptPrefix.Length(), static_cast<std::size_t>(end) - 1);
+  wxString label = data.Mid(m_promptPrefix.Length(),
+                            static_cast<std::size_t>(end) - m_promptPrefix.Length());
   // Remove the prompt we will process from the string.
-  data = data.Right(data.Length() - static_cast<std::size_t>(end) - m_promptSuffix.Length());
-  if (data == wxS(" "))
-    data = wxEmptyString;
+  data.Consume(static_cast<std::size_t>(end) + m_promptSuffix.Length());
+  if (data.IsSameAs(wxS(" ")))
+    data.Clear();
 
   // If we got a prompt our connection to maxima was successful.
   if (m_unsuccessfulConnectionAttempts > 0)
@@ -3789,16 +4049,38 @@ void wxMaxima::ReadPrompt(wxString &data) {
   // don't do that; Lisp prompts look like question prompts.
   //
   // sbcl debug prompts have the format "(dbm:1)".
-  if (((label.Length() > 2) && label.StartsWith("(%") &&
-       (!label.StartsWith("(dbm:")) && label.EndsWith(")") &&
-       (((label[label.Length() - 2] >= (wxS('0'))) &&
-         (label[label.Length() - 2] <= (wxS('9')))) ||
-        ((label[label.Length() - 2] >= (wxS('A'))) &&
-         (label[label.Length() - 2] <= (wxS('Z')))))) ||
-      m_configuration.InLispMode() || (label.StartsWith(wxS("MAXIMA>"))) ||
-      (label.StartsWith(wxS("\nMAXIMA>")))) {
+  bool const mainPrompt =
+    ((label.Length() > 2) && label.StartsWith("(%") &&
+     (!label.StartsWith("(dbm:")) && label.EndsWith(")") &&
+     (((label[label.Length() - 2] >= (wxS('0'))) &&
+       (label[label.Length() - 2] <= (wxS('9')))) ||
+      ((label[label.Length() - 2] >= (wxS('A'))) &&
+       (label[label.Length() - 2] <= (wxS('Z')))))) ||
+    m_configuration.InLispMode() || (label.StartsWith(wxS("MAXIMA>"))) ||
+    (label.StartsWith(wxS("\nMAXIMA>")));
+  if (mainPrompt && m_worksheet->m_evaluationQueue.IgnorePrompt()) {
+    // This prompt ends a command from a cell that has been deleted while
+    // maxima was evaluating it.
+    wxLogMessage(_("Ignoring the prompt of a command from a deleted cell."));
+    m_lastPrompt = label;
+    m_outputCellsFromCurrentCommand = 0;
+    // Only start the next cell if maxima has answered every command it has
+    // received.
+    if (m_worksheet->m_evaluationQueue.CommandSent() ||
+        m_worksheet->m_evaluationQueue.DiscardsOutput())
+      m_maximaBusy = true;
+    else
+      TriggerEvaluation();
+  } else if (mainPrompt) {
     // Maxima displayed a new main prompt => We don't have a question
     m_worksheet->QuestionAnswered();
+    if (m_benchmark)
+      LogOutputStatistics();
+    // If this prompt ends the last command of a cell the cell's input has
+    // been evaluated.
+    if ((m_worksheet->m_evaluationQueue.CommandsLeftInCell() <= 1) &&
+        m_worksheet->m_evaluationQueue.GetCell())
+      m_worksheet->m_evaluationQueue.GetCell()->InputEvaluated();
     // And we can remove one command from the evaluation queue.
     m_worksheet->m_evaluationQueue.RemoveFirst();
 
@@ -3833,8 +4115,14 @@ void wxMaxima::ReadPrompt(wxString &data) {
       m_ready = false;
       m_worksheet->RequestRedraw();
       m_worksheet->SetWorkingGroup(nullptr);
-      StatusMaximaBusy(StatusBar::MaximaStatus::sending);
-      TriggerEvaluation();
+      // The next prompt might still belong to a command from a deleted cell.
+      // Only then does the output belong to the next cell.
+      if (m_worksheet->m_evaluationQueue.DiscardsOutput())
+        m_maximaBusy = true;
+      else {
+        StatusMaximaBusy(StatusBar::MaximaStatus::sending);
+        TriggerEvaluation();
+      }
     }
 
     if (m_worksheet->m_evaluationQueue.Empty()) {
@@ -3846,6 +4134,10 @@ void wxMaxima::ReadPrompt(wxString &data) {
     if (m_exitAfterEval && m_worksheet->m_evaluationQueue.Empty())
       Close();
   } else { // We have a question
+    // Commands are only sent ahead after commands that cannot ask questions
+    // => maxima would read the next command as the answer.
+    if (m_worksheet->m_evaluationQueue.CommandsSentAhead() > 0)
+      wxLogWarning(_("Maxima asks a question while it already has received the next command."));
     m_worksheet->SetLastQuestion(label);
     m_worksheet->QuestionAnswered();
     m_worksheet->QuestionPending(true);
@@ -4445,18 +4737,22 @@ wxMaxima::CreateTreeFromXMLNode(wxXmlNode *xmlcells,
 
   bool warning = true;
 
-  if (xmlcells)
-    xmlcells = xmlcells->GetChildren();
+  XMLTokenStream xml(xmlcells);
+  // Skip the root element's start tag
+  xml.Next();
+  xml.Next();
 
-  for (; xmlcells; xmlcells = xmlcells->GetNext()) {
-    if (xmlcells->GetType() != wxXML_TEXT_NODE) {
-      bool ok = tree.DynamicAppend(mp.ParseTag(xmlcells, false));
-      if (!ok && warning) {
-        LoggingMessageBox(
-                          _("Parts of the document will not be loaded correctly!"),
-                          _("Warning"), wxOK | wxICON_WARNING);
-        warning = false;
-      }
+  while (xml.AtContent()) {
+    if (xml.GetType() == XMLTokenStream::text) {
+      xml.Next();
+      continue;
+    }
+    bool ok = tree.DynamicAppend(mp.ParseTag(xml, false));
+    if (!ok && warning) {
+      LoggingMessageBox(
+                        _("Parts of the document will not be loaded correctly!"),
+                        _("Warning"), wxOK | wxICON_WARNING);
+      warning = false;
     }
   }
   return tree;
@@ -4471,7 +4767,7 @@ wxString wxMaxima::EscapeForLisp(wxString str) {
 void wxMaxima::SetupVariables() {
   wxLogMessage(_("Sending maxima the info how to express 2d maths as XML"));
   wxMathML wxmathml(&m_configuration);
-  SendMaxima(wxmathml.GetCmd());
+  SendMaxima(wxmathml.GetLoadCmd());
   wxString cmd;
 
 #if defined(__WXOSX__)
@@ -4790,7 +5086,8 @@ void wxMaxima::ShowMaximaHelp(wxString keyword) {
   }
 }
 
-bool wxMaxima::InterpretDataFromMaxima(const wxString &newData) {
+bool wxMaxima::InterpretDataFromMaxima(const wxString &newData,
+                                       const MaximaOutputBuffer::KnownFrames &knownFrames) {
   if(m_discardAllData)
     return false;
   wxString miscText;
@@ -4810,12 +5107,12 @@ bool wxMaxima::InterpretDataFromMaxima(const wxString &newData) {
   // data between 2 tags
   m_currentOutputEnd = m_currentOutput.Right(30) + newData;
 
-  m_currentOutput += newData;
+  m_currentOutput.Append(newData, knownFrames);
   if ((m_xmlInspector) && (IsPaneDisplayed(EventIDs::menu_pane_xmlInspector)))
     m_xmlInspector->Add_FromMaxima(wxm::emptyString);
 
-  if (!m_dispReadOut && (m_currentOutput != wxS("\n")) &&
-      (m_currentOutput != m_emptywxxmlSymbols)) {
+  if (!m_dispReadOut && (!m_currentOutput.IsSameAs(wxS("\n"))) &&
+      (!m_currentOutput.IsSameAs(m_emptywxxmlSymbols))) {
     if(!m_first)
       {
         StatusMaximaBusy(StatusBar::MaximaStatus::waitingForPrompt);
@@ -4840,8 +5137,17 @@ bool wxMaxima::InterpretDataFromMaxima() {
   long startlength = m_currentOutput.Length();
 
   while ((length_old != m_currentOutput.Length()) && (stopWatch.Time() < 250)) {
-    if (m_currentOutput.StartsWith("\n<"))
-      m_currentOutput = m_currentOutput.Right(m_currentOutput.Length() - 1);
+    if (m_currentOutput.StartsWith(wxS("\n<")))
+      m_currentOutput.Consume(1);
+
+    // Everything but maths has to wait until the maths before it has been
+    // converted to cells in the background and has been appended to the
+    // worksheet: A prompt, for example, switches to the next working group.
+    InsertParsedMath();
+    if (m_parserPool.HasPending() &&
+        !m_currentOutput.StartsWith(m_mathPrefix1) &&
+        !m_currentOutput.StartsWith(m_mathPrefix2))
+      break;
 
     length_old = m_currentOutput.Length();
 
@@ -5031,6 +5337,13 @@ void wxMaxima::OnIdle(wxIdleEvent &event) {
     return;
   }
 
+  if ((m_profilingPane != NULL) && (IsPaneDisplayed(EventIDs::menu_pane_profiling)) &&
+      (m_profilingPane->UpdateNeeded())) {
+    m_profilingPane->UpdateContents();
+    event.RequestMore();
+    return;
+  }
+
   if (UpdateDrawPane()) {
     event.RequestMore();
     return;
@@ -5683,6 +5996,11 @@ bool wxMaxima::AbortOnError() {
   // Maxima encountered an error.
   // The question is now if we want to try to send it something new to evaluate.
 
+  // An error in a cell that has been deleted doesn't stop the evaluation of
+  // the other cells.
+  if (m_worksheet->m_evaluationQueue.DiscardsOutput())
+    return false;
+
   ExitAfterEval(false);
   EvalOnStartup(false);
 
@@ -5701,7 +6019,9 @@ bool wxMaxima::AbortOnError() {
     wxExit();
   }
   if (m_configuration.GetAbortOnError()) {
-    m_worksheet->m_evaluationQueue.Clear();
+    // Maxima will evaluate the commands it already has received, anyway => their
+    // output still has to go to the cells they belong to.
+    m_worksheet->m_evaluationQueue.ClearAfterSentCommands();
     // Inform the user that the evaluation queue is empty.
     EvaluationQueueLength(0);
     m_worksheet->ScrollToError();
@@ -5710,95 +6030,38 @@ bool wxMaxima::AbortOnError() {
     return false;
 }
 
-long long wxMaxima::GetTotalCpuTime() {
-#ifdef __WXMSW__
-  FILETIME systemtime;
-  GetSystemTimeAsFileTime(&systemtime);
-  return (long long)systemtime.dwLowDateTime +
-    ((long long)systemtime.dwHighDateTime << 32);
-#else
-  int CpuJiffies = 0;
-  if (wxFileExists("/proc/stat")) {
-    wxFileInputStream input("/proc/stat");
-    if (input.IsOk()) {
-      wxTextInputStream text(input, wxS('\t'), wxConvAuto(wxFONTENCODING_UTF8));
-      wxString line;
-      while ((!input.Eof()) && (!line.StartsWith("cpu ")))
-        line = text.ReadLine();
-
-      // Strip the "cpu" from the line
-      line = line.Right(line.Length() - 4);
-      line.Trim(false);
-      wxStringTokenizer tokens(line, wxS(" "));
-      for (int i = 0; i < 3; i++) {
-        if (tokens.HasMoreTokens()) {
-          long additionalJiffies;
-          if (!tokens.GetNextToken().ToLong(&additionalJiffies))
-            return -1;
-          CpuJiffies += additionalJiffies;
-        } else
-          return -1;
-      }
-    }
-  }
-  return CpuJiffies;
-#endif
-}
-
-long long wxMaxima::GetMaximaCpuTime() {
-#ifdef __WXMSW__
-  HANDLE maximaHandle =
-    OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, m_pid);
-  if (maximaHandle != NULL) {
-    FILETIME creationTime, exitTime, kernelTime, userTime;
-    if (GetProcessTimes(maximaHandle, &creationTime, &exitTime, &kernelTime,
-                        &userTime)) {
-      long long retval =
-        (long long)kernelTime.dwLowDateTime + userTime.dwLowDateTime +
-        (1LL << 32) *
-        ((long long)kernelTime.dwHighDateTime + userTime.dwHighDateTime);
-      CloseHandle(maximaHandle);
-
-      return retval;
-    }
-  }
-#endif
-  int maximaJiffies = 0;
-  wxString statFileName = wxString::Format("/proc/%li/stat", static_cast<long>(m_pid));
-  if (wxFileExists(statFileName)) {
-    wxFileInputStream input(statFileName);
-    if (input.IsOk()) {
-      wxTextInputStream text(input, wxS('\t'), wxConvAuto(wxFONTENCODING_UTF8));
-      wxString line = text.ReadLine();
-
-      wxStringTokenizer tokens(line, wxS(" "));
-      for (int i = 0; i < 13; i++) {
-        if (tokens.HasMoreTokens())
-          tokens.GetNextToken();
-        else
-          return -1;
-      }
-
-      for (int i = 0; i < 4; i++) {
-        {
-          if (tokens.HasMoreTokens()) {
-            long additionalJiffies;
-            if (!tokens.GetNextToken().ToLong(&additionalJiffies)) {
-              maximaJiffies = -1;
-              break;
-            }
-            maximaJiffies += additionalJiffies;
-          } else
-            return -1;
-        }
-      }
-    }
-  }
-  return maximaJiffies;
+ProcessMonitor::Sample wxMaxima::SampleMaximaResources() {
+  ProcessMonitor::Sample const sample = m_maximaMonitor.Read(m_pid);
+  m_statusBar->SetMaximaMemory(sample.residentSetSize);
+
+  GroupCell *const cell = m_resourceCell;
+  EvaluationTimes *const times = cell ? cell->GetEvaluationTimes() : NULL;
+  if (times) {
+    if ((sample.processCpuTime >= 0) && (m_resourceCellStart.processCpuTime >= 0))
+      times->cpuTime = (sample.processCpuTime - m_resourceCellStart.processCpuTime) /
+        ProcessMonitor::CpuTimeUnitsPerSecond();
+    if ((sample.majorPageFaults >= 0) && (m_resourceCellStart.majorPageFaults >= 0))
+      times->majorPageFaults = sample.majorPageFaults - m_resourceCellStart.majorPageFaults;
+    times->peakMemory = std::max(times->peakMemory, sample.residentSetSize);
+  }
+
+  // Warn before the operating system starts to swap or to kill maxima
+  std::size_t const physicalMemory = ResourceUsage::PhysicalMemory();
+  if ((physicalMemory > 0) && (sample.residentSetSize > physicalMemory / 4 * 3)) {
+    if (!m_maximaMemoryWarningShown)
+      StatusText(wxString::Format(
+                   _("Warning: Maxima occupies %li of the %li MB of memory this computer has"),
+                   static_cast<long>(sample.residentSetSize / 1000000),
+                   static_cast<long>(physicalMemory / 1000000)));
+    m_maximaMemoryWarningShown = true;
+  } else
+    m_maximaMemoryWarningShown = false;
+  return sample;
 }
 
 double wxMaxima::GetMaximaCPUPercentage() {
-  int CpuJiffies = GetTotalCpuTime();
+  ProcessMonitor::Sample const sample = SampleMaximaResources();
+  long long const CpuJiffies = sample.totalCpuTime;
   if (CpuJiffies < 0)
     return -1;
 
@@ -5813,7 +6076,7 @@ double wxMaxima::GetMaximaCPUPercentage() {
     return -1;
   }
 
-  int maximaJiffies = GetMaximaCpuTime();
+  long long const maximaJiffies = sample.processCpuTime;
   if (maximaJiffies < 0)
     return -1;
 
@@ -5861,6 +6124,7 @@ void wxMaxima::OnTimerEvent(wxTimerEvent &event) {
 }
 
 bool wxMaxima::AutoSave() {
+  WXM_TRACE_ZONE("wxMaxima::AutoSave");
   if (!SaveNecessary())
     return true;
 
@@ -6235,6 +6499,10 @@ void wxMaxima::EditMenu(wxCommandEvent &event) {
       if (m_worksheet->GetTree())
         m_worksheet->GetTree()->FontsChangedList();
       ConfigChanged();
+      // The spare maxima follows the new configuration, too. While our own
+      // maxima is starting ReadFirstPrompt() will take care of that.
+      if (!m_configuration.WarmSpareMaxima() || !m_first)
+        StartSpareMaxima();
       m_worksheet->RecalculateForce();
       m_worksheet->RequestRedraw();
     }
@@ -7450,6 +7718,42 @@ void wxMaxima::MaximaMenu(wxCommandEvent &event) {
                           m_worksheet->m_evaluationQueue.CommandsLeftInCell());
     TriggerEvaluation();
   }
+  else if(event.GetId() == EventIDs::menu_evaluate_changed) {
+    m_worksheet->m_evaluationQueue.Clear();
+    EvaluationQueueLength(0);
+    // Restarting maxima here would make all cells outdated.
+    if (m_worksheet->AddChangedCellsToEvaluationQueue(m_maximaSession) == 0) {
+      StatusText(_("All cells are up to date"));
+      return;
+    }
+    // Inform the user about the length of the evaluation queue.
+    EvaluationQueueLength(m_worksheet->m_evaluationQueue.Size(),
+                          m_worksheet->m_evaluationQueue.CommandsLeftInCell());
+    TriggerEvaluation();
+  }
+  else if(event.GetId() == EventIDs::menu_evaluate_all_parallel) {
+    if (!m_worksheet->m_evaluationQueue.Empty() ||
+        (m_parallelEvaluation && m_parallelEvaluation->IsRunning())) {
+      StatusText(_("Cannot evaluate in parallel while an evaluation is running"));
+      return;
+    }
+    wxString const command = GetCommand();
+    if (command.IsEmpty())
+      return;
+    if (!m_parallelEvaluation)
+      m_parallelEvaluation = std::make_unique<ParallelEvaluation>(
+        m_worksheet, &m_configuration,
+        [this](const wxString &status) { StatusText(status); });
+    if (m_parallelEvaluation->Start(
+          command,
+          [this](const wxString &authString) { return MaximaEnvironment(authString); },
+          [this]() { return NewMaximaAuthString(); }, m_port + 1) == 0) {
+      // Nothing to gain from parallelism
+      wxLogMessage(_("No independent sections found: Evaluating the whole worksheet"));
+      wxCommandEvent evaluateAll(wxEVT_MENU, EventIDs::menu_evaluate_all);
+      MaximaMenu(evaluateAll);
+    }
+  }
   else if(event.GetId() == ToolBar::tb_evaltillhere) {
     m_worksheet->m_evaluationQueue.Clear();
     m_worksheet->ResetInputPrompts();
@@ -10375,10 +10679,14 @@ void wxMaxima::TriggerEvaluation() {
       return;
     }
 
+  // Add the resources maxima has used until now to the cell it has evaluated
+  ProcessMonitor::Sample const resources = SampleMaximaResources();
+
   // Maxima is connected. Let's test if the evaluation queue is empty.
   GroupCell *const tmp = m_worksheet->m_evaluationQueue.GetCell();
   if (!tmp) {
     wxLogMessage(_("Evaluation ended, since evaluation queue is empty."));
+    m_resourceCell = nullptr;
     // Maxima is no more busy.
     StatusMaximaBusy(StatusBar::MaximaStatus::waiting);
     // Inform the user that the evaluation queue length now is 0.
@@ -10436,15 +10744,25 @@ void wxMaxima::TriggerEvaluation() {
         m_worksheet->ClearSelection();
     }
     tmp->RemoveOutput();
+    tmp->InputSent(m_maximaSession);
+    tmp->StartEvaluationTimes().peakMemory = resources.residentSetSize;
+    m_resourceCell = tmp;
+    m_resourceCellStart = resources;
+    m_profilingPane->AddEvaluation(tmp);
     m_worksheet->Recalculate(tmp);
     m_worksheet->RequestRedraw();
   }
   wxString text = m_worksheet->m_evaluationQueue.GetCommand();
   m_commandIndex = m_worksheet->m_evaluationQueue.GetIndex();
   if ((text != wxEmptyString) && (text != wxS(";")) && (text != wxS("$"))) {
-    std::size_t index;
-    wxString parenthesisError =
-      GetUnmatchedParenthesisState(tmp->GetEditable()->ToString(true), index);
+    // If maxima already has received this command we only need to remember
+    // that its output belongs to this cell.
+    bool const sentAhead = m_worksheet->m_evaluationQueue.TakeCommandSentAhead();
+    std::size_t index = 0;
+    wxString parenthesisError;
+    if (!sentAhead)
+      parenthesisError =
+        GetUnmatchedParenthesisState(tmp->GetEditable()->ToString(true), index);
     if (parenthesisError.IsEmpty()) {
       if (m_worksheet->FollowEvaluation()) {
         m_worksheet->SetSelection(tmp);
@@ -10458,16 +10776,22 @@ void wxMaxima::TriggerEvaluation() {
       tmp->GetPrompt()->SetValue(m_lastPrompt);
       tmp->ResetSize();
 
-      wxLogMessage(_("Sending a new command to Maxima."));
-      SendMaxima(m_configCommands);
-      SendMaxima(text, true);
+      if (sentAhead)
+        wxLogMessage(_("Maxima already has received the next command."));
+      else {
+        wxLogMessage(_("Sending a new command to Maxima."));
+        SendMaxima(m_configCommands);
+        SendMaxima(text, true);
+        m_worksheet->m_evaluationQueue.SetCommandSent();
+        m_configCommands = wxEmptyString;
+      }
       m_maximaBusy = true;
       // Now that we have sent a command we need to query all variable values
       // anew
       m_varNamesToQuery = m_worksheet->m_variablesPane->GetEscapedVarnames();
       // And the gui is interested in a few variable names
       m_readMaximaVariables = true;
-      m_configCommands = wxEmptyString;
+      SendCommandsAhead();
 
       EvaluationQueueLength(
                             m_worksheet->m_evaluationQueue.Size(),
@@ -10517,6 +10841,87 @@ void wxMaxima::TriggerEvaluation() {
   }
 }
 
+void wxMaxima::SendCommandsAhead() {
+  EvaluationQueue &queue = m_worksheet->m_evaluationQueue;
+  // Settings that have to be sent before the next command keep us from sending
+  // commands ahead until they have been sent.
+  if (!m_configuration.PipelineCommands() || !m_configCommands.IsEmpty() ||
+      queue.ClearsAfterSentCommands() || !queue.CommandSent())
+    return;
+
+  GroupCell *cell;
+  // The last command maxima has received
+  wxString command = queue.PeekCommand(queue.CommandsSentAhead(), &cell);
+  while ((queue.CommandsSentAhead() < m_maxCommandsSentAhead) &&
+         CannotAskQuestion(command)) {
+    command = queue.PeekCommand(queue.CommandsSentAhead() + 1, &cell);
+    wxString trimmed = command;
+    trimmed.Trim(true);
+    trimmed.Trim(false);
+    // Commands without an ending are completed only when they are evaluated,
+    // cells with unmatched parenthesis are refused then.
+    if (!cell || (trimmed.Length() < 2) ||
+        (!trimmed.EndsWith(wxS(";")) && !trimmed.EndsWith(wxS("$"))) ||
+        trimmed.StartsWith(wxS(":lisp")))
+      return;
+    std::size_t index;
+    if (!GetUnmatchedParenthesisState(cell->GetEditable()->ToString(true), index).IsEmpty())
+      return;
+    SendMaxima(command, true);
+    queue.CommandSentAhead(cell);
+  }
+}
+
+bool wxMaxima::CannotAskQuestion(const wxString &command) {
+  // Maxima asks questions only from within functions: A command that calls
+  // no function cannot make it ask one. The body of a function definition
+  // isn't evaluated when the function is defined.
+  MaximaTokenizer::TokenList const tokens =
+    MaximaTokenizer(command, &m_configuration).PopTokens();
+  // The last token that isn't a space
+  const MaximaTokenizer::Token *previous = nullptr;
+  bool isFirstToken = true;
+  bool callsFunction = false;
+  for (auto const &token : tokens) {
+    wxString text = token.GetText();
+    text.Trim(true);
+    text.Trim(false);
+    if (text.IsEmpty() || (token.GetTextStyle() == TS_CODE_COMMENT))
+      continue;
+    switch (token.GetTextStyle()) {
+    case TS_CODE_LISP:
+      return false;
+    case TS_CODE_FUNCTION:
+      // Might be the name of a function that is defined
+      if (!isFirstToken)
+        return false;
+      callsFunction = true;
+      break;
+    case TS_CODE_OPERATOR:
+      // The rest of a function definition won't be evaluated now
+      if ((text == wxS("=")) && previous && (previous->GetText() == wxS(":")))
+        return true;
+      // Subscripted variables might be array functions
+      if ((text == wxS("[")) && previous &&
+          ((previous->GetTextStyle() == TS_CODE_VARIABLE) ||
+           (previous->GetText() == wxS(")")) || (previous->GetText() == wxS("]"))))
+        return false;
+      // Operators the user has defined are functions
+      if (wxIsalpha(text[0]) && (text != wxS("and")) && (text != wxS("or")) &&
+          (text != wxS("not")))
+        return false;
+      break;
+    default:
+      // ?name is a call to a lisp function
+      if (text.StartsWith(wxS("?")))
+        return false;
+    }
+    previous = &token;
+    isFirstToken = false;
+  }
+  return !isFirstToken && !callsFunction;
+}
+
 void wxMaxima::ReplaceSuggestion(wxCommandEvent &event) {
   int index = event.GetId() - EventIDs::popid_suggestion1;
 
@@ -11132,6 +11537,8 @@ wxString wxMaxima::EscapeFilenameForShell(wxString name)
 
 bool wxMaxima::m_pipeToStderr = false;
 bool wxMaxima::m_exitOnError = false;
+wxString wxMaxima::m_recordingFile;
+bool wxMaxima::m_benchmark = false;
 wxString wxMaxima::m_extraMaximaArgs;
 int wxMaxima::m_exitCode = 0;
 // wxRegEx  wxMaxima::m_outputPromptRegEx(wxS("<lbl>.*</lbl>"));
@@ -11161,6 +11568,8 @@ wxString wxMaxima::m_mathPrefix1(wxS("<mth>"));
 wxString wxMaxima::m_mathPrefix2(wxS("<math>"));
 wxString wxMaxima::m_mathSuffix1(wxS("</mth>"));
 wxString wxMaxima::m_mathSuffix2(wxS("</math>"));
+wxString wxMaxima::m_text1DPrefix(wxS("<wxtext>"));
+wxString wxMaxima::m_text1DSuffix(wxS("</wxtext>"));
 wxString wxMaxima::m_emptywxxmlSymbols(wxS("<wxxml-symbols></wxxml-symbols>"));
 wxString wxMaxima::m_firstPrompt(wxS("(%i1) "));
 // wxString wxMaxima::m_outputPromptPrefix(wxS("<lbl>"));
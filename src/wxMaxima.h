@@ -34,7 +34,11 @@
 #include <vector>
 #include "wxMaximaFrame.h"
 #include "MathParser.h"
+#include "MathParserPool.h"
 #include "MaximaIPC.h"
+#include "MaximaOutputBuffer.h"
+#include "ParallelEvaluation.h"
+#include "ResourceUsage.h"
 #include "Dirstructure.h"
 #include <wx/socket.h>
 #include <wx/config.h>
@@ -97,6 +101,14 @@ public:
   static void ExitOnError(){m_exitOnError = true;}
   //! Do we exit if we encounter an error?
   static bool GetExitOnError(){return m_exitOnError;}
+  //! Record all data exchanged with maxima to the file filename, see Maxima::RecordTo()
+  static void RecordMaximaSession(const wxString &filename){m_recordingFile = filename;}
+  //! The file the data exchanged with maxima is recorded to, or an empty string
+  static const wxString &GetRecordingFile(){return m_recordingFile;}
+  //! Log statistics about the output of each command, see LogOutputStatistics()
+  static void Benchmark(){m_benchmark = true;}
+  //! Do we log statistics about the output of each command?
+  static bool GetBenchmark(){return m_benchmark;}
   /*! Allow maxima to click buttons in wxMaxima
 
     Disabled by default for security reasons
@@ -203,6 +215,8 @@ private:
   wxString m_initialWorkSheetContents;
   static bool m_pipeToStderr;
   static bool m_exitOnError;
+  static wxString m_recordingFile;
+  static bool m_benchmark;
   static wxString m_extraMaximaArgs;
   //! The variable names to query for the variables pane and for internal reasons
   std::vector<wxString> m_varNamesToQuery;
@@ -229,6 +243,8 @@ private:
   int m_oldFindFlags;
   //! On opening a new file we only need a new maxima process if the old one ever evaluated cells.
   bool m_hasEvaluatedCells;
+  //! Counts the maxima processes this window has talked to, see GroupCell::InputSent()
+  long m_maximaSession = 0;
   //! Searches for maxima's output prompts
 //  static wxRegEx m_outputPromptRegEx;
   //! The number of output cells the current command has produced so far.
@@ -352,11 +368,14 @@ protected:
 
     We don't interpret this data directly in the idle event since if we
     block somewhere in the idle event we block gnome.
+    \param newData The data
+    \param knownFrames The frames in newData maxima has told us the length of
     \return
     - true, if there was new data
     - false, if there wasn't any new data.
   */
-  bool InterpretDataFromMaxima(const wxString &newData);
+  bool InterpretDataFromMaxima(const wxString &newData,
+                               const MaximaOutputBuffer::KnownFrames &knownFrames = {});
   bool InterpretDataFromMaxima();
   bool m_dataFromMaximaIs;
 
@@ -404,10 +423,15 @@ protected:
 
   //! Is called if maxima connects to wxMaxima.
   void OnMaximaConnect();
+  //! Starts talking to the maxima that has opened the connection socket
+  void UseMaximaConnection(wxSocketBase *socket);
 
   //! Maxima sends or receives data, or disconnects
   void MaximaEvent(::MaximaEvent &event);
 
+  //! A background thread has converted a piece of maths to cells
+  void OnMathParsed(wxThreadEvent &event);
+
   //! Server event: Maxima connects
   void ServerEvent(wxSocketEvent &event);
 
@@ -430,12 +454,28 @@ protected:
   enum AppendOpt { NewLine = 1, BigSkip = 2, PromptToolTip = 4, DefaultOpt = NewLine|BigSkip };
   void DoConsoleAppend(wxString s, CellType type, AppendOpt opts = AppendOpt::DefaultOpt,
                        const wxString &userLabel = {});
+  //! Appends the cells MathParser has generated from maxima's output to the console
+  void InsertParsedCell(std::unique_ptr<Cell> &&cell, AppendOpt opts);
+  /*! Appends the maths m_parserPool has finished parsing to the console
+
+    \param wait true = Wait until all maths that has been handed to the pool
+    has been parsed.
+  */
+  void InsertParsedMath(bool wait = false);
 
   /*!Append one or more lines of ordinary unicode text to the console
 
     \return A pointer to the last line that was appended or NULL, if there is no such line
   */
   TextCell *DoRawConsoleAppend(wxString s, CellType  type, AppendOpt opts = {});
+  /*! Appends text to a text cell that already is part of the worksheet
+
+    Long lines are split into several cells in the same line so maxima can
+    stream text into the worksheet without each piece of text making us
+    handle all of the text that was sent before.
+    \return The cell the text ended up in.
+  */
+  TextCell *AppendToTextCell(TextCell *cell, const wxString &text);
 
   /*! Spawn the "configure" menu.
 
@@ -472,6 +512,17 @@ protected:
   //! Try to evaluate the next command for maxima that is in the evaluation queue
   void TriggerEvaluation();
 
+  /*! Sends the commands that follow the current one to maxima, if pipelining is enabled
+
+    A command is only sent ahead if all commands maxima will process before
+    it cannot ask a question: Else maxima would read it as the answer.
+  */
+  void SendCommandsAhead();
+  //! Is it impossible for command to make maxima ask a question?
+  bool CannotAskQuestion(const wxString &command);
+  //! The maximum number of commands that are sent before the current one has finished
+  static constexpr std::size_t m_maxCommandsSentAhead = 16;
+
   void TryUpdateInspector();
 
   bool UpdateDrawPane();
@@ -491,6 +542,24 @@ protected:
     \param force true means to restart maxima unconditionally.
   */
   bool StartMaxima(bool force = false);
+  /*! The environment maxima is started in
+
+    \param authString The key maxima authenticates itself with
+  */
+  wxEnvVariableHashMap MaximaEnvironment(const wxString &authString);
+  //! Generates a new key for maxima to authenticate itself with
+  wxString NewMaximaAuthString();
+  /*! Takes over the spare maxima, if there is one that fits
+
+    \param command The command maxima is to be started with, without "-s <port>"
+  */
+  bool UseSpareMaxima(const wxString &command);
+  /*! Starts a spare maxima, if the user has asked for that, and stops it, if not
+
+    Called once our own maxima has started and whenever the configuration
+    has been changed.
+  */
+  void StartSpareMaxima();
 
   void OnClose(wxCloseEvent &event);               //!< close wxMaxima window
   wxString GetCommand(bool params = true);         //!< returns the command to start maxima
@@ -506,10 +575,10 @@ protected:
     - it discards all data until this point
     - and it prepares the worksheet for editing.
 
-    \param data The string ReadFirstPrompt() does read its data from.
+    \param data The buffer ReadFirstPrompt() does read its data from.
     After leaving this function data is empty again.
   */
-  void ReadFirstPrompt(wxString &data);
+  void ReadFirstPrompt(MaximaOutputBuffer &data);
 
   /*! Reads an XML tag or a piece of status text from maxima's output
 
@@ -517,10 +586,14 @@ protected:
     theoretical case that maxima might stop sending data in the middle of an XML tag
     and then resume sending data with the next XML packet?
   */
-  bool ParseNextChunkFromMaxima(wxString &data);
+  bool ParseNextChunkFromMaxima(MaximaOutputBuffer &data);
 
-  //! Find the end of a tag in wxMaxima's output.
-  long FindTagEnd(const wxString &data, const wxString &tag);
+  /*! Find the end of a tag in wxMaxima's output.
+
+    If maxima has told us the length of the frame data starts with the end
+    of the tag is found without searching for it.
+  */
+  long FindTagEnd(const MaximaOutputBuffer &data, const wxString &tag);
 
   /*! Reads text that isn't enclosed between xml tags.
 
@@ -531,20 +604,28 @@ protected:
   */
   void ReadMiscText(const wxString &data);
 
+  /*! Tells if text maxima has output is an error message, a warning or a result
+
+    \return MC_TYPE_ERROR, MC_TYPE_WARNING, MC_TYPE_TEXT or MC_TYPE_ASCIIMATHS
+  */
+  CellType ClassifyText(const wxString &data) const;
+  //! Adds the cell maxima is working on to the list of cells with errors
+  void MarkErroneousGroup();
+
   /*! Reads the input prompt from Maxima.
 
     After processing the input prompt it is removed from data.
   */
-  void ReadPrompt(wxString &data);
+  void ReadPrompt(MaximaOutputBuffer &data);
 
   /*! Reads the output of wxstatusbar() commands
 
     wxstatusbar allows the user to give and update visual feedback from long-running
     commands and makes sure this feedback is deleted once the command is finished.
   */
-  void ReadStatusBar(wxString &data);
+  void ReadStatusBar(MaximaOutputBuffer &data);
   //! Read a manual topic name so we can jump to the right documentation page
-  void ReadManualTopicNames(wxString &data);
+  void ReadManualTopicNames(MaximaOutputBuffer &data);
 
   /*! Reads the math cell's contents from Maxima.
 
@@ -554,26 +635,32 @@ protected:
 
     After processing the status bar marker is removed from data.
   */
-  void ReadMath(wxString &data);
+  void ReadMath(MaximaOutputBuffer &data);
+
+  /*! Reads a result maxima has output as plain text because display2d is false
+
+    The text is put into text cells directly, without being parsed.
+  */
+  void ReadText1D(MaximaOutputBuffer &data);
 
   /*! Reads autocompletion templates we get on definition of a function or variable
 
     After processing the templates they are removed from data.
   */
 
-  void ReadMaximaIPC(wxString &data){m_ipc.ReadInputData(data);}
-  void ReadLoadSymbols(wxString &data);
+  void ReadMaximaIPC(MaximaOutputBuffer &data){m_ipc.ReadInputData(data);}
+  void ReadLoadSymbols(MaximaOutputBuffer &data);
 
   //! Read (and discard) suppressed output
-  void ReadSuppressedOutput(wxString &data);
+  void ReadSuppressedOutput(MaximaOutputBuffer &data);
 
   /*! Reads the variable values maxima advertises to us
    */
-  void ReadVariables(wxString &data);
+  void ReadVariables(MaximaOutputBuffer &data);
 
   /*! Reads the "add variable to watch list" tag maxima can send us
    */
-  void ReadAddVariables(wxString &data);
+  void ReadAddVariables(MaximaOutputBuffer &data);
   void VariableActionGentranlang(const wxString &value);
   void VariableActionHtmlHelp(const wxString &value);
   void VariableActionOpSubst(const wxString &value);
@@ -609,18 +696,21 @@ protected:
   wxString m_maximaVariable_altdisplay2d;
   wxString m_maximaVariable_engineeringFormat;
   bool m_readMaximaVariables = false;
-  /*! How much CPU time has been used by the system until now? Used by GetMaximaCPUPercentage.
+  /*! Finds out which resources maxima uses
 
-    \return The CPU time elapsed in the same unit as GetMaximaCpuTime(); -1 means: Unable to determine this value.
+    Adds the CPU time and memory maxima has used since the last call to the
+    cell that is being evaluated and warns if maxima is about to run out of
+    memory.
   */
-  long long GetTotalCpuTime();
-
-  /*! How much CPU time has maxima used till now? Used by GetMaximaCPUPercentage.
-
-    \return The CPU time maxima has used in the same unit as GetTotalCpuTime(); -1 means: Unable to determine this value.
-
-  */
-  long long GetMaximaCpuTime();
+  ProcessMonitor::Sample SampleMaximaResources();
+  //! Watches the resources the maxima process uses
+  ProcessMonitor m_maximaMonitor;
+  //! The cell the resources maxima uses currently are added to
+  CellPtr<GroupCell> m_resourceCell;
+  //! What maxima had used when m_resourceCell was sent to it
+  ProcessMonitor::Sample m_resourceCellStart;
+  //! Have we already warned that maxima uses nearly all memory?
+  bool m_maximaMemoryWarningShown = false;
 
   /*! How much CPU horsepower is maxima using currently?
 
@@ -742,7 +832,7 @@ protected:
   */
   wxString m_currentOutputEnd;
   //! All from maxima's current output we still haven't interpreted
-  wxString m_currentOutput;
+  MaximaOutputBuffer m_currentOutput;
   //! A marker for the start of maths
   static wxString m_mathPrefix1;
   //! A marker for the start of maths
@@ -751,6 +841,10 @@ protected:
   static wxString m_mathSuffix1;
   //! A marker for the end of maths
   static wxString m_mathSuffix2;
+  //! A marker for the start of a result in plain text
+  static wxString m_text1DPrefix;
+  //! A marker for the end of a result in plain text
+  static wxString m_text1DSuffix;
   //! The marker for the start of a input prompt
   static wxString m_promptPrefix;
 public:
@@ -827,13 +921,37 @@ protected:
   static wxRegEx m_blankStatementRegEx;
   static wxRegEx m_sbclCompilationRegEx;
   MathParser m_parser;
+  //! The threads that convert maths from maxima to cells in the background
+  MathParserPool m_parserPool;
+  //! Evaluates independent sections in separate maxima processes, if requested
+  std::unique_ptr<ParallelEvaluation> m_parallelEvaluation;
+  //! True while InsertParsedMath() is running
+  bool m_insertingParsedMath = false;
+  //! The time the GUI thread has spent parsing maxima's output in total, in seconds
+  double m_parseTime = 0;
+  //! The numbers LogOutputStatistics() has reported last
+  struct OutputStatistics
+  {
+    std::size_t cellsCreated = 0;
+    double parseTime = 0;
+    double recalculationTime = 0;
+  } m_lastOutputStatistics;
+  /*! Logs the resources maxima's output has used since the last call
+
+    Allows to find out how fast the output of a command could be displayed,
+    for example when test/replay/maxima-replay stands in for maxima. The
+    output is laid out when wxMaxima is idle, which means that most of its
+    layout time is reported the next time. Only used with --benchmark, as
+    finding out the peak memory usage isn't free.
+  */
+  void LogOutputStatistics();
   bool m_maximaBusy;
 private:
   bool m_fourierLoaded = false;
   //! The value of maxima's logexpand variable
   wxString m_logexpand;
   //! A pointer to a method that handles a text chunk
-  typedef void (wxMaxima::*ParseFunction)(wxString &s);
+  typedef void (wxMaxima::*ParseFunction)(MaximaOutputBuffer &s);
   typedef void (wxMaxima::*VarReadFunction)(const wxString &value);
   typedef void (wxMaxima::*VarUndefinedFunction)();
 #if wxCHECK_VERSION(3, 3, 0) || wxUSE_STL
@@ -178,7 +178,8 @@ wxMaximaFrame::wxMaximaFrame(wxWindow *parent, int id,
                                                        &m_configuration,
                                                        m_worksheet->GetTreeAddress());
 
-  m_xmlInspector = new XmlInspector(this, -1);
+  m_xmlInspector = new XmlInspector(this, -1, &m_configuration);
+  m_profilingPane = new ProfilingPane(this, -1);
   //  wxWindowUpdateLocker xmlInspectorBlocker(m_xmlInspector);
   m_statusBar = new StatusBar(this, -1);
   //  wxWindowUpdateLocker statusbarBlocker(m_statusBar);
@@ -265,6 +266,12 @@ wxMaximaFrame::wxMaximaFrame(wxWindow *parent, int id,
                     .Name(m_sidebarNames[EventIDs::menu_pane_xmlInspector])
                     .Right());
 
+  m_sidebarNames[EventIDs::menu_pane_profiling] = wxS("profiling");
+  m_sidebarCaption[EventIDs::menu_pane_profiling] = _("Evaluation times");
+  m_manager.AddPane(m_profilingPane, wxAuiPaneInfo()
+                    .Name(m_sidebarNames[EventIDs::menu_pane_profiling])
+                    .Right());
+
   m_sidebarNames[EventIDs::menu_pane_stats] = wxS("stats");
   m_sidebarCaption[EventIDs::menu_pane_stats] = _("Statistics");
   wxWindow *statPane;
@@ -435,6 +442,7 @@ wxMaximaFrame::wxMaximaFrame(wxWindow *parent, int id,
   m_manager.GetPane(m_sidebarNames[EventIDs::menu_pane_wizard]).Show(false);
   // The xml inspector slows down everything => close it at startup
   m_manager.GetPane(m_sidebarNames[EventIDs::menu_pane_xmlInspector]).Show(false);
+  m_manager.GetPane(m_sidebarNames[EventIDs::menu_pane_profiling]).Show(false);
   // The unicode selector needs loads of time for starting up
   // => close it at startup
   m_manager.GetPane(m_sidebarNames[EventIDs::menu_pane_unicode]).Show(false);
@@ -744,6 +752,8 @@ void wxMaximaFrame::SetupMenu() {
   m_Maxima_Panes_Sub->AppendCheckItem(EventIDs::menu_pane_variables, _("Variables"));
   m_Maxima_Panes_Sub->AppendCheckItem(EventIDs::menu_pane_xmlInspector,
                                       _("Raw XML monitor"));
+  m_Maxima_Panes_Sub->AppendCheckItem(EventIDs::menu_pane_profiling,
+                                      _("Evaluation times"));
   m_Maxima_Panes_Sub->AppendSeparator();
   m_Maxima_Panes_Sub->Append(EventIDs::menu_pane_dockAll, _("Dock all Sidebars"));
   m_Maxima_Panes_Sub->AppendSeparator();
@@ -879,6 +889,17 @@ void wxMaximaFrame::SetupMenu() {
                                                                wxRendererNative::Get().GetCheckBoxSize(this)));
     m_CellMenu->Append(it);
   }
+  m_CellMenu->Append(
+                     EventIDs::menu_evaluate_changed, _("Evaluate Changed Cells"),
+                     _("Evaluate the cells that have changed since they were "
+                       "evaluated last and the cells that depend on them"),
+                     wxITEM_NORMAL);
+  m_CellMenu->Append(
+                     EventIDs::menu_evaluate_all_parallel,
+                     _("Evaluate Independent Sections in Parallel"),
+                     _("Evaluate sections that don't depend on each other in "
+                       "separate maxima processes at the same time"),
+                     wxITEM_NORMAL);
   {
     wxMenuItem *it = new wxMenuItem(
                                     m_CellMenu, ToolBar::tb_evaltillhere,
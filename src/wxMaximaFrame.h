@@ -51,6 +51,7 @@
 #include "MainMenuBar.h"
 #include "History.h"
 #include "XmlInspector.h"
+#include "ProfilingPane.h"
 #include "StatusBar.h"
 #include "LogPane.h"
 #include "ButtonWrapSizer.h"
@@ -370,6 +371,8 @@ protected:
   wxAuiManager m_manager;
   //! A XmlInspector-like xml monitor
   XmlInspector *m_xmlInspector;
+  //! The sidebar that shows how long evaluating the cells took
+  ProfilingPane *m_profilingPane;
   //! true=force an update of the status bar at the next call of StatusMaximaBusy()
   bool m_forceStatusbarUpdate;
   //! The panel the log and debug messages will appear on
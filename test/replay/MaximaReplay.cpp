@@ -0,0 +1,469 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+/*! \file
+  A stand-in for maxima that plays back a session recorded by wxMaxima's
+  --record option.
+
+  wxMaxima starts it instead of maxima if it is passed as the maxima binary:
+
+    MAXIMA_REPLAY_FILE=session.wxmrec wxmaxima --maxima=maxima-replay ...
+
+  It then connects to the port wxMaxima passes with "-s", exactly like maxima
+  does, and sends all data maxima has sent in the recorded session. Each
+  time wxMaxima had sent something in the recorded session the playback
+  waits until wxMaxima sends something, again. All other arguments are
+  ignored, so the usual maxima arguments don't disturb.
+
+  Options (or the environment variables that set them):
+  - --recording=FILE (MAXIMA_REPLAY_FILE): The recording to play back
+  - --timing=original (MAXIMA_REPLAY_TIMING): Send the data at the times
+    it has been recorded at instead of as fast as possible
+  - --check: Don't connect to wxMaxima, only read the recording and print
+    what it contains.
+  - --generate=KIND:SIZE[:COUNT] (MAXIMA_REPLAY_GENERATE): Instead of playing back a recording answer
+    the first command wxMaxima sends with COUNT (default: 1) synthetic
+    outputs that stress the way wxMaxima reads and displays output. KIND is
+    one of:
+    - matrix: a SIZE×SIZE matrix
+    - fractions: fractions nested SIZE levels deep
+    - list: a list with SIZE elements
+    - prompts: SIZE short outputs, each followed by a prompt
+    - text: SIZE lines of plain text
+
+  wxMaxima logs how many cells it has created for each command's output, the
+  time it has spent parsing and laying them out and its peak memory usage
+  ("Output statistics", see its options --benchmark and --logtostderr).
+
+  The time it took to send everything, the time wxMaxima took to react to
+  each prompt and the time until wxMaxima closed the connection are printed
+  to stdout, which wxMaxima logs.
+
+  The authentication key in the recording is replaced by the one wxMaxima
+  passes in MAXIMA_AUTH_CODE.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <wx/ffile.h>
+#include <wx/init.h>
+#include <wx/socket.h>
+#include <wx/string.h>
+#include <wx/utils.h>
+
+namespace {
+//! A block of data that was sent in the recorded session
+struct Record
+{
+  //! 'M' for data from maxima, 'W' for data from wxMaxima
+  char direction = 'M';
+  //! The time the data was sent at, in microseconds after the session started
+  long long time = 0;
+  std::string data;
+};
+
+//! The first line of a recording
+const std::string RECORDING_HEADER = "wxMaxima-recording 1\n";
+//! How long we wait for wxMaxima to answer, in seconds
+constexpr int ANSWER_TIMEOUT = 120;
+
+/*! Reads a recording made by Maxima::RecordTo()
+
+  \return false, if the file couldn't be read or isn't a recording.
+*/
+bool ReadRecording(const wxString &filename, std::vector<Record> &records)
+{
+  wxFFile file(filename, wxS("rb"));
+  if (!file.IsOpened())
+    return false;
+  std::string contents(static_cast<std::size_t>(file.Length()), '\0');
+  if (file.Read(&contents[0], contents.size()) != contents.size())
+    return false;
+
+  if (contents.compare(0, RECORDING_HEADER.size(), RECORDING_HEADER) != 0)
+    return false;
+  std::size_t pos = RECORDING_HEADER.size();
+  while (pos < contents.size()) {
+    std::size_t const lineEnd = contents.find('\n', pos);
+    if (lineEnd == std::string::npos)
+      return false;
+    Record record;
+    unsigned long length = 0;
+    char direction = 0;
+    if (std::sscanf(contents.substr(pos, lineEnd - pos).c_str(), "%c %lld %lu",
+                    &direction, &record.time, &length) != 3)
+      return false;
+    if ((direction != 'M') && (direction != 'W'))
+      return false;
+    record.direction = direction;
+    pos = lineEnd + 1;
+    // The data is followed by a newline
+    if (pos + length + 1 > contents.size())
+      return false;
+    record.data = contents.substr(pos, length);
+    pos += length + 1;
+    records.push_back(std::move(record));
+  }
+  return true;
+}
+
+//! Replaces the authentication key in the recording by the one of this session
+void ReplaceAuthKey(std::vector<Record> &records)
+{
+  const char *const key = std::getenv("MAXIMA_AUTH_CODE");
+  if (!key)
+    return;
+  static const std::string keyStart = "<wxxml-key>";
+  static const std::string keyEnd = "</wxxml-key>";
+  for (auto &record : records) {
+    if (record.direction != 'M')
+      continue;
+    std::size_t const start = record.data.find(keyStart);
+    if (start == std::string::npos)
+      continue;
+    std::size_t const end = record.data.find(keyEnd, start);
+    if (end == std::string::npos)
+      continue;
+    record.data.replace(start + keyStart.size(),
+                        end - start - keyStart.size(), key);
+  }
+}
+
+//! Reads and discards everything wxMaxima has sent. Returns the number of bytes.
+std::size_t Drain(wxSocketClient &socket, long milliseconds)
+{
+  std::size_t bytes = 0;
+  char buffer[65536];
+  while (socket.IsConnected() && socket.WaitForRead(0, milliseconds)) {
+    socket.Read(buffer, sizeof(buffer));
+    if (socket.Error() || (socket.LastReadCount() == 0)) {
+      // There was something to read, but nothing could be read => wxMaxima
+      // has closed the connection.
+      socket.Close();
+      break;
+    }
+    bytes += socket.LastReadCount();
+    milliseconds = 0;
+  }
+  return bytes;
+}
+
+//! Sends data to wxMaxima, reading its input meanwhile so neither side can block
+bool Send(wxSocketClient &socket, const std::string &data)
+{
+  std::size_t pos = 0;
+  while (pos < data.size()) {
+    socket.Write(data.data() + pos, data.size() - pos);
+    if (socket.Error() && (socket.LastError() != wxSOCKET_WOULDBLOCK))
+      return false;
+    pos += socket.LastWriteCount();
+    if (!socket.IsConnected())
+      return false;
+    if (pos < data.size())
+      Drain(socket, 1);
+  }
+  return true;
+}
+
+//! Appends a block of data maxima sends to records
+void AddMaximaRecord(std::vector<Record> &records, std::string data)
+{
+  Record record;
+  record.direction = 'M';
+  record.data = std::move(data);
+  records.push_back(std::move(record));
+}
+
+//! Appends a point at which the playback waits for wxMaxima to send something
+void AddWait(std::vector<Record> &records)
+{
+  Record record;
+  record.direction = 'W';
+  records.push_back(std::move(record));
+}
+
+//! An output label in the format maxima sends it
+std::string OutputLabel(std::size_t number)
+{
+  std::string const label = "%o" + std::to_string(number);
+  return "<lbl altCopy=\"" + label + "\">(" + label + ") </lbl>";
+}
+
+//! The prompt maxima sends after command number-1 has been evaluated
+std::string Prompt(std::size_t number)
+{
+  return "<PROMPT>(%i" + std::to_string(number) + ") </PROMPT>";
+}
+
+std::string Matrix(std::size_t size, std::size_t outputNumber)
+{
+  std::string result = "<math>" + OutputLabel(outputNumber) +
+    "<tb roundedParens=\"true\">";
+  for (std::size_t row = 0; row < size; row++) {
+    result += "<mtr>";
+    for (std::size_t column = 0; column < size; column++)
+      result += "<mtd><mi>x</mi><mo>+</mo><mn>" +
+        std::to_string(row * size + column) + "</mn></mtd>";
+    result += "</mtr>";
+  }
+  return result + "</tb></math>";
+}
+
+std::string Fractions(std::size_t depth, std::size_t outputNumber)
+{
+  std::string result = "<math>" + OutputLabel(outputNumber);
+  for (std::size_t i = 0; i < depth; i++)
+    result += "<mfrac><mrow><mn>1</mn></mrow><mrow><mn>" +
+      std::to_string(i + 1) + "</mn><mo>+</mo>";
+  result += "<mi>x</mi>";
+  for (std::size_t i = 0; i < depth; i++)
+    result += "</mrow></mfrac>";
+  return result + "</math>";
+}
+
+std::string List(std::size_t size, std::size_t outputNumber)
+{
+  std::string result = "<math>" + OutputLabel(outputNumber) +
+    "<mrow list=\"true\"><t listdelim=\"true\">[</t>";
+  for (std::size_t i = 0; i < size; i++) {
+    if (i > 0)
+      result += "<fnm>,</fnm>";
+    result += "<mn>" + std::to_string(i) + "</mn>";
+  }
+  return result + "<t listdelim=\"true\">]</t></mrow></math>";
+}
+
+std::string Text(std::size_t lines)
+{
+  std::string result;
+  for (std::size_t i = 0; i < lines; i++)
+    result += "Line " + std::to_string(i) +
+      " of a long text maxima has printed while evaluating a command\n";
+  return result;
+}
+
+/*! Creates a session that answers the first command with synthetic outputs
+
+  \param spec KIND:SIZE[:COUNT], see the description of --generate
+  \return false, if spec cannot be understood.
+*/
+bool Generate(const wxString &spec, std::vector<Record> &records)
+{
+  wxString const kind = spec.BeforeFirst(':');
+  wxString const rest = spec.AfterFirst(':');
+  unsigned long size = 0;
+  unsigned long count = 1;
+  if (!rest.BeforeFirst(':').ToULong(&size) || (size == 0))
+    return false;
+  if (rest.Contains(wxS(":")) && !rest.AfterFirst(':').ToULong(&count))
+    return false;
+
+  // The handshake: The first prompt, to which wxMaxima answers with its
+  // setup commands, and the authentication key.
+  AddMaximaRecord(records, "(%i1) ");
+  AddWait(records);
+  AddMaximaRecord(records, "<suppressOutput>\n<wxxml-key>KEY</wxxml-key>\n"
+                  "</suppressOutput>\n" + Prompt(1));
+  // The first command the user evaluates
+  AddWait(records);
+
+  std::size_t prompt = 1;
+  for (unsigned long i = 0; i < count; i++) {
+    std::string output;
+    if (kind == wxS("matrix"))
+      output = Matrix(size, prompt);
+    else if (kind == wxS("fractions"))
+      output = Fractions(size, prompt);
+    else if (kind == wxS("list"))
+      output = List(size, prompt);
+    else if (kind == wxS("text"))
+      output = Text(size);
+    else if (kind == wxS("prompts")) {
+      for (unsigned long j = 0; j < size; j++) {
+        output += "<math>" + OutputLabel(prompt) + "<mn>" +
+          std::to_string(j) + "</mn></math>";
+        output += Prompt(++prompt);
+      }
+      AddMaximaRecord(records, std::move(output));
+      continue;
+    }
+    else
+      return false;
+    AddMaximaRecord(records, std::move(output) + Prompt(++prompt));
+  }
+  return true;
+}
+
+int Check(const std::vector<Record> &records)
+{
+  std::size_t maximaBytes = 0;
+  std::size_t wxMaximaBytes = 0;
+  std::size_t waits = 0;
+  for (auto const &record : records) {
+    if (record.direction == 'M')
+      maximaBytes += record.data.size();
+    else {
+      wxMaximaBytes += record.data.size();
+      waits++;
+    }
+  }
+  long long const duration = records.empty() ? 0 : records.back().time;
+  std::printf("%lu blocks, %lu bytes from maxima, %lu bytes from wxMaxima in "
+              "%lu blocks, %.3f s\n",
+              static_cast<unsigned long>(records.size()),
+              static_cast<unsigned long>(maximaBytes),
+              static_cast<unsigned long>(wxMaximaBytes),
+              static_cast<unsigned long>(waits), duration / 1e6);
+  return 0;
+}
+
+int Replay(const std::vector<Record> &records, unsigned short port,
+           bool originalTiming)
+{
+  // We have no event loop => the socket must block instead of yielding
+  wxSocketClient socket(wxSOCKET_BLOCK);
+  wxIPV4address address;
+  address.Hostname(wxS("localhost"));
+  address.Service(port);
+  if (!socket.Connect(address, true)) {
+    std::fprintf(stderr, "maxima-replay: Cannot connect to port %u\n",
+                 static_cast<unsigned>(port));
+    return 1;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  auto const start = Clock::now();
+  auto lastSent = start;
+  double maxAnswerTime = 0;
+  double totalAnswerTime = 0;
+  std::size_t answers = 0;
+  std::size_t bytesSent = 0;
+  for (auto const &record : records) {
+    if (record.direction == 'W') {
+      // wxMaxima had answered here => wait for it to answer, again.
+      long waited = 0;
+      while ((Drain(socket, 100) == 0) && socket.IsConnected()) {
+        waited += 100;
+        if (waited > ANSWER_TIMEOUT * 1000)
+          break;
+      }
+      double const answerTime =
+        std::chrono::duration<double>(Clock::now() - lastSent).count();
+      maxAnswerTime = std::max(maxAnswerTime, answerTime);
+      totalAnswerTime += answerTime;
+      answers++;
+      continue;
+    }
+    if (originalTiming) {
+      auto const due = start + std::chrono::microseconds(record.time);
+      while (Clock::now() < due) {
+        auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now());
+        Drain(socket, std::max(1L, static_cast<long>(left.count())));
+      }
+    }
+    if (!Send(socket, record.data)) {
+      std::fprintf(stderr, "maxima-replay: wxMaxima has closed the connection\n");
+      return 1;
+    }
+    bytesSent += record.data.size();
+    lastSent = Clock::now();
+  }
+
+  double const sendTime =
+    std::chrono::duration<double>(Clock::now() - start).count();
+  std::printf("maxima-replay: Sent %lu bytes in %.3f s (%.1f MB/s)\n",
+              static_cast<unsigned long>(bytesSent), sendTime,
+              (sendTime > 0) ? bytesSent / sendTime / 1e6 : 0.0);
+  if (answers > 0)
+    std::printf("maxima-replay: wxMaxima answered %lu times, after %.3f s on "
+                "average and %.3f s at most\n",
+                static_cast<unsigned long>(answers),
+                totalAnswerTime / answers, maxAnswerTime);
+  std::fflush(stdout);
+
+  // Maxima stays connected until wxMaxima closes the connection
+  while (socket.IsConnected())
+    Drain(socket, 100);
+  std::printf("maxima-replay: wxMaxima closed the connection after %.3f s\n",
+              std::chrono::duration<double>(Clock::now() - start).count());
+  return 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+  wxInitializer initializer;
+  if (!initializer.IsOk()) {
+    std::fprintf(stderr, "maxima-replay: Cannot initialize wxWidgets\n");
+    return 1;
+  }
+
+  wxString recording;
+  wxGetEnv(wxS("MAXIMA_REPLAY_FILE"), &recording);
+  wxString timing;
+  wxGetEnv(wxS("MAXIMA_REPLAY_TIMING"), &timing);
+  wxString generate;
+  wxGetEnv(wxS("MAXIMA_REPLAY_GENERATE"), &generate);
+  bool check = false;
+  unsigned long port = 0;
+  for (int i = 1; i < argc; i++) {
+    wxString const arg = wxString::FromUTF8(argv[i]);
+    wxString value;
+    if ((arg == wxS("-s")) && (i + 1 < argc))
+      wxString::FromUTF8(argv[++i]).ToULong(&port);
+    else if (arg.StartsWith(wxS("--recording="), &value))
+      recording = value;
+    else if (arg.StartsWith(wxS("--timing="), &value))
+      timing = value;
+    else if (arg.StartsWith(wxS("--generate="), &value))
+      generate = value;
+    else if (arg == wxS("--check"))
+      check = true;
+  }
+
+  std::vector<Record> records;
+  if (!generate.IsEmpty()) {
+    if (!Generate(generate, records)) {
+      std::fprintf(stderr, "maxima-replay: Cannot generate \"%s\"\n",
+                   static_cast<const char *>(generate.utf8_str()));
+      return 1;
+    }
+  }
+  else if (recording.IsEmpty() || !ReadRecording(recording, records)) {
+    std::fprintf(stderr, "maxima-replay: Cannot read the recording \"%s\"\n",
+                 static_cast<const char *>(recording.utf8_str()));
+    return 1;
+  }
+  if (check)
+    return Check(records);
+
+  if ((port == 0) || (port > 65535)) {
+    std::fprintf(stderr, "maxima-replay: No port to connect to given (-s PORT)\n");
+    return 1;
+  }
+  ReplaceAuthKey(records);
+  return Replay(records, static_cast<unsigned short>(port),
+                timing == wxS("original"));
+}
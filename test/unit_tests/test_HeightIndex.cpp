@@ -0,0 +1,222 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#define CATCH_CONFIG_RUNNER
+
+// HeightIndex only needs the height of each GroupCell and the list they form.
+// Real GroupCells would need a configuration and fonts => we replace them
+// with the fake below.
+#define GROUPCELL_H
+#include "HeightIndex.h"
+#include <memory>
+#include <vector>
+
+class GroupCell
+{
+public:
+  explicit GroupCell(int height) : m_height(height) {}
+  int GetHeight() const { return m_height; }
+  void SetHeight(int height) { m_height = height; }
+  void SetHeightIndex(HeightIndex *index, std::size_t slot)
+    { m_heightIndex = index; m_heightIndexSlot = slot; }
+  const HeightIndex *GetHeightIndex() const { return m_heightIndex; }
+  std::size_t GetHeightIndexSlot() const { return m_heightIndexSlot; }
+
+  GroupCell *m_next = {};
+
+private:
+  int m_height;
+  HeightIndex *m_heightIndex = {};
+  std::size_t m_heightIndexSlot = 0;
+};
+
+class GroupCellIterator
+{
+public:
+  explicit GroupCellIterator(GroupCell *cell) : m_cell(cell) {}
+  GroupCell &operator*() const { return *m_cell; }
+  GroupCellIterator &operator++() { m_cell = m_cell->m_next; return *this; }
+  bool operator!=(const GroupCellIterator &other) const
+    { return m_cell != other.m_cell; }
+
+private:
+  GroupCell *m_cell;
+};
+
+struct GroupCellList
+{
+  GroupCell *first;
+  GroupCellIterator begin() const { return GroupCellIterator(first); }
+  GroupCellIterator end() const { return GroupCellIterator(nullptr); }
+};
+
+static GroupCellList OnList(GroupCell *cell) { return {cell}; }
+
+#include "HeightIndex.cpp"
+#include <catch2/catch.hpp>
+
+//! A list of fake GroupCells with the given heights
+static std::vector<std::unique_ptr<GroupCell>> MakeCells(const std::vector<int> &heights) {
+  std::vector<std::unique_ptr<GroupCell>> cells;
+  for (auto height : heights) {
+    cells.emplace_back(std::make_unique<GroupCell>(height));
+    if (cells.size() > 1)
+      cells[cells.size() - 2]->m_next = cells.back().get();
+  }
+  return cells;
+}
+
+SCENARIO("HeightIndex knows the y position of GroupCells") {
+  GIVEN("Cells of the heights 20, 0, 30, -1 and 40") {
+    // With a base indent of 10 and a GroupSkip of 5 the cells occupy:
+    //   0: 10..29, GroupSkip 30..34
+    //   1: Zero height at 35, GroupSkip 35..39
+    //   2: 40..74, GroupSkip 75..79  (= top 40, height 30 + skip 5)
+    //   3: Not recalculated, counts as zero height at 75, GroupSkip 75..79
+    //   4: 80..119
+    auto cells = MakeCells({20, 0, 30, -1, 40});
+    HeightIndex index;
+    REQUIRE(index.Sync(cells.front().get(), 10, 5));
+
+    THEN("The tops are the sums of the heights above") {
+      REQUIRE(index.Size() == 5);
+      REQUIRE(index.GetTop(0) == 10);
+      REQUIRE(index.GetTop(1) == 35);
+      REQUIRE(index.GetTop(2) == 40);
+      REQUIRE(index.GetTop(3) == 75);
+      REQUIRE(index.GetTop(4) == 80);
+      REQUIRE(index.GetBottom(4) == 119);
+      REQUIRE(index.GetTotalHeight() == 119);
+    }
+    THEN("A negative height counts as zero") {
+      REQUIRE(index.GetHeight(3) == 0);
+      REQUIRE(index.GetBottom(3) == 74);
+    }
+    THEN("FindSlot finds the cell that begins at exactly y") {
+      REQUIRE(index.FindSlot(10) == 0);
+      REQUIRE(index.FindSlot(35) == 1);
+      REQUIRE(index.FindSlot(40) == 2);
+      REQUIRE(index.FindSlot(75) == 3);
+      REQUIRE(index.FindSlot(80) == 4);
+    }
+    THEN("FindSlot finds the last cell that begins above y") {
+      REQUIRE(index.FindSlot(29) == 0);
+      REQUIRE(index.FindSlot(74) == 2);
+      REQUIRE(index.FindSlot(119) == 4);
+    }
+    THEN("The GroupSkip belongs to the cell above it") {
+      REQUIRE(index.FindSlot(30) == 0);
+      REQUIRE(index.FindSlot(34) == 0);
+      REQUIRE(index.FindSlot(39) == 1);
+      REQUIRE(index.FindSlot(79) == 3);
+    }
+    THEN("Positions outside the worksheet find the first and the last cell") {
+      REQUIRE(index.FindSlot(-100) == 0);
+      REQUIRE(index.FindSlot(9) == 0);
+      REQUIRE(index.FindSlot(120) == 4);
+      REQUIRE(index.FindSlot(100000) == 4);
+    }
+    THEN("FirstCellEndingBelow skips the cells that end at or above y") {
+      REQUIRE(index.FirstCellEndingBelow(-100) == cells[0].get());
+      REQUIRE(index.FirstCellEndingBelow(28) == cells[0].get());
+      REQUIRE(index.FirstCellEndingBelow(29) == cells[1].get());
+      REQUIRE(index.FirstCellEndingBelow(34) == cells[2].get());
+      REQUIRE(index.FirstCellEndingBelow(74) == cells[4].get());
+      REQUIRE(index.FirstCellEndingBelow(118) == cells[4].get());
+    }
+    THEN("There is no cell ending below the end of the worksheet") {
+      REQUIRE(index.FirstCellEndingBelow(119) == nullptr);
+      REQUIRE(index.FirstCellEndingBelow(100000) == nullptr);
+    }
+    THEN("The index contains all cells") {
+      for (std::size_t i = 0; i < cells.size(); i++) {
+        REQUIRE(index.Contains(cells[i].get()));
+        REQUIRE(index.GetSlot(cells[i].get()) == i);
+        REQUIRE(index.GetCell(i) == cells[i].get());
+      }
+    }
+    THEN("Syncing again doesn't rebuild the index") {
+      REQUIRE_FALSE(index.Sync(cells.front().get(), 10, 5));
+    }
+    THEN("Changing the GroupSkip rebuilds the index") {
+      REQUIRE(index.Sync(cells.front().get(), 10, 0));
+      REQUIRE(index.GetTop(4) == 60);
+    }
+    WHEN("A cell's height changes") {
+      cells[1]->SetHeight(10);
+      index.HeightChanged(cells[1].get());
+      THEN("The cells below move down") {
+        REQUIRE(index.GetTop(1) == 35);
+        REQUIRE(index.GetTop(2) == 50);
+        REQUIRE(index.GetTop(4) == 90);
+        REQUIRE(index.FindSlot(49) == 1);
+        REQUIRE(index.FindSlot(50) == 2);
+      }
+    }
+    WHEN("A cell that hasn't been recalculated gets a height") {
+      cells[3]->SetHeight(7);
+      index.HeightChanged(cells[3].get());
+      THEN("It occupies space") {
+        REQUIRE(index.GetBottom(3) == 81);
+        REQUIRE(index.GetTop(4) == 87);
+        REQUIRE(index.FirstCellEndingBelow(80) == cells[3].get());
+      }
+    }
+    WHEN("The list of cells changes") {
+      cells[1]->m_next = cells[3].get();
+      index.ListChanged();
+      THEN("The index doesn't contain any cell until it is rebuilt") {
+        REQUIRE_FALSE(index.Contains(cells[0].get()));
+        REQUIRE(index.Sync(cells.front().get(), 10, 5));
+        REQUIRE(index.Size() == 4);
+        REQUIRE(index.GetTop(2) == 40);
+        REQUIRE(index.GetCell(2) == cells[3].get());
+      }
+    }
+  }
+  GIVEN("No cells") {
+    HeightIndex index;
+    index.Sync(nullptr, 10, 5);
+    THEN("The worksheet ends at the base indent") {
+      REQUIRE(index.Size() == 0);
+      REQUIRE(index.GetTotalHeight() == 10);
+      REQUIRE(index.FirstCellEndingBelow(0) == nullptr);
+    }
+  }
+  GIVEN("A cell of zero height") {
+    auto cells = MakeCells({0});
+    HeightIndex index;
+    index.Sync(cells.front().get(), 0, 0);
+    THEN("It is found at its top, but ends just above it") {
+      REQUIRE(index.FindSlot(0) == 0);
+      REQUIRE(index.FirstCellEndingBelow(0) == nullptr);
+      REQUIRE(index.FirstCellEndingBelow(-2) == cells[0].get());
+    }
+  }
+}
+
+// If we don't provide our own main when compiling on MinGW
+// we currently get an error message that WinMain@16 is missing
+// (https://github.com/catchorg/Catch2/issues/1287)
+int main(int argc, const char* argv[])
+{
+    return Catch::Session().run(argc, argv);
+}
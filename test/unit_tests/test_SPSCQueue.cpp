@@ -0,0 +1,150 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#define CATCH_CONFIG_RUNNER
+#include "SPSCQueue.h"
+#include <catch2/catch.hpp>
+#include <string>
+#include <thread>
+
+SCENARIO("An SPSCQueue starts empty") {
+  GIVEN("A new queue") {
+    SPSCQueue<int> queue(3);
+    THEN("It is empty and not full") {
+      REQUIRE(queue.Empty());
+      REQUIRE_FALSE(queue.Full());
+    }
+    THEN("Pop() fails and leaves the item untouched") {
+      int item = 42;
+      REQUIRE_FALSE(queue.Pop(item));
+      REQUIRE(item == 42);
+    }
+  }
+}
+
+SCENARIO("An SPSCQueue holds exactly its capacity") {
+  GIVEN("A queue with room for 3 items") {
+    SPSCQueue<int> queue(3);
+    WHEN("3 items are pushed") {
+      REQUIRE(queue.Push(1));
+      REQUIRE(queue.Push(2));
+      REQUIRE_FALSE(queue.Full());
+      REQUIRE(queue.Push(3));
+      THEN("It is full") {
+        REQUIRE(queue.Full());
+        REQUIRE_FALSE(queue.Empty());
+      }
+      THEN("A 4th item is refused") {
+        REQUIRE_FALSE(queue.Push(4));
+      }
+      THEN("The items come out in the order they went in") {
+        int item;
+        REQUIRE(queue.Pop(item));
+        REQUIRE(item == 1);
+        REQUIRE_FALSE(queue.Full());
+        REQUIRE(queue.Pop(item));
+        REQUIRE(item == 2);
+        REQUIRE(queue.Pop(item));
+        REQUIRE(item == 3);
+        REQUIRE(queue.Empty());
+        REQUIRE_FALSE(queue.Pop(item));
+      }
+    }
+  }
+}
+
+SCENARIO("An SPSCQueue wraps around the end of its buffer") {
+  GIVEN("A queue with room for 2 items") {
+    SPSCQueue<int> queue(2);
+    WHEN("Many more items than that are passed through it") {
+      int next = 0;
+      int expected = 0;
+      for (int round = 0; round < 10; round++) {
+        while (queue.Push(int(next)))
+          next++;
+        REQUIRE(queue.Full());
+        int item;
+        REQUIRE(queue.Pop(item));
+        REQUIRE(item == expected++);
+      }
+      THEN("No item is lost or duplicated") {
+        int item;
+        while (queue.Pop(item))
+          REQUIRE(item == expected++);
+        REQUIRE(expected == next);
+        REQUIRE(queue.Empty());
+      }
+    }
+  }
+}
+
+SCENARIO("An SPSCQueue doesn't keep popped items alive") {
+  GIVEN("A queue of strings") {
+    SPSCQueue<std::string> queue(2);
+    REQUIRE(queue.Push(std::string(1000, 'x')));
+    WHEN("The item is popped") {
+      std::string item;
+      REQUIRE(queue.Pop(item));
+      THEN("The item has been moved out") {
+        REQUIRE(item.size() == 1000);
+        REQUIRE(queue.Empty());
+      }
+    }
+  }
+}
+
+SCENARIO("An SPSCQueue passes items between two threads") {
+  GIVEN("A small queue") {
+    SPSCQueue<int> queue(7);
+    constexpr int count = 100000;
+    WHEN("One thread pushes and another one pops") {
+      std::thread producer([&queue] {
+        for (int i = 0; i < count; i++)
+          while (!queue.Push(int(i)))
+            std::this_thread::yield();
+      });
+      int expected = 0;
+      bool inOrder = true;
+      while (expected < count) {
+        int item;
+        if (!queue.Pop(item)) {
+          std::this_thread::yield();
+          continue;
+        }
+        inOrder = inOrder && (item == expected);
+        expected++;
+      }
+      producer.join();
+      THEN("All items arrive in order") {
+        REQUIRE(inOrder);
+        REQUIRE(queue.Empty());
+      }
+    }
+  }
+}
+
+// If we don't provide our own main when compiling on MinGW
+// we currently get an error message that WinMain@16 is missing
+// (https://github.com/catchorg/Catch2/issues/1287)
+int main(int argc, const char* argv[])
+{
+    return Catch::Session().run(argc, argv);
+}
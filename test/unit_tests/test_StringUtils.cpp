@@ -0,0 +1,99 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#define CATCH_CONFIG_RUNNER
+#include "StringUtils.cpp"
+#include <catch2/catch.hpp>
+#include <cstring>
+
+//! CompleteUTF8Length() for a string literal
+static std::size_t CompleteLength(const char *data) {
+  return wxm::CompleteUTF8Length(data, std::strlen(data));
+}
+
+SCENARIO("CompleteUTF8Length keeps complete text") {
+  GIVEN("Nothing") {
+    THEN("Nothing is complete") {
+      REQUIRE(wxm::CompleteUTF8Length("", 0) == 0);
+    }
+  }
+  GIVEN("ASCII text") {
+    THEN("All of it is complete") {
+      REQUIRE(CompleteLength("abc") == 3);
+    }
+  }
+  GIVEN("Text ending in complete multibyte chars") {
+    THEN("All of it is complete") {
+      REQUIRE(CompleteLength("a\xC3\xA4") == 3);         // ä
+      REQUIRE(CompleteLength("a\xE2\x88\x9E") == 4);     // ∞
+      REQUIRE(CompleteLength("a\xF0\x9D\x9B\xBC") == 5); // 𝛼
+      REQUIRE(CompleteLength("\xF0\x9D\x9B\xBC") == 4);
+    }
+  }
+}
+
+SCENARIO("CompleteUTF8Length holds back incomplete chars") {
+  GIVEN("A 2-byte char whose last byte is missing") {
+    THEN("The char is held back") {
+      REQUIRE(CompleteLength("ab\xC3") == 2);
+    }
+  }
+  GIVEN("A 3-byte char that is cut after 1 and after 2 bytes") {
+    THEN("The char is held back") {
+      REQUIRE(CompleteLength("ab\xE2") == 2);
+      REQUIRE(CompleteLength("ab\xE2\x88") == 2);
+    }
+  }
+  GIVEN("A 4-byte char that is cut after 1, 2 and 3 bytes") {
+    THEN("The char is held back") {
+      REQUIRE(CompleteLength("ab\xF0") == 2);
+      REQUIRE(CompleteLength("ab\xF0\x9D") == 2);
+      REQUIRE(CompleteLength("ab\xF0\x9D\x9B") == 2);
+    }
+  }
+  GIVEN("Only the start of a char") {
+    THEN("Nothing is complete") {
+      REQUIRE(CompleteLength("\xF0\x9D\x9B") == 0);
+      REQUIRE(CompleteLength("\xC3") == 0);
+    }
+  }
+}
+
+SCENARIO("CompleteUTF8Length doesn't hold back invalid UTF-8 forever") {
+  GIVEN("More continuation bytes than a char can have") {
+    THEN("They are passed on") {
+      REQUIRE(CompleteLength("a\x80\x80\x80") == 4);
+    }
+  }
+  GIVEN("A stray continuation byte after an ASCII char") {
+    THEN("It is passed on") {
+      REQUIRE(CompleteLength("a\x80") == 2);
+    }
+  }
+}
+
+// If we don't provide our own main when compiling on MinGW
+// we currently get an error message that WinMain@16 is missing
+// (https://github.com/catchorg/Catch2/issues/1287)
+int main(int argc, const char* argv[])
+{
+    return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,111 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#define CATCH_CONFIG_RUNNER
+#include "FontAttribs.cpp"
+#include "TextExtentCache.cpp"
+#include <catch2/catch.hpp>
+
+//! Is text in the cache?
+static bool Contains(TextExtentCache &cache, const wxString &text) {
+  wxSize size;
+  return cache.Find(0, text, size);
+}
+
+SCENARIO("TextExtentCache drops the text that has been used least recently") {
+  GIVEN("A full cache for 3 texts") {
+    TextExtentCache cache(3);
+    cache.Add(0, wxS("a"), wxSize(1, 10));
+    cache.Add(0, wxS("b"), wxSize(2, 10));
+    cache.Add(0, wxS("c"), wxSize(3, 10));
+    THEN("It knows all of them") {
+      wxSize size;
+      REQUIRE(cache.Find(0, wxS("b"), size));
+      REQUIRE(size == wxSize(2, 10));
+    }
+    WHEN("More texts are added") {
+      cache.Add(0, wxS("d"), wxSize(4, 10));
+      THEN("The oldest text is dropped first") {
+        REQUIRE_FALSE(Contains(cache, wxS("a")));
+        cache.Add(0, wxS("e"), wxSize(5, 10));
+        REQUIRE_FALSE(Contains(cache, wxS("b")));
+        REQUIRE(Contains(cache, wxS("c")));
+        REQUIRE(Contains(cache, wxS("d")));
+        REQUIRE(Contains(cache, wxS("e")));
+      }
+    }
+    WHEN("The oldest text is looked up") {
+      REQUIRE(Contains(cache, wxS("a")));
+      cache.Add(0, wxS("d"), wxSize(4, 10));
+      THEN("It becomes the newest one and the next oldest text is dropped") {
+        REQUIRE(Contains(cache, wxS("a")));
+        REQUIRE_FALSE(Contains(cache, wxS("b")));
+        REQUIRE(Contains(cache, wxS("c")));
+        REQUIRE(Contains(cache, wxS("d")));
+      }
+    }
+    WHEN("A text is added again") {
+      cache.Add(0, wxS("a"), wxSize(7, 12));
+      THEN("Its size is replaced") {
+        wxSize size;
+        REQUIRE(cache.Find(0, wxS("a"), size));
+        REQUIRE(size == wxSize(7, 12));
+      }
+      THEN("It doesn't take a second place, but becomes the newest text") {
+        cache.Add(0, wxS("d"), wxSize(4, 10));
+        REQUIRE(Contains(cache, wxS("a")));
+        REQUIRE_FALSE(Contains(cache, wxS("b")));
+        REQUIRE(Contains(cache, wxS("c")));
+        REQUIRE(Contains(cache, wxS("d")));
+      }
+    }
+  }
+}
+
+SCENARIO("TextExtentCache distinguishes fonts") {
+  GIVEN("An empty cache") {
+    TextExtentCache cache(10);
+    TextExtentCache::FontKey const font1(wxS("Sans"), 1, 2, 3, AFontSize(10.0f), 96);
+    TextExtentCache::FontKey const font2(wxS("Sans"), 1, 2, 3, AFontSize(12.0f), 96);
+    THEN("Equal fonts get the same id and different fonts different ones") {
+      auto const id1 = cache.GetFontId(font1);
+      auto const id2 = cache.GetFontId(font2);
+      REQUIRE(id1 != id2);
+      REQUIRE(cache.GetFontId(font1) == id1);
+    }
+    WHEN("A text is added for one font") {
+      cache.Add(1, wxS("x"), wxSize(5, 10));
+      THEN("It isn't known for another one") {
+        wxSize size;
+        REQUIRE(cache.Find(1, wxS("x"), size));
+        REQUIRE_FALSE(cache.Find(2, wxS("x"), size));
+      }
+    }
+  }
+}
+
+// If we don't provide our own main when compiling on MinGW
+// we currently get an error message that WinMain@16 is missing
+// (https://github.com/catchorg/Catch2/issues/1287)
+int main(int argc, const char* argv[])
+{
+    return Catch::Session().run(argc, argv);
+}
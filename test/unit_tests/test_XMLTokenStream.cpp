@@ -0,0 +1,357 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2014-2018 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+//  SPDX-License-Identifier: GPL-2.0+
+
+#define CATCH_CONFIG_RUNNER
+#include "XMLTokenStream.cpp"
+#include <catch2/catch.hpp>
+
+/*! All tokens the stream reads from now on, as a string
+
+  Start tags are written as "<name>", texts as "[text]", end tags as
+  "</name>". A stream that fails ends in "error".
+*/
+static wxString Tokens(XMLTokenStream &xml) {
+  wxString result;
+  while (true) {
+    switch (xml.Next()) {
+    case XMLTokenStream::startTag:
+      result += wxS("<") + xml.GetName() + wxS(">");
+      break;
+    case XMLTokenStream::text:
+      result += wxS("[") + xml.GetText() + wxS("]");
+      break;
+    case XMLTokenStream::endTag:
+      result += wxS("</") + xml.GetName() + wxS(">");
+      break;
+    case XMLTokenStream::error:
+      return result + wxS("error");
+    default:
+      return result;
+    }
+  }
+}
+
+//! All tokens a string of XML consists of
+static wxString Tokens(const wxString &xmlText) {
+  XMLTokenStream xml(xmlText);
+  return Tokens(xml);
+}
+
+//! The text the first text token of an XML string contains
+static wxString FirstText(const wxString &xmlText) {
+  XMLTokenStream xml(xmlText);
+  while ((xml.Next() != XMLTokenStream::text) && (xml.GetType() != XMLTokenStream::end) &&
+         (xml.GetType() != XMLTokenStream::error)) {}
+  return xml.GetText();
+}
+
+SCENARIO("XMLTokenStream reads the XML maxima sends") {
+  GIVEN("Nested elements") {
+    wxString const xml = wxS("<mth><p><v>x</v><t>+</t><n>1</n></p></mth>");
+    THEN("They are read as start tags, texts and end tags") {
+      REQUIRE(Tokens(xml) ==
+              wxS("<mth><p><v>[x]</v><t>[+]</t><n>[1]</n></p></mth>"));
+    }
+    THEN("The depth counts the elements that are open") {
+      XMLTokenStream tokens(xml);
+      REQUIRE(tokens.Next() == XMLTokenStream::startTag);
+      REQUIRE(tokens.GetDepth() == 1);
+      REQUIRE(tokens.Next() == XMLTokenStream::startTag);
+      REQUIRE(tokens.GetDepth() == 2);
+      REQUIRE(tokens.Next() == XMLTokenStream::startTag);
+      REQUIRE(tokens.Next() == XMLTokenStream::text);
+      REQUIRE(tokens.GetDepth() == 3);
+      REQUIRE(tokens.Next() == XMLTokenStream::endTag);
+      REQUIRE(tokens.GetDepth() == 2);
+    }
+  }
+  GIVEN("An empty element") {
+    THEN("It is read as a start and an end tag") {
+      REQUIRE(Tokens(wxS("<mth><e/><v>x</v></mth>")) ==
+              wxS("<mth><e></e><v>[x]</v></mth>"));
+      REQUIRE(Tokens(wxS("<mth/>")) == wxS("<mth></mth>"));
+    }
+  }
+  GIVEN("A start tag with attributes") {
+    wxString const xml =
+      wxS("<lbl altCopy=\"%o1\" userdefined='yes' x = \"a&amp;b\">(%o1)</lbl>");
+    XMLTokenStream tokens(xml);
+    REQUIRE(tokens.Next() == XMLTokenStream::startTag);
+    THEN("The attributes can be read, no matter how they are quoted") {
+      REQUIRE(tokens.GetTag().GetAttribute(wxS("altCopy")) == wxS("%o1"));
+      REQUIRE(tokens.GetTag().GetAttribute(wxS("userdefined")) == wxS("yes"));
+      REQUIRE(tokens.GetTag().HasAttribute(wxS("x")));
+    }
+    THEN("Entities in attributes are decoded") {
+      REQUIRE(tokens.GetTag().GetAttribute(wxS("x")) == wxS("a&b"));
+    }
+    THEN("Missing attributes return the default value") {
+      wxString value;
+      REQUIRE_FALSE(tokens.GetTag().GetAttribute(wxS("missing"), &value));
+      REQUIRE(tokens.GetTag().GetAttribute(wxS("missing"), wxS("default")) ==
+              wxS("default"));
+    }
+  }
+  GIVEN("XML declarations, doctypes and comments") {
+    THEN("They are skipped") {
+      REQUIRE(Tokens(wxS("<?xml version=\"1.0\"?><!DOCTYPE mth>"
+                         "<mth><!-- a comment -- with dashes --><v>x</v></mth>")) ==
+              wxS("<mth><v>[x]</v></mth>"));
+    }
+  }
+}
+
+SCENARIO("XMLTokenStream decodes entities") {
+  GIVEN("The predefined entities") {
+    THEN("They are decoded") {
+      REQUIRE(FirstText(wxS("<t>&amp;&lt;&gt;&quot;&apos;</t>")) ==
+              wxS("&<>\"'"));
+    }
+  }
+  GIVEN("Numeric character references") {
+    THEN("Decimal and hexadecimal references are decoded") {
+      REQUIRE(FirstText(wxS("<t>&#65;&#x42;&#X43;</t>")) == wxS("ABC"));
+      REQUIRE(FirstText(wxS("<t>&#x3c0;</t>")) == wxS("π"));
+    }
+    THEN("References that aren't valid chars are kept as they are") {
+      REQUIRE(FirstText(wxS("<t>&#x110000;</t>")) == wxS("&#x110000;"));
+      REQUIRE(FirstText(wxS("<t>&#xyz;</t>")) == wxS("&#xyz;"));
+    }
+  }
+  GIVEN("Entities XML doesn't define") {
+    THEN("They are kept as they are") {
+      REQUIRE(FirstText(wxS("<t>&pi;</t>")) == wxS("&pi;"));
+    }
+  }
+  GIVEN("An ampersand that doesn't start an entity") {
+    THEN("It is kept") {
+      REQUIRE(FirstText(wxS("<t>a & b</t>")) == wxS("a & b"));
+      REQUIRE(FirstText(wxS("<t>a &amp</t>")) == wxS("a &amp"));
+    }
+  }
+}
+
+SCENARIO("XMLTokenStream replaces control chars") {
+  GIVEN("Control chars in a text") {
+    THEN("They are replaced by a replacement character") {
+      REQUIRE(FirstText(wxS("<t>a\u0001b\u007Fc</t>")) ==
+              wxS("a�b�c"));
+      REQUIRE(FirstText(wxS("<t>a\nb</t>")) == wxS("a�b"));
+    }
+  }
+  GIVEN("References to control chars") {
+    THEN("They are replaced, too") {
+      REQUIRE(FirstText(wxS("<t>&#1;&#x9F;</t>")) == wxS("��"));
+    }
+  }
+  GIVEN("Control chars in an attribute") {
+    wxString const xml = wxS("<t a=\"x\u0002y\"/>");
+    XMLTokenStream tokens(xml);
+    REQUIRE(tokens.Next() == XMLTokenStream::startTag);
+    THEN("They are replaced") {
+      REQUIRE(tokens.GetTag().GetAttribute(wxS("a")) == wxS("x�y"));
+    }
+  }
+}
+
+SCENARIO("XMLTokenStream detects broken XML") {
+  THEN("End tags must match the start tags") {
+    REQUIRE(Tokens(wxS("<mth><v>x</t></mth>")) == wxS("<mth><v>[x]error"));
+  }
+  THEN("Elements must be closed") {
+    REQUIRE(Tokens(wxS("<mth><v>x</v>")) == wxS("<mth><v>[x]</v>error"));
+  }
+  THEN("There must be only one root element") {
+    REQUIRE(Tokens(wxS("<mth></mth><mth></mth>")) == wxS("<mth></mth>error"));
+  }
+  THEN("Tags must be complete") {
+    REQUIRE(Tokens(wxS("<mth><v")) == wxS("<mth>error"));
+    REQUIRE(Tokens(wxS("<mth a=b></mth>")) == wxS("error"));
+  }
+  THEN("Reading on after an error returns an error, again") {
+    wxString const xml = wxS("<mth></t>");
+    XMLTokenStream tokens(xml);
+    REQUIRE(tokens.Next() == XMLTokenStream::startTag);
+    REQUIRE(tokens.Next() == XMLTokenStream::error);
+    REQUIRE(tokens.Next() == XMLTokenStream::error);
+  }
+}
+
+SCENARIO("XMLTokenStream can look ahead") {
+  GIVEN("A stream at a start tag") {
+    wxString const xml = wxS("<mth><v>x</v><t>+</t></mth>");
+    XMLTokenStream tokens(xml);
+    tokens.Next();
+    tokens.Next();
+    REQUIRE(tokens.GetName() == wxS("v"));
+    WHEN("A copy reads on") {
+      XMLTokenStream lookAhead = tokens;
+      lookAhead.Next();
+      lookAhead.Next();
+      lookAhead.Next();
+      REQUIRE(lookAhead.GetName() == wxS("t"));
+      THEN("The original stays where it was") {
+        REQUIRE(tokens.GetType() == XMLTokenStream::startTag);
+        REQUIRE(tokens.GetName() == wxS("v"));
+        REQUIRE(tokens.GetDepth() == 2);
+        REQUIRE(Tokens(tokens) == wxS("[x]</v><t>[+]</t></mth>"));
+      }
+    }
+    WHEN("The original reads on and the copy is assigned back") {
+      XMLTokenStream const saved = tokens;
+      REQUIRE(Tokens(tokens) == wxS("[x]</v><t>[+]</t></mth>"));
+      tokens = saved;
+      THEN("The stream returns to where it was") {
+        REQUIRE(tokens.GetName() == wxS("v"));
+        REQUIRE(Tokens(tokens) == wxS("[x]</v><t>[+]</t></mth>"));
+      }
+    }
+  }
+}
+
+SCENARIO("XMLTokenStream skips elements") {
+  GIVEN("A stream at a start tag") {
+    wxString const xml = wxS("<mth><p><v>x</v><v>y</v></p><t>+</t></mth>");
+    XMLTokenStream tokens(xml);
+    tokens.Next();
+    tokens.Next();
+    REQUIRE(tokens.GetName() == wxS("p"));
+    WHEN("The element is skipped") {
+      tokens.Skip();
+      THEN("The stream is at the token after the element") {
+        REQUIRE(tokens.GetType() == XMLTokenStream::startTag);
+        REQUIRE(tokens.GetName() == wxS("t"));
+        REQUIRE(tokens.GetDepth() == 2);
+      }
+    }
+    WHEN("The stream advances to the end of the element") {
+      std::size_t const depth = tokens.GetDepth();
+      tokens.Next();
+      tokens.Next();
+      REQUIRE(tokens.ReadText() == wxS("x"));
+      REQUIRE(tokens.GetType() == XMLTokenStream::endTag);
+      tokens.SkipToEndOf(depth);
+      THEN("The stream is at the token after the element") {
+        REQUIRE(tokens.GetName() == wxS("t"));
+      }
+    }
+  }
+}
+
+SCENARIO("XMLTokenStream walks trees of XML nodes") {
+  GIVEN("A tree with elements, texts, CDATA and a comment") {
+    wxXmlNode root(wxXML_ELEMENT_NODE, wxS("mth"));
+    auto *v = new wxXmlNode(&root, wxXML_ELEMENT_NODE, wxS("v"));
+    v->AddAttribute(wxS("type"), wxS("x"));
+    new wxXmlNode(v, wxXML_TEXT_NODE, wxEmptyString, wxS("x"));
+    new wxXmlNode(&root, wxXML_COMMENT_NODE, wxEmptyString, wxS("comment"));
+    auto *t = new wxXmlNode(&root, wxXML_ELEMENT_NODE, wxS("t"));
+    new wxXmlNode(t, wxXML_CDATA_SECTION_NODE, wxEmptyString, wxS("a<b"));
+    new wxXmlNode(&root, wxXML_ELEMENT_NODE, wxS("e"));
+    THEN("It is read exactly like the XML it stands for") {
+      XMLTokenStream tokens(&root);
+      REQUIRE(Tokens(tokens) == wxS("<mth><v>[x]</v><t>[a<b]</t><e></e></mth>"));
+    }
+    THEN("Attributes are read") {
+      XMLTokenStream tokens(&root);
+      tokens.Next();
+      tokens.Next();
+      REQUIRE(tokens.GetTag().GetAttribute(wxS("type")) == wxS("x"));
+    }
+    THEN("Copies of the stream look ahead") {
+      XMLTokenStream tokens(&root);
+      tokens.Next();
+      tokens.Next();
+      XMLTokenStream lookAhead = tokens;
+      REQUIRE(Tokens(lookAhead) == wxS("[x]</v><t>[a<b]</t><e></e></mth>"));
+      REQUIRE(tokens.GetName() == wxS("v"));
+      REQUIRE(Tokens(tokens) == wxS("[x]</v><t>[a<b]</t><e></e></mth>"));
+    }
+  }
+}
+
+SCENARIO("XMLTokenStream writes elements back as XML") {
+  GIVEN("Maxima's XML with entities, attributes and control chars") {
+    wxString const xml =
+      wxS("<mth><lbl altCopy=\"a&quot;b\">(%o1) </lbl><t>&lt;&#65;&pi;\u0001</t>"
+          "<e/><v>x</v></mth>");
+    XMLTokenStream tokens(xml);
+    tokens.Next();
+    wxString contents;
+    REQUIRE(tokens.ReadContentsAsXML(contents));
+    THEN("The stream is behind the element") {
+      REQUIRE(tokens.GetType() == XMLTokenStream::end);
+    }
+    THEN("The contents are written back with everything decoded re-encoded") {
+      REQUIRE(contents ==
+              wxS("<lbl altCopy=\"a&quot;b\">(%o1) </lbl>"
+                  "<t>&lt;A&amp;pi;�</t><e></e><v>x</v>"));
+    }
+    THEN("Reading the contents again gives the same tokens") {
+      REQUIRE(Tokens(wxS("<mth>") + contents + wxS("</mth>")) ==
+              Tokens(xml));
+      REQUIRE(FirstText(wxS("<mth>") + contents + wxS("</mth>")) ==
+              wxS("(%o1) "));
+    }
+  }
+  GIVEN("An element inside the XML") {
+    wxString const xml = wxS("<mth><p><v>x</v></p><t>+</t></mth>");
+    XMLTokenStream tokens(xml);
+    tokens.Next();
+    tokens.Next();
+    wxString contents;
+    REQUIRE(tokens.ReadContentsAsXML(contents));
+    THEN("Only its contents are written") {
+      REQUIRE(contents == wxS("<v>x</v>"));
+    }
+    THEN("The stream is at the token after the element") {
+      REQUIRE(tokens.GetName() == wxS("t"));
+    }
+  }
+  GIVEN("Broken XML") {
+    wxString const xml = wxS("<mth><v>x</t></mth>");
+    XMLTokenStream tokens(xml);
+    tokens.Next();
+    wxString contents;
+    THEN("Writing it fails") {
+      REQUIRE_FALSE(tokens.ReadContentsAsXML(contents));
+    }
+  }
+  GIVEN("A stream that isn't at a start tag") {
+    wxString const xml = wxS("<mth>x</mth>");
+    XMLTokenStream tokens(xml);
+    tokens.Next();
+    tokens.Next();
+    wxString contents;
+    THEN("Nothing is written") {
+      REQUIRE_FALSE(tokens.ReadContentsAsXML(contents));
+      REQUIRE(contents.IsEmpty());
+    }
+  }
+}
+
+// If we don't provide our own main when compiling on MinGW
+// we currently get an error message that WinMain@16 is missing
+// (https://github.com/catchorg/Catch2/issues/1287)
+int main(int argc, const char* argv[])
+{
+    return Catch::Session().run(argc, argv);
+}